@@ -20,6 +20,7 @@
 #include <util/translation.h>
 
 #include <cstdint>
+#include <cstdio>
 
 namespace {
 
@@ -122,6 +123,90 @@ void DeserializeFileDB(const CChainParams &chainParams, const fs::path &path,
     DeserializeDB(chainParams, filein, data);
 }
 
+/**
+ * Append the changes made to addrman since it was last written to peers.dat
+ * as a journal, so the file does not have to be rewritten whole. Journals are
+ * framed like a full file, with a network magic and a checksum, so a
+ * truncated or corrupt one can be detected and dropped. Older versions stop
+ * reading the file after the full serialization and ignore them.
+ *
+ * @return false if the file has to be rewritten whole instead.
+ */
+bool AppendPeersJournal(const CChainParams &chainParams, const fs::path &path,
+                        const AddrMan &addr) {
+    CDataStream journal(SER_DISK, CLIENT_VERSION);
+    if (!addr.SerializeJournal(journal)) {
+        return false;
+    }
+    if (journal.empty()) {
+        return true;
+    }
+    if (!fs::exists(path)) {
+        return false;
+    }
+
+    FILE *file = fsbridge::fopen(path, "ab");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        return error("%s: Failed to open file %s", __func__,
+                     fs::PathToString(path));
+    }
+    const std::vector<uint8_t> data{UCharCast(journal.data()),
+                                    UCharCast(journal.data() + journal.size())};
+    if (!SerializeDB(chainParams, fileout, data)) {
+        return false;
+    }
+    if (!FileCommit(fileout.Get())) {
+        return error("%s: Failed to flush file %s", __func__,
+                     fs::PathToString(path));
+    }
+    return true;
+}
+
+/**
+ * Read peers.dat: the full serialization of addrman followed by the journals
+ * appended since it was written.
+ *
+ * @return false if a journal is truncated or corrupt, e.g. after a crash
+ *         while it was appended. The journals before it are applied.
+ */
+bool ReadPeersFile(const CChainParams &chainParams, const fs::path &path,
+                   AddrMan &addr) {
+    FILE *file = fsbridge::fopen(path, "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        throw DbNotFoundError{};
+    }
+
+    DeserializeDB(chainParams, filein, addr);
+
+    int journals{0};
+    while (true) {
+        const int c{std::fgetc(filein.Get())};
+        if (c == EOF) {
+            break;
+        }
+        std::ungetc(c, filein.Get());
+
+        std::vector<uint8_t> data;
+        try {
+            DeserializeDB(chainParams, filein, data);
+        } catch (const std::exception &e) {
+            LogPrintf("Dropping journal %d and the rest of peers.dat (%s)\n",
+                      journals + 1, e.what());
+            return false;
+        }
+        CDataStream journal(data, SER_DISK, CLIENT_VERSION);
+        addr.UnserializeJournal(journal);
+        ++journals;
+    }
+    if (journals > 0) {
+        LogPrint(BCLog::ADDRMAN, "Applied %d journals from peers.dat\n",
+                 journals);
+    }
+    return true;
+}
+
 } // namespace
 
 CBanDB::CBanDB(fs::path ban_list_path, const CChainParams &_chainParams)
@@ -151,6 +236,10 @@ bool CBanDB::Read(banmap_t &banSet) {
 bool DumpPeerAddresses(const CChainParams &chainParams, const ArgsManager &args,
                        const AddrMan &addr) {
     const auto pathAddr = args.GetDataDirNet() / "peers.dat";
+    if (args.GetBoolArg("-peersjournal", DEFAULT_PEERS_JOURNAL) &&
+        AppendPeersJournal(chainParams, pathAddr, addr)) {
+        return true;
+    }
     return SerializeFileDB(chainParams, "peers", pathAddr, addr,
                            CLIENT_VERSION);
 }
@@ -172,9 +261,16 @@ LoadAddrman(const CChainParams &chainparams, const std::vector<bool> &asmap,
     int64_t nStart = GetTimeMillis();
     const auto path_addr{args.GetDataDirNet() / "peers.dat"};
     try {
-        DeserializeFileDB(chainparams, path_addr, *addrman, CLIENT_VERSION);
+        const bool journals_valid{
+            ReadPeersFile(chainparams, path_addr, *addrman)};
         LogPrintf("Loaded %i addresses from peers.dat  %dms\n", addrman->size(),
                   GetTimeMillis() - nStart);
+        if (!journals_valid) {
+            // Rewrite the file whole, or the next journals would be appended
+            // after the damaged one and dropped with it.
+            SerializeFileDB(chainparams, "peers", path_addr, *addrman,
+                            CLIENT_VERSION);
+        }
     } catch (const DbNotFoundError &) {
         // Addrman can be in an inconsistent state after failure, reset it
         addrman = std::make_unique<AddrMan>(
@@ -21,6 +21,13 @@ class CAddress;
 class CDataStream;
 class CChainParams;
 
+/** Default for -peersjournal */
+static constexpr bool DEFAULT_PEERS_JOURNAL{false};
+
+/**
+ * Write addrman to peers.dat, or with -peersjournal only append the changes
+ * made since it was last written, when there are few enough of them.
+ */
 bool DumpPeerAddresses(const CChainParams &chainParams, const ArgsManager &args,
                        const AddrMan &addr);
 /** Only used by tests. */
@@ -19,6 +19,7 @@
 #include <util/check.h>
 #include <util/time.h>
 
+#include <algorithm>
 #include <cmath>
 #include <optional>
 
@@ -51,6 +52,11 @@ static constexpr auto ADDRMAN_REPLACEMENT{4h};
 static constexpr size_t ADDRMAN_SET_TRIED_COLLISION_SIZE{10};
 /** The maximum time we'll spend trying to resolve a tried table collision */
 static constexpr auto ADDRMAN_TEST_WINDOW{40min};
+/**
+ * Past as many journal entries as there are addresses, a full serialization is
+ * cheaper to write and to load, but small tables are allowed this many.
+ */
+static constexpr size_t ADDRMAN_JOURNAL_MIN_ENTRIES{1000};
 
 int AddrInfo::GetTriedBucket(const uint256 &nKey,
                              const std::vector<bool> &asmap) const {
@@ -242,6 +248,11 @@ template <typename Stream> void AddrManImpl::Serialize(Stream &s_) const {
         asmap_checksum = (HashWriter{} << m_asmap).GetHash();
     }
     s << asmap_checksum;
+
+    // Journals are now serialized against this serialization.
+    m_journal_changes.clear();
+    m_journal_entries = 0;
+    m_journal_invalid = false;
 }
 
 template <typename Stream> void AddrManImpl::Unserialize(Stream &s_) {
@@ -326,7 +337,7 @@ template <typename Stream> void AddrManImpl::Unserialize(Stream &s_) {
             vRandom.push_back(nIdCount);
             mapInfo[nIdCount] = info;
             mapAddr[info] = nIdCount;
-            vvTried[nKBucket][nKBucketPos] = nIdCount;
+            vvTried.Set(nKBucket, nKBucketPos, nIdCount);
             nIdCount++;
         } else {
             nLost++;
@@ -389,7 +400,7 @@ template <typename Stream> void AddrManImpl::Unserialize(Stream &s_) {
         if (restore_bucketing && vvNew[bucket][bucket_position] == -1) {
             // Bucketing has not changed, using existing bucket positions
             // for the new table
-            vvNew[bucket][bucket_position] = entry_index;
+            vvNew.Set(bucket, bucket_position, entry_index);
             ++info.nRefCount;
         } else {
             // In case the new table data cannot be used (bucket count
@@ -398,7 +409,7 @@ template <typename Stream> void AddrManImpl::Unserialize(Stream &s_) {
             bucket = info.GetNewBucket(nKey, m_asmap);
             bucket_position = info.GetBucketPosition(nKey, true, bucket);
             if (vvNew[bucket][bucket_position] == -1) {
-                vvNew[bucket][bucket_position] = entry_index;
+                vvNew.Set(bucket, bucket_position, entry_index);
                 ++info.nRefCount;
             }
         }
@@ -427,6 +438,253 @@ template <typename Stream> void AddrManImpl::Unserialize(Stream &s_) {
         throw std::ios_base::failure(strprintf(
             "Corrupt data. Consistency check failed with code %s", check_code));
     }
+
+    // Journals can only be applied on top of the serialized tables, so they
+    // cannot be serialized against them if some entries were moved or lost.
+    m_journal_changes.clear();
+    m_journal_entries = 0;
+    m_journal_invalid = !restore_bucketing || nLost + nLostUnk > 0;
+}
+
+template <typename Stream>
+bool AddrManImpl::SerializeJournal(Stream &s_) const {
+    LOCK(cs);
+
+    if (m_journal_invalid) {
+        return false;
+    }
+    if (m_journal_changes.empty()) {
+        return true;
+    }
+
+    /**
+     * Serialized format.
+     * * format version byte (JOURNAL_FORMAT)
+     * * asmap checksum
+     * * number of changed entries
+     * * for each changed entry:
+     *   * whether it is still in addrman
+     *   * if so, the entry, whether it is in tried and the list of the "new"
+     *     buckets holding it
+     *   * otherwise its address
+     *
+     * Positions are not serialized, they are derived from the buckets.
+     */
+    OverrideStream<Stream> s(&s_, s_.GetType(),
+                             s_.GetVersion() | ADDRV2_FORMAT);
+
+    s << JOURNAL_FORMAT;
+    uint256 asmap_checksum;
+    if (m_asmap.size() != 0) {
+        asmap_checksum = (HashWriter{} << m_asmap).GetHash();
+    }
+    s << asmap_checksum;
+
+    // Find the buckets of the changed entries with a single pass over the new
+    // table, instead of hashing their position in every bucket.
+    std::unordered_map<int, std::vector<int>> new_buckets;
+    for (const CService &addr : m_journal_changes) {
+        const auto it{mapAddr.find(addr)};
+        if (it != mapAddr.end()) {
+            new_buckets[it->second];
+        }
+    }
+    for (size_t i = 0; i < vvNew.NonEmptyBuckets(); ++i) {
+        const int bucket{vvNew.GetNonEmptyBucket(i)};
+        for (const int nId : vvNew[bucket]) {
+            const auto it{new_buckets.find(nId)};
+            if (it != new_buckets.end()) {
+                it->second.push_back(bucket);
+            }
+        }
+    }
+
+    WriteCompactSize(s, m_journal_changes.size());
+    for (const CService &addr : m_journal_changes) {
+        const auto it{mapAddr.find(addr)};
+        if (it == mapAddr.end()) {
+            s << false << addr;
+            continue;
+        }
+        const AddrInfo &info{mapInfo.at(it->second)};
+        s << true << info << info.fInTried << new_buckets[it->second];
+    }
+
+    m_journal_entries += m_journal_changes.size();
+    m_journal_changes.clear();
+    return true;
+}
+
+template <typename Stream> void AddrManImpl::UnserializeJournal(Stream &s_) {
+    LOCK(cs);
+
+    OverrideStream<Stream> s(&s_, s_.GetType(),
+                             s_.GetVersion() | ADDRV2_FORMAT);
+
+    uint8_t format;
+    s >> format;
+    if (format != JOURNAL_FORMAT) {
+        throw std::ios_base::failure(strprintf(
+            "Unsupported format of addrman journal: %u", format));
+    }
+
+    uint256 supplied_asmap_checksum;
+    if (m_asmap.size() != 0) {
+        supplied_asmap_checksum = SerializeHash(m_asmap);
+    }
+    uint256 serialized_asmap_checksum;
+    s >> serialized_asmap_checksum;
+    const bool restore_bucketing{serialized_asmap_checksum ==
+                                 supplied_asmap_checksum};
+
+    // Read the whole journal before changing anything, so a corrupt one leaves
+    // addrman untouched.
+    const uint64_t num_changes{ReadCompactSize(s)};
+    std::vector<CService> changed;
+    std::vector<JournalEntry> entries;
+    for (uint64_t n = 0; n < num_changes; ++n) {
+        bool present;
+        s >> present;
+        if (!present) {
+            CService addr;
+            s >> addr;
+            changed.push_back(addr);
+            continue;
+        }
+
+        JournalEntry entry;
+        s >> entry.info >> entry.in_tried >> entry.new_buckets;
+        if ((entry.in_tried && !entry.new_buckets.empty()) ||
+            entry.new_buckets.size() > ADDRMAN_NEW_BUCKETS_PER_ADDRESS ||
+            std::any_of(entry.new_buckets.begin(), entry.new_buckets.end(),
+                        [](int bucket) {
+                            return bucket < 0 ||
+                                   bucket >= ADDRMAN_NEW_BUCKET_COUNT;
+                        })) {
+            throw std::ios_base::failure(
+                strprintf("Corrupt addrman journal: invalid buckets for %s",
+                          entry.info.ToString()));
+        }
+        changed.push_back(entry.info);
+        entries.push_back(std::move(entry));
+    }
+
+    // Remove the changed entries first and then add them back as they were
+    // when the journal was serialized, so that they don't collide with their
+    // former selves.
+    std::unordered_set<int> removed;
+    for (const CService &addr : changed) {
+        int nId;
+        AddrInfo *pinfo = Find(addr, &nId);
+        if (!pinfo) {
+            continue;
+        }
+        if (pinfo->fInTried) {
+            const int bucket{pinfo->GetTriedBucket(nKey, m_asmap)};
+            vvTried.Set(bucket, pinfo->GetBucketPosition(nKey, false, bucket),
+                        -1);
+            pinfo->fInTried = false;
+            nTried--;
+            // Delete() expects an entry of the new table.
+            nNew++;
+        }
+        removed.insert(nId);
+    }
+    if (!removed.empty()) {
+        // Emptying a bucket moves the last non-empty one in its place, so
+        // iterate backwards to visit each one once.
+        for (size_t i = vvNew.NonEmptyBuckets(); i-- > 0;) {
+            const int bucket{vvNew.GetNonEmptyBucket(i)};
+            for (int pos = 0; pos < ADDRMAN_BUCKET_SIZE; ++pos) {
+                const int nId{vvNew[bucket][pos]};
+                if (nId != -1 && removed.count(nId)) {
+                    vvNew.Set(bucket, pos, -1);
+                    mapInfo[nId].nRefCount--;
+                }
+            }
+        }
+        for (const int nId : removed) {
+            Delete(nId);
+        }
+    }
+
+    int nLost = 0;
+    for (JournalEntry &entry : entries) {
+        if (mapAddr.count(entry.info)) {
+            nLost++;
+            continue;
+        }
+        const int nId = nIdCount++;
+        AddrInfo &info = mapInfo[nId];
+        info = std::move(entry.info);
+        mapAddr[info] = nId;
+        info.nRandomPos = vRandom.size();
+        vRandom.push_back(nId);
+        nNew++;
+
+        if (entry.in_tried) {
+            const int bucket{info.GetTriedBucket(nKey, m_asmap)};
+            const int pos{info.GetBucketPosition(nKey, false, bucket)};
+            if (vvTried[bucket][pos] == -1) {
+                vvTried.Set(bucket, pos, nId);
+                info.fInTried = true;
+                nNew--;
+                nTried++;
+            }
+        }
+        for (int bucket : entry.new_buckets) {
+            if (!restore_bucketing) {
+                // Like when loading the tables, give the entry a single
+                // reference based on its primary source.
+                bucket = info.GetNewBucket(nKey, m_asmap);
+            }
+            const int pos{info.GetBucketPosition(nKey, true, bucket)};
+            if (vvNew[bucket][pos] == -1) {
+                vvNew.Set(bucket, pos, nId);
+                ++info.nRefCount;
+            }
+            if (!restore_bucketing) {
+                break;
+            }
+        }
+        if (!info.fInTried && info.nRefCount == 0) {
+            Delete(nId);
+            nLost++;
+        }
+    }
+    if (nLost > 0) {
+        LogPrint(BCLog::ADDRMAN,
+                 "addrman lost %i addresses from its journal due to "
+                 "collisions\n",
+                 nLost);
+    }
+
+    const int check_code{CheckAddrman()};
+    if (check_code != 0) {
+        throw std::ios_base::failure(strprintf(
+            "Corrupt journal. Consistency check failed with code %s",
+            check_code));
+    }
+
+    m_journal_changes.clear();
+    m_journal_entries += num_changes;
+    if (!restore_bucketing || nLost > 0) {
+        m_journal_invalid = true;
+    }
+}
+
+void AddrManImpl::JournalChange(const CService &addr) {
+    AssertLockHeld(cs);
+
+    if (m_journal_invalid) {
+        return;
+    }
+    m_journal_changes.insert(addr);
+    if (m_journal_entries + m_journal_changes.size() >
+        std::max(vRandom.size(), ADDRMAN_JOURNAL_MIN_ENTRIES)) {
+        m_journal_invalid = true;
+        m_journal_changes.clear();
+    }
 }
 
 AddrInfo *AddrManImpl::Find(const CService &addr, int *pnId) {
@@ -494,6 +752,7 @@ void AddrManImpl::Delete(int nId) {
     assert(!info.fInTried);
     assert(info.nRefCount == 0);
 
+    JournalChange(info);
     SwapRandom(info.nRandomPos, vRandom.size() - 1);
     vRandom.pop_back();
     mapAddr.erase(info);
@@ -510,7 +769,8 @@ void AddrManImpl::ClearNew(int nUBucket, int nUBucketPos) {
         AddrInfo &infoDelete = mapInfo[nIdDelete];
         assert(infoDelete.nRefCount > 0);
         infoDelete.nRefCount--;
-        vvNew[nUBucket][nUBucketPos] = -1;
+        vvNew.Set(nUBucket, nUBucketPos, -1);
+        JournalChange(infoDelete);
         LogPrint(BCLog::ADDRMAN, "Removed %s from new[%i][%i]\n",
                  infoDelete.ToString(), nUBucket, nUBucketPos);
         if (infoDelete.nRefCount == 0) {
@@ -522,13 +782,15 @@ void AddrManImpl::ClearNew(int nUBucket, int nUBucketPos) {
 void AddrManImpl::MakeTried(AddrInfo &info, int nId) {
     AssertLockHeld(cs);
 
+    JournalChange(info);
+
     // remove the entry from all new buckets
     const int start_bucket{info.GetNewBucket(nKey, m_asmap)};
     for (int n = 0; n < ADDRMAN_NEW_BUCKET_COUNT; ++n) {
         const int bucket{(start_bucket + n) % ADDRMAN_NEW_BUCKET_COUNT};
         const int pos{info.GetBucketPosition(nKey, true, bucket)};
         if (vvNew[bucket][pos] == nId) {
-            vvNew[bucket][pos] = -1;
+            vvNew.Set(bucket, pos, -1);
             info.nRefCount--;
             if (info.nRefCount == 0) {
                 break;
@@ -552,8 +814,9 @@ void AddrManImpl::MakeTried(AddrInfo &info, int nId) {
         AddrInfo &infoOld = mapInfo[nIdEvict];
 
         // Remove the to-be-evicted item from the tried set.
+        JournalChange(infoOld);
         infoOld.fInTried = false;
-        vvTried[nKBucket][nKBucketPos] = -1;
+        vvTried.Set(nKBucket, nKBucketPos, -1);
         nTried--;
 
         // find which new bucket it belongs to
@@ -564,7 +827,7 @@ void AddrManImpl::MakeTried(AddrInfo &info, int nId) {
 
         // Enter it into the new set again.
         infoOld.nRefCount = 1;
-        vvNew[nUBucket][nUBucketPos] = nIdEvict;
+        vvNew.Set(nUBucket, nUBucketPos, nIdEvict);
         nNew++;
         LogPrint(BCLog::ADDRMAN,
                  "Moved %s from tried[%i][%i] to new[%i][%i] to make space\n",
@@ -573,7 +836,7 @@ void AddrManImpl::MakeTried(AddrInfo &info, int nId) {
     }
     assert(vvTried[nKBucket][nKBucketPos] == -1);
 
-    vvTried[nKBucket][nKBucketPos] = nId;
+    vvTried.Set(nKBucket, nKBucketPos, nId);
     nTried++;
     info.fInTried = true;
 }
@@ -595,6 +858,9 @@ bool AddrManImpl::AddSingle(const CAddress &addr, const CNetAddr &source,
     }
 
     if (pinfo) {
+        const NodeSeconds old_time{pinfo->nTime};
+        const ServiceFlags old_services{pinfo->nServices};
+
         // periodically update nTime
         const bool currently_online{NodeClock::now() - addr.nTime < 24h};
         const auto update_interval{currently_online ? 1h : 24h};
@@ -605,6 +871,10 @@ bool AddrManImpl::AddSingle(const CAddress &addr, const CNetAddr &source,
         // add services
         pinfo->nServices = ServiceFlags(pinfo->nServices | addr.nServices);
 
+        if (pinfo->nTime != old_time || pinfo->nServices != old_services) {
+            JournalChange(addr);
+        }
+
         // do not update if no new information is present
         if (addr.nTime <= pinfo->nTime) {
             return false;
@@ -651,7 +921,8 @@ bool AddrManImpl::AddSingle(const CAddress &addr, const CNetAddr &source,
         if (fInsert) {
             ClearNew(nUBucket, nUBucketPos);
             pinfo->nRefCount++;
-            vvNew[nUBucket][nUBucketPos] = nId;
+            vvNew.Set(nUBucket, nUBucketPos, nId);
+            JournalChange(addr);
             LogPrint(BCLog::ADDRMAN, "Added %s mapped to AS%i to new[%i][%i]\n",
                      addr.ToString(), addr.GetMappedAS(m_asmap), nUBucket,
                      nUBucketPos);
@@ -683,6 +954,7 @@ void AddrManImpl::Good_(const CService &addr, bool test_before_evict,
     info.m_last_success = time;
     info.m_last_try = time;
     info.nAttempts = 0;
+    JournalChange(addr);
     // nTime is not updated here, to avoid leaking information about
     // currently-connected peers.
 
@@ -758,6 +1030,7 @@ void AddrManImpl::Attempt_(const CService &addr, bool fCountFailure,
     if (fCountFailure && info.m_last_count_attempt < m_last_good) {
         info.m_last_count_attempt = time;
         info.nAttempts++;
+        JournalChange(addr);
     }
 }
 
@@ -773,82 +1046,41 @@ std::pair<CAddress, NodeSeconds> AddrManImpl::Select_(bool newOnly) const {
     }
 
     // Use a 50% chance for choosing between tried and new table entries.
-    if (!newOnly &&
-        (nTried > 0 && (nNew == 0 || insecure_rand.randbool() == 0))) {
-        // use a tried node
-        double fChanceFactor = 1.0;
-        while (1) {
-            // Pick a tried bucket, and an initial position in that bucket.
-            int nKBucket = insecure_rand.randrange(ADDRMAN_TRIED_BUCKET_COUNT);
-            int nKBucketPos = insecure_rand.randrange(ADDRMAN_BUCKET_SIZE);
-            // Iterate over the positions of that bucket, starting at the
-            // initial one, and looping around.
-            int i;
-            for (i = 0; i < ADDRMAN_BUCKET_SIZE; ++i) {
-                if (vvTried[nKBucket]
-                           [(nKBucketPos + i) % ADDRMAN_BUCKET_SIZE] != -1) {
-                    break;
-                }
-            }
-            // If the bucket is entirely empty, start over with a (likely)
-            // different one.
-            if (i == ADDRMAN_BUCKET_SIZE) {
-                continue;
-            }
-            // Find the entry to return.
-            int nId =
-                vvTried[nKBucket][(nKBucketPos + i) % ADDRMAN_BUCKET_SIZE];
-            const auto it_found{mapInfo.find(nId)};
-            assert(it_found != mapInfo.end());
-            const AddrInfo &info{it_found->second};
-            // With probability GetChance() * fChanceFactor, return the entry.
-            if (insecure_rand.randbits(30) <
-                fChanceFactor * info.GetChance() * (1 << 30)) {
-                LogPrint(BCLog::ADDRMAN, "Selected %s from tried\n",
-                         info.ToString());
-                return {info, info.m_last_try};
-            }
-            // Otherwise start over with a (likely) different bucket, and
-            // increased chance factor.
-            fChanceFactor *= 1.2;
+    const bool use_tried{
+        !newOnly &&
+        (nTried > 0 && (nNew == 0 || insecure_rand.randbool() == 0))};
+
+    // Pick a non-empty bucket, and an initial position in that bucket. The
+    // non-empty buckets are tracked, so this does not depend on how many
+    // buckets are empty. Iterate over the positions of that bucket, starting
+    // at the initial one, and looping around until an entry is found.
+    const auto pick_entry = [&](const auto &table) {
+        const int bucket{table.GetNonEmptyBucket(
+            insecure_rand.randrange(table.NonEmptyBuckets()))};
+        int pos = insecure_rand.randrange(ADDRMAN_BUCKET_SIZE);
+        while (table[bucket][pos] == -1) {
+            pos = (pos + 1) % ADDRMAN_BUCKET_SIZE;
         }
-    } else {
-        // use a new node
-        double fChanceFactor = 1.0;
-        while (1) {
-            // Pick a new bucket, and an initial position in that bucket.
-            int nUBucket = insecure_rand.randrange(ADDRMAN_NEW_BUCKET_COUNT);
-            int nUBucketPos = insecure_rand.randrange(ADDRMAN_BUCKET_SIZE);
-            // Iterate over the positions of that bucket, starting at the
-            // initial one, and looping around.
-            int i;
-            for (i = 0; i < ADDRMAN_BUCKET_SIZE; ++i) {
-                if (vvNew[nUBucket][(nUBucketPos + i) % ADDRMAN_BUCKET_SIZE] !=
-                    -1) {
-                    break;
-                }
-            }
-            // If the bucket is entirely empty, start over with a (likely)
-            // different one.
-            if (i == ADDRMAN_BUCKET_SIZE) {
-                continue;
-            }
-            // Find the entry to return.
-            int nId = vvNew[nUBucket][(nUBucketPos + i) % ADDRMAN_BUCKET_SIZE];
-            const auto it_found{mapInfo.find(nId)};
-            assert(it_found != mapInfo.end());
-            const AddrInfo &info{it_found->second};
-            // With probability GetChance() * fChanceFactor, return the entry.
-            if (insecure_rand.randbits(30) <
-                fChanceFactor * info.GetChance() * (1 << 30)) {
-                LogPrint(BCLog::ADDRMAN, "Selected %s from new\n",
-                         info.ToString());
-                return {info, info.m_last_try};
-            }
-            // Otherwise start over with a (likely) different bucket, and
-            // increased chance factor.
-            fChanceFactor *= 1.2;
+        return table[bucket][pos];
+    };
+
+    double fChanceFactor = 1.0;
+    while (1) {
+        const int nId{use_tried ? pick_entry(vvTried) : pick_entry(vvNew)};
+        // Find the entry to return.
+        const auto it_found{mapInfo.find(nId)};
+        assert(it_found != mapInfo.end());
+        const AddrInfo &info{it_found->second};
+        // With probability GetChance() * fChanceFactor, return the entry.
+        if (insecure_rand.randbits(30) <
+            fChanceFactor * info.GetChance() * (1 << 30)) {
+            LogPrint(BCLog::ADDRMAN, "Selected %s from %s\n", info.ToString(),
+                     use_tried ? "tried" : "new");
+            return {info, info.m_last_try};
         }
+        // Otherwise start over with a (likely) different bucket, and
+        // increased chance factor.
+        fChanceFactor *= 1.2;
     }
 }
 
@@ -913,6 +1145,7 @@ void AddrManImpl::Connected_(const CService &addr, NodeSeconds time) {
     const auto update_interval{20min};
     if (time - info.nTime > update_interval) {
         info.nTime = time;
+        JournalChange(addr);
     }
 }
 
@@ -930,6 +1163,7 @@ void AddrManImpl::SetServices_(const CService &addr, ServiceFlags nServices) {
 
     // update info
     info.nServices = nServices;
+    JournalChange(addr);
 }
 
 void AddrManImpl::ResolveCollisions_() {
@@ -1119,9 +1353,12 @@ int AddrManImpl::CheckAddrman() const {
         return -10;
     }
 
+    size_t tried_nonempty{0};
     for (int n = 0; n < ADDRMAN_TRIED_BUCKET_COUNT; n++) {
+        int bucket_size{0};
         for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
             if (vvTried[n][i] != -1) {
+                ++bucket_size;
                 if (!setTried.count(vvTried[n][i])) {
                     return -11;
                 }
@@ -1136,11 +1373,18 @@ int AddrManImpl::CheckAddrman() const {
                 setTried.erase(vvTried[n][i]);
             }
         }
+        if (vvTried.BucketSize(n) != bucket_size) {
+            return -20;
+        }
+        tried_nonempty += bucket_size > 0;
     }
 
+    size_t new_nonempty{0};
     for (int n = 0; n < ADDRMAN_NEW_BUCKET_COUNT; n++) {
+        int bucket_size{0};
         for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
             if (vvNew[n][i] != -1) {
+                ++bucket_size;
                 if (!mapNew.count(vvNew[n][i])) {
                     return -12;
                 }
@@ -1154,6 +1398,10 @@ int AddrManImpl::CheckAddrman() const {
                 }
             }
         }
+        if (vvNew.BucketSize(n) != bucket_size) {
+            return -20;
+        }
+        new_nonempty += bucket_size > 0;
     }
 
     if (setTried.size()) {
@@ -1165,6 +1413,10 @@ int AddrManImpl::CheckAddrman() const {
     if (nKey.IsNull()) {
         return -16;
     }
+    if (vvTried.NonEmptyBuckets() != tried_nonempty ||
+        vvNew.NonEmptyBuckets() != new_nonempty) {
+        return -20;
+    }
 
     return 0;
 }
@@ -1262,16 +1514,8 @@ void AddrManImpl::Clear() {
     } else {
         nKey = insecure_rand.rand256();
     }
-    for (size_t bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
-        for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
-            vvNew[bucket][entry] = -1;
-        }
-    }
-    for (size_t bucket = 0; bucket < ADDRMAN_TRIED_BUCKET_COUNT; bucket++) {
-        for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
-            vvTried[bucket][entry] = -1;
-        }
-    }
+    vvNew.Clear();
+    vvTried.Clear();
 
     nIdCount = 0;
     nTried = 0;
@@ -1280,6 +1524,9 @@ void AddrManImpl::Clear() {
     m_last_good = NodeSeconds{1s};
     mapInfo.clear();
     mapAddr.clear();
+    m_journal_changes.clear();
+    m_journal_entries = 0;
+    m_journal_invalid = true;
 }
 
 void AddrManImpl::MakeDeterministic() {
@@ -1303,6 +1550,14 @@ template <typename Stream> void AddrMan::Unserialize(Stream &s_) {
     m_impl->Unserialize<Stream>(s_);
 }
 
+template <typename Stream> bool AddrMan::SerializeJournal(Stream &s_) const {
+    return m_impl->SerializeJournal<Stream>(s_);
+}
+
+template <typename Stream> void AddrMan::UnserializeJournal(Stream &s_) {
+    m_impl->UnserializeJournal<Stream>(s_);
+}
+
 // explicit instantiation
 template void AddrMan::Serialize(HashedSourceWriter<CAutoFile> &s) const;
 template void AddrMan::Serialize(CDataStream &s) const;
@@ -1310,6 +1565,8 @@ template void AddrMan::Unserialize(CAutoFile &s);
 template void AddrMan::Unserialize(CHashVerifier<CAutoFile> &s);
 template void AddrMan::Unserialize(CDataStream &s);
 template void AddrMan::Unserialize(CHashVerifier<CDataStream> &s);
+template bool AddrMan::SerializeJournal(CDataStream &s) const;
+template void AddrMan::UnserializeJournal(CDataStream &s);
 
 size_t AddrMan::size() const {
     return m_impl->size();
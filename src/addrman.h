@@ -31,7 +31,7 @@ static constexpr int32_t DEFAULT_ADDRMAN_CONSISTENCY_CHECKS{0};
  *
  * Design goals:
  *  * Keep the address tables in-memory, and asynchronously dump the entire
- * table to peers.dat.
+ * table to peers.dat, or only append the changes to it as a journal.
  *  * Make sure no (localized) attacker can fill the entire table with his
  * nodes/addresses.
  *
@@ -60,7 +60,8 @@ static constexpr int32_t DEFAULT_ADDRMAN_CONSISTENCY_CHECKS{0};
  *    * Bucket selection is based on cryptographic hashing, using a
  * randomly-generated 256-bit key, which should not
  *      be observable by adversaries.
- *    * Several indexes are kept for high performance. Setting
+ *    * Several indexes are kept for high performance, such as the non-empty
+ * buckets of each table so selection does not depend on its density. Setting
  * m_consistency_check_ratio with the -checkaddrman configuration option will
  * introduce (expensive) consistency checks for the entire data structure.
  */
@@ -77,6 +78,21 @@ public:
 
     template <typename Stream> void Unserialize(Stream &s_);
 
+    /**
+     * Serialize the changes made since addrman was last serialized, fully or
+     * by this function, as a journal to apply on top of the last full
+     * serialization. Nothing is serialized if there were no changes.
+     *
+     * @return false, without serializing anything, if the changes can only be
+     *         saved by a full serialization: there are more of them than
+     *         addresses, or addrman was not loaded as is from a full
+     *         serialization.
+     */
+    template <typename Stream> bool SerializeJournal(Stream &s_) const;
+
+    //! Apply a journal serialized by SerializeJournal().
+    template <typename Stream> void UnserializeJournal(Stream &s_);
+
     //! Return the number of (unique) addresses in all tables.
     size_t size() const;
 
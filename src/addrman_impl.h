@@ -15,6 +15,7 @@
 #include <uint256.h>
 #include <util/time.h>
 
+#include <array>
 #include <cstdint>
 #include <optional>
 #include <set>
@@ -37,6 +38,66 @@ static constexpr int ADDRMAN_NEW_BUCKET_COUNT{1
 static constexpr int32_t ADDRMAN_BUCKET_SIZE_LOG2{6};
 static constexpr int ADDRMAN_BUCKET_SIZE{1 << ADDRMAN_BUCKET_SIZE_LOG2};
 
+/**
+ * The buckets of a "new" or "tried" table, holding the nIds of the entries at
+ * each position or -1 for the empty ones. The number of entries of each bucket
+ * is tracked, and the non-empty buckets are also kept in a dense vector, so
+ * that a random non-empty bucket can be picked in constant time however sparse
+ * the table is.
+ */
+template <int BUCKET_COUNT> class AddrTable {
+public:
+    AddrTable() { Clear(); }
+
+    const std::array<int, ADDRMAN_BUCKET_SIZE> &operator[](int bucket) const {
+        return m_ids[bucket];
+    }
+
+    //! Store nId at a position, or clear it if nId is -1.
+    void Set(int bucket, int pos, int nId) {
+        if (m_ids[bucket][pos] == -1 && nId != -1) {
+            if (m_bucket_sizes[bucket]++ == 0) {
+                m_nonempty_index[bucket] = m_nonempty.size();
+                m_nonempty.push_back(bucket);
+            }
+        } else if (m_ids[bucket][pos] != -1 && nId == -1) {
+            if (--m_bucket_sizes[bucket] == 0) {
+                const int last{m_nonempty.back()};
+                m_nonempty[m_nonempty_index[bucket]] = last;
+                m_nonempty_index[last] = m_nonempty_index[bucket];
+                m_nonempty.pop_back();
+                m_nonempty_index[bucket] = -1;
+            }
+        }
+        m_ids[bucket][pos] = nId;
+    }
+
+    void Clear() {
+        for (auto &bucket : m_ids) {
+            bucket.fill(-1);
+        }
+        m_bucket_sizes.fill(0);
+        m_nonempty_index.fill(-1);
+        m_nonempty.clear();
+    }
+
+    //! Number of entries in a bucket
+    int BucketSize(int bucket) const { return m_bucket_sizes[bucket]; }
+
+    //! Number of buckets holding at least one entry
+    size_t NonEmptyBuckets() const { return m_nonempty.size(); }
+
+    //! The i-th non-empty bucket, in no given order.
+    int GetNonEmptyBucket(size_t i) const { return m_nonempty[i]; }
+
+private:
+    std::array<std::array<int, ADDRMAN_BUCKET_SIZE>, BUCKET_COUNT> m_ids;
+    std::array<int, BUCKET_COUNT> m_bucket_sizes;
+    //! Index in m_nonempty of each bucket, or -1 if it is empty
+    std::array<int, BUCKET_COUNT> m_nonempty_index;
+    std::vector<int> m_nonempty;
+};
+
 /**
  * Extended statistics about a CAddress
  */
@@ -118,6 +179,12 @@ public:
     template <typename Stream>
     void Unserialize(Stream &s_) EXCLUSIVE_LOCKS_REQUIRED(!cs);
 
+    template <typename Stream>
+    bool SerializeJournal(Stream &s_) const EXCLUSIVE_LOCKS_REQUIRED(!cs);
+
+    template <typename Stream>
+    void UnserializeJournal(Stream &s_) EXCLUSIVE_LOCKS_REQUIRED(!cs);
+
     size_t size() const EXCLUSIVE_LOCKS_REQUIRED(!cs);
 
     bool Add(const std::vector<CAddress> &vAddr, const CNetAddr &source,
@@ -187,6 +254,17 @@ private:
     //! `lowest_compatible` in `Unserialize()`) is less or equal to this.
     static constexpr Format FILE_FORMAT = Format::V4_MULTIPORT;
 
+    //! Format of the journals, serialized after a byte holding it.
+    static constexpr uint8_t JOURNAL_FORMAT{1};
+
+    //! The state of a changed entry as serialized in a journal.
+    struct JournalEntry {
+        AddrInfo info;
+        bool in_tried{false};
+        //! The "new" buckets holding the entry
+        std::vector<int> new_buckets;
+    };
+
     //! The initial value of a field that is incremented every time an
     //! incompatible format change is made (such that old software versions
     //! would not be able to parse and understand the new file format). This is
@@ -213,17 +291,31 @@ private:
     int nTried GUARDED_BY(cs);
 
     //! list of "tried" buckets
-    int vvTried[ADDRMAN_TRIED_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE] GUARDED_BY(cs);
+    AddrTable<ADDRMAN_TRIED_BUCKET_COUNT> vvTried GUARDED_BY(cs);
 
     //! number of (unique) "new" entries
     int nNew GUARDED_BY(cs);
 
     //! list of "new" buckets
-    int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE] GUARDED_BY(cs);
+    AddrTable<ADDRMAN_NEW_BUCKET_COUNT> vvNew GUARDED_BY(cs);
 
     //! last time Good was called (memory only)
     NodeSeconds m_last_good GUARDED_BY(cs);
 
+    //! Addresses of the entries changed since addrman was last serialized,
+    //! fully or as a journal. Serialization is const, so this bookkeeping of
+    //! what it wrote is mutable.
+    mutable std::unordered_set<CService, CServiceHash>
+        m_journal_changes GUARDED_BY(cs);
+
+    //! Number of journal entries serialized since the last full serialization
+    mutable size_t m_journal_entries GUARDED_BY(cs){0};
+
+    //! Whether the changes since the last full serialization can no longer be
+    //! serialized as a journal, because there are too many of them or addrman
+    //! was not loaded as is from a full serialization.
+    mutable bool m_journal_invalid GUARDED_BY(cs){true};
+
     //! Holds addrs inserted into tried table that collide with existing
     //! entries. Test-before-evict discipline used to resolve these collisions.
     std::set<int> m_tried_collisions;
@@ -263,6 +355,9 @@ private:
     AddrInfo *Create(const CAddress &addr, const CNetAddr &addrSource,
                      int *pnId = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    //! Record that an entry changed, for the next journal serialization.
+    void JournalChange(const CService &addr) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
     //! Swap two elements in vRandom.
     void SwapRandom(unsigned int nRandomPos1, unsigned int nRandomPos2) const
         EXCLUSIVE_LOCKS_REQUIRED(cs);
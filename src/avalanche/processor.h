@@ -362,6 +362,10 @@ public:
                          std::atomic<bool> &interrupt) override {
         return false;
     }
+    bool ProcessUrgentMessage(const ::Config &config, CNode *pnode,
+                              std::atomic<bool> &interrupt) override {
+        return false;
+    }
     bool SendMessages(const ::Config &config, CNode *pnode) override {
         return false;
     }
@@ -4,7 +4,10 @@
 
 #include <addrman.h>
 #include <bench/bench.h>
+#include <clientversion.h>
+#include <netbase.h>
 #include <random.h>
+#include <streams.h>
 #include <util/check.h>
 #include <util/time.h>
 
@@ -94,6 +97,18 @@ static void AddrManSelect(benchmark::Bench &bench) {
     });
 }
 
+static void AddrManSelectFromAlmostEmpty(benchmark::Bench &bench) {
+    AddrMan addrman(/*asmap=*/std::vector<bool>(),
+                    /*consistency_check_ratio=*/0);
+
+    // Add one address to the new table, so most buckets are empty.
+    CService addr;
+    Lookup("250.3.1.1", addr, 8333, false);
+    addrman.Add({CAddress(addr, NODE_NETWORK)}, addr);
+
+    bench.run([&] { (void)addrman.Select(); });
+}
+
 static void AddrManGetAddr(benchmark::Bench &bench) {
     AddrMan addrman(/* asmap= */ std::vector<bool>(),
                     /* consistency_check_ratio= */ 0);
@@ -138,7 +153,48 @@ static void AddrManAddThenGood(benchmark::Bench &bench) {
     });
 }
 
+static void AddrManSerialize(benchmark::Bench &bench) {
+    AddrMan addrman(/*asmap=*/std::vector<bool>(),
+                    /*consistency_check_ratio=*/0);
+
+    FillAddrMan(addrman);
+
+    bench.run([&] {
+        CDataStream stream(SER_DISK, CLIENT_VERSION);
+        stream << addrman;
+        assert(!stream.empty());
+    });
+}
+
+static void AddrManSerializeJournal(benchmark::Bench &bench) {
+    AddrMan addrman(/*asmap=*/std::vector<bool>(),
+                    /*consistency_check_ratio=*/0);
+
+    FillAddrMan(addrman);
+    CDataStream full(SER_DISK, CLIENT_VERSION);
+    full << addrman;
+
+    // Write the changes made to a few addresses, as between two dumps.
+    size_t source_i = 0;
+    bench.run([&] {
+        for (const CAddress &addr : g_addresses[source_i]) {
+            addrman.SetServices(addr, NODE_NETWORK_LIMITED);
+        }
+        source_i = (source_i + 1) % NUM_SOURCES;
+        CDataStream stream(SER_DISK, CLIENT_VERSION);
+        if (!addrman.SerializeJournal(stream)) {
+            // Once the journals hold as many entries as addrman, it is
+            // serialized whole instead, like DumpPeerAddresses() does.
+            stream << addrman;
+        }
+        assert(!stream.empty());
+    });
+}
+
 BENCHMARK(AddrManAdd);
 BENCHMARK(AddrManSelect);
+BENCHMARK(AddrManSelectFromAlmostEmpty);
 BENCHMARK(AddrManGetAddr);
 BENCHMARK(AddrManAddThenGood);
+BENCHMARK(AddrManSerialize);
+BENCHMARK(AddrManSerializeJournal);
@@ -75,6 +75,16 @@ static void SipHash_32b(benchmark::Bench &bench) {
     });
 }
 
+static void SipHash_32b_batch(benchmark::Bench &bench) {
+    std::vector<uint256> vals(1024);
+    std::vector<uint64_t> out(vals.size());
+    uint64_t k1 = 0;
+    bench.batch(vals.size()).unit("hash").run([&] {
+        SipHashUint256Batch(0, ++k1, vals.data(), vals.size(), out.data());
+        std::memcpy(vals[0].begin(), &out[0], sizeof(out[0]));
+    });
+}
+
 static void FastRandom_32bit(benchmark::Bench &bench) {
     FastRandomContext rng(true);
     bench.run([&] { rng.rand32(); });
@@ -127,6 +137,7 @@ BENCHMARK(SHA3_256_1M);
 
 BENCHMARK(SHA256_32b);
 BENCHMARK(SipHash_32b);
+BENCHMARK(SipHash_32b_batch);
 BENCHMARK(SHA256D64_1024);
 BENCHMARK(FastRandom_32bit);
 BENCHMARK(FastRandom_1bit);
@@ -0,0 +1,101 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <invrequest.h>
+#include <random.h>
+#include <uint256.h>
+
+#include <cassert>
+#include <chrono>
+#include <vector>
+
+static constexpr NodeId NUM_PEERS{1000};
+static constexpr size_t NUM_INVS{100000};
+/** Number of peers announcing each inv. */
+static constexpr size_t ANNOUNCERS_PER_INV{4};
+
+static constexpr std::chrono::microseconds REQUEST_DELAY{2s};
+static constexpr std::chrono::microseconds REQUEST_EXPIRY{60s};
+
+static std::vector<uint256> CreateInvIds(FastRandomContext &rng) {
+    std::vector<uint256> invids;
+    invids.reserve(NUM_INVS);
+    for (size_t i = 0; i < NUM_INVS; ++i) {
+        invids.push_back(rng.rand256());
+    }
+    return invids;
+}
+
+/**
+ * Have random peers announce each inv, starting at time start. The
+ * announcements are spread over 10 seconds so some of them are always delayed.
+ */
+static void Announce(InvRequestTracker<uint256> &tracker,
+                     const std::vector<uint256> &invids,
+                     std::chrono::microseconds start, FastRandomContext &rng) {
+    for (size_t i = 0; i < invids.size(); ++i) {
+        const auto time = start + std::chrono::microseconds{10s} * int64_t(i) /
+                                      int64_t(invids.size());
+        for (size_t j = 0; j < ANNOUNCERS_PER_INV; ++j) {
+            const NodeId peer = rng.randrange(NUM_PEERS);
+            tracker.ReceivedInv(peer, invids[i], /*preferred=*/peer % 2,
+                                time + REQUEST_DELAY);
+        }
+    }
+}
+
+/** Poll every peer for requestable invs, as the message handler does. */
+static void InvRequestTrackerGetRequestable(benchmark::Bench &bench) {
+    FastRandomContext rng{/*fDeterministic=*/true};
+    InvRequestTracker<uint256> tracker{/*deterministic=*/true};
+    const std::vector<uint256> invids = CreateInvIds(rng);
+    const std::chrono::microseconds start{1s};
+    Announce(tracker, invids, start, rng);
+
+    // Half of the announcements are ready to be requested.
+    const auto now = start + REQUEST_DELAY + 5s;
+    std::vector<std::pair<NodeId, uint256>> expired;
+    bench.batch(NUM_PEERS).unit("peer").run([&] {
+        for (NodeId peer = 0; peer < NUM_PEERS; ++peer) {
+            auto requestable = tracker.GetRequestable(peer, now, &expired);
+            ankerl::nanobench::doNotOptimizeAway(requestable);
+        }
+    });
+}
+
+/**
+ * Announce, request and receive all the invs, so the tracker is back to empty
+ * at the end of each iteration.
+ */
+static void InvRequestTrackerLifecycle(benchmark::Bench &bench) {
+    FastRandomContext rng{/*fDeterministic=*/true};
+    InvRequestTracker<uint256> tracker{/*deterministic=*/true};
+    const std::vector<uint256> invids = CreateInvIds(rng);
+    std::chrono::microseconds now{1s};
+    std::vector<std::pair<NodeId, uint256>> expired;
+
+    bench.batch(NUM_INVS).unit("inv").run([&] {
+        Announce(tracker, invids, now, rng);
+        now += 10s + REQUEST_DELAY;
+
+        std::vector<std::pair<NodeId, uint256>> requested;
+        for (NodeId peer = 0; peer < NUM_PEERS; ++peer) {
+            for (const uint256 &invid :
+                 tracker.GetRequestable(peer, now, &expired)) {
+                tracker.RequestedData(peer, invid, now + REQUEST_EXPIRY);
+                requested.emplace_back(peer, invid);
+            }
+        }
+
+        for (const auto &[peer, invid] : requested) {
+            tracker.ReceivedResponse(peer, invid);
+            tracker.ForgetInvId(invid);
+        }
+        assert(tracker.Size() == 0);
+    });
+}
+
+BENCHMARK(InvRequestTrackerGetRequestable);
+BENCHMARK(InvRequestTrackerLifecycle);
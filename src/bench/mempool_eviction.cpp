@@ -10,8 +10,8 @@
 #include <txmempool.h>
 
 static void AddTx(const CTransactionRef &tx, const Amount &nFee,
-                  CTxMemPool &pool) EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs) {
-    int64_t nTime = 0;
+                  CTxMemPool &pool, int64_t nTime = 0)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main, pool.cs) {
     unsigned int nHeight = 1;
     unsigned int nSigChecks = 1;
     LockPoints lp;
@@ -120,3 +120,36 @@ static void MempoolEviction(benchmark::Bench &bench) {
 }
 
 BENCHMARK(MempoolEviction);
+
+// Fill the mempool with transactions received over time and expire them in a
+// few steps, as LimitSize() would.
+static void MempoolExpiry(benchmark::Bench &bench) {
+    const auto testing_setup = MakeNoLogFileContext<const TestingSetup>();
+
+    std::vector<CTransactionRef> txs;
+    for (uint32_t i = 0; i < 1000; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(TxId(uint256::ONE), i);
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        txs.push_back(MakeTransactionRef(tx));
+    }
+
+    CTxMemPool &pool = *Assert(testing_setup->m_node.mempool);
+    LOCK2(cs_main, pool.cs);
+
+    bench.run([&]() NO_THREAD_SAFETY_ANALYSIS {
+        for (size_t i = 0; i < txs.size(); i++) {
+            AddTx(txs[i], 1000 * SATOSHI, pool, i / 10);
+        }
+        for (int64_t t = 25; t <= 100; t += 25) {
+            pool.Expire(std::chrono::seconds{t});
+        }
+        assert(pool.size() == 0);
+    });
+}
+
+BENCHMARK(MempoolExpiry);
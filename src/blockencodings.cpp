@@ -9,13 +9,16 @@
 #include <config.h>
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
+#include <core_memusage.h>
 #include <crypto/sha256.h>
 #include <crypto/siphash.h>
 #include <random.h>
 #include <streams.h>
 #include <txmempool.h>
 #include <validation.h>
+#include <version.h>
 
+#include <algorithm>
 #include <unordered_map>
 
 CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock &block)
@@ -25,10 +28,12 @@ CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock &block)
     // TODO: Use our mempool prior to block acceptance to predictively fill more
     // than just the coinbase.
     prefilledtxn[0] = {0, block.vtx[0]};
+    std::vector<uint256> hashes;
+    hashes.reserve(shorttxids.size());
     for (size_t i = 1; i < block.vtx.size(); i++) {
-        const CTransaction &tx = *block.vtx[i];
-        shorttxids[i - 1] = GetShortID(tx.GetHash());
+        hashes.push_back(block.vtx[i]->GetHash());
     }
+    shorttxids = GetShortIDs(hashes);
 }
 
 void CBlockHeaderAndShortTxIDs::FillShortTxIDSelector() const {
@@ -48,6 +53,139 @@ uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const TxHash &txhash) const {
     return SipHashUint256(shorttxidk0, shorttxidk1, txhash) & 0xffffffffffffL;
 }
 
+std::vector<uint64_t> CBlockHeaderAndShortTxIDs::GetShortIDs(
+    const std::vector<uint256> &hashes) const {
+    std::vector<uint64_t> shortids(hashes.size());
+    SipHashUint256Batch(shorttxidk0, shorttxidk1, hashes.data(), hashes.size(),
+                        shortids.data());
+    for (uint64_t &shortid : shortids) {
+        shortid &= 0xffffffffffffL;
+    }
+    return shortids;
+}
+
+std::shared_ptr<const ShortIdCache::ShortIds>
+ShortIdCache::Get(uint64_t k0, uint64_t k1,
+                  unsigned int mempool_updated) const {
+    LOCK(m_mutex);
+    for (const Entry &entry : m_entries) {
+        if (entry.k0 == k0 && entry.k1 == k1 &&
+            entry.mempool_updated == mempool_updated) {
+            return entry.shortids;
+        }
+    }
+    return nullptr;
+}
+
+void ShortIdCache::Add(uint64_t k0, uint64_t k1, unsigned int mempool_updated,
+                       std::shared_ptr<const ShortIds> shortids) {
+    LOCK(m_mutex);
+    // Entries computed for another mempool state can never match again, drop
+    // them rather than keeping their transactions alive.
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+                                   [&](const Entry &entry) {
+                                       return entry.mempool_updated !=
+                                                  mempool_updated ||
+                                              (entry.k0 == k0 &&
+                                               entry.k1 == k1);
+                                   }),
+                    m_entries.end());
+    m_entries.push_front({k0, k1, mempool_updated, std::move(shortids)});
+    if (m_entries.size() > MAX_ENTRIES) {
+        m_entries.pop_back();
+    }
+}
+
+size_t RecentBlockMsgsCache::Entry::DynamicMemoryUsage() const {
+    size_t usage{memusage::DynamicUsage(block) +
+                 memusage::DynamicUsage(block->vtx)};
+    for (const CTransactionRef &tx : block->vtx) {
+        usage += RecursiveDynamicUsage(tx);
+    }
+    for (const auto &payload :
+         {block_payload, cmpctblock_payload, headers_payload}) {
+        usage += memusage::DynamicUsage(payload) +
+                 memusage::DynamicUsage(*payload);
+    }
+    return usage;
+}
+
+bool RecentBlockMsgsCache::Contains(const BlockHash &hash) const {
+    LOCK(m_mutex);
+    return std::any_of(m_entries.begin(), m_entries.end(),
+                       [&](const Entry &entry) { return entry.hash == hash; });
+}
+
+void RecentBlockMsgsCache::Add(const std::shared_ptr<const CBlock> &block,
+                               const CBlockHeaderAndShortTxIDs &cmpctblock) {
+    // Serialize outside of the lock, this can take a while for large blocks
+    const auto serialize = [](const auto &obj) {
+        std::vector<uint8_t> payload;
+        CVectorWriter{SER_NETWORK, PROTOCOL_VERSION, payload, 0, obj};
+        return std::make_shared<const std::vector<uint8_t>>(
+            std::move(payload));
+    };
+    Entry entry{
+        block->GetHash(), block, serialize(*block), serialize(cmpctblock),
+        serialize(std::vector<CBlock>{CBlock{block->GetBlockHeader()}})};
+    const size_t entry_usage{entry.DynamicMemoryUsage()};
+
+    LOCK(m_mutex);
+    for (const Entry &cached : m_entries) {
+        if (cached.hash == entry.hash) {
+            return;
+        }
+    }
+    m_usage += entry_usage;
+    m_entries.push_front(std::move(entry));
+    while (m_entries.size() > 1 && (m_entries.size() > m_max_entries ||
+                                    m_usage > m_max_usage)) {
+        m_usage -= m_entries.back().DynamicMemoryUsage();
+        m_entries.pop_back();
+    }
+}
+
+std::optional<RecentBlockMsgsCache::Entry>
+RecentBlockMsgsCache::Get(const BlockHash &hash) {
+    LOCK(m_mutex);
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->hash == hash) {
+            m_entries.splice(m_entries.begin(), m_entries, it);
+            return *it;
+        }
+    }
+    return std::nullopt;
+}
+
+size_t RecentBlockMsgsCache::Size() const {
+    LOCK(m_mutex);
+    return m_entries.size();
+}
+
+size_t RecentBlockMsgsCache::DynamicMemoryUsage() const {
+    LOCK(m_mutex);
+    return m_usage;
+}
+
+/** Compute the short IDs of all the mempool transactions in one batch. */
+static ShortIdCache::ShortIds
+ComputeMempoolShortIDs(const CBlockHeaderAndShortTxIDs &cmpctblock,
+                       const CTxMemPool &pool) {
+    ShortIdCache::ShortIds shortids;
+    std::vector<uint256> hashes;
+    pool.forEachTx([&](const CTransactionRef &tx) {
+        shortids.emplace_back(0, tx->GetId());
+        hashes.push_back(tx->GetHash());
+        return true;
+    });
+
+    const std::vector<uint64_t> ids = cmpctblock.GetShortIDs(hashes);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        shortids[i].first = ids[i];
+    }
+    return shortids;
+}
+
 ReadStatus PartiallyDownloadedBlock::InitData(
     const CBlockHeaderAndShortTxIDs &cmpctblock,
     const std::vector<std::pair<TxHash, CTransactionRef>> &extra_txns) {
@@ -98,19 +236,39 @@ ReadStatus PartiallyDownloadedBlock::InitData(
         return READ_STATUS_FAILED;
     }
 
-    {
-        LOCK(pool->cs);
-        auto it = pool->mapTx.begin();
-        while (it != pool->mapTx.end()) {
-            uint64_t shortid = cmpctblock.GetShortID((*it)->GetTx().GetHash());
+    // Matching doesn't need a consistent view of the mempool, so avoid
+    // contending on its lock with transaction acceptance. The update counter
+    // is read first so that a cached set of IDs is never newer than the
+    // counter it is stored with.
+    const unsigned int mempool_updated = pool->GetTransactionsUpdated();
+    std::shared_ptr<const ShortIdCache::ShortIds> mempool_shortids;
+    if (shortid_cache) {
+        mempool_shortids =
+            shortid_cache->Get(cmpctblock.shorttxidk0, cmpctblock.shorttxidk1,
+                               mempool_updated);
+    }
+    if (!mempool_shortids) {
+        mempool_shortids = std::make_shared<const ShortIdCache::ShortIds>(
+            ComputeMempoolShortIDs(cmpctblock, *pool));
+        if (shortid_cache) {
+            shortid_cache->Add(cmpctblock.shorttxidk0, cmpctblock.shorttxidk1,
+                               mempool_updated, mempool_shortids);
+        }
+    }
 
-            mempool_count +=
-                shortidProcessor->matchKnownItem(shortid, (*it)->GetSharedTx());
-            it++;
+    for (const auto &[shortid, txid] : *mempool_shortids) {
+        if (!shortidProcessor->hasShortId(shortid)) {
+            continue;
+        }
+        // The transaction may have left the mempool since.
+        const CTransactionRef tx = pool->get(txid);
+        if (!tx) {
+            continue;
+        }
+        mempool_count += shortidProcessor->matchKnownItem(shortid, tx);
 
-            if (mempool_count == shortidProcessor->getShortIdCount()) {
-                break;
-            }
+        if (mempool_count == shortidProcessor->getShortIdCount()) {
+            break;
         }
     }
 
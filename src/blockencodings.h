@@ -8,9 +8,14 @@
 #include <primitives/block.h>
 #include <serialize.h>
 #include <shortidprocessor.h>
+#include <sync.h>
 
 #include <cstdint>
+#include <deque>
+#include <list>
 #include <memory>
+#include <optional>
+#include <utility>
 #include <vector>
 
 class Config;
@@ -101,6 +106,8 @@ public:
     explicit CBlockHeaderAndShortTxIDs(const CBlock &block);
 
     uint64_t GetShortID(const TxHash &txhash) const;
+    /** Batched GetShortID, using the SIMD SipHash kernel where available. */
+    std::vector<uint64_t> GetShortIDs(const std::vector<uint256> &hashes) const;
 
     size_t BlockTxCount() const {
         return shorttxids.size() + prefilledtxn.size();
@@ -138,6 +145,92 @@ public:
     }
 };
 
+/**
+ * Short IDs of the mempool transactions computed for the SipHash keys of the
+ * most recent compact blocks. Reconstructing a block again from a compact
+ * block with the same key, e.g. one relayed by several peers, reuses them as
+ * long as the mempool did not change in between. The transactions are only
+ * referenced by txid, so the cache doesn't keep evicted ones alive and its
+ * memory usage is bounded by MAX_ENTRIES times the mempool size times 40
+ * bytes.
+ */
+class ShortIdCache {
+public:
+    using ShortIds = std::vector<std::pair<uint64_t, TxId>>;
+
+    /** Number of keys for which short IDs are kept. */
+    static constexpr size_t MAX_ENTRIES = 4;
+
+    std::shared_ptr<const ShortIds> Get(uint64_t k0, uint64_t k1,
+                                        unsigned int mempool_updated) const
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    void Add(uint64_t k0, uint64_t k1, unsigned int mempool_updated,
+             std::shared_ptr<const ShortIds> shortids)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    struct Entry {
+        uint64_t k0;
+        uint64_t k1;
+        //! CTxMemPool::GetTransactionsUpdated() when the IDs were computed
+        unsigned int mempool_updated;
+        std::shared_ptr<const ShortIds> shortids;
+    };
+
+    mutable Mutex m_mutex;
+    std::deque<Entry> m_entries GUARDED_BY(m_mutex);
+};
+
+/**
+ * Wire forms of the recently connected blocks, so peers that fell slightly
+ * behind are served without disk reads or reserialization. The least recently
+ * used blocks are evicted once there are too many of them or they use too much
+ * memory, the blocks kept alive by the cache included.
+ */
+class RecentBlockMsgsCache {
+public:
+    /** A recently connected block along with its wire forms. */
+    struct Entry {
+        BlockHash hash;
+        std::shared_ptr<const CBlock> block;
+        /** Payloads of the block, cmpctblock and single header messages. */
+        std::shared_ptr<const std::vector<uint8_t>> block_payload;
+        std::shared_ptr<const std::vector<uint8_t>> cmpctblock_payload;
+        std::shared_ptr<const std::vector<uint8_t>> headers_payload;
+
+        size_t DynamicMemoryUsage() const;
+    };
+
+    RecentBlockMsgsCache(size_t max_entries, size_t max_usage)
+        : m_max_entries(max_entries), m_max_usage(max_usage) {}
+
+    bool Contains(const BlockHash &hash) const
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /**
+     * Serialize a block into the cache, unless it is already there. The most
+     * recently added block is kept even if it exceeds the memory bound on its
+     * own.
+     */
+    void Add(const std::shared_ptr<const CBlock> &block,
+             const CBlockHeaderAndShortTxIDs &cmpctblock)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    /** Look up a block and mark it as used. */
+    std::optional<Entry> Get(const BlockHash &hash)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    size_t Size() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+    size_t DynamicMemoryUsage() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    const size_t m_max_entries;
+    const size_t m_max_usage;
+
+    mutable Mutex m_mutex;
+    //! Most recently used first
+    std::list<Entry> m_entries GUARDED_BY(m_mutex);
+    size_t m_usage GUARDED_BY(m_mutex){0};
+};
+
 class PartiallyDownloadedBlock {
     struct CTransactionRefCompare {
         bool operator()(const CTransactionRef &lhs,
@@ -160,11 +253,13 @@ protected:
     size_t prefilled_count = 0, mempool_count = 0, extra_count = 0;
     const CTxMemPool *pool;
     const Config *config;
+    ShortIdCache *shortid_cache;
 
 public:
     CBlockHeader header;
-    PartiallyDownloadedBlock(const Config &configIn, CTxMemPool *poolIn)
-        : pool(poolIn), config(&configIn) {}
+    PartiallyDownloadedBlock(const Config &configIn, CTxMemPool *poolIn,
+                             ShortIdCache *shortidCacheIn = nullptr)
+        : pool(poolIn), config(&configIn), shortid_cache(shortidCacheIn) {}
 
     // extra_txn is a list of extra transactions to look at, in <txhash,
     // reference> form.
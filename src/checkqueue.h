@@ -28,7 +28,7 @@ template <typename T> class CCheckQueueControl;
 template <typename T> class CCheckQueue {
 private:
     //! Mutex to protect the inner state
-    Mutex m_mutex;
+    mutable Mutex m_mutex;
 
     //! Worker threads block on this when out of work
     std::condition_variable m_worker_cv;
@@ -60,6 +60,8 @@ private:
     const unsigned int nBatchSize;
 
     std::vector<std::thread> m_worker_threads;
+    //! The number of worker threads, readable from any thread.
+    size_t m_worker_count GUARDED_BY(m_mutex){0};
     bool m_request_stop GUARDED_BY(m_mutex){false};
 
     /** Internal function that does bulk of the verification work. */
@@ -148,6 +150,7 @@ public:
             nIdle = 0;
             nTotal = 0;
             fAllOk = true;
+            m_worker_count = threads_num;
         }
         assert(m_worker_threads.empty());
         for (int n = 0; n < threads_num; ++n) {
@@ -177,9 +180,19 @@ public:
         }
     }
 
+    //! Whether there are worker threads to offload the checks to.
+    bool HasThreads() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
+        LOCK(m_mutex);
+        return m_worker_count > 0;
+    }
+
     //! Stop all of the worker threads.
     void StopWorkerThreads() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
-        WITH_LOCK(m_mutex, m_request_stop = true);
+        {
+            LOCK(m_mutex);
+            m_request_stop = true;
+            m_worker_count = 0;
+        }
         m_worker_cv.notify_all();
         for (std::thread &t : m_worker_threads) {
             t.join();
@@ -97,6 +97,9 @@ typedef char *sockopt_arg_type;
 // https://github.com/bitcoin/bitcoin/pull/14336#issuecomment-437384408
 #if defined(__linux__)
 #define USE_POLL
+// The connected peers are watched with a persistent epoll(7) set, see
+// SockEpoll. Other platforms fall back to polling all the sockets.
+#define USE_EPOLL
 #endif
 
 static bool inline IsSelectableSocket(const SOCKET &s) {
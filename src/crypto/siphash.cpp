@@ -4,6 +4,13 @@
 
 #include <crypto/siphash.h>
 
+#include <compat/cpuid.h>
+
+namespace siphash_avx2 {
+void SipHashUint256_4way(uint64_t k0, uint64_t k1, const uint256 *vals,
+                         uint64_t *out);
+}
+
 #define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
 
 #define SIPROUND                                                               \
@@ -175,3 +182,46 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256 &val,
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
 }
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+namespace {
+/** Whether the CPU and OS support the AVX2 kernel. */
+bool HaveAVX2() {
+#if defined(HAVE_GETCPUID)
+    uint32_t eax, ebx, ecx, edx;
+    GetCPUID(1, 0, eax, ebx, ecx, edx);
+    const bool have_xsave = (ecx >> 27) & 1;
+    const bool have_avx = (ecx >> 28) & 1;
+    if (!have_xsave || !have_avx) {
+        return false;
+    }
+    // Check whether the OS has enabled AVX registers.
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    if ((a & 6) != 6) {
+        return false;
+    }
+    GetCPUID(7, 0, eax, ebx, ecx, edx);
+    return (ebx >> 5) & 1;
+#else
+    return false;
+#endif
+}
+} // namespace
+#endif
+
+void SipHashUint256Batch(uint64_t k0, uint64_t k1, const uint256 *vals,
+                         size_t count, uint64_t *out) {
+    size_t i = 0;
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    static const bool use_avx2 = HaveAVX2();
+    if (use_avx2) {
+        for (; i + 4 <= count; i += 4) {
+            siphash_avx2::SipHashUint256_4way(k0, k1, vals + i, out + i);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = SipHashUint256(k0, k1, vals[i]);
+    }
+}
@@ -7,6 +7,7 @@
 
 #include <uint256.h>
 
+#include <cstddef>
 #include <cstdint>
 
 /** SipHash-2-4 */
@@ -48,4 +49,11 @@ uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256 &val);
 uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256 &val,
                              uint32_t extra);
 
+/**
+ * Compute out[i] = SipHashUint256(k0, k1, vals[i]) for i < count, several
+ * values at a time when the CPU supports AVX2.
+ */
+void SipHashUint256Batch(uint64_t k0, uint64_t k1, const uint256 *vals,
+                         size_t count, uint64_t *out);
+
 #endif // BITCOIN_CRYPTO_SIPHASH_H
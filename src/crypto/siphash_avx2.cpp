@@ -0,0 +1,97 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <uint256.h>
+
+#include <cstdint>
+#include <immintrin.h>
+
+namespace siphash_avx2 {
+namespace {
+
+    __m256i inline K(uint64_t x) {
+        return _mm256_set1_epi64x(x);
+    }
+
+    template <int b> __m256i inline Rotl(__m256i x) {
+        return _mm256_or_si256(_mm256_slli_epi64(x, b),
+                               _mm256_srli_epi64(x, 64 - b));
+    }
+    template <> __m256i inline Rotl<32>(__m256i x) {
+        return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+    }
+
+    void inline SipRound(__m256i &v0, __m256i &v1, __m256i &v2, __m256i &v3) {
+        v0 = _mm256_add_epi64(v0, v1);
+        v1 = Rotl<13>(v1);
+        v1 = _mm256_xor_si256(v1, v0);
+        v0 = Rotl<32>(v0);
+        v2 = _mm256_add_epi64(v2, v3);
+        v3 = Rotl<16>(v3);
+        v3 = _mm256_xor_si256(v3, v2);
+        v0 = _mm256_add_epi64(v0, v3);
+        v3 = Rotl<21>(v3);
+        v3 = _mm256_xor_si256(v3, v0);
+        v2 = _mm256_add_epi64(v2, v1);
+        v1 = Rotl<17>(v1);
+        v1 = _mm256_xor_si256(v1, v2);
+        v2 = Rotl<32>(v2);
+    }
+
+    void inline Compress(__m256i &v0, __m256i &v1, __m256i &v2, __m256i &v3,
+                         __m256i d) {
+        v3 = _mm256_xor_si256(v3, d);
+        SipRound(v0, v1, v2, v3);
+        SipRound(v0, v1, v2, v3);
+        v0 = _mm256_xor_si256(v0, d);
+    }
+
+} // namespace
+
+/**
+ * Compute SipHashUint256(k0, k1, vals[i]) for 4 values at once, one per 64 bit
+ * lane.
+ */
+void SipHashUint256_4way(uint64_t k0, uint64_t k1, const uint256 *vals,
+                         uint64_t *out) {
+    // Transpose the 4 values so that dj holds word j of every value.
+    __m256i r0 = _mm256_loadu_si256((const __m256i *)vals[0].begin());
+    __m256i r1 = _mm256_loadu_si256((const __m256i *)vals[1].begin());
+    __m256i r2 = _mm256_loadu_si256((const __m256i *)vals[2].begin());
+    __m256i r3 = _mm256_loadu_si256((const __m256i *)vals[3].begin());
+    __m256i t0 = _mm256_unpacklo_epi64(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi64(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi64(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi64(r2, r3);
+    __m256i d0 = _mm256_permute2x128_si256(t0, t2, 0x20);
+    __m256i d1 = _mm256_permute2x128_si256(t1, t3, 0x20);
+    __m256i d2 = _mm256_permute2x128_si256(t0, t2, 0x31);
+    __m256i d3 = _mm256_permute2x128_si256(t1, t3, 0x31);
+
+    __m256i v0 = K(0x736f6d6570736575ULL ^ k0);
+    __m256i v1 = K(0x646f72616e646f6dULL ^ k1);
+    __m256i v2 = K(0x6c7967656e657261ULL ^ k0);
+    __m256i v3 = K(0x7465646279746573ULL ^ k1);
+
+    Compress(v0, v1, v2, v3, d0);
+    Compress(v0, v1, v2, v3, d1);
+    Compress(v0, v1, v2, v3, d2);
+    Compress(v0, v1, v2, v3, d3);
+    Compress(v0, v1, v2, v3, K(uint64_t(4) << 59));
+    v2 = _mm256_xor_si256(v2, K(0xFF));
+    SipRound(v0, v1, v2, v3);
+    SipRound(v0, v1, v2, v3);
+    SipRound(v0, v1, v2, v3);
+    SipRound(v0, v1, v2, v3);
+
+    __m256i res = _mm256_xor_si256(_mm256_xor_si256(v0, v1),
+                                   _mm256_xor_si256(v2, v3));
+    _mm256_storeu_si256((__m256i *)out, res);
+}
+
+} // namespace siphash_avx2
+
+#endif
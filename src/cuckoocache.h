@@ -532,6 +532,24 @@ public:
         return false;
     }
 
+    /**
+     * for_each_live calls `f` on every element stored in the table which has
+     * not been marked for garbage collection. This is a Read operation, so it
+     * must not run concurrently with any Write.
+     *
+     * This is used to persist the cache contents; the order of the visited
+     * elements is the table order and carries no meaning.
+     *
+     * @param f A callable taking a `const Element &`
+     */
+    template <typename F> void for_each_live(F &&f) const {
+        for (uint32_t i = 0; i < size; ++i) {
+            if (!collection_flags.bit_is_set(i)) {
+                f(table[i]);
+            }
+        }
+    }
+
 private:
     const Element *find(const Key &k, const bool erase) const {
         std::array<uint32_t, 8> locs = compute_hashes(k);
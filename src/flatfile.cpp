@@ -8,6 +8,12 @@
 #include <tinyformat.h>
 #include <util/fs_helpers.h>
 
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <ios>
 #include <stdexcept>
 
 FlatFileSeq::FlatFileSeq(fs::path dir, const char *prefix, size_t chunk_size)
@@ -96,3 +102,51 @@ bool FlatFileSeq::Flush(const FlatFilePos &pos, bool finalize) {
     fclose(file);
     return true;
 }
+
+FlatFileMapping::FlatFileMapping(FILE *file) {
+#ifndef WIN32
+    const int fd = fileno(file);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *map = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED,
+                         fd, 0);
+        if (map != MAP_FAILED) {
+            m_map = map;
+            m_size = size_t(st.st_size);
+            return;
+        }
+    }
+#endif
+    throw std::ios_base::failure("FlatFileMapping: failed to map the file");
+}
+
+FlatFileMapping::~FlatFileMapping() {
+#ifndef WIN32
+    munmap(m_map, m_size);
+#endif
+}
+
+FlatFileRegion::FlatFileRegion(FILE *file, uint64_t offset, size_t size) {
+    m_buffer.resize(size);
+    if (fseek(file, offset, SEEK_SET) != 0 ||
+        fread(m_buffer.data(), 1, size, file) != size) {
+        throw std::ios_base::failure(
+            strprintf("FlatFileRegion: failed to read %u bytes at %u", size,
+                      offset));
+    }
+    m_data = m_buffer;
+}
+
+FlatFileRegion::FlatFileRegion(std::shared_ptr<const FlatFileMapping> mapping,
+                               uint64_t offset, size_t size)
+    : m_mapping(std::move(mapping)) {
+    // Touching a mapped page past the end of the file raises SIGBUS, so the
+    // range must lie within the file as it was mapped.
+    const Span<const uint8_t> map_data{m_mapping->Data()};
+    if (offset > map_data.size() || size > map_data.size() - offset) {
+        throw std::ios_base::failure(
+            strprintf("FlatFileRegion: %u bytes at %u are not mapped", size,
+                      offset));
+    }
+    m_data = map_data.subspan(offset, size);
+}
@@ -7,9 +7,13 @@
 #define BITCOIN_FLATFILE_H
 
 #include <serialize.h>
+#include <span.h>
 #include <util/fs.h>
 
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
 struct FlatFilePos {
     int nFile;
@@ -94,4 +98,67 @@ public:
     bool Flush(const FlatFilePos &pos, bool finalize = false);
 };
 
+/**
+ * A read-only memory mapping of a whole flat file, as large as the file was
+ * when it was mapped. Data appended within that size later, e.g. to the
+ * preallocated space of the file, is visible through the mapping too.
+ */
+class FlatFileMapping {
+private:
+    void *m_map{nullptr};
+    size_t m_size{0};
+
+public:
+    /**
+     * Map @p file.
+     *
+     * @throws std::ios_base::failure if the file cannot be mapped, which is
+     *         always the case on platforms without mmap.
+     */
+    explicit FlatFileMapping(FILE *file);
+    ~FlatFileMapping();
+
+    FlatFileMapping(const FlatFileMapping &) = delete;
+    FlatFileMapping &operator=(const FlatFileMapping &) = delete;
+
+    Span<const uint8_t> Data() const {
+        return {static_cast<const uint8_t *>(m_map), m_size};
+    }
+};
+
+/**
+ * A read-only view of a byte range of a flat file, either within a
+ * FlatFileMapping, so its bytes can be handed to the socket without being
+ * copied into a user space buffer, or read into memory. The view stays valid
+ * after the file handle is closed.
+ */
+class FlatFileRegion {
+private:
+    std::shared_ptr<const FlatFileMapping> m_mapping;
+    std::vector<uint8_t> m_buffer;
+    Span<const uint8_t> m_data;
+
+public:
+    /**
+     * Read @p size bytes of @p file starting at @p offset.
+     *
+     * @throws std::ios_base::failure if the range cannot be read.
+     */
+    FlatFileRegion(FILE *file, uint64_t offset, size_t size);
+    /**
+     * View @p size bytes of @p mapping starting at @p offset, keeping the
+     * mapping alive.
+     *
+     * @throws std::ios_base::failure if the range is not within the mapping.
+     */
+    FlatFileRegion(std::shared_ptr<const FlatFileMapping> mapping,
+                   uint64_t offset, size_t size);
+
+    FlatFileRegion(const FlatFileRegion &) = delete;
+    FlatFileRegion &operator=(const FlatFileRegion &) = delete;
+
+    Span<const uint8_t> Data() const { return m_data; }
+    bool IsMapped() const { return m_mapping != nullptr; }
+};
+
 #endif // BITCOIN_FLATFILE_H
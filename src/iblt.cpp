@@ -0,0 +1,112 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <iblt.h>
+
+#include <cassert>
+
+namespace {
+/** A 32 bits integer hash with good avalanche behavior. */
+uint32_t Mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+uint32_t CheckSum(uint32_t key) {
+    return Mix(key ^ 0x5bd1e995U);
+}
+
+constexpr uint32_t HASH_SEEDS[IBLT::NUM_HASHES] = {0x9e3779b9U, 0x85ebca6bU,
+                                                   0xc2b2ae35U};
+} // namespace
+
+IBLT::IBLT(size_t cells)
+    : m_cells((cells + NUM_HASHES - 1) / NUM_HASHES * NUM_HASHES) {}
+
+size_t IBLT::CellIndex(uint32_t key, size_t hash) const {
+    const size_t part_size = m_cells.size() / NUM_HASHES;
+    return hash * part_size +
+           size_t((uint64_t(Mix(key ^ HASH_SEEDS[hash])) * part_size) >> 32);
+}
+
+void IBLT::Update(uint32_t key, uint8_t count) {
+    if (m_cells.empty()) {
+        return;
+    }
+    const uint32_t check_sum = CheckSum(key);
+    for (size_t hash = 0; hash < NUM_HASHES; ++hash) {
+        Cell &cell = m_cells[CellIndex(key, hash)];
+        cell.count += count;
+        cell.key_sum ^= key;
+        cell.check_sum ^= check_sum;
+    }
+}
+
+void IBLT::Insert(uint32_t key) {
+    Update(key, 1);
+}
+
+IBLT &IBLT::operator-=(const IBLT &other) {
+    assert(m_cells.size() == other.m_cells.size());
+    for (size_t i = 0; i < m_cells.size(); ++i) {
+        m_cells[i].count -= other.m_cells[i].count;
+        m_cells[i].key_sum ^= other.m_cells[i].key_sum;
+        m_cells[i].check_sum ^= other.m_cells[i].check_sum;
+    }
+    return *this;
+}
+
+bool IBLT::IsPure(size_t index) const {
+    const Cell &cell = m_cells[index];
+    return (cell.count == 1 || cell.count == 0xff) &&
+           cell.check_sum == CheckSum(cell.key_sum);
+}
+
+bool IBLT::Decode(std::vector<uint32_t> &positive,
+                  std::vector<uint32_t> &negative) const {
+    IBLT table{*this};
+
+    std::vector<size_t> pure;
+    for (size_t i = 0; i < table.m_cells.size(); ++i) {
+        if (table.IsPure(i)) {
+            pure.push_back(i);
+        }
+    }
+
+    // Every key removed empties at least one cell, so a table that does not
+    // decode within that many steps is inconsistent.
+    size_t steps = table.m_cells.size();
+    while (!pure.empty() && steps > 0) {
+        const size_t index = pure.back();
+        pure.pop_back();
+        if (!table.IsPure(index)) {
+            continue;
+        }
+        --steps;
+
+        const uint32_t key = table.m_cells[index].key_sum;
+        const uint8_t count = table.m_cells[index].count;
+        (count == 1 ? positive : negative).push_back(key);
+
+        // Remove the key, which may leave other cells with a single key.
+        table.Update(key, uint8_t(-count));
+        for (size_t hash = 0; hash < NUM_HASHES; ++hash) {
+            const size_t other = table.CellIndex(key, hash);
+            if (table.IsPure(other)) {
+                pure.push_back(other);
+            }
+        }
+    }
+
+    for (const Cell &cell : table.m_cells) {
+        if (!cell.IsEmpty()) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_IBLT_H
+#define BITCOIN_IBLT_H
+
+#include <serialize.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * An invertible Bloom lookup table of 32 bits keys, used as a set sketch.
+ *
+ * Each key is added to one cell in each of NUM_HASHES equally sized parts of
+ * the table. Subtracting the sketch of another set made with the same number
+ * of cells leaves a sketch of the symmetric difference of the two sets, which
+ * can be decoded as long as that difference is small enough compared to the
+ * number of cells. Counts are allowed to wrap around: decoding only relies on
+ * the cells holding a single key.
+ */
+class IBLT {
+public:
+    static constexpr size_t NUM_HASHES{3};
+
+    struct Cell {
+        uint8_t count{0};
+        uint32_t key_sum{0};
+        uint32_t check_sum{0};
+
+        bool IsEmpty() const {
+            return count == 0 && key_sum == 0 && check_sum == 0;
+        }
+
+        SERIALIZE_METHODS(Cell, obj) {
+            READWRITE(obj.count, obj.key_sum, obj.check_sum);
+        }
+    };
+
+    IBLT() = default;
+    /** Make an empty table of cells rounded up to a multiple of NUM_HASHES. */
+    explicit IBLT(size_t cells);
+
+    size_t Size() const { return m_cells.size(); }
+
+    void Insert(uint32_t key);
+
+    /** Subtract a table of the same size, which must not be this one. */
+    IBLT &operator-=(const IBLT &other);
+
+    /**
+     * Recover the keys of a table that is the difference of two sketches.
+     * Keys only in the first set are added to positive, keys only in the
+     * second set to negative.
+     *
+     * @return false if the table could not be fully decoded.
+     */
+    bool Decode(std::vector<uint32_t> &positive,
+                std::vector<uint32_t> &negative) const;
+
+    SERIALIZE_METHODS(IBLT, obj) { READWRITE(obj.m_cells); }
+
+private:
+    std::vector<Cell> m_cells;
+
+    /** Add count to the cells of key, where count is 1 or -1 mod 256. */
+    void Update(uint32_t key, uint8_t count);
+    size_t CellIndex(uint32_t key, size_t hash) const;
+    bool IsPure(size_t index) const;
+};
+
+#endif // BITCOIN_IBLT_H
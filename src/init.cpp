@@ -12,6 +12,7 @@
 #include <kernel/mempool_persist.h>
 #include <kernel/validation_cache_sizes.h>
 
+#include <addrdb.h>
 #include <addrman.h>
 #include <avalanche/avalanche.h>
 #include <avalanche/processor.h>
@@ -53,6 +54,7 @@
 #include <node/mempool_persist_args.h>
 #include <node/miner.h>
 #include <node/peerman_args.h>
+#include <node/txreconciliation.h>
 #include <node/ui_interface.h>
 #include <node/validation_cache_args.h>
 #include <policy/block/rtt.h>
@@ -123,12 +125,16 @@ using node::BlockManager;
 using node::CacheSizes;
 using node::CalculateCacheSizes;
 using node::DEFAULT_PERSIST_MEMPOOL;
+using node::DEFAULT_PERSIST_VALIDATION_CACHES;
 using node::fReindex;
 using node::KernelNotifications;
 using node::LoadChainstate;
 using node::MempoolPath;
 using node::NodeContext;
+using node::ScriptExecutionCachePath;
 using node::ShouldPersistMempool;
+using node::ShouldPersistValidationCaches;
+using node::SignatureCachePath;
 using node::ThreadImport;
 using node::VerifyLoadedChainstate;
 
@@ -296,6 +302,14 @@ void Shutdown(NodeContext &node) {
         DumpMempool(*node.mempool, MempoolPath(*node.args));
     }
 
+    // The script check workers are stopped, so the validation caches are no
+    // longer being written to.
+    if (ShouldPersistValidationCaches(*node.args)) {
+        DumpSignatureCache(SignatureCachePath(*node.args));
+        WITH_LOCK(cs_main, DumpScriptExecutionCache(
+                               ScriptExecutionCachePath(*node.args)));
+    }
+
     // FlushStateToDisk generates a ChainStateFlushed callback, which we should
     // avoid missing
     if (node.chainman) {
@@ -824,6 +838,12 @@ void SetupServerArgs(NodeContext &node) {
                              "bytes (default: %u)",
                              DEFAULT_MAXRECEIVEBUFFER),
                    ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+    argsman.AddArg(
+        "-netthreads=<n>",
+        strprintf("Number of threads doing the socket I/O of the connected "
+                  "peers, up to %d (default: %d)",
+                  MAX_NET_THREADS, DEFAULT_NET_THREADS),
+        ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg(
         "-maxsendbuffer=<n>",
         strprintf(
@@ -878,6 +898,12 @@ void SetupServerArgs(NodeContext &node) {
             "Serve compact block filters to peers per BIP 157 (default: %u)",
             DEFAULT_PEERBLOCKFILTERS),
         ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
+    argsman.AddArg("-peersjournal",
+                   strprintf("Only append the changes to the address database "
+                             "to peers.dat when saving it, until rewriting it "
+                             "whole is cheaper (default: %u)",
+                             DEFAULT_PEERS_JOURNAL),
+                   ArgsManager::ALLOW_ANY, OptionsCategory::CONNECTION);
     argsman.AddArg("-permitbaremultisig",
                    strprintf("Relay non-P2SH multisig (default: %d)",
                              DEFAULT_PERMIT_BAREMULTISIG),
@@ -935,6 +961,13 @@ void SetupServerArgs(NodeContext &node) {
                    "Tor control port password (default: empty)",
                    ArgsManager::ALLOW_ANY | ArgsManager::SENSITIVE,
                    OptionsCategory::CONNECTION);
+    argsman.AddArg("-txreconciliation",
+                   strprintf("Announce transactions to the peers which "
+                             "support it through set reconciliation instead "
+                             "of inv flooding (default: %d)",
+                             DEFAULT_TXRECONCILIATION_ENABLE),
+                   ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY,
+                   OptionsCategory::CONNECTION);
 #ifdef USE_UPNP
 #if USE_UPNP
     argsman.AddArg("-upnp",
@@ -1127,6 +1160,13 @@ void SetupServerArgs(NodeContext &node) {
                   DEFAULT_MAX_SCRIPT_CACHE_BYTES >> 20),
         ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY,
         OptionsCategory::DEBUG_TEST);
+    argsman.AddArg("-persistvalidationcaches",
+                   strprintf("Whether to save the signature and script "
+                             "caches on shutdown and load them on restart "
+                             "(default: %u)",
+                             DEFAULT_PERSIST_VALIDATION_CACHES),
+                   ArgsManager::ALLOW_ANY | ArgsManager::DEBUG_ONLY,
+                   OptionsCategory::DEBUG_TEST);
     argsman.AddArg("-maxtipage=<n>",
                    strprintf("Maximum tip age in seconds to consider node in "
                              "initial block download (default: %u)",
@@ -2124,6 +2164,13 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
             args.GetIntArg("-maxscriptcachesize",
                            DEFAULT_MAX_SCRIPT_CACHE_BYTES >> 20)));
     }
+    if (ShouldPersistValidationCaches(args)) {
+        // Warm up the caches before anything gets validated, so that neither
+        // the mempool reload nor the first blocks pay the full script cost.
+        LoadSignatureCache(SignatureCachePath(args));
+        WITH_LOCK(cs_main,
+                  LoadScriptExecutionCache(ScriptExecutionCachePath(args)));
+    }
 
     int script_threads = args.GetIntArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
     if (script_threads <= 0) {
@@ -2788,6 +2835,8 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
         1000 * args.GetIntArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize =
         1000 * args.GetIntArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
+    connOptions.m_net_threads =
+        args.GetIntArg("-netthreads", DEFAULT_NET_THREADS);
     connOptions.m_added_nodes = args.GetArgs("-addnode");
 
     connOptions.nMaxOutboundLimit =
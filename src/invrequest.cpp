@@ -722,7 +722,11 @@ public:
         // Move time.
         SetTimePoint(now, clearExpired, emplaceExpired);
 
-        // Find all CANDIDATE_BEST announcements for this peer.
+        // Find all CANDIDATE_BEST announcements for this peer, unless it has
+        // no candidate at all.
+        if (CountCandidates(peer) == 0) {
+            return {};
+        }
         std::vector<const Announcement *> selected;
         auto it_peer = m_index.get<ByPeer>().lower_bound(
             ByPeerView{peer, true, uint256(uint256::ZERO)});
@@ -87,80 +87,6 @@ static void ApplyStats(CCoinsStats &stats, const TxId &txid,
     }
 }
 
-//! Calculate statistics about the unspent transaction output set
-template <typename T>
-static bool ComputeUTXOStats(CCoinsView *view, CCoinsStats &stats, T hash_obj,
-                             const std::function<void()> &interruption_point) {
-    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-    assert(pcursor);
-
-    PrepareHash(hash_obj, stats);
-
-    TxId prevkey;
-    std::map<uint32_t, Coin> outputs;
-    while (pcursor->Valid()) {
-        interruption_point();
-        COutPoint key;
-        Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            if (!outputs.empty() && key.GetTxId() != prevkey) {
-                ApplyStats(stats, prevkey, outputs);
-                ApplyHash(hash_obj, prevkey, outputs);
-                outputs.clear();
-            }
-            prevkey = key.GetTxId();
-            outputs[key.GetN()] = std::move(coin);
-            stats.coins_count++;
-        } else {
-            return error("%s: unable to read value", __func__);
-        }
-        pcursor->Next();
-    }
-    if (!outputs.empty()) {
-        ApplyStats(stats, prevkey, outputs);
-        ApplyHash(hash_obj, prevkey, outputs);
-    }
-
-    FinalizeHash(hash_obj, stats);
-
-    stats.nDiskSize = view->EstimateSize();
-
-    return true;
-}
-
-std::optional<CCoinsStats>
-ComputeUTXOStats(CoinStatsHashType hash_type, CCoinsView *view,
-                 node::BlockManager &blockman,
-                 const std::function<void()> &interruption_point) {
-    CBlockIndex *pindex = WITH_LOCK(
-        ::cs_main, return blockman.LookupBlockIndex(view->GetBestBlock()));
-    CCoinsStats stats{Assert(pindex)->nHeight, pindex->GetBlockHash()};
-
-    bool success = [&]() -> bool {
-        switch (hash_type) {
-            case (CoinStatsHashType::HASH_SERIALIZED): {
-                HashWriter ss{};
-                return ComputeUTXOStats(view, stats, ss, interruption_point);
-            }
-            case (CoinStatsHashType::MUHASH): {
-                MuHash3072 muhash;
-                return ComputeUTXOStats(view, stats, muhash,
-                                        interruption_point);
-            }
-            case (CoinStatsHashType::NONE): {
-                return ComputeUTXOStats(view, stats, nullptr,
-                                        interruption_point);
-            }
-        } // no default case, so the compiler can warn about missing cases
-        assert(false);
-    }();
-
-    if (!success) {
-        return std::nullopt;
-    }
-    return stats;
-}
-
 // The legacy hash serializes the hashBlock
 static void PrepareHash(HashWriter &ss, const CCoinsStats &stats) {
     ss << stats.hashBlock;
@@ -179,4 +105,93 @@ static void FinalizeHash(MuHash3072 &muhash, CCoinsStats &stats) {
 }
 static void FinalizeHash(std::nullptr_t, CCoinsStats &stats) {}
 
+static std::variant<HashWriter, MuHash3072, std::nullptr_t>
+MakeHashObject(CoinStatsHashType hash_type) {
+    switch (hash_type) {
+        case (CoinStatsHashType::HASH_SERIALIZED):
+            return HashWriter{};
+        case (CoinStatsHashType::MUHASH):
+            return MuHash3072{};
+        case (CoinStatsHashType::NONE):
+            return nullptr;
+    } // no default case, so the compiler can warn about missing cases
+    assert(false);
+}
+
+UTXOStatsBuilder::UTXOStatsBuilder(CoinStatsHashType hash_type,
+                                   int block_height,
+                                   const BlockHash &block_hash)
+    : m_stats(block_height, block_hash),
+      m_hash_obj(MakeHashObject(hash_type)) {
+    std::visit([&](auto &hash_obj) { PrepareHash(hash_obj, m_stats); },
+               m_hash_obj);
+}
+
+void UTXOStatsBuilder::ApplyOutputs() {
+    ApplyStats(m_stats, m_prevkey, m_outputs);
+    std::visit(
+        [&](auto &hash_obj) { ApplyHash(hash_obj, m_prevkey, m_outputs); },
+        m_hash_obj);
+    m_outputs.clear();
+}
+
+bool UTXOStatsBuilder::Add(const COutPoint &outpoint, Coin coin) {
+    if (!m_outputs.empty() && outpoint.GetTxId() != m_prevkey) {
+        // Each transaction must show up in a single group, in the same order
+        // as the database keys.
+        if (outpoint.GetTxId() < m_prevkey) {
+            return false;
+        }
+        ApplyOutputs();
+    }
+    m_prevkey = outpoint.GetTxId();
+    if (!m_outputs.try_emplace(outpoint.GetN(), std::move(coin)).second) {
+        return false;
+    }
+    m_stats.coins_count++;
+    return true;
+}
+
+CCoinsStats UTXOStatsBuilder::Finalize() {
+    if (!m_outputs.empty()) {
+        ApplyOutputs();
+    }
+    std::visit([&](auto &hash_obj) { FinalizeHash(hash_obj, m_stats); },
+               m_hash_obj);
+    return m_stats;
+}
+
+//! Calculate statistics about the unspent transaction output set
+std::optional<CCoinsStats>
+ComputeUTXOStats(CoinStatsHashType hash_type, CCoinsView *view,
+                 node::BlockManager &blockman,
+                 const std::function<void()> &interruption_point) {
+    CBlockIndex *pindex = WITH_LOCK(
+        ::cs_main, return blockman.LookupBlockIndex(view->GetBestBlock()));
+    UTXOStatsBuilder builder{hash_type, Assert(pindex)->nHeight,
+                             pindex->GetBlockHash()};
+
+    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
+    assert(pcursor);
+
+    while (pcursor->Valid()) {
+        interruption_point();
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+            error("%s: unable to read value", __func__);
+            return std::nullopt;
+        }
+        if (!builder.Add(key, std::move(coin))) {
+            error("%s: coins are not in database order", __func__);
+            return std::nullopt;
+        }
+        pcursor->Next();
+    }
+
+    CCoinsStats stats = builder.Finalize();
+    stats.nDiskSize = view->EstimateSize();
+    return stats;
+}
+
 } // namespace kernel
@@ -8,11 +8,16 @@
 #include <chain.h>
 #include <coins.h>
 #include <consensus/amount.h>
+#include <crypto/muhash.h>
+#include <hash.h>
+#include <primitives/txid.h>
 #include <streams.h>
 #include <uint256.h>
 
 #include <cstdint>
 #include <functional>
+#include <map>
+#include <variant>
 
 class CCoinsView;
 namespace node {
@@ -77,6 +82,39 @@ uint64_t GetBogoSize(const CScript &script_pub_key);
 
 CDataStream TxOutSer(const COutPoint &outpoint, const Coin &coin);
 
+/**
+ * Computes the statistics of a UTXO set from its coins, supplied one at a
+ * time in database order, i.e. grouped by txid with txids in ascending order.
+ * This is what ComputeUTXOStats uses to walk a CCoinsView, and it allows to
+ * compute the very same statistics and hash over any stream of coins, e.g.
+ * while a UTXO snapshot is being written or loaded.
+ */
+class UTXOStatsBuilder {
+public:
+    UTXOStatsBuilder(CoinStatsHashType hash_type, int block_height,
+                     const BlockHash &block_hash);
+
+    /**
+     * Add the next coin. Returns false if the coin is out of order or
+     * duplicated, in which case the resulting statistics would not match the
+     * ones of a database holding the same coins.
+     */
+    [[nodiscard]] bool Add(const COutPoint &outpoint, Coin coin);
+
+    /** Compute the final statistics. Invalidates this object. */
+    CCoinsStats Finalize();
+
+private:
+    CCoinsStats m_stats;
+    std::variant<HashWriter, MuHash3072, std::nullptr_t> m_hash_obj;
+
+    //! Coins of the transaction currently being added, indexed by output.
+    TxId m_prevkey;
+    std::map<uint32_t, Coin> m_outputs;
+
+    void ApplyOutputs();
+};
+
 std::optional<CCoinsStats>
 ComputeUTXOStats(CoinStatsHashType hash_type, CCoinsView *view,
                  node::BlockManager &blockman,
@@ -152,20 +152,28 @@ void DisconnectedBlockTransactions::removeForBlock(
 
     addForBlock(vtx, pool);
 
+    // Sort the queued transactions in a single pass, then remove the confirmed
+    // ones and the conflicts each as one staged removal, instead of updating
+    // the mempool links once per transaction.
+    std::vector<CTxMemPool::txiter> confirmed;
+    std::vector<CTransactionRef> unconfirmed;
     for (const CTransactionRef &tx :
          reverse_iterate(queuedTx.get<insertion_order>())) {
         CTxMemPool::txiter it = pool.mapTx.find(tx->GetId());
         if (it != pool.mapTx.end()) {
-            CTxMemPool::setEntries stage;
-            stage.insert(it);
-            pool.RemoveStaged(stage, MemPoolRemovalReason::BLOCK);
+            confirmed.push_back(it);
         } else {
             // Conflicting txs can only exist if the tx was not in the mempool
-            pool.removeConflicts(*tx);
+            unconfirmed.push_back(tx);
         }
         pool.ClearPrioritisation(tx->GetId());
     }
 
+    // The confirmed transactions go first so they can't be mistaken for
+    // conflicts of a queued transaction that spends the same outputs.
+    pool.RemoveStaged(confirmed, MemPoolRemovalReason::BLOCK);
+    pool.removeConflicts(unconfirmed);
+
     pool.updateFeeForBlock();
 
     removeForBlock(vtx);
@@ -11,13 +11,14 @@
 #include <policy/settings.h>
 #include <primitives/transaction.h>
 #include <rcu.h>
+#include <util/epochguard.h>
 
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <memory>
-#include <set>
+#include <vector>
 
 struct LockPoints {
     // Will be set to the blockchain height and median time past values that
@@ -65,11 +66,13 @@ using CTxMemPoolEntryRef = RCUPtr<CTxMemPoolEntry>;
 class CTxMemPoolEntry {
 public:
     // two aliases, should the types ever diverge
-    typedef std::set<std::reference_wrapper<const CTxMemPoolEntryRef>,
-                     CompareIteratorById>
+    // The links to the in-mempool parents and children are kept sorted by
+    // txid (see CompareIteratorById) in flat vectors: there are usually only a
+    // few of them, and walking the mempool graph then doesn't chase pointers
+    // through tree nodes.
+    typedef std::vector<std::reference_wrapper<const CTxMemPoolEntryRef>>
         Parents;
-    typedef std::set<std::reference_wrapper<const CTxMemPoolEntryRef>,
-                     CompareIteratorById>
+    typedef std::vector<std::reference_wrapper<const CTxMemPoolEntryRef>>
         Children;
 
 private:
@@ -115,7 +118,9 @@ public:
           nTime(other.nTime), entryHeight(other.entryHeight),
           sigChecks(other.sigChecks), feeDelta(other.feeDelta),
           lockPoints(std::move(other.lockPoints)),
-          refcount(other.refcount.load()){};
+          refcount(other.refcount.load()),
+          m_epoch_marker(other.m_epoch_marker),
+          m_expiry_pos(other.m_expiry_pos){};
 
     uint64_t GetEntryId() const { return entryId; }
     //! This should only be set by addUnchecked() before entry insertion into
@@ -148,6 +153,11 @@ public:
     const Children &GetMemPoolChildrenConst() const { return m_children; }
     Parents &GetMemPoolParents() const { return m_parents; }
     Children &GetMemPoolChildren() const { return m_children; }
+
+    //! epoch when last touched, useful for graph algorithms
+    mutable Epoch::Marker m_epoch_marker;
+    //! position in the mempool expiry bucket of its entry time
+    mutable size_t m_expiry_pos{0};
 };
 
 #endif // BITCOIN_KERNEL_MEMPOOL_ENTRY_H
@@ -35,6 +35,8 @@ using fsbridge::FopenFn;
 
 namespace kernel {
 static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+//! Number of transactions read from the file and submitted together.
+static constexpr size_t LOAD_MEMPOOL_BATCH_SIZE{1000};
 
 bool LoadMempool(CTxMemPool &pool, const fs::path &load_path,
                  Chainstate &active_chainstate,
@@ -67,24 +69,43 @@ bool LoadMempool(CTxMemPool &pool, const fs::path &load_path,
 
         uint64_t num;
         file >> num;
+        std::vector<CTransactionRef> batch;
+        std::vector<int64_t> batch_times;
         while (num) {
-            --num;
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            Amount amountdelta = nFeeDelta * SATOSHI;
-            if (amountdelta != Amount::zero()) {
-                pool.PrioritiseTransaction(tx->GetId(), amountdelta);
+            batch.clear();
+            batch_times.clear();
+            while (num && batch.size() < LOAD_MEMPOOL_BATCH_SIZE) {
+                --num;
+                CTransactionRef tx;
+                int64_t nTime;
+                int64_t nFeeDelta;
+                file >> tx;
+                file >> nTime;
+                file >> nFeeDelta;
+
+                Amount amountdelta = nFeeDelta * SATOSHI;
+                if (amountdelta != Amount::zero()) {
+                    pool.PrioritiseTransaction(tx->GetId(), amountdelta);
+                }
+                if (nTime > TicksSinceEpoch<std::chrono::seconds>(
+                                now - pool.m_expiry)) {
+                    batch.push_back(std::move(tx));
+                    batch_times.push_back(nTime);
+                } else {
+                    ++expired;
+                }
             }
-            if (nTime >
-                TicksSinceEpoch<std::chrono::seconds>(now - pool.m_expiry)) {
+
+            // The transactions were dumped in the order they entered the
+            // mempool, so the parents come first and the whole batch can have
+            // its signatures checked in parallel before being submitted.
+            WITH_LOCK(cs_main, WarmSignatureCache(active_chainstate, batch));
+
+            for (size_t i = 0; i < batch.size(); ++i) {
+                const CTransactionRef &tx = batch[i];
                 LOCK(cs_main);
                 const auto &accepted =
-                    AcceptToMemoryPool(active_chainstate, tx, nTime,
+                    AcceptToMemoryPool(active_chainstate, tx, batch_times[i],
                                        /*bypass_limits=*/false,
                                        /*test_accept=*/false);
                 if (accepted.m_result_type ==
@@ -101,8 +122,10 @@ bool LoadMempool(CTxMemPool &pool, const fs::path &load_path,
                         ++failed;
                     }
                 }
-            } else {
-                ++expired;
+
+                if (ShutdownRequested()) {
+                    return false;
+                }
             }
 
             if (ShutdownRequested()) {
@@ -157,6 +180,8 @@ bool DumpMempool(const CTxMemPool &pool, const fs::path &dump_path,
             mapDeltas[i.first] = i.second;
         }
 
+        // In the order the transactions entered the mempool, so parents come
+        // before their children as LoadMempool expects.
         vinfo = pool.infoAll();
         unbroadcast_txids = pool.GetUnbroadcastTxs();
     }
@@ -13,11 +13,13 @@
 #include <addrman.h>
 #include <avalanche/avalanche.h>
 #include <banman.h>
+#include <blockencodings.h>
 #include <clientversion.h>
 #include <common/args.h>
 #include <compat.h>
 #include <config.h>
 #include <consensus/consensus.h>
+#include <core_memusage.h>
 #include <crypto/sha256.h>
 #include <dnsseeds.h>
 #include <i2p.h>
@@ -25,10 +27,13 @@
 #include <netaddress.h>
 #include <netbase.h>
 #include <node/ui_interface.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
 #include <protocol.h>
 #include <random.h>
 #include <scheduler.h>
 #include <util/fs.h>
+#include <util/lz.h>
 #include <util/sock.h>
 #include <util/strencodings.h>
 #include <util/thread.h>
@@ -664,11 +669,25 @@ void CNode::copyStats(CNodeStats &stats) {
         LOCK(cs_vSend);
         stats.mapSendBytesPerMsgCmd = mapSendBytesPerMsgCmd;
         stats.nSendBytes = nSendBytes;
+        stats.m_compression_sent = m_compression_sent;
+        // Include the stall in progress, if any.
+        stats.m_send_stall_time = m_send_stall_time;
+        if (m_send_stall_start) {
+            stats.m_send_stall_time +=
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    SteadyClock::now() - *m_send_stall_start);
+        }
     }
     {
         LOCK(cs_vRecv);
         stats.mapRecvBytesPerMsgCmd = mapRecvBytesPerMsgCmd;
         stats.nRecvBytes = nRecvBytes;
+        stats.m_compression_recv = m_compression_recv;
+    }
+    {
+        LOCK(m_process_time_mutex);
+        stats.m_process_time_per_msg_cmd = m_process_time_per_msg_cmd;
+        stats.m_queue_wait_time = m_queue_wait_time;
     }
     stats.m_permission_flags = m_permission_flags;
 
@@ -687,10 +706,124 @@ void CNode::copyStats(CNodeStats &stats) {
                                     : std::nullopt;
 }
 
+static size_t TxsDynamicUsage(const std::vector<CTransactionRef> &txs) {
+    size_t usage{memusage::DynamicUsage(txs)};
+    for (const auto &tx : txs) {
+        usage += RecursiveDynamicUsage(tx);
+    }
+    return usage;
+}
+
+void CNetMessage::Preparse() {
+    if (!m_valid_netmagic || !m_valid_header || !m_valid_checksum) {
+        return;
+    }
+
+    SpanReader reader{m_recv.GetType(), m_recv.GetVersion(),
+                      MakeUCharSpan(m_recv)};
+    try {
+        if (m_type == NetMsgType::BLOCK) {
+            auto block = std::make_shared<CBlock>();
+            reader >> *block;
+            m_parsed_usage =
+                memusage::DynamicUsage(block) + TxsDynamicUsage(block->vtx);
+            m_block = std::move(block);
+        } else if (m_type == NetMsgType::BLOCKTXN) {
+            auto blocktxn = std::make_shared<BlockTransactions>();
+            reader >> *blocktxn;
+            m_parsed_usage = memusage::DynamicUsage(blocktxn) +
+                             TxsDynamicUsage(blocktxn->txn);
+            m_blocktxn = std::move(blocktxn);
+        } else if (m_type == NetMsgType::TX) {
+            reader >> m_tx;
+            m_parsed_usage = RecursiveDynamicUsage(m_tx);
+        }
+    } catch (const std::exception &) {
+        // The message handler will parse it again and fail the same way.
+    }
+}
+
+bool IsCompressibleMessage(const std::string &msg_type) {
+    return msg_type == NetMsgType::HEADERS || msg_type == NetMsgType::BLOCK ||
+           msg_type == NetMsgType::BLOCKTXN;
+}
+
+std::optional<CSerializedNetMsg>
+CompressMessage(const CSerializedNetMsg &msg) {
+    const Span<const uint8_t> payload{msg.Payload()};
+
+    CSerializedNetMsg compressed;
+    compressed.m_type = NetMsgType::CMPRMSG;
+    CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, compressed.data, 0,
+                  msg.m_type, COMPACTSIZE(uint64_t{payload.size()})};
+    LZCompress(payload, compressed.data);
+    if (compressed.data.size() >= payload.size()) {
+        return std::nullopt;
+    }
+    return compressed;
+}
+
+bool DecompressMessage(const Config &config, CNetMessage &msg) {
+    std::string msg_type;
+    uint64_t raw_size;
+    try {
+        msg.m_recv >> LIMITED_STRING(msg_type, CMessageHeader::COMMAND_SIZE) >>
+            COMPACTSIZE(raw_size);
+    } catch (const std::exception &) {
+        return false;
+    }
+
+    if (!IsCompressibleMessage(msg_type)) {
+        return false;
+    }
+    // Apply the same limits as CMessageHeader::IsOversized() to the payload
+    // before allocating it.
+    const uint64_t max_size = NetMsgType::IsBlockLike(msg_type)
+                                  ? 2 * config.GetMaxBlockSize()
+                                  : MAX_PROTOCOL_MESSAGE_LENGTH;
+    if (raw_size > max_size) {
+        return false;
+    }
+
+    CDataStream raw{msg.m_recv.GetType(), msg.m_recv.GetVersion()};
+    raw.resize(raw_size);
+    if (!LZDecompress(MakeUCharSpan(msg.m_recv), MakeUCharSpan(raw))) {
+        return false;
+    }
+
+    msg.m_recv = std::move(raw);
+    msg.m_type = std::move(msg_type);
+    msg.m_message_size = raw_size;
+    return true;
+}
+
+MsgPriority GetMessagePriority(const std::string &msg_type) {
+    if (msg_type == NetMsgType::HEADERS || msg_type == NetMsgType::CMPCTBLOCK ||
+        msg_type == NetMsgType::BLOCKTXN ||
+        msg_type == NetMsgType::GETBLOCKTXN || msg_type == NetMsgType::BLOCK) {
+        return MsgPriority::BLOCK;
+    }
+    if (msg_type == NetMsgType::AVAHELLO || msg_type == NetMsgType::AVAPOLL ||
+        msg_type == NetMsgType::AVARESPONSE ||
+        msg_type == NetMsgType::AVAPROOF ||
+        msg_type == NetMsgType::GETAVAADDR ||
+        msg_type == NetMsgType::GETAVAPROOFS ||
+        msg_type == NetMsgType::AVAPROOFS ||
+        msg_type == NetMsgType::AVAPROOFSREQ) {
+        return MsgPriority::AVALANCHE;
+    }
+    if (msg_type == NetMsgType::ADDR || msg_type == NetMsgType::ADDRV2 ||
+        msg_type == NetMsgType::GETADDR) {
+        return MsgPriority::ADDR;
+    }
+    return MsgPriority::DEFAULT;
+}
+
 bool CNode::ReceiveMsgBytes(const Config &config, Span<const uint8_t> msg_bytes,
                             bool &complete) {
     complete = false;
     const auto time = GetTime<std::chrono::microseconds>();
+    const auto steady_time{SteadyClock::now()};
     LOCK(cs_vRecv);
     m_last_recv = std::chrono::duration_cast<std::chrono::seconds>(time);
     nRecvBytes += msg_bytes.size();
@@ -704,6 +837,28 @@ bool CNode::ReceiveMsgBytes(const Config &config, Span<const uint8_t> msg_bytes,
         if (m_deserializer->Complete()) {
             // decompose a transport agnostic CNetMessage from the deserializer
             CNetMessage msg = m_deserializer->GetMessage(config, time);
+            msg.m_steady_time = steady_time;
+
+            // Unwrap the compressed messages of the peers we allow to send
+            // them, so they are accounted and processed as the message they
+            // carry.
+            if (msg.m_type == NetMsgType::CMPRMSG && msg.m_valid_netmagic &&
+                msg.m_valid_header && msg.m_valid_checksum &&
+                HasPermission(NetPermissionFlags::Compress)) {
+                const auto start{SteadyClock::now()};
+                const uint32_t compressed_size{msg.m_message_size};
+                if (!DecompressMessage(config, msg)) {
+                    LogPrint(BCLog::NET,
+                             "Invalid compressed message from peer=%d\n",
+                             GetId());
+                    return false;
+                }
+                m_compression_recv.raw_bytes += msg.m_message_size;
+                m_compression_recv.compressed_bytes += compressed_size;
+                m_compression_recv.time +=
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        SteadyClock::now() - start);
+            }
 
             // Store received bytes per message command to prevent a memory DOS,
             // only allow valid commands.
@@ -715,6 +870,14 @@ bool CNode::ReceiveMsgBytes(const Config &config, Span<const uint8_t> msg_bytes,
             assert(i != mapRecvBytesPerMsgCmd.end());
             i->second += msg.m_raw_message_size;
 
+            // Only parse the payloads the message handler accepts from this
+            // peer, anything else is left for it to reject cheaply.
+            if (fSuccessfullyConnected &&
+                (msg.m_type == NetMsgType::TX ? m_preparse_txs.load()
+                                              : m_preparse_blocks.load())) {
+                msg.Preparse();
+            }
+
             // push the message to the process queue,
             vRecvMsg.push_back(std::move(msg));
 
@@ -725,6 +888,111 @@ bool CNode::ReceiveMsgBytes(const Config &config, Span<const uint8_t> msg_bytes,
     return true;
 }
 
+/**
+ * Whether a message of the DEFAULT queue must be processed before the block
+ * propagation messages received after it: a compact block is reconstructed
+ * from the transactions its sender relayed first.
+ */
+static bool IsOrderedWithBlocks(const std::string &msg_type) {
+    return msg_type == NetMsgType::TX ||
+           GetMessagePriority(msg_type) == MsgPriority::BLOCK;
+}
+
+void CNode::MarkReceivedMsgsForProcessing(size_t recv_flood_size) {
+    // Keep the messages of the version handshake in order, the peer state
+    // they set up is needed to process the other ones.
+    const bool handshake_done{fSuccessfullyConnected};
+
+    LOCK(cs_vProcessMsg);
+    // vRecvMsg contains only completed CNetMessage, the single possible
+    // partially deserialized message is held by the TransportDeserializer.
+    while (!vRecvMsg.empty()) {
+        const std::string &msg_type{vRecvMsg.front().m_type};
+        MsgPriority priority{handshake_done ? GetMessagePriority(msg_type)
+                                            : MsgPriority::DEFAULT};
+        if (priority == MsgPriority::BLOCK && m_process_msgs_ordered > 0) {
+            priority = MsgPriority::DEFAULT;
+        }
+        if (priority == MsgPriority::DEFAULT && IsOrderedWithBlocks(msg_type)) {
+            ++m_process_msgs_ordered;
+        }
+        auto &queue = m_process_msgs[size_t(priority)];
+        nProcessQueueSize += vRecvMsg.front().GetProcessQueueSize();
+        queue.splice(queue.end(), vRecvMsg, vRecvMsg.begin());
+    }
+    fPauseRecv = nProcessQueueSize > recv_flood_size;
+}
+
+std::optional<std::pair<CNetMessage, bool>>
+CNode::PollMessage(size_t recv_flood_size) {
+    LOCK(cs_vProcessMsg);
+
+    // Serve the most urgent class, or the most urgent of the classes which
+    // have been passed over too many times so none of them starves.
+    std::optional<size_t> selected;
+    for (size_t i = 0; i < NUM_MSG_PRIORITIES; ++i) {
+        if (m_process_msgs[i].empty()) {
+            continue;
+        }
+        if (!selected) {
+            selected = i;
+        }
+        if (m_process_msgs_skipped[i] >= MAX_MSG_PRIORITY_SKIPS) {
+            selected = i;
+            break;
+        }
+    }
+    if (!selected) {
+        return std::nullopt;
+    }
+
+    return TakeMessage(*selected, recv_flood_size);
+}
+
+std::optional<std::pair<CNetMessage, bool>>
+CNode::PollUrgentMessage(size_t recv_flood_size) {
+    LOCK(cs_vProcessMsg);
+    if (m_process_msgs[size_t(MsgPriority::BLOCK)].empty()) {
+        return std::nullopt;
+    }
+    return TakeMessage(size_t(MsgPriority::BLOCK), recv_flood_size);
+}
+
+std::pair<CNetMessage, bool> CNode::TakeMessage(size_t priority,
+                                                size_t recv_flood_size) {
+    AssertLockHeld(cs_vProcessMsg);
+
+    bool more{false};
+    for (size_t i = 0; i < NUM_MSG_PRIORITIES; ++i) {
+        if (i != priority && !m_process_msgs[i].empty()) {
+            more = true;
+            if (i > priority) {
+                ++m_process_msgs_skipped[i];
+            }
+        }
+    }
+    m_process_msgs_skipped[priority] = 0;
+
+    auto &queue = m_process_msgs[priority];
+    std::pair<CNetMessage, bool> result{std::move(queue.front()), false};
+    queue.pop_front();
+    result.second = more || !queue.empty();
+
+    if (priority == size_t(MsgPriority::DEFAULT) &&
+        IsOrderedWithBlocks(result.first.m_type)) {
+        --m_process_msgs_ordered;
+    }
+    nProcessQueueSize -= result.first.GetProcessQueueSize();
+    fPauseRecv = nProcessQueueSize > recv_flood_size;
+
+    return result;
+}
+
+bool CNode::HasUrgentMessages() {
+    LOCK(cs_vProcessMsg);
+    return !m_process_msgs[size_t(MsgPriority::BLOCK)].empty();
+}
+
 int V1TransportDeserializer::readHeader(const Config &config,
                                         Span<const uint8_t> msg_bytes) {
     // copy data to temporary parsing buffer
@@ -831,11 +1099,11 @@ void V1TransportSerializer::prepareForTransport(const Config &config,
                                                 CSerializedNetMsg &msg,
                                                 std::vector<uint8_t> &header) {
     // create dbl-sha256 checksum
-    uint256 hash = Hash(msg.data);
+    uint256 hash = Hash(msg.Payload());
 
     // create header
     CMessageHeader hdr(config.GetChainParams().NetMagic(), msg.m_type.c_str(),
-                       msg.data.size());
+                       msg.Payload().size());
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
     // serialize header
@@ -847,7 +1115,10 @@ std::pair<size_t, bool> CConnman::SocketSendData(CNode &node) const {
     size_t nSentSize = 0;
     size_t nMsgCount = 0;
 
-    for (const auto &data : node.vSendMsg) {
+    for (auto &data : node.vSendMsg) {
+        if (data.NeedsCompression()) {
+            CompressSendChunk(node, data);
+        }
         assert(data.size() > node.nSendOffset);
         int nBytes = 0;
 
@@ -864,6 +1135,7 @@ std::pair<size_t, bool> CConnman::SocketSendData(CNode &node) const {
 
         if (nBytes == 0) {
             // couldn't send anything at all
+            StartSendStall(node);
             break;
         }
 
@@ -875,18 +1147,22 @@ std::pair<size_t, bool> CConnman::SocketSendData(CNode &node) const {
                 LogPrint(BCLog::NET, "socket send error for peer=%d: %s\n",
                          node.GetId(), NetworkErrorString(nErr));
                 node.CloseSocketDisconnect();
+            } else {
+                StartSendStall(node);
             }
 
             break;
         }
 
         assert(nBytes > 0);
+        EndSendStall(node);
         node.m_last_send = GetTime<std::chrono::seconds>();
         node.nSendBytes += nBytes;
         node.nSendOffset += nBytes;
         nSentSize += nBytes;
         if (node.nSendOffset != data.size()) {
             // could not send full message; stop sending more
+            StartSendStall(node);
             break;
         }
 
@@ -907,6 +1183,54 @@ std::pair<size_t, bool> CConnman::SocketSendData(CNode &node) const {
     return {nSentSize, !node.vSendMsg.empty()};
 }
 
+void CConnman::StartSendStall(CNode &node) const {
+    if (!node.m_send_stall_start) {
+        node.m_send_stall_start = SteadyClock::now();
+    }
+}
+
+void CConnman::EndSendStall(CNode &node) const {
+    if (!node.m_send_stall_start) {
+        return;
+    }
+    const auto stall{std::chrono::duration_cast<std::chrono::microseconds>(
+        SteadyClock::now() - *node.m_send_stall_start)};
+    node.m_send_stall_start.reset();
+    node.m_send_stall_time += stall;
+
+    LOCK(m_timing_stats_mutex);
+    m_timing_stats.send_stall.Add(stall);
+}
+
+void CConnman::CompressSendChunk(CNode &node, CSendChunk &chunk) const {
+    const auto start{SteadyClock::now()};
+
+    CSerializedNetMsg msg{chunk.TakeMessageToCompress()};
+    const size_t raw_size{msg.Payload().size()};
+    std::optional<CSerializedNetMsg> compressed{CompressMessage(msg)};
+    CSerializedNetMsg &to_send{compressed ? *compressed : msg};
+
+    std::vector<uint8_t> bytes;
+    node.m_serializer->prepareForTransport(*config, to_send, bytes);
+    const Span<const uint8_t> payload{to_send.Payload()};
+    bytes.insert(bytes.end(), payload.begin(), payload.end());
+
+    // The message was queued with the size it has uncompressed.
+    const size_t saved{CMessageHeader::HEADER_SIZE + raw_size - bytes.size()};
+    node.nSendSize -= saved;
+    node.mapSendBytesPerMsgCmd[msg.m_type] -= saved;
+
+    if (compressed) {
+        node.m_compression_sent.raw_bytes += raw_size;
+        node.m_compression_sent.compressed_bytes += payload.size();
+    }
+    node.m_compression_sent.time +=
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            SteadyClock::now() - start);
+
+    chunk = CSendChunk{std::move(bytes)};
+}
+
 static bool ReverseCompareNodeMinPingTime(const NodeEvictionCandidate &a,
                                           const NodeEvictionCandidate &b) {
     return a.m_min_ping_time > b.m_min_ping_time;
@@ -1405,6 +1729,7 @@ void CConnman::CreateNodeFromAcceptedSocket(std::unique_ptr<Sock> &&sock,
     {
         LOCK(m_nodes_mutex);
         m_nodes.push_back(pnode);
+        WatchNodeSocket(*pnode);
     }
 
     // We received a new connection, harvest entropy from the time (and our peer
@@ -1489,6 +1814,7 @@ void CConnman::DisconnectNodes() {
                 pnode->grantOutbound.Release();
 
                 // close socket and cleanup
+                UnwatchNodeSocket(*pnode);
                 pnode->CloseSocketDisconnect();
 
                 // hold in disconnected pool until all refs are released
@@ -1570,11 +1896,15 @@ bool CConnman::InactivityCheck(const CNode &node) const {
     return false;
 }
 
-Sock::EventsPerSock CConnman::GenerateWaitSockets(Span<CNode *const> nodes) {
+Sock::EventsPerSock CConnman::GenerateWaitSockets(Span<CNode *const> nodes,
+                                                  bool listening) {
     Sock::EventsPerSock events_per_sock;
 
-    for (const ListenSocket &hListenSocket : vhListenSocket) {
-        events_per_sock.emplace(hListenSocket.sock, Sock::Events{Sock::RECV});
+    if (listening) {
+        for (const ListenSocket &hListenSocket : vhListenSocket) {
+            events_per_sock.emplace(hListenSocket.sock,
+                                    Sock::Events{Sock::RECV});
+        }
     }
 
     for (CNode *pnode : nodes) {
@@ -1596,11 +1926,79 @@ Sock::EventsPerSock CConnman::GenerateWaitSockets(Span<CNode *const> nodes) {
     return events_per_sock;
 }
 
-void CConnman::SocketHandler() {
+void CConnman::WatchNodeSocket(CNode &node) {
+#ifdef USE_EPOLL
+    if (m_net_shards.empty()) {
+        return;
+    }
+    const auto &epoll = m_net_shards[GetNetShard(node.GetId())].epoll;
+    if (!epoll) {
+        return;
+    }
+
+    m_net_shards[GetNetShard(node.GetId())].nodes.emplace(node.GetId(), &node);
+
+    LOCK(node.m_sock_mutex);
+    if (node.m_sock &&
+        !epoll->Add(*node.m_sock, node.GetId(), /*edge_triggered=*/true)) {
+        // The socket would never be serviced.
+        LogPrint(BCLog::NET, "failed to watch socket for peer=%d: %s\n",
+                 node.GetId(), NetworkErrorString(WSAGetLastError()));
+        node.fDisconnect = true;
+    }
+#endif
+}
+
+void CConnman::UnwatchNodeSocket(CNode &node) {
+#ifdef USE_EPOLL
+    if (m_net_shards.empty()) {
+        return;
+    }
+    const auto &epoll = m_net_shards[GetNetShard(node.GetId())].epoll;
+    if (!epoll) {
+        return;
+    }
+
+    m_net_shards[GetNetShard(node.GetId())].nodes.erase(node.GetId());
+
+    LOCK(node.m_sock_mutex);
+    if (node.m_sock) {
+        epoll->Remove(*node.m_sock);
+    }
+#endif
+}
+
+bool CConnman::WakeSocketHandler(const CNode &node) {
+#ifdef USE_EPOLL
+    if (m_net_shards.empty()) {
+        return false;
+    }
+    NetShard &net_shard = m_net_shards[GetNetShard(node.GetId())];
+    if (!net_shard.epoll) {
+        return false;
+    }
+    WITH_LOCK(net_shard.send_mutex,
+              net_shard.send_pending.push_back(node.GetId()));
+    return net_shard.epoll->Interrupt();
+#else
+    return false;
+#endif
+}
+
+void CConnman::SocketHandler(size_t shard) {
+#ifdef USE_EPOLL
+    if (m_net_shards[shard].epoll) {
+        SocketHandlerEpoll(shard);
+        return;
+    }
+#endif
+
+    // Only the first network thread accepts connections.
+    const bool listening = shard == 0;
     Sock::EventsPerSock events_per_sock;
 
     {
-        const NodesSnapshot snap{*this, /*shuffle=*/false};
+        const NodesSnapshot snap{*this, shard};
 
         const auto timeout =
             std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS);
@@ -1609,7 +2007,7 @@ void CConnman::SocketHandler() {
         // listening sockets in one call ("readiness" as in poll(2) or
         // select(2)). If none are ready, wait for a short while and return
         // empty sets.
-        events_per_sock = GenerateWaitSockets(snap.Nodes());
+        events_per_sock = GenerateWaitSockets(snap.Nodes(), listening);
         if (events_per_sock.empty() ||
             !events_per_sock.begin()->first->WaitMany(timeout,
                                                       events_per_sock)) {
@@ -1621,8 +2019,139 @@ void CConnman::SocketHandler() {
     }
 
     // Accept new connections from listening sockets.
+    if (listening) {
+        SocketHandlerListening(events_per_sock);
+    }
+}
+
+#ifdef USE_EPOLL
+void CConnman::SocketHandlerEpoll(size_t shard) {
+    NetShard &net_shard = m_net_shards[shard];
+    auto &ready_nodes = net_shard.ready_nodes;
+    Sock::EventsPerSock events_per_sock;
+
+    // The connected sockets are edge triggered: a node that still had data
+    // to read after the previous iteration won't be reported again, so don't
+    // wait if there is one. A node whose send buffer is full is not counted:
+    // it is only read from once per wait, like after a partial send with
+    // select(), until its socket is writable again. Otherwise a peer that
+    // doesn't drain its receive window would keep this thread spinning.
+    const bool pending = std::any_of(
+        ready_nodes.begin(), ready_nodes.end(), [](const auto &entry) {
+            CNode *pnode = entry.second;
+            if (pnode->m_sock_ready & Sock::ERR) {
+                return true;
+            }
+            if (!(pnode->m_sock_ready & Sock::RECV) || pnode->fPauseRecv) {
+                return false;
+            }
+            return (pnode->m_sock_ready & Sock::SEND) ||
+                   WITH_LOCK(pnode->cs_vSend, return pnode->vSendMsg.empty());
+        });
+    const auto timeout =
+        pending ? 0ms : std::chrono::milliseconds(SELECT_TIMEOUT_MILLISECONDS);
+
+    SockEpoll::ReadySocks ready;
+    if (!net_shard.epoll->Wait(timeout, ready)) {
+        interruptNet.sleep_for(timeout);
+    }
+
+    std::vector<NodeId> send_pending;
+    WITH_LOCK(net_shard.send_mutex, send_pending.swap(net_shard.send_pending));
+
+    // Add the nodes reported ready, and the ones with messages to send, to the
+    // ready set. A node may already be gone.
+    {
+        LOCK(m_nodes_mutex);
+        auto add_ready = [&](NodeId id, Sock::Event occurred) {
+            const auto it = net_shard.nodes.find(id);
+            if (it == net_shard.nodes.end()) {
+                return;
+            }
+            CNode *pnode = it->second;
+            pnode->m_sock_ready |= occurred;
+            if (ready_nodes.emplace(id, pnode).second) {
+                pnode->AddRef();
+            }
+        };
+        for (const auto &[id, occurred] : ready) {
+            if (id & LISTEN_SOCKET_ID) {
+                Sock::Events events{Sock::RECV};
+                events.occurred = occurred;
+                events_per_sock.emplace(
+                    vhListenSocket.at(id & ~LISTEN_SOCKET_ID).sock, events);
+                continue;
+            }
+            add_ready(NodeId(id), occurred);
+        }
+        for (const NodeId id : send_pending) {
+            add_ready(id, 0);
+        }
+    }
+
+    // Select the nodes that have something to do with their readiness, just
+    // like GenerateWaitSockets() would.
+    std::vector<CNode *> nodes;
+    nodes.reserve(ready_nodes.size());
+    for (const auto &[id, pnode] : ready_nodes) {
+        Sock::Event event = pnode->m_sock_ready & Sock::ERR;
+        if ((pnode->m_sock_ready & Sock::RECV) && !pnode->fPauseRecv) {
+            event |= Sock::RECV;
+        }
+        if ((pnode->m_sock_ready & Sock::SEND) &&
+            WITH_LOCK(pnode->cs_vSend, return !pnode->vSendMsg.empty())) {
+            event |= Sock::SEND;
+        }
+        if (event == 0) {
+            continue;
+        }
+
+        LOCK(pnode->m_sock_mutex);
+        if (pnode->m_sock) {
+            Sock::Events events{event};
+            events.occurred = event;
+            events_per_sock.emplace(pnode->m_sock, events);
+            nodes.push_back(pnode);
+        }
+    }
+
+    SocketHandlerConnected(nodes, events_per_sock);
+
+    // Keep the nodes with some readiness left to act on: data to read, or
+    // queued messages and a writable socket. A paused node stays, so it is
+    // read from again once resumed. The other nodes are added back when their
+    // socket is reported ready or when a message is queued for them.
+    for (auto it = ready_nodes.begin(); it != ready_nodes.end();) {
+        CNode *pnode = it->second;
+        const bool keep =
+            !pnode->fDisconnect &&
+            ((pnode->m_sock_ready & (Sock::RECV | Sock::ERR)) ||
+             ((pnode->m_sock_ready & Sock::SEND) &&
+              WITH_LOCK(pnode->cs_vSend, return !pnode->vSendMsg.empty())));
+        if (keep) {
+            ++it;
+            continue;
+        }
+        pnode->Release();
+        it = ready_nodes.erase(it);
+    }
+
+    // The idle nodes are not visited otherwise.
+    const auto now{SteadyClock::now()};
+    if (now >= net_shard.next_inactivity_check) {
+        net_shard.next_inactivity_check = now + 1s;
+        const NodesSnapshot snap{*this, shard};
+        for (CNode *pnode : snap.Nodes()) {
+            if (InactivityCheck(*pnode)) {
+                pnode->fDisconnect = true;
+            }
+        }
+    }
+
+    // The listening sockets are only registered with the first shard.
     SocketHandlerListening(events_per_sock);
 }
+#endif
 
 void CConnman::SocketHandlerConnected(
     const std::vector<CNode *> &nodes,
@@ -1670,6 +2199,11 @@ void CConnman::SocketHandlerConnected(
                     recvSet = false;
                 }
             }
+            // The send buffer is full, wait for the socket to be reported
+            // writable again.
+            if (data_left) {
+                pnode->m_sock_ready &= ~Sock::SEND;
+            }
         }
 
         if (recvSet || errorSet) {
@@ -1683,6 +2217,12 @@ void CConnman::SocketHandlerConnected(
                 }
                 nBytes =
                     pnode->m_sock->Recv(pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+                // A short read drained the socket, wait for it to be reported
+                // readable again. Retry later if interrupted by a signal.
+                if (nBytes >= 0 ? size_t(nBytes) < sizeof(pchBuf)
+                                : WSAGetLastError() != WSAEINTR) {
+                    pnode->m_sock_ready &= ~(Sock::RECV | Sock::ERR);
+                }
             }
             if (nBytes > 0) {
                 bool notify = false;
@@ -1692,23 +2232,7 @@ void CConnman::SocketHandlerConnected(
                 }
                 RecordBytesRecv(nBytes);
                 if (notify) {
-                    size_t nSizeAdded = 0;
-                    auto it(pnode->vRecvMsg.begin());
-                    for (; it != pnode->vRecvMsg.end(); ++it) {
-                        // vRecvMsg contains only completed CNetMessage
-                        // the single possible partially deserialized message
-                        // are held by TransportDeserializer
-                        nSizeAdded += it->m_raw_message_size;
-                    }
-                    {
-                        LOCK(pnode->cs_vProcessMsg);
-                        pnode->vProcessMsg.splice(pnode->vProcessMsg.end(),
-                                                  pnode->vRecvMsg,
-                                                  pnode->vRecvMsg.begin(), it);
-                        pnode->nProcessQueueSize += nSizeAdded;
-                        pnode->fPauseRecv =
-                            pnode->nProcessQueueSize > nReceiveFloodSize;
-                    }
+                    pnode->MarkReceivedMsgsForProcessing(nReceiveFloodSize);
                     WakeMessageHandler();
                 }
             } else if (nBytes == 0) {
@@ -1752,11 +2276,13 @@ void CConnman::SocketHandlerListening(
     }
 }
 
-void CConnman::ThreadSocketHandler() {
+void CConnman::ThreadSocketHandler(size_t shard) {
     while (!interruptNet) {
-        DisconnectNodes();
-        NotifyNumConnectionsChanged();
-        SocketHandler();
+        if (shard == 0) {
+            DisconnectNodes();
+            NotifyNumConnectionsChanged();
+        }
+        SocketHandler(shard);
     }
 }
 
@@ -2465,6 +2991,7 @@ void CConnman::OpenNetworkConnection(const CAddress &addrConnect,
     {
         LOCK(m_nodes_mutex);
         m_nodes.push_back(pnode);
+        WatchNodeSocket(*pnode);
     }
 }
 
@@ -2482,6 +3009,24 @@ void CConnman::ThreadMessageHandler() {
             // multiple consecutive connections in the vNodes list.
             const NodesSnapshot snap{*this, /*shuffle=*/true};
 
+            // Process the pending block propagation messages of all the peers
+            // first, so a block does not wait behind a full round of the other
+            // peers' transactions. Each peer still gets a single message per
+            // pass so none of them can monopolize the handler.
+            for (CNode *pnode : snap.Nodes()) {
+                if (pnode->fDisconnect || !pnode->HasUrgentMessages()) {
+                    continue;
+                }
+
+                for (auto interface : m_msgproc) {
+                    interface->ProcessUrgentMessage(*config, pnode,
+                                                    flagInterruptMsgProc);
+                }
+                if (flagInterruptMsgProc) {
+                    return;
+                }
+            }
+
             for (CNode *pnode : snap.Nodes()) {
                 if (pnode->fDisconnect) {
                     continue;
@@ -2783,6 +3328,31 @@ bool CConnman::Start(CScheduler &scheduler, const Options &connOptions) {
         return false;
     }
 
+    // NetShard is not movable.
+    m_net_shards = std::vector<NetShard>(m_net_threads);
+#ifdef USE_EPOLL
+    try {
+        for (NetShard &net_shard : m_net_shards) {
+            net_shard.epoll = std::make_unique<SockEpoll>();
+        }
+        for (size_t i = 0; i < vhListenSocket.size(); ++i) {
+            if (!m_net_shards[0].epoll->Add(*vhListenSocket[i].sock,
+                                            LISTEN_SOCKET_ID | i,
+                                            /*edge_triggered=*/false)) {
+                throw std::runtime_error(
+                    strprintf("epoll_ctl(): %s",
+                              NetworkErrorString(WSAGetLastError())));
+            }
+        }
+    } catch (const std::runtime_error &e) {
+        LogPrintf("Failed to set up epoll, falling back to poll: %s\n",
+                  e.what());
+        for (NetShard &net_shard : m_net_shards) {
+            net_shard.epoll.reset();
+        }
+    }
+#endif
+
     proxyType i2p_sam;
     if (GetProxy(NET_I2P, i2p_sam)) {
         m_i2p_sam_session = std::make_unique<i2p::sam::Session>(
@@ -2839,7 +3409,15 @@ bool CConnman::Start(CScheduler &scheduler, const Options &connOptions) {
 
     // Send and receive from sockets, accept connections
     threadSocketHandler = std::thread(&util::TraceThread, "net",
-                                      [this] { ThreadSocketHandler(); });
+                                      [this] { ThreadSocketHandler(0); });
+    // Send and receive from the sockets of the other shards
+    for (size_t shard = 1; shard < m_net_shards.size(); ++shard) {
+        m_net_shard_threads.emplace_back([this, shard] {
+            const std::string thread_name{strprintf("net.%u", shard)};
+            util::TraceThread(thread_name.c_str(),
+                              [this, shard] { ThreadSocketHandler(shard); });
+        });
+    }
 
     if (!gArgs.GetBoolArg("-dnsseed", DEFAULT_DNSSEED)) {
         LogPrintf("DNS seeding disabled\n");
@@ -2945,6 +3523,12 @@ void CConnman::StopThreads() {
     if (threadDNSAddressSeed.joinable()) {
         threadDNSAddressSeed.join();
     }
+    for (std::thread &thread : m_net_shard_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    m_net_shard_threads.clear();
     if (threadSocketHandler.joinable()) {
         threadSocketHandler.join();
     }
@@ -2980,6 +3564,7 @@ void CConnman::StopNodes() {
         DeleteNode(pnode);
     }
     m_nodes_disconnected.clear();
+    m_net_shards.clear();
     vhListenSocket.clear();
     semOutbound.reset();
     semAddnode.reset();
@@ -3250,6 +3835,36 @@ uint64_t CConnman::GetTotalBytesSent() const {
     return nTotalBytesSent;
 }
 
+void CConnman::RecordMessageProcessing(CNode &node,
+                                       const std::string &msg_type,
+                                       std::chrono::microseconds queue_wait,
+                                       std::chrono::microseconds process_time) {
+    // Only known message types are accounted by their type, to prevent a
+    // memory DOS.
+    const std::string *msg_cmd;
+    {
+        LOCK(node.m_process_time_mutex);
+        auto it = node.m_process_time_per_msg_cmd.find(msg_type);
+        if (it == node.m_process_time_per_msg_cmd.end()) {
+            it = node.m_process_time_per_msg_cmd.find(
+                NET_MESSAGE_COMMAND_OTHER);
+        }
+        assert(it != node.m_process_time_per_msg_cmd.end());
+        it->second += process_time;
+        node.m_queue_wait_time += queue_wait;
+        msg_cmd = &it->first;
+    }
+
+    LOCK(m_timing_stats_mutex);
+    m_timing_stats.process_time_per_msg_cmd[*msg_cmd].Add(process_time);
+    m_timing_stats.queue_wait.Add(queue_wait);
+}
+
+NetTimingStats CConnman::GetTimingStats() const {
+    LOCK(m_timing_stats_mutex);
+    return m_timing_stats;
+}
+
 ServiceFlags CConnman::GetLocalServices() const {
     return nLocalServices;
 }
@@ -3311,6 +3926,13 @@ CNode::CNode(NodeId idIn, std::shared_ptr<Sock> sock, const CAddress &addrIn,
         mapRecvBytesPerMsgCmd[msg] = 0;
     }
     mapRecvBytesPerMsgCmd[NET_MESSAGE_COMMAND_OTHER] = 0;
+    {
+        LOCK(m_process_time_mutex);
+        for (const std::string &msg : getAllNetMessageTypes()) {
+            m_process_time_per_msg_cmd[msg] = 0us;
+        }
+        m_process_time_per_msg_cmd[NET_MESSAGE_COMMAND_OTHER] = 0us;
+    }
 
     if (fLogIPs) {
         LogPrint(BCLog::NET, "Added connection to %s peer=%d\n", m_addr_name,
@@ -3331,22 +3953,33 @@ bool CConnman::NodeFullyConnected(const CNode *pnode) {
 }
 
 void CConnman::PushMessage(CNode *pnode, CSerializedNetMsg &&msg) {
-    size_t nMessageSize = msg.data.size();
+    const Span<const uint8_t> payload{msg.Payload()};
+    size_t nMessageSize = payload.size();
     LogPrint(BCLog::NETDEBUG, "sending %s (%d bytes) peer=%d\n", msg.m_type,
              nMessageSize, pnode->GetId());
     if (gArgs.GetBoolArg("-capturemessages", false)) {
-        CaptureMessage(pnode->addr, msg.m_type, msg.data,
+        CaptureMessage(pnode->addr, msg.m_type, payload,
                        /*is_incoming=*/false);
     }
 
     TRACE6(net, outbound_message, pnode->GetId(), pnode->m_addr_name.c_str(),
            pnode->ConnectionTypeAsString().c_str(), msg.m_type.c_str(),
-           msg.data.size(), msg.data.data());
+           payload.size(), payload.data());
+
+    // The large messages sent to the peers which support compression are
+    // compressed when they are sent, see SocketSendData(). That is done by the
+    // network thread, unless it can't be woken up to send them right away.
+    const bool compress{pnode->m_compress_msgs &&
+                        nMessageSize >= MIN_COMPRESS_MSG_SIZE &&
+                        IsCompressibleMessage(msg.m_type)};
 
     // make sure we use the appropriate network transport format
     std::vector<uint8_t> serializedHeader;
-    pnode->m_serializer->prepareForTransport(*config, msg, serializedHeader);
-    size_t nTotalSize = nMessageSize + serializedHeader.size();
+    if (!compress) {
+        pnode->m_serializer->prepareForTransport(*config, msg,
+                                                 serializedHeader);
+    }
+    size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
 
     size_t nBytesSent = 0;
     {
@@ -3360,14 +3993,23 @@ void CConnman::PushMessage(CNode *pnode, CSerializedNetMsg &&msg) {
         if (pnode->nSendSize > nSendBufferMaxSize) {
             pnode->fPauseSend = true;
         }
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize) {
-            pnode->vSendMsg.push_back(std::move(msg.data));
+        if (compress) {
+            pnode->vSendMsg.emplace_back(std::move(msg));
+        } else {
+            pnode->vSendMsg.push_back(std::move(serializedHeader));
+            if (nMessageSize && msg.m_payload_owner) {
+                // Queue the external payload in place rather than copying it
+                pnode->vSendMsg.emplace_back(std::move(msg.m_payload_owner),
+                                             payload);
+            } else if (nMessageSize) {
+                pnode->vSendMsg.push_back(std::move(msg.data));
+            }
         }
 
-        // If write queue empty, attempt "optimistic write"
+        // If write queue empty, attempt "optimistic write". A message to be
+        // compressed is left to the network thread if it can be woken up.
         bool data_left;
-        if (optimisticSend) {
+        if (optimisticSend && !(compress && WakeSocketHandler(*pnode))) {
             std::tie(nBytesSent, data_left) = SocketSendData(*pnode);
         }
     }
@@ -22,6 +22,7 @@
 #include <netaddress.h>
 #include <netbase.h>
 #include <nodeid.h>
+#include <primitives/transaction.h>
 #include <protocol.h>
 #include <pubkey.h>
 #include <radix.h>
@@ -32,9 +33,12 @@
 #include <threadinterrupt.h>
 #include <uint256.h>
 #include <util/check.h>
+#include <util/histogram.h>
 #include <util/sock.h>
 #include <util/time.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <condition_variable>
 #include <cstdint>
@@ -43,11 +47,15 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <optional>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 class AddrMan;
 class BanMan;
+class BlockTransactions;
+class CBlock;
 class Config;
 class CNode;
 class CScheduler;
@@ -102,6 +110,10 @@ static const bool DEFAULT_DNSSEED = true;
 static const bool DEFAULT_FIXEDSEEDS = true;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER = 1 * 1000;
+/** Default number of threads doing the socket I/O of the connected peers */
+static const int DEFAULT_NET_THREADS = 1;
+/** Maximum number of threads doing the socket I/O of the connected peers */
+static const int MAX_NET_THREADS = 16;
 
 struct AddedNodeInfo {
     std::string strAddedNode;
@@ -125,11 +137,79 @@ struct CSerializedNetMsg {
         CSerializedNetMsg copy;
         copy.data = data;
         copy.m_type = m_type;
+        copy.m_payload_owner = m_payload_owner;
+        copy.m_payload = m_payload;
         return copy;
     }
 
+    /**
+     * Use bytes owned by another object as the payload instead of data, so
+     * large payloads such as blocks mapped from disk are never copied.
+     */
+    void SetExternalPayload(std::shared_ptr<const void> owner,
+                            Span<const uint8_t> payload) {
+        m_payload_owner = std::move(owner);
+        m_payload = payload;
+    }
+
+    /** The payload bytes: either the external payload or data. */
+    Span<const uint8_t> Payload() const {
+        return m_payload_owner ? m_payload : Span<const uint8_t>{data};
+    }
+
     std::vector<uint8_t> data;
     std::string m_type;
+    /** Keeps the external payload alive, if any. */
+    std::shared_ptr<const void> m_payload_owner;
+    Span<const uint8_t> m_payload;
+};
+
+/** Minimum payload size of the messages worth compressing. */
+static constexpr size_t MIN_COMPRESS_MSG_SIZE{1024};
+/** Version of the compressed message framing announced in sendcmpr. */
+static constexpr uint32_t MSG_COMPRESSION_VERSION{1};
+
+/** Whether messages of this type are compressed for the peers allowing it. */
+bool IsCompressibleMessage(const std::string &msg_type);
+
+/**
+ * Wrap a message into a cmprmsg message carrying its compressed payload.
+ *
+ * @return nullopt if compression does not make the message smaller.
+ */
+std::optional<CSerializedNetMsg>
+CompressMessage(const CSerializedNetMsg &msg);
+
+/**
+ * A chunk of outgoing data in a node's send queue. It either owns its bytes,
+ * refers to an external message payload kept alive by its owner, or holds a
+ * message left for the network thread to compress before it can be sent.
+ */
+class CSendChunk {
+private:
+    std::vector<uint8_t> m_bytes;
+    std::shared_ptr<const void> m_owner;
+    Span<const uint8_t> m_view;
+    std::optional<CSerializedNetMsg> m_msg_to_compress;
+
+public:
+    CSendChunk(std::vector<uint8_t> &&bytes) : m_bytes(std::move(bytes)) {}
+    CSendChunk(std::shared_ptr<const void> owner, Span<const uint8_t> view)
+        : m_owner(std::move(owner)), m_view(view) {}
+    explicit CSendChunk(CSerializedNetMsg &&msg)
+        : m_msg_to_compress(std::move(msg)) {}
+
+    bool NeedsCompression() const { return m_msg_to_compress.has_value(); }
+    CSerializedNetMsg TakeMessageToCompress() {
+        CSerializedNetMsg msg{std::move(*m_msg_to_compress)};
+        m_msg_to_compress.reset();
+        return msg;
+    }
+
+    const uint8_t *data() const {
+        return m_owner ? m_view.data() : m_bytes.data();
+    }
+    size_t size() const { return m_owner ? m_view.size() : m_bytes.size(); }
 };
 
 const std::vector<std::string> CONNECTION_TYPE_DOC{
@@ -278,6 +358,32 @@ extern std::map<CNetAddr, LocalServiceInfo>
 extern const std::string NET_MESSAGE_COMMAND_OTHER;
 // Command, total bytes
 typedef std::map<std::string, uint64_t> mapMsgCmdSize;
+// Command, total processing time
+typedef std::map<std::string, std::chrono::microseconds> mapMsgCmdTime;
+
+/** Counters of the messages compressed or decompressed for a peer. */
+struct MsgCompressionStats {
+    //! Size of the payloads before compression
+    uint64_t raw_bytes{0};
+    //! Size of the payloads once compressed
+    uint64_t compressed_bytes{0};
+    //! Time spent compressing or decompressing them
+    std::chrono::microseconds time{0};
+};
+
+/**
+ * Node wide timing statistics of the message handling, measured with the
+ * steady clock. Returned by CConnman::GetTimingStats.
+ */
+struct NetTimingStats {
+    //! Time spent processing the received messages, by message type
+    std::map<std::string, LatencyHistogram> process_time_per_msg_cmd;
+    //! Time the received messages waited before being processed
+    LatencyHistogram queue_wait;
+    //! Durations of the stalls of the sends to peers, while their socket send
+    //! buffer was full
+    LatencyHistogram send_stall;
+};
 
 /**
  * POD that contains various stats about a node.
@@ -306,6 +412,11 @@ struct CNodeStats {
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     uint64_t nRecvBytes;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    MsgCompressionStats m_compression_sent;
+    MsgCompressionStats m_compression_recv;
+    mapMsgCmdTime m_process_time_per_msg_cmd;
+    std::chrono::microseconds m_queue_wait_time;
+    std::chrono::microseconds m_send_stall_time;
     NetPermissionFlags m_permission_flags;
     std::chrono::microseconds m_last_ping_time;
     std::chrono::microseconds m_min_ping_time;
@@ -333,6 +444,8 @@ public:
     CDataStream m_recv;
     //! time of message receipt
     std::chrono::microseconds m_time{0};
+    //! steady time of message receipt, to measure how long it is queued
+    SteadyClock::time_point m_steady_time{};
     bool m_valid_netmagic = false;
     bool m_valid_header = false;
     bool m_valid_checksum = false;
@@ -342,11 +455,70 @@ public:
     uint32_t m_raw_message_size{0};
     std::string m_type;
 
+    //! Payload of the heavy message types, parsed by Preparse(). The message
+    //! handler takes ownership of them.
+    std::shared_ptr<CBlock> m_block;
+    std::shared_ptr<BlockTransactions> m_blocktxn;
+    CTransactionRef m_tx;
+    //! Memory used by the parsed payload, counted in the process queue size
+    size_t m_parsed_usage{0};
+
     CNetMessage(CDataStream &&recv_in) : m_recv(std::move(recv_in)) {}
 
     void SetVersion(int nVersionIn) { m_recv.SetVersion(nVersionIn); }
+
+    /**
+     * Memory charged to the process queue for this message: its wire size,
+     * or its payload size if it was decompressed, plus the parsed payload.
+     */
+    size_t GetProcessQueueSize() const {
+        return std::max<size_t>(m_raw_message_size, m_message_size) +
+               m_parsed_usage;
+    }
+
+    /**
+     * Parse the payload of a block, blocktxn or tx message, computing the
+     * transaction ids along the way. This is done by the network thread as
+     * soon as the message is complete, so the message handler only has to
+     * validate it. m_recv is left untouched and a payload that fails to parse
+     * is left for the message handler to deal with. Only used for the
+     * message types the peer is allowed to send, see CNode::m_preparse_txs
+     * and CNode::m_preparse_blocks.
+     */
+    void Preparse();
 };
 
+/**
+ * Unwrap a cmprmsg message in place, so it is processed as the message it
+ * carries.
+ *
+ * @return false if the message is malformed, carries a message type which is
+ *         not compressible or would decompress into an oversized message.
+ */
+bool DecompressMessage(const Config &config, CNetMessage &msg);
+
+/**
+ * Priority classes of the received messages, from the most to the least
+ * urgent. Block propagation goes first since it gates everything else, then the
+ * avalanche polls and votes, then the transaction relay and the remaining
+ * messages, and finally the address relay.
+ */
+enum class MsgPriority : uint8_t {
+    BLOCK,
+    AVALANCHE,
+    DEFAULT,
+    ADDR,
+};
+static constexpr size_t NUM_MSG_PRIORITIES{4};
+
+/**
+ * Number of messages of a peer which can be processed ahead of a pending
+ * message of a less urgent class before that class is served anyway.
+ */
+static constexpr uint32_t MAX_MSG_PRIORITY_SKIPS{8};
+
+MsgPriority GetMessagePriority(const std::string &msg_type);
+
 /**
  * The TransportDeserializer takes care of holding and deserializing the
  * network receive buffer. It can deserialize the network buffer into a
@@ -483,13 +655,20 @@ public:
     /** Offset inside the first vSendMsg already sent */
     size_t nSendOffset GUARDED_BY(cs_vSend){0};
     uint64_t nSendBytes GUARDED_BY(cs_vSend){0};
-    std::deque<std::vector<uint8_t>> vSendMsg GUARDED_BY(cs_vSend);
+    std::deque<CSendChunk> vSendMsg GUARDED_BY(cs_vSend);
     Mutex cs_vSend;
     Mutex m_sock_mutex;
     Mutex cs_vRecv;
 
     RecursiveMutex cs_vProcessMsg;
-    std::list<CNetMessage> vProcessMsg GUARDED_BY(cs_vProcessMsg);
+    //! Messages waiting for the message handler, one queue per MsgPriority
+    std::array<std::list<CNetMessage>, NUM_MSG_PRIORITIES>
+        m_process_msgs GUARDED_BY(cs_vProcessMsg);
+    //! How many times each queue was passed over for a more urgent one
+    std::array<uint32_t, NUM_MSG_PRIORITIES>
+        m_process_msgs_skipped GUARDED_BY(cs_vProcessMsg){};
+    //! Messages of the DEFAULT queue a block message must not overtake
+    size_t m_process_msgs_ordered GUARDED_BY(cs_vProcessMsg){0};
     size_t nProcessQueueSize{0};
 
     uint64_t nRecvBytes GUARDED_BY(cs_vRecv){0};
@@ -524,6 +703,13 @@ public:
         return NetPermissions::HasFlag(m_permission_flags, permission);
     }
     std::atomic_bool fSuccessfullyConnected{false};
+    //! Whether the tx messages from this peer are accepted, so they can be
+    //! parsed by the network thread. Set by the message handler.
+    std::atomic_bool m_preparse_txs{false};
+    //! Whether blocks are in flight from this peer, so the block and blocktxn
+    //! messages can be parsed by the network thread. Set by the message
+    //! handler.
+    std::atomic_bool m_preparse_blocks{false};
     // Setting fDisconnect to true will cause the node to be disconnected the
     // next time DisconnectNodes() runs
     std::atomic_bool fDisconnect{false};
@@ -533,6 +719,12 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv{false};
     std::atomic_bool fPauseSend{false};
+    /**
+     * Socket readiness reported by the edge triggered epoll backend and not
+     * consumed yet. Only accessed by the network thread of the node, which
+     * keeps the node in its ready set while there is some to act on.
+     */
+    Sock::Event m_sock_ready{0};
 
     bool IsOutboundOrBlockRelayConn() const {
         switch (m_conn_type) {
@@ -621,6 +813,12 @@ public:
      */
     std::atomic_bool m_relays_txs{false};
 
+    /**
+     * Whether we compress the large messages sent to this peer, which is set
+     * once both sides announced it in the version handshake.
+     */
+    std::atomic_bool m_compress_msgs{false};
+
     /**
      * Whether this peer has loaded a bloom filter. Used only in inbound
      * eviction logic.
@@ -743,6 +941,41 @@ public:
     bool ReceiveMsgBytes(const Config &config, Span<const uint8_t> msg_bytes,
                          bool &complete) EXCLUSIVE_LOCKS_REQUIRED(!cs_vRecv);
 
+    /**
+     * Move the messages completed by ReceiveMsgBytes to the queues of the
+     * message handler, and pause receiving if more than recv_flood_size bytes
+     * are waiting to be processed. Until the version handshake completes all
+     * the messages go to the same queue so they are processed in order.
+     * Likewise a block propagation message does not overtake a transaction
+     * received earlier from the same peer, which it may need to be
+     * reconstructed.
+     */
+    void MarkReceivedMsgsForProcessing(size_t recv_flood_size);
+
+    /**
+     * Take the next message to process: the oldest message of the most urgent
+     * non empty class, unless a less urgent class was passed over
+     * MAX_MSG_PRIORITY_SKIPS times in a row.
+     *
+     * @return the message and whether more messages are waiting, or nullopt
+     *         if there is no message to process.
+     */
+    std::optional<std::pair<CNetMessage, bool>>
+    PollMessage(size_t recv_flood_size);
+
+    /**
+     * Take the oldest block propagation message, if any, regardless of the
+     * messages of the other classes.
+     *
+     * @return the message and whether more messages are waiting, or nullopt
+     *         if there is no block propagation message to process.
+     */
+    std::optional<std::pair<CNetMessage, bool>>
+    PollUrgentMessage(size_t recv_flood_size);
+
+    /** Whether block propagation messages are waiting to be processed. */
+    bool HasUrgentMessages();
+
     void SetCommonVersion(int greatest_common_version) {
         Assume(m_greatest_common_version == INIT_PROTO_VERSION);
         m_greatest_common_version = greatest_common_version;
@@ -778,9 +1011,13 @@ private:
     const ConnectionType m_conn_type;
     std::atomic<int> m_greatest_common_version{INIT_PROTO_VERSION};
 
-    // Used only by SocketHandler thread
+    // Used only by the network thread of the node, see CConnman::NetShard
     std::list<CNetMessage> vRecvMsg;
 
+    std::pair<CNetMessage, bool> TakeMessage(size_t priority,
+                                             size_t recv_flood_size)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_vProcessMsg);
+
     // Our address, as reported by the peer
     mutable Mutex m_addr_local_mutex;
     CService addrLocal GUARDED_BY(m_addr_local_mutex);
@@ -797,6 +1034,20 @@ private:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd GUARDED_BY(cs_vSend);
     mapMsgCmdSize mapRecvBytesPerMsgCmd GUARDED_BY(cs_vRecv);
+
+    MsgCompressionStats m_compression_sent GUARDED_BY(cs_vSend);
+    MsgCompressionStats m_compression_recv GUARDED_BY(cs_vRecv);
+
+    //! Since when the socket send buffer is full, if it is
+    std::optional<SteadyClock::time_point>
+        m_send_stall_start GUARDED_BY(cs_vSend);
+    //! Total time the socket send buffer was full
+    std::chrono::microseconds m_send_stall_time GUARDED_BY(cs_vSend){0};
+
+    Mutex m_process_time_mutex;
+    mapMsgCmdTime m_process_time_per_msg_cmd GUARDED_BY(m_process_time_mutex);
+    std::chrono::microseconds
+        m_queue_wait_time GUARDED_BY(m_process_time_mutex){0};
 };
 
 /**
@@ -829,6 +1080,20 @@ public:
                                  std::atomic<bool> &interrupt)
         EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex) = 0;
 
+    /**
+     * Process a single pending block propagation message from a given node,
+     * ahead of its other messages.
+     *
+     * @param[in]   config          The applicable configuration object.
+     * @param[in]   pnode           The node which we have received messages
+     * from.
+     * @param[in]   interrupt       Interrupt condition for processing threads
+     * @return                      True if there is more work to be done
+     */
+    virtual bool ProcessUrgentMessage(const Config &config, CNode *pnode,
+                                      std::atomic<bool> &interrupt)
+        EXCLUSIVE_LOCKS_REQUIRED(g_msgproc_mutex) = 0;
+
     /**
      * Send queued protocol messages to a given node.
      *
@@ -868,6 +1133,7 @@ public:
         BanMan *m_banman = nullptr;
         unsigned int nSendBufferMaxSize = 0;
         unsigned int nReceiveFloodSize = 0;
+        int m_net_threads = DEFAULT_NET_THREADS;
         uint64_t nMaxOutboundLimit = 0;
         int64_t m_peer_connect_timeout = DEFAULT_PEER_CONNECT_TIMEOUT;
         std::vector<std::string> vSeedNodes;
@@ -912,6 +1178,8 @@ public:
         m_msgproc = connOptions.m_msgproc;
         nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
         nReceiveFloodSize = connOptions.nReceiveFloodSize;
+        m_net_threads =
+            std::clamp(connOptions.m_net_threads, 1, MAX_NET_THREADS);
         m_peer_connect_timeout =
             std::chrono::seconds{connOptions.m_peer_connect_timeout};
         {
@@ -1075,6 +1343,17 @@ public:
     uint64_t GetTotalBytesRecv() const;
     uint64_t GetTotalBytesSent() const;
 
+    /**
+     * Record the processing of a message received from node: how long it
+     * waited in the queue and how long it took to process.
+     */
+    void RecordMessageProcessing(CNode &node, const std::string &msg_type,
+                                 std::chrono::microseconds queue_wait,
+                                 std::chrono::microseconds process_time)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_timing_stats_mutex);
+    NetTimingStats GetTimingStats() const
+        EXCLUSIVE_LOCKS_REQUIRED(!m_timing_stats_mutex);
+
     /** Get a unique deterministic randomizer. */
     CSipHasher GetDeterministicRandomizer(uint64_t id) const;
 
@@ -1148,13 +1427,42 @@ private:
      * @param[in] nodes Select from these nodes' sockets.
      * @return sockets to check for readiness
      */
-    Sock::EventsPerSock GenerateWaitSockets(Span<CNode *const> nodes);
+    Sock::EventsPerSock GenerateWaitSockets(Span<CNode *const> nodes,
+                                            bool listening = true);
 
     /**
      * Check connected and listening sockets for IO readiness and process them
      * accordingly.
+     * @param[in] shard Only process the nodes of this network thread. The
+     *     listening sockets are processed by the first one.
      */
-    void SocketHandler() EXCLUSIVE_LOCKS_REQUIRED(!mutexMsgProc);
+    void SocketHandler(size_t shard) EXCLUSIVE_LOCKS_REQUIRED(!mutexMsgProc);
+
+#ifdef USE_EPOLL
+    /**
+     * Same as SocketHandler(), but the readiness comes from the epoll set of
+     * the shard rather than from polling every socket, and only the nodes
+     * with some readiness to act on are visited.
+     */
+    void SocketHandlerEpoll(size_t shard)
+        EXCLUSIVE_LOCKS_REQUIRED(!mutexMsgProc);
+#endif
+
+    /** Index of the network thread doing the socket I/O of a node. */
+    size_t GetNetShard(NodeId id) const {
+        return size_t(id) % std::max<size_t>(m_net_shards.size(), 1);
+    }
+
+    /** Start watching the socket of a node added to m_nodes. */
+    void WatchNodeSocket(CNode &node) EXCLUSIVE_LOCKS_REQUIRED(m_nodes_mutex);
+    /** Stop watching the socket of a node removed from m_nodes. */
+    void UnwatchNodeSocket(CNode &node) EXCLUSIVE_LOCKS_REQUIRED(m_nodes_mutex);
+    /**
+     * Make the network thread of a node send its queued messages now rather
+     * than after its current wait times out.
+     * @return false if that thread cannot be woken up
+     */
+    bool WakeSocketHandler(const CNode &node);
 
     /**
      * Do the read/write for connected sockets that are ready for IO.
@@ -1172,7 +1480,8 @@ private:
      */
     void SocketHandlerListening(const Sock::EventsPerSock &events_per_sock);
 
-    void ThreadSocketHandler() EXCLUSIVE_LOCKS_REQUIRED(!mutexMsgProc);
+    void ThreadSocketHandler(size_t shard)
+        EXCLUSIVE_LOCKS_REQUIRED(!mutexMsgProc);
     void ThreadDNSAddressSeed()
         EXCLUSIVE_LOCKS_REQUIRED(!m_addr_fetches_mutex, !m_nodes_mutex);
 
@@ -1205,6 +1514,23 @@ private:
      * Returns (bytes_sent, data_left).
      */
     std::pair<size_t, bool> SocketSendData(CNode &node) const
+        EXCLUSIVE_LOCKS_REQUIRED(node.cs_vSend, !m_timing_stats_mutex);
+
+    /**
+     * Track the stalls of the sends to node: a stall starts when its socket
+     * send buffer is full and ends when sending makes progress again.
+     */
+    void StartSendStall(CNode &node) const
+        EXCLUSIVE_LOCKS_REQUIRED(node.cs_vSend);
+    void EndSendStall(CNode &node) const
+        EXCLUSIVE_LOCKS_REQUIRED(node.cs_vSend, !m_timing_stats_mutex);
+
+    /**
+     * Compress the message of a send chunk and replace it with the bytes to
+     * send. This is done by the network thread when the chunk is about to be
+     * sent, so the message handler does not spend time on it.
+     */
+    void CompressSendChunk(CNode &node, CSendChunk &chunk) const
         EXCLUSIVE_LOCKS_REQUIRED(node.cs_vSend);
 
     void DumpAddresses();
@@ -1228,6 +1554,10 @@ private:
     std::atomic<uint64_t> nTotalBytesRecv{0};
     uint64_t nTotalBytesSent GUARDED_BY(cs_totalBytesSent){0};
 
+    mutable Mutex m_timing_stats_mutex;
+    //! Mutable so the send stalls are recorded by SocketSendData().
+    mutable NetTimingStats m_timing_stats GUARDED_BY(m_timing_stats_mutex);
+
     // outbound limit & stats
     uint64_t nMaxOutboundTotalBytesSentInCycle GUARDED_BY(cs_totalBytesSent){0};
     std::chrono::seconds
@@ -1245,8 +1575,52 @@ private:
 
     unsigned int nSendBufferMaxSize{0};
     unsigned int nReceiveFloodSize{0};
+    int m_net_threads{DEFAULT_NET_THREADS};
 
     std::vector<ListenSocket> vhListenSocket;
+
+    /**
+     * State of a network thread. The connected nodes are split between the
+     * network threads by NodeId (see GetNetShard()) and each thread only reads
+     * from and writes to the sockets of its own nodes, so the message framing
+     * and checksum verification are spread over the threads too. The first
+     * one also accepts the incoming connections and disconnects the nodes.
+     */
+    struct NetShard {
+#ifdef USE_EPOLL
+        /**
+         * Persistent set of the sockets of the shard, so its thread doesn't
+         * poll all of them on each iteration. The connected sockets are edge
+         * triggered and identified by their NodeId. The listening sockets
+         * belong to the first shard, are level triggered and are identified
+         * by their index in vhListenSocket tagged with LISTEN_SOCKET_ID. Null
+         * if it could not be created, in which case Sock::WaitMany() is used.
+         */
+        std::unique_ptr<SockEpoll> epoll;
+        /**
+         * The watched nodes of the shard, to find the ones reported ready
+         * without walking all of them. Guarded by m_nodes_mutex.
+         */
+        std::unordered_map<NodeId, CNode *> nodes;
+        /**
+         * The nodes with some readiness left to act on, see m_sock_ready.
+         * Each one holds a reference. Only accessed by the shard thread.
+         */
+        std::unordered_map<NodeId, CNode *> ready_nodes;
+        /** When to next check the inactivity of all the nodes. */
+        SteadyClock::time_point next_inactivity_check;
+        Mutex send_mutex;
+        /**
+         * Nodes with a message queued for the shard thread to send, see
+         * WakeSocketHandler().
+         */
+        std::vector<NodeId> send_pending GUARDED_BY(send_mutex);
+#endif
+    };
+    std::vector<NetShard> m_net_shards;
+#ifdef USE_EPOLL
+    static constexpr uint64_t LISTEN_SOCKET_ID{uint64_t{1} << 63};
+#endif
     std::atomic<bool> fNetworkActive{true};
     bool fAddressesInitialized{false};
     AddrMan &addrman;
@@ -1358,6 +1732,7 @@ private:
 
     std::thread threadDNSAddressSeed;
     std::thread threadSocketHandler;
+    std::vector<std::thread> m_net_shard_threads;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadMessageHandler;
@@ -1401,6 +1776,17 @@ private:
      */
     class NodesSnapshot {
     public:
+        /** Only the nodes of one network thread, see NetShard. */
+        NodesSnapshot(const CConnman &connman, size_t shard) {
+            LOCK(connman.m_nodes_mutex);
+            for (CNode *node : connman.m_nodes) {
+                if (connman.GetNetShard(node->GetId()) == shard) {
+                    node->AddRef();
+                    m_nodes_copy.push_back(node);
+                }
+            }
+        }
+
         explicit NodesSnapshot(const CConnman &connman, bool shuffle) {
             {
                 LOCK(connman.m_nodes_mutex);
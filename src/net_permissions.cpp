@@ -22,7 +22,9 @@ const std::vector<std::string> NET_PERMISSIONS_DOC{
     "bypass_proof_request_limits (experimental, bypass the limits on avalanche "
     "proof downloads)",
     "addr (responses to GETADDR avoid hitting the cache and contain random "
-    "records with the most up-to-date info)"};
+    "records with the most up-to-date info)",
+    "compress (exchange compressed blocks and headers if the peer has this "
+    "permission too, not implied by all)"};
 
 namespace {
 
@@ -77,6 +79,8 @@ TryParsePermissionFlags(const std::string &str, NetPermissionFlags &output,
                 NetPermissions::AddFlag(flags, NetPermissionFlags::Relay);
             } else if (permission == "addr") {
                 NetPermissions::AddFlag(flags, NetPermissionFlags::Addr);
+            } else if (permission == "compress") {
+                NetPermissions::AddFlag(flags, NetPermissionFlags::Compress);
             } else if (permission == "in") {
                 connection_direction |= ConnectionDirection::In;
             } else if (permission == "out") {
@@ -147,6 +151,9 @@ std::vector<std::string> NetPermissions::ToStrings(NetPermissionFlags flags) {
                                 NetPermissionFlags::BypassProofRequestLimits)) {
         strings.push_back("bypass_proof_request_limits");
     }
+    if (NetPermissions::HasFlag(flags, NetPermissionFlags::Compress)) {
+        strings.push_back("compress");
+    }
     return strings;
 }
 
@@ -42,6 +42,9 @@ enum class NetPermissionFlags : uint32_t {
     // Can request addrs without hitting a privacy-preserving cache, and send us
     // unlimited amounts of addrs.
     Addr = (1U << 7),
+    // Compress the blocks and headers sent to this peer, if it supports it.
+    // Not part of All since it trades CPU time for bandwidth.
+    Compress = (1U << 8),
     // Bypass the limit on how many proof INVs are tracked from this peer as
     // well as the delay penalty when reaching the the in-flight requests limit
     BypassProofRequestLimits = (1U << 30),
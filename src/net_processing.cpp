@@ -22,6 +22,7 @@
 #include <config.h>
 #include <consensus/amount.h>
 #include <consensus/validation.h>
+#include <flatfile.h>
 #include <hash.h>
 #include <headerssync.h>
 #include <index/blockfilterindex.h>
@@ -31,6 +32,7 @@
 #include <netbase.h>
 #include <netmessagemaker.h>
 #include <node/blockstorage.h>
+#include <node/txreconciliation.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/settings.h>
@@ -52,8 +54,10 @@
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <deque>
 #include <functional>
 #include <future>
+#include <list>
 #include <memory>
 #include <numeric>
 #include <typeinfo>
@@ -183,9 +187,30 @@ static constexpr DataRequestParameters PROOF_REQUEST_PARAMS{
  */
 static const unsigned int MAX_GETDATA_SZ = 1000;
 /**
- * Number of blocks that can be requested at any given time from a single peer.
+ * Number of blocks that can be requested at any given time from a single peer,
+ * until we have measured how fast it delivers blocks.
  */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Bounds of the per-peer in-flight limit sized from measurements. */
+static constexpr int MIN_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER{2};
+static constexpr int MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER{64};
+/**
+ * How much download work we queue on a peer: its in-flight limit is the number
+ * of blocks it is expected to deliver in that time.
+ */
+static constexpr auto BLOCK_DOWNLOAD_TARGET_TIME{4s};
+/**
+ * Weight of the previous value in the moving averages of the block download
+ * times of a peer, out of BLOCK_DOWNLOAD_AVERAGE_WEIGHT.
+ */
+static constexpr int64_t BLOCK_DOWNLOAD_AVERAGE_WEIGHT{4};
+/**
+ * A block blocking the download window is requested in parallel from an idle
+ * peer when it has been in flight for more than this many times the usual
+ * latency of that peer, and at least LAGGING_BLOCK_MIN_AGE.
+ */
+static constexpr int LAGGING_BLOCK_LATENCY_FACTOR{2};
+static constexpr auto LAGGING_BLOCK_MIN_AGE{500ms};
 /**
  * Default time during which a peer must stall block download progress before
  * being disconnected. The actual timeout is increased temporarily if peers are
@@ -204,6 +229,17 @@ static const int MAX_CMPCTBLOCK_DEPTH = 5;
  * for.
  */
 static const int MAX_BLOCKTXN_DEPTH = 10;
+/**
+ * Number of recently connected blocks kept in serialized wire form, so peers
+ * that fell slightly behind are served without disk reads or
+ * reserialization.
+ */
+static constexpr size_t MAX_RECENT_BLOCK_MSGS{8};
+/**
+ * Bound on the memory held by the recent block cache, including the blocks it
+ * keeps alive.
+ */
+static constexpr size_t MAX_RECENT_BLOCK_MSGS_BYTES{64 * 1024 * 1024};
 /**
  * Size of the "block download window": how far ahead of our current height do
  * we fetch? Larger windows tolerate larger download speed differences between
@@ -230,6 +266,11 @@ static const unsigned int MAX_BLOCKS_TO_ANNOUNCE = 8;
 static const int MAX_NUM_UNCONNECTING_HEADERS_MSGS = 10;
 /** Minimum blocks required to signal NODE_NETWORK_LIMITED */
 static const unsigned int NODE_NETWORK_LIMITED_MIN_BLOCKS = 288;
+/**
+ * Number of the latest new blocks for which we remember when they were first
+ * announced, to measure how long the other peers take to announce them.
+ */
+static constexpr size_t MAX_BLOCK_FIRST_ANNOUNCEMENTS{8};
 /**
  * Average delay between local address broadcasts.
  */
@@ -317,6 +358,8 @@ struct QueuedBlock {
     const CBlockIndex *pindex;
     /** Optional, used for CMPCTBLOCK downloads */
     std::unique_ptr<PartiallyDownloadedBlock> partialBlock;
+    /** When the block was requested from the peer. */
+    std::chrono::microseconds m_time_requested{0us};
 };
 
 /**
@@ -667,6 +710,23 @@ struct CNodeState {
     //! When the first entry in vBlocksInFlight started downloading. Don't care
     //! when vBlocksInFlight is empty.
     std::chrono::microseconds m_downloading_since{0us};
+    //! Moving average of the time between requesting a block from this peer
+    //! and receiving it, or 0 if it did not deliver any block yet.
+    std::chrono::microseconds m_block_latency{0us};
+    //! Moving average of the time this peer takes to deliver a block once it
+    //! is done with the previous one, or 0 if it did not deliver any block
+    //! yet. This is the inverse of its block download throughput.
+    std::chrono::microseconds m_block_service_time{0us};
+    //! When this peer last delivered a block we requested from it.
+    std::chrono::microseconds m_last_block_received{0us};
+    //! Number of lagging blocks requested from this peer in parallel with the
+    //! slower peer they were in flight from.
+    uint64_t m_parallel_block_requests{0};
+    //! How long after their first announcement by any peer this peer
+    //! announced the new blocks.
+    LatencyHistogram m_block_relay_delay;
+    //! The last block announced by this peer, so it is only accounted once.
+    BlockHash m_last_announced_block;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload{false};
     /**
@@ -736,7 +796,8 @@ public:
     /** Overridden from CValidationInterface. */
     void BlockConnected(const std::shared_ptr<const CBlock> &pblock,
                         const CBlockIndex *pindexConnected) override
-        EXCLUSIVE_LOCKS_REQUIRED(!m_recent_confirmed_transactions_mutex);
+        EXCLUSIVE_LOCKS_REQUIRED(!m_recent_confirmed_transactions_mutex,
+                                 !m_most_recent_block_mutex);
     void BlockDisconnected(const std::shared_ptr<const CBlock> &block,
                            const CBlockIndex *pindex) override
         EXCLUSIVE_LOCKS_REQUIRED(!m_recent_confirmed_transactions_mutex);
@@ -764,6 +825,12 @@ public:
                                  !m_recent_confirmed_transactions_mutex,
                                  !m_most_recent_block_mutex, !cs_proofrequest,
                                  !m_headers_presync_mutex, g_msgproc_mutex);
+    bool ProcessUrgentMessage(const Config &config, CNode *pfrom,
+                              std::atomic<bool> &interrupt) override
+        EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex,
+                                 !m_recent_confirmed_transactions_mutex,
+                                 !m_most_recent_block_mutex, !cs_proofrequest,
+                                 !m_headers_presync_mutex, g_msgproc_mutex);
     bool SendMessages(const Config &config, CNode *pto) override
         EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex,
                                  !m_recent_confirmed_transactions_mutex,
@@ -796,7 +863,10 @@ public:
         EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex,
                                  !m_recent_confirmed_transactions_mutex,
                                  !m_most_recent_block_mutex, !cs_proofrequest,
-                                 !m_headers_presync_mutex, g_msgproc_mutex);
+                                 !m_headers_presync_mutex, g_msgproc_mutex) {
+        ProcessMessage(config, pfrom, msg_type, vRecv, time_received,
+                       interruptMsgProc, nullptr);
+    }
     void UpdateLastBlockAnnounceTime(NodeId node,
                                      int64_t time_in_seconds) override;
 
@@ -973,6 +1043,39 @@ private:
     bool ProcessOrphanTx(const Config &config, Peer &peer)
         EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex, g_msgproc_mutex);
 
+    /**
+     * Same as the public ProcessMessage(), but the payload may have been
+     * parsed already by the network thread, see CNetMessage::Preparse().
+     *
+     * @param[in]   preparsed   The message, if any, whose parsed payload is
+     *                          used instead of parsing vRecv. The payload is
+     *                          moved out of it.
+     */
+    void ProcessMessage(const Config &config, CNode &pfrom,
+                        const std::string &msg_type, CDataStream &vRecv,
+                        const std::chrono::microseconds time_received,
+                        const std::atomic<bool> &interruptMsgProc,
+                        CNetMessage *preparsed)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex,
+                                 !m_recent_confirmed_transactions_mutex,
+                                 !m_most_recent_block_mutex, !cs_proofrequest,
+                                 !m_headers_presync_mutex, g_msgproc_mutex);
+
+    /**
+     * Check and process a message taken from the queues of a peer.
+     *
+     * @param[in]   more_work   Whether more messages were waiting.
+     * @return                  True if there is more work to be done
+     */
+    bool ProcessPolledMessage(const Config &config, CNode *pfrom,
+                              const PeerRef &peer, CNetMessage &msg,
+                              bool more_work,
+                              std::atomic<bool> &interruptMsgProc)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_peer_mutex,
+                                 !m_recent_confirmed_transactions_mutex,
+                                 !m_most_recent_block_mutex, !cs_proofrequest,
+                                 !m_headers_presync_mutex, g_msgproc_mutex);
+
     /**
      * Process a single headers message from a peer.
      *
@@ -1173,6 +1276,12 @@ private:
 
     const Options m_opts;
 
+    /**
+     * Transaction reconciliation state of the peers, only set when
+     * reconciliation is enabled.
+     */
+    std::unique_ptr<TxReconciliationTracker> m_txreconciliation;
+
     bool RejectIncomingTxs(const CNode &peer) const;
 
     /**
@@ -1326,6 +1435,9 @@ private:
     NextInvToInbounds(std::chrono::microseconds now,
                       std::chrono::seconds average_interval);
 
+    /** Mempool short IDs shared by the compact block reconstructions. */
+    ShortIdCache m_shortid_cache;
+
     // All of the following cache a recent block, and are protected by
     // m_most_recent_block_mutex
     mutable Mutex m_most_recent_block_mutex;
@@ -1335,6 +1447,14 @@ private:
         m_most_recent_compact_block GUARDED_BY(m_most_recent_block_mutex);
     BlockHash m_most_recent_block_hash GUARDED_BY(m_most_recent_block_mutex);
 
+    /** Wire forms of the last connected blocks. */
+    RecentBlockMsgsCache m_recent_block_msgs{MAX_RECENT_BLOCK_MSGS,
+                                             MAX_RECENT_BLOCK_MSGS_BYTES};
+
+    /** Serialize a connected block into the recent block cache. */
+    void CacheRecentBlockMsgs(const std::shared_ptr<const CBlock> &pblock)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_most_recent_block_mutex);
+
     // Data about the low-work headers synchronization, aggregated from all
     // peers' HeadersSyncStates.
     /** Mutex guarding the other m_headers_presync_* variables. */
@@ -1397,13 +1517,40 @@ private:
 
     bool TipMayBeStale() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    /**
+     * Update the download statistics of a peer which delivered a block we
+     * requested from it.
+     */
+    void RecordBlockDownload(NodeId nodeid, const BlockHash &hash,
+                             std::chrono::microseconds time_received)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /**
+     * How many blocks may be in flight from a peer, sized so that it has
+     * about BLOCK_DOWNLOAD_TARGET_TIME worth of blocks to deliver.
+     */
+    int GetBlocksInTransitLimit(const CNodeState &state) const;
+
+    /**
+     * Whether the block blocking the download window, in flight from another
+     * peer, has been waited for long enough to request it in parallel from
+     * the idle peer with the given state.
+     */
+    bool IsLaggingBlock(const CBlockIndex &block, const CNodeState &state,
+                        std::chrono::microseconds now)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     /**
      * Update pindexLastCommonBlock and add not-in-flight missing successors to
-     * vBlocks, until it has at most count entries.
+     * vBlocks, until it has at most count entries. If nothing can be fetched
+     * because the download window is blocked by a block in flight from
+     * another peer, that peer and block are returned in nodeStaller and
+     * waiting_block.
      */
     void FindNextBlocksToDownload(NodeId nodeid, unsigned int count,
                                   std::vector<const CBlockIndex *> &vBlocks,
-                                  NodeId &nodeStaller)
+                                  NodeId &nodeStaller,
+                                  const CBlockIndex *&waiting_block)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     /** Multimap used to preserve insertion order */
@@ -1415,6 +1562,18 @@ private:
     /** When our tip was last updated. */
     std::atomic<std::chrono::seconds> m_last_tip_update{0s};
 
+    /** When the latest new blocks were first announced, oldest first. */
+    std::deque<std::pair<BlockHash, SteadyClock::time_point>>
+        m_block_first_announcements GUARDED_BY(cs_main);
+
+    /**
+     * Account the delay between the first announcement of a new block and its
+     * announcement by this peer.
+     */
+    void RecordBlockAnnouncement(CNodeState &state, const BlockHash &hash,
+                                 const CBlockIndex *pindex)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     /**
      * Determine whether or not a peer can request a transaction, and return it
      * (or nullptr if not found or not allowed).
@@ -1425,6 +1584,14 @@ private:
         LOCKS_EXCLUDED(cs_main)
             EXCLUSIVE_LOCKS_REQUIRED(NetEventsInterface::g_msgproc_mutex);
 
+    /**
+     * Announce the transactions resulting from a reconciliation to the peer,
+     * skipping the ones no longer in our mempool.
+     */
+    void AnnounceReconciledTxs(CNode &node, Peer &peer,
+                               const std::vector<TxId> &txids)
+        EXCLUSIVE_LOCKS_REQUIRED(NetEventsInterface::g_msgproc_mutex);
+
     void ProcessGetData(const Config &config, CNode &pfrom, Peer &peer,
                         const std::atomic<bool> &interruptMsgProc)
         EXCLUSIVE_LOCKS_REQUIRED(!m_most_recent_block_mutex,
@@ -1789,14 +1956,18 @@ bool PeerManagerImpl::BlockRequested(const Config &config, NodeId nodeid,
     // Make sure it's not being fetched already from same peer.
     RemoveBlockRequest(hash, nodeid);
 
+    const auto now{GetTime<std::chrono::microseconds>()};
     std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(
         state->vBlocksInFlight.end(),
-        {&block, std::unique_ptr<PartiallyDownloadedBlock>(
-                     pit ? new PartiallyDownloadedBlock(config, &m_mempool)
-                         : nullptr)});
+        {&block,
+         std::unique_ptr<PartiallyDownloadedBlock>(
+             pit ? new PartiallyDownloadedBlock(config, &m_mempool,
+                                                &m_shortid_cache)
+                 : nullptr),
+         now});
     if (state->vBlocksInFlight.size() == 1) {
         // We're starting a block download (batch) from this peer.
-        state->m_downloading_since = GetTime<std::chrono::microseconds>();
+        state->m_downloading_since = now;
         m_peers_downloading_from++;
     }
 
@@ -1956,11 +2127,118 @@ void PeerManagerImpl::UpdateBlockAvailability(NodeId nodeid,
         // the best one.
         state->hashLastUnknownBlock = hash;
     }
+
+    RecordBlockAnnouncement(*state, hash, pindex);
+}
+
+void PeerManagerImpl::RecordBlockAnnouncement(CNodeState &state,
+                                              const BlockHash &hash,
+                                              const CBlockIndex *pindex) {
+    if (state.m_last_announced_block == hash ||
+        m_chainman.ActiveChainstate().IsInitialBlockDownload()) {
+        return;
+    }
+    state.m_last_announced_block = hash;
+
+    const auto now{SteadyClock::now()};
+    auto it = std::find_if(
+        m_block_first_announcements.begin(), m_block_first_announcements.end(),
+        [&hash](const auto &announcement) {
+            return announcement.first == hash;
+        });
+    if (it == m_block_first_announcements.end()) {
+        // Only the blocks we did not connect yet are new ones.
+        if (pindex && m_chainman.ActiveChain().Contains(pindex)) {
+            return;
+        }
+        if (m_block_first_announcements.size() >=
+            MAX_BLOCK_FIRST_ANNOUNCEMENTS) {
+            m_block_first_announcements.pop_front();
+        }
+        m_block_first_announcements.emplace_back(hash, now);
+        it = std::prev(m_block_first_announcements.end());
+    }
+
+    state.m_block_relay_delay.Add(
+        std::chrono::duration_cast<std::chrono::microseconds>(now -
+                                                              it->second));
+}
+
+static std::chrono::microseconds
+UpdateBlockDownloadAverage(std::chrono::microseconds average,
+                           std::chrono::microseconds sample) {
+    if (average == 0us) {
+        return std::max(sample, 1us);
+    }
+    return std::max((average * (BLOCK_DOWNLOAD_AVERAGE_WEIGHT - 1) + sample) /
+                        BLOCK_DOWNLOAD_AVERAGE_WEIGHT,
+                    1us);
+}
+
+void PeerManagerImpl::RecordBlockDownload(
+    NodeId nodeid, const BlockHash &hash,
+    std::chrono::microseconds time_received) {
+    for (auto range = mapBlocksInFlight.equal_range(hash);
+         range.first != range.second; range.first++) {
+        auto [node_id, list_it] = range.first->second;
+        if (node_id != nodeid) {
+            continue;
+        }
+
+        CNodeState &state = *Assert(State(nodeid));
+        const auto time_requested = list_it->m_time_requested;
+        // Peers deliver blocks in order, so the time spent on this block
+        // starts when the previous one was received, or when it was requested
+        // if the peer was idle.
+        const auto service_start =
+            std::max(time_requested, state.m_last_block_received);
+        state.m_block_latency = UpdateBlockDownloadAverage(
+            state.m_block_latency,
+            std::max(time_received - time_requested, 0us));
+        state.m_block_service_time = UpdateBlockDownloadAverage(
+            state.m_block_service_time,
+            std::max(time_received - service_start, 0us));
+        state.m_last_block_received = time_received;
+        return;
+    }
+}
+
+int PeerManagerImpl::GetBlocksInTransitLimit(const CNodeState &state) const {
+    if (state.m_block_service_time == 0us) {
+        return MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+    }
+    const int64_t limit{
+        std::chrono::microseconds{BLOCK_DOWNLOAD_TARGET_TIME} /
+        state.m_block_service_time};
+    return std::clamp<int64_t>(limit, MIN_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER,
+                               MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER);
+}
+
+bool PeerManagerImpl::IsLaggingBlock(const CBlockIndex &block,
+                                     const CNodeState &state,
+                                     std::chrono::microseconds now) {
+    // Only a peer that proved it can deliver blocks is worth asking.
+    if (state.m_block_latency == 0us) {
+        return false;
+    }
+
+    // Don't request a block from more than one extra peer.
+    auto range = mapBlocksInFlight.equal_range(block.GetBlockHash());
+    if (range.first == range.second ||
+        std::next(range.first) != range.second) {
+        return false;
+    }
+
+    const auto waited = now - range.first->second.second->m_time_requested;
+    return waited > std::max<std::chrono::microseconds>(
+                        LAGGING_BLOCK_LATENCY_FACTOR * state.m_block_latency,
+                        LAGGING_BLOCK_MIN_AGE);
 }
 
 void PeerManagerImpl::FindNextBlocksToDownload(
     NodeId nodeid, unsigned int count,
-    std::vector<const CBlockIndex *> &vBlocks, NodeId &nodeStaller) {
+    std::vector<const CBlockIndex *> &vBlocks, NodeId &nodeStaller,
+    const CBlockIndex *&waiting_block) {
     if (count == 0) {
         return;
     }
@@ -2009,6 +2287,7 @@ void PeerManagerImpl::FindNextBlocksToDownload(
     int nMaxHeight =
         std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
+    const CBlockIndex *pindexWaiting{nullptr};
     while (pindexWalk->nHeight < nMaxHeight) {
         // Read up to 128 (or more, if more blocks than that are needed)
         // successors of pindexWalk (towards pindexBestKnownBlock) into
@@ -2047,6 +2326,7 @@ void PeerManagerImpl::FindNextBlocksToDownload(
                         // We aren't able to fetch anything, but we would be if
                         // the download window was one larger.
                         nodeStaller = waitingfor;
+                        waiting_block = pindexWaiting;
                     }
                     return;
                 }
@@ -2059,6 +2339,7 @@ void PeerManagerImpl::FindNextBlocksToDownload(
                 waitingfor =
                     mapBlocksInFlight.lower_bound(pindex->GetBlockHash())
                         ->second.first;
+                pindexWaiting = pindex;
             }
         }
     }
@@ -2416,6 +2697,9 @@ void PeerManagerImpl::FinalizeNode(const Config &config, const CNode &node) {
             LOCK(m_peer_mutex);
             m_peer_map.erase(nodeid);
         }
+        if (m_txreconciliation) {
+            m_txreconciliation->ForgetPeer(nodeid);
+        }
         CNodeState *state = State(nodeid);
         assert(state != nullptr);
 
@@ -2514,6 +2798,11 @@ bool PeerManagerImpl::GetNodeStateStats(NodeId nodeid,
                 stats.vHeightInFlight.push_back(queue.pindex->nHeight);
             }
         }
+        stats.m_blocks_inflight_limit = GetBlocksInTransitLimit(*state);
+        stats.m_block_latency = state->m_block_latency;
+        stats.m_block_service_time = state->m_block_service_time;
+        stats.m_parallel_block_requests = state->m_parallel_block_requests;
+        stats.m_block_relay_delay = state->m_block_relay_delay;
     }
 
     PeerRef peer = GetPeerRef(nodeid);
@@ -2767,7 +3056,12 @@ PeerManagerImpl::PeerManagerImpl(CConnman &connman, AddrMan &addrman,
       m_fee_filter_rounder{CFeeRate{DEFAULT_MIN_RELAY_TX_FEE_PER_KB}, m_rng},
       m_chainparams(chainman.GetParams()), m_connman(connman),
       m_addrman(addrman), m_banman(banman), m_chainman(chainman),
-      m_mempool(pool), m_avalanche(avalanche), m_opts{opts} {}
+      m_mempool(pool), m_avalanche(avalanche), m_opts{opts} {
+    if (opts.reconcile_txs) {
+        m_txreconciliation = std::make_unique<TxReconciliationTracker>(
+            TXRECONCILIATION_VERSION);
+    }
+}
 
 void PeerManagerImpl::StartScheduledTasks(CScheduler &scheduler) {
     // Stale tip checking and peer eviction are on two different timers, but we
@@ -2811,11 +3105,12 @@ void PeerManagerImpl::StartScheduledTasks(CScheduler &scheduler) {
  */
 void PeerManagerImpl::BlockConnected(
     const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex) {
-    m_mempool.withOrphanage([&pblock](TxOrphanage &orphanage) {
-        orphanage.EraseForBlock(*pblock);
-    });
-    m_mempool.withConflicting([&pblock](TxConflicting &conflicting) {
-        conflicting.EraseForBlock(*pblock);
+    // Both pools are cleaned up from the same list of spent outpoints.
+    const std::vector<COutPoint> spent = TxPool::GetSpentOutpoints(*pblock);
+    m_mempool.withOrphanage(
+        [&spent](TxOrphanage &orphanage) { orphanage.EraseSpending(spent); });
+    m_mempool.withConflicting([&spent](TxConflicting &conflicting) {
+        conflicting.EraseSpending(spent);
     });
     m_last_tip_update = GetTime<std::chrono::seconds>();
 
@@ -2847,6 +3142,41 @@ void PeerManagerImpl::BlockConnected(
                      count_seconds(new_timeout));
         }
     }
+
+    // Blocks connected during IBD are not relayed, and each of them would
+    // only evict the previous one from the cache.
+    if (!m_chainman.ActiveChainstate().IsInitialBlockDownload()) {
+        CacheRecentBlockMsgs(pblock);
+    }
+}
+
+/** Make a message whose payload is shared with the recent block cache. */
+static CSerializedNetMsg
+MakeCachedMsg(std::string msg_type,
+              const std::shared_ptr<const std::vector<uint8_t>> &payload) {
+    CSerializedNetMsg msg;
+    msg.m_type = std::move(msg_type);
+    msg.SetExternalPayload(payload, *payload);
+    return msg;
+}
+
+void PeerManagerImpl::CacheRecentBlockMsgs(
+    const std::shared_ptr<const CBlock> &pblock) {
+    const BlockHash hash{pblock->GetHash()};
+    if (m_recent_block_msgs.Contains(hash)) {
+        // Reconnected after a reorg, already cached
+        return;
+    }
+
+    std::shared_ptr<const CBlockHeaderAndShortTxIDs> cmpctblock{
+        WITH_LOCK(m_most_recent_block_mutex,
+                  return m_most_recent_block_hash == hash
+                             ? m_most_recent_compact_block
+                             : nullptr)};
+    if (!cmpctblock) {
+        cmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs>(*pblock);
+    }
+    m_recent_block_msgs.Add(pblock, *cmpctblock);
 }
 
 void PeerManagerImpl::BlockDisconnected(
@@ -3180,6 +3510,8 @@ void PeerManagerImpl::ProcessGetBlockData(const Config &config, CNode &pfrom,
         a_recent_block = m_most_recent_block;
         a_recent_compact_block = m_most_recent_compact_block;
     }
+    const std::optional<RecentBlockMsgsCache::Entry> cached_block{
+        m_recent_block_msgs.Get(hash)};
 
     bool need_activate_chain = false;
     {
@@ -3261,17 +3593,36 @@ void PeerManagerImpl::ProcessGetBlockData(const Config &config, CNode &pfrom,
         return;
     }
     std::shared_ptr<const CBlock> pblock;
+    std::shared_ptr<const FlatFileRegion> raw_block;
     if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
         pblock = a_recent_block;
+    } else if (cached_block) {
+        pblock = cached_block->block;
     } else {
-        // Send block from disk
-        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
-        if (!m_chainman.m_blockman.ReadBlockFromDisk(*pblockRead, *pindex)) {
-            assert(!"cannot load block from disk");
+        if (inv.IsMsgBlk()) {
+            // The block file holds the block in its network serialization, so
+            // a plain block request is served from the mapped file bytes.
+            raw_block = m_chainman.m_blockman.ReadRawBlockFromDisk(*pindex);
+        }
+        if (!raw_block) {
+            // Send block from disk
+            std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+            if (!m_chainman.m_blockman.ReadBlockFromDisk(*pblockRead,
+                                                         *pindex)) {
+                assert(!"cannot load block from disk");
+            }
+            pblock = pblockRead;
         }
-        pblock = pblockRead;
     }
-    if (inv.IsMsgBlk()) {
+    if (inv.IsMsgBlk() && cached_block) {
+        m_connman.PushMessage(&pfrom,
+                              MakeCachedMsg(NetMsgType::BLOCK,
+                                            cached_block->block_payload));
+    } else if (inv.IsMsgBlk() && raw_block) {
+        CSerializedNetMsg msg{msgMaker.Make(NetMsgType::BLOCK)};
+        msg.SetExternalPayload(raw_block, raw_block->Data());
+        m_connman.PushMessage(&pfrom, std::move(msg));
+    } else if (inv.IsMsgBlk()) {
         m_connman.PushMessage(&pfrom,
                               msgMaker.Make(NetMsgType::BLOCK, *pblock));
     } else if (inv.IsMsgFilteredBlk()) {
@@ -3320,12 +3671,20 @@ void PeerManagerImpl::ProcessGetBlockData(const Config &config, CNode &pfrom,
                 m_connman.PushMessage(&pfrom,
                                       msgMaker.Make(NetMsgType::CMPCTBLOCK,
                                                     *a_recent_compact_block));
+            } else if (cached_block) {
+                m_connman.PushMessage(
+                    &pfrom, MakeCachedMsg(NetMsgType::CMPCTBLOCK,
+                                          cached_block->cmpctblock_payload));
             } else {
                 CBlockHeaderAndShortTxIDs cmpctblock(*pblock);
                 m_connman.PushMessage(
                     &pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK,
                                           cmpctblock));
             }
+        } else if (cached_block) {
+            m_connman.PushMessage(&pfrom,
+                                  MakeCachedMsg(NetMsgType::BLOCK,
+                                                cached_block->block_payload));
         } else {
             m_connman.PushMessage(
                 &pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCK, *pblock));
@@ -3385,6 +3744,34 @@ PeerManagerImpl::FindTxForGetData(const Peer &peer, const TxId &txid,
     return {};
 }
 
+void PeerManagerImpl::AnnounceReconciledTxs(CNode &node, Peer &peer,
+                                            const std::vector<TxId> &txids) {
+    auto tx_relay = peer.GetTxRelay();
+    if (!tx_relay) {
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(node.GetCommonVersion());
+    std::vector<CInv> vInv;
+    for (const TxId &txid : txids) {
+        if (!m_mempool.exists(txid)) {
+            continue;
+        }
+        // The announcement may be well after the transaction was added to the
+        // reconciliation set, so make sure the peer can still request it.
+        tx_relay->m_recently_announced_invs.insert(txid);
+        vInv.emplace_back(MSG_TX, txid);
+        if (vInv.size() == MAX_INV_SZ) {
+            m_connman.PushMessage(
+                &node, msgMaker.Make(NetMsgType::INV, std::move(vInv)));
+            vInv.clear();
+        }
+    }
+    if (!vInv.empty()) {
+        m_connman.PushMessage(&node, msgMaker.Make(NetMsgType::INV, vInv));
+    }
+}
+
 //! Determine whether or not a peer can request a proof, and return it (or
 //! nullptr if not found or not allowed).
 avalanche::ProofRef
@@ -3897,9 +4284,9 @@ void PeerManagerImpl::HeadersDirectFetchBlocks(const Config &config,
         } else {
             std::vector<CInv> vGetData;
             // Download as much as possible, from earliest to latest.
+            const int max_in_flight{GetBlocksInTransitLimit(*nodestate)};
             for (const CBlockIndex *pindex : reverse_iterate(vToFetch)) {
-                if (nodestate->vBlocksInFlight.size() >=
-                    MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+                if (int(nodestate->vBlocksInFlight.size()) >= max_in_flight) {
                     // Can't download any more from this peer
                     break;
                 }
@@ -4745,7 +5132,7 @@ void PeerManagerImpl::ProcessBlock(const Config &config, CNode &node,
 void PeerManagerImpl::ProcessMessage(
     const Config &config, CNode &pfrom, const std::string &msg_type,
     CDataStream &vRecv, const std::chrono::microseconds time_received,
-    const std::atomic<bool> &interruptMsgProc) {
+    const std::atomic<bool> &interruptMsgProc, CNetMessage *preparsed) {
     AssertLockHeld(g_msgproc_mutex);
 
     LogPrint(BCLog::NETDEBUG, "received: %s (%u bytes) peer=%d\n",
@@ -4869,6 +5256,26 @@ void PeerManagerImpl::ProcessMessage(
 
         const CNetMsgMaker msg_maker(greatest_common_version);
 
+        // Signal support for transaction reconciliation to the peers we
+        // exchange transactions with. This must be sent before verack.
+        if (m_txreconciliation && fRelay && !pfrom.IsBlockOnlyConn() &&
+            !pfrom.IsFeelerConn() && !RejectIncomingTxs(pfrom)) {
+            const uint64_t recon_salt =
+                m_txreconciliation->PreRegisterPeer(pfrom.GetId());
+            m_connman.PushMessage(&pfrom,
+                                  msg_maker.Make(NetMsgType::SENDTXRCNCL,
+                                                 TXRECONCILIATION_VERSION,
+                                                 recon_salt));
+        }
+
+        // Signal support for compressed messages to the peers we are allowed
+        // to exchange them with. This must be sent before verack.
+        if (pfrom.HasPermission(NetPermissionFlags::Compress)) {
+            m_connman.PushMessage(&pfrom,
+                                  msg_maker.Make(NetMsgType::SENDCMPR,
+                                                 MSG_COMPRESSION_VERSION));
+        }
+
         m_connman.PushMessage(&pfrom, msg_maker.Make(NetMsgType::VERACK));
 
         // Signal ADDRv2 support (BIP155).
@@ -5065,6 +5472,118 @@ void PeerManagerImpl::ProcessMessage(
         return;
     }
 
+    // Received from a peer ready to receive compressed messages. This feature
+    // negotiation must happen between VERSION and VERACK.
+    if (msg_type == NetMsgType::SENDCMPR) {
+        if (pfrom.fSuccessfullyConnected) {
+            LogPrint(BCLog::NET,
+                     "sendcmpr received after verack from peer=%d; "
+                     "disconnecting\n",
+                     pfrom.GetId());
+            pfrom.fDisconnect = true;
+            return;
+        }
+
+        // Only compress for the peers we were told to, which also got our
+        // own sendcmpr.
+        if (!pfrom.HasPermission(NetPermissionFlags::Compress)) {
+            LogPrint(BCLog::NET,
+                     "sendcmpr from peer=%d ignored, as it does not have the "
+                     "compress permission\n",
+                     pfrom.GetId());
+            return;
+        }
+
+        uint32_t peer_compression_version;
+        vRecv >> peer_compression_version;
+        if (peer_compression_version < MSG_COMPRESSION_VERSION) {
+            LogPrint(BCLog::NET,
+                     "sendcmpr from peer=%d ignored, unsupported version %u\n",
+                     pfrom.GetId(), peer_compression_version);
+            return;
+        }
+
+        LogPrint(BCLog::NET, "Compressing messages sent to peer=%d\n",
+                 pfrom.GetId());
+        pfrom.m_compress_msgs = true;
+        return;
+    }
+
+    // Received from a peer demonstrating readiness to announce transactions
+    // via reconciliations. This feature negotiation must happen between
+    // VERSION and VERACK.
+    if (msg_type == NetMsgType::SENDTXRCNCL) {
+        if (!m_txreconciliation) {
+            LogPrint(BCLog::NET,
+                     "sendtxrcncl from peer=%d ignored, as our node does not "
+                     "have txreconciliation enabled\n",
+                     pfrom.GetId());
+            return;
+        }
+
+        if (pfrom.fSuccessfullyConnected) {
+            LogPrint(BCLog::NET,
+                     "sendtxrcncl received after verack from peer=%d; "
+                     "disconnecting\n",
+                     pfrom.GetId());
+            pfrom.fDisconnect = true;
+            return;
+        }
+
+        // Peer must not offer us reconciliations if we specified no tx relay
+        // support in VERSION.
+        if (RejectIncomingTxs(pfrom)) {
+            LogPrint(BCLog::NET,
+                     "sendtxrcncl received from peer=%d to which we indicated "
+                     "no tx relay; disconnecting\n",
+                     pfrom.GetId());
+            pfrom.fDisconnect = true;
+            return;
+        }
+
+        // Peer must not offer us reconciliations if they specified no tx
+        // relay support in VERSION.
+        auto tx_relay = peer->GetTxRelay();
+        if (!tx_relay || !WITH_LOCK(tx_relay->m_bloom_filter_mutex,
+                                    return tx_relay->m_relay_txs)) {
+            LogPrint(BCLog::NET,
+                     "sendtxrcncl received from peer=%d which indicated no tx "
+                     "relay to us; disconnecting\n",
+                     pfrom.GetId());
+            pfrom.fDisconnect = true;
+            return;
+        }
+
+        uint32_t peer_txreconcl_version;
+        uint64_t remote_salt;
+        vRecv >> peer_txreconcl_version >> remote_salt;
+
+        const ReconciliationRegisterResult result =
+            m_txreconciliation->RegisterPeer(pfrom.GetId(),
+                                             pfrom.IsInboundConn(),
+                                             peer_txreconcl_version,
+                                             remote_salt);
+        switch (result) {
+            case ReconciliationRegisterResult::NOT_FOUND:
+                LogPrint(BCLog::NET,
+                         "Ignore unexpected txreconciliation signal from "
+                         "peer=%d\n",
+                         pfrom.GetId());
+                break;
+            case ReconciliationRegisterResult::SUCCESS:
+                break;
+            case ReconciliationRegisterResult::ALREADY_REGISTERED:
+            case ReconciliationRegisterResult::PROTOCOL_VIOLATION:
+                LogPrint(BCLog::NET,
+                         "txreconciliation protocol violation from peer=%d; "
+                         "disconnecting\n",
+                         pfrom.GetId());
+                pfrom.fDisconnect = true;
+                return;
+        }
+        return;
+    }
+
     if (!pfrom.fSuccessfullyConnected) {
         // Must have a verack message before anything else
         Misbehaving(*peer, 10, "non-verack message before version handshake");
@@ -5226,6 +5745,82 @@ void PeerManagerImpl::ProcessMessage(
         return;
     }
 
+    if (msg_type == NetMsgType::REQRECON) {
+        if (!m_txreconciliation) {
+            return;
+        }
+
+        uint16_t peer_set_size;
+        uint16_t peer_q;
+        vRecv >> peer_set_size >> peer_q;
+
+        IBLT sketch;
+        std::vector<TxId> to_flood;
+        if (!m_txreconciliation->HandleReconciliationRequest(
+                pfrom.GetId(), peer_set_size, peer_q, sketch, to_flood)) {
+            Misbehaving(*peer, 100, "unexpected reqrecon");
+            return;
+        }
+
+        const CNetMsgMaker msgMaker(pfrom.GetCommonVersion());
+        m_connman.PushMessage(&pfrom,
+                              msgMaker.Make(NetMsgType::SKETCH, sketch));
+        AnnounceReconciledTxs(pfrom, *peer, to_flood);
+        return;
+    }
+
+    if (msg_type == NetMsgType::SKETCH) {
+        if (!m_txreconciliation) {
+            return;
+        }
+
+        IBLT sketch;
+        vRecv >> sketch;
+
+        std::vector<uint32_t> ask_shortids;
+        std::vector<TxId> to_announce;
+        const ReconciliationSketchResult result{
+            m_txreconciliation->HandleSketch(pfrom.GetId(), sketch,
+                                             ask_shortids, to_announce)};
+        if (result == ReconciliationSketchResult::PROTOCOL_VIOLATION) {
+            Misbehaving(*peer, 100, "unexpected sketch");
+            return;
+        }
+        if (result == ReconciliationSketchResult::STALE) {
+            // Its transactions have already been flooded.
+            return;
+        }
+
+        const bool success{result == ReconciliationSketchResult::SUCCESS};
+        const CNetMsgMaker msgMaker(pfrom.GetCommonVersion());
+        m_connman.PushMessage(&pfrom,
+                              msgMaker.Make(NetMsgType::RECONCILDIFF,
+                                            uint8_t(success), ask_shortids));
+        AnnounceReconciledTxs(pfrom, *peer, to_announce);
+        return;
+    }
+
+    if (msg_type == NetMsgType::RECONCILDIFF) {
+        if (!m_txreconciliation) {
+            return;
+        }
+
+        uint8_t success;
+        std::vector<uint32_t> shortids;
+        vRecv >> success >> shortids;
+
+        std::vector<TxId> to_announce;
+        if (shortids.size() > MAX_SKETCH_CELLS ||
+            !m_txreconciliation->HandleReconciliationDifference(
+                pfrom.GetId(), success, shortids, to_announce)) {
+            Misbehaving(*peer, 100, "unexpected reconcildiff");
+            return;
+        }
+
+        AnnounceReconciledTxs(pfrom, *peer, to_announce);
+        return;
+    }
+
     if (msg_type == NetMsgType::INV) {
         std::vector<CInv> vInv;
         vRecv >> vInv;
@@ -5484,6 +6079,11 @@ void PeerManagerImpl::ProcessMessage(
             }
             // Unlock m_most_recent_block_mutex to avoid cs_main lock inversion
         }
+        if (!recent_block) {
+            if (auto cached_block{m_recent_block_msgs.Get(req.blockhash)}) {
+                recent_block = cached_block->block;
+            }
+        }
         if (recent_block) {
             SendBlockTransactions(pfrom, *peer, *recent_block, req);
             return;
@@ -5656,7 +6256,11 @@ void PeerManagerImpl::ProcessMessage(
         }
 
         CTransactionRef ptx;
-        vRecv >> ptx;
+        if (preparsed && preparsed->m_tx) {
+            ptx = std::move(preparsed->m_tx);
+        } else {
+            vRecv >> ptx;
+        }
         const CTransaction &tx = *ptx;
         const TxId &txid = tx.GetId();
         AddKnownTx(*peer, txid);
@@ -6064,8 +6668,8 @@ void PeerManagerImpl::ProcessMessage(
                         if (!(*queuedBlockIt)->partialBlock) {
                             (*queuedBlockIt)
                                 ->partialBlock.reset(
-                                    new PartiallyDownloadedBlock(config,
-                                                                 &m_mempool));
+                                    new PartiallyDownloadedBlock(
+                                        config, &m_mempool, &m_shortid_cache));
                         } else {
                             // The block was already in flight using compact
                             // blocks from the same peer.
@@ -6148,7 +6752,8 @@ void PeerManagerImpl::ProcessMessage(
                     // peer, or this peer has too many blocks outstanding to
                     // download from. Optimistically try to reconstruct anyway
                     // since we might be able to without any round trips.
-                    PartiallyDownloadedBlock tempBlock(config, &m_mempool);
+                    PartiallyDownloadedBlock tempBlock(config, &m_mempool,
+                                                       &m_shortid_cache);
                     ReadStatus status =
                         tempBlock.InitData(cmpctblock, vExtraTxnForCompact);
                     if (status != READ_STATUS_OK) {
@@ -6237,7 +6842,11 @@ void PeerManagerImpl::ProcessMessage(
         }
 
         BlockTransactions resp;
-        vRecv >> resp;
+        if (preparsed && preparsed->m_blocktxn) {
+            resp = std::move(*preparsed->m_blocktxn);
+        } else {
+            vRecv >> resp;
+        }
 
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
         bool fBlockRead = false;
@@ -6410,8 +7019,13 @@ void PeerManagerImpl::ProcessMessage(
             return;
         }
 
-        std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-        vRecv >> *pblock;
+        std::shared_ptr<CBlock> pblock;
+        if (preparsed && preparsed->m_block) {
+            pblock = std::move(preparsed->m_block);
+        } else {
+            pblock = std::make_shared<CBlock>();
+            vRecv >> *pblock;
+        }
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n",
                  pblock->GetHash().ToString(), pfrom.GetId());
@@ -6430,6 +7044,7 @@ void PeerManagerImpl::ProcessMessage(
             // Always process the block if we requested it, since we may
             // need it even when it's not a candidate for a new best tip.
             forceProcessing = IsBlockRequested(hash);
+            RecordBlockDownload(pfrom.GetId(), hash, time_received);
             RemoveBlockRequest(hash, pfrom.GetId());
             // mapBlockSource is only used for punishing peers and setting
             // which peers send us compact blocks, so the race between here and
@@ -6798,6 +7413,12 @@ void PeerManagerImpl::ProcessMessage(
                 // from disk.
                 std::shared_ptr<const CBlock> pblock = WITH_LOCK(
                     m_most_recent_block_mutex, return m_most_recent_block);
+                if (!pblock || pblock->GetHash() != pindex->GetBlockHash()) {
+                    if (auto cached_block{
+                            m_recent_block_msgs.Get(pindex->GetBlockHash())}) {
+                        pblock = cached_block->block;
+                    }
+                }
 
                 if (!pblock || pblock->GetHash() != pindex->GetBlockHash()) {
                     std::shared_ptr<CBlock> pblockRead =
@@ -7634,8 +8255,6 @@ bool PeerManagerImpl::ProcessMessages(const Config &config, CNode *pfrom,
     //  (4) checksum
     //  (x) data
     //
-    bool fMoreWork = false;
-
     PeerRef peer = GetPeerRef(pfrom->GetId());
     if (peer == nullptr) {
         return false;
@@ -7672,21 +8291,47 @@ bool PeerManagerImpl::ProcessMessages(const Config &config, CNode *pfrom,
         return false;
     }
 
-    std::list<CNetMessage> msgs;
+    // Just take one message
+    auto poll_result{pfrom->PollMessage(m_connman.GetReceiveFloodSize())};
+    if (!poll_result) {
+        return false;
+    }
+    return ProcessPolledMessage(config, pfrom, peer, poll_result->first,
+                                poll_result->second, interruptMsgProc);
+}
+
+bool PeerManagerImpl::ProcessUrgentMessage(
+    const Config &config, CNode *pfrom, std::atomic<bool> &interruptMsgProc) {
+    AssertLockHeld(g_msgproc_mutex);
+
+    PeerRef peer = GetPeerRef(pfrom->GetId());
+    if (peer == nullptr || pfrom->fDisconnect || pfrom->fPauseSend) {
+        return false;
+    }
+
+    // Leave the peer to ProcessMessages() until its pending getdata requests
+    // are served, so the responses stay in order.
     {
-        LOCK(pfrom->cs_vProcessMsg);
-        if (pfrom->vProcessMsg.empty()) {
+        LOCK(peer->m_getdata_requests_mutex);
+        if (!peer->m_getdata_requests.empty()) {
             return false;
         }
-        // Just take one message
-        msgs.splice(msgs.begin(), pfrom->vProcessMsg,
-                    pfrom->vProcessMsg.begin());
-        pfrom->nProcessQueueSize -= msgs.front().m_raw_message_size;
-        pfrom->fPauseRecv =
-            pfrom->nProcessQueueSize > m_connman.GetReceiveFloodSize();
-        fMoreWork = !pfrom->vProcessMsg.empty();
     }
-    CNetMessage &msg(msgs.front());
+
+    auto poll_result{pfrom->PollUrgentMessage(m_connman.GetReceiveFloodSize())};
+    if (!poll_result) {
+        return false;
+    }
+    return ProcessPolledMessage(config, pfrom, peer, poll_result->first,
+                                poll_result->second, interruptMsgProc);
+}
+
+bool PeerManagerImpl::ProcessPolledMessage(
+    const Config &config, CNode *pfrom, const PeerRef &peer, CNetMessage &msg,
+    bool more_work, std::atomic<bool> &interruptMsgProc) {
+    AssertLockHeld(g_msgproc_mutex);
+
+    bool fMoreWork = more_work;
 
     TRACE6(net, inbound_message, pfrom->GetId(), pfrom->m_addr_name.c_str(),
            pfrom->ConnectionTypeAsString().c_str(), msg.m_type.c_str(),
@@ -7735,9 +8380,10 @@ bool PeerManagerImpl::ProcessMessages(const Config &config, CNode *pfrom,
         return fMoreWork;
     }
 
+    const auto process_start{SteadyClock::now()};
     try {
         ProcessMessage(config, *pfrom, msg.m_type, vRecv, msg.m_time,
-                       interruptMsgProc);
+                       interruptMsgProc, &msg);
         if (interruptMsgProc) {
             return false;
         }
@@ -7766,6 +8412,13 @@ bool PeerManagerImpl::ProcessMessages(const Config &config, CNode *pfrom,
                  __func__, SanitizeString(msg.m_type), msg.m_message_size);
     }
 
+    m_connman.RecordMessageProcessing(
+        *pfrom, msg.m_type,
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            process_start - msg.m_steady_time),
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            SteadyClock::now() - process_start));
+
     return fMoreWork;
 }
 
@@ -8498,7 +9151,12 @@ bool PeerManagerImpl::SendMessages(const Config &config, CNode *pto) {
                              pto->GetId());
 
                     std::optional<CSerializedNetMsg> cached_cmpctblock_msg;
-                    {
+                    if (auto cached_block{m_recent_block_msgs.Get(
+                            pBestIndex->GetBlockHash())}) {
+                        cached_cmpctblock_msg =
+                            MakeCachedMsg(NetMsgType::CMPCTBLOCK,
+                                          cached_block->cmpctblock_payload);
+                    } else {
                         LOCK(m_most_recent_block_mutex);
                         if (m_most_recent_block_hash ==
                             pBestIndex->GetBlockHash()) {
@@ -8535,8 +9193,19 @@ bool PeerManagerImpl::SendMessages(const Config &config, CNode *pto) {
                                  vHeaders.front().GetHash().ToString(),
                                  pto->GetId());
                     }
-                    m_connman.PushMessage(
-                        pto, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
+                    std::optional<RecentBlockMsgsCache::Entry> cached_block;
+                    if (vHeaders.size() == 1) {
+                        cached_block =
+                            m_recent_block_msgs.Get(pBestIndex->GetBlockHash());
+                    }
+                    if (cached_block) {
+                        m_connman.PushMessage(
+                            pto, MakeCachedMsg(NetMsgType::HEADERS,
+                                               cached_block->headers_payload));
+                    } else {
+                        m_connman.PushMessage(
+                            pto, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
+                    }
                     state.pindexBestHeaderSent = pBestIndex;
                 } else {
                     fRevertToInv = true;
@@ -8761,9 +9430,13 @@ bool PeerManagerImpl::SendMessages(const Config &config, CNode *pto) {
                             *txinfo.tx)) {
                         continue;
                     }
-                    // Send
+                    // Send, or leave it to the next reconciliation with
+                    // this peer if we have negotiated one.
                     tx_relay->m_recently_announced_invs.insert(txid);
-                    addInvAndMaybeFlush(MSG_TX, txid);
+                    if (!m_txreconciliation ||
+                        !m_txreconciliation->AddToSet(pto->GetId(), txid)) {
+                        addInvAndMaybeFlush(MSG_TX, txid);
+                    }
                     nRelayedTransactions++;
                     {
                         // Expire old relay messages
@@ -8784,6 +9457,25 @@ bool PeerManagerImpl::SendMessages(const Config &config, CNode *pto) {
                     tx_relay->m_tx_inventory_known_filter.insert(txid);
                 }
             }
+
+            // Start a new reconciliation if we are the initiator and it is
+            // time to. Transactions that could not be reconciled are flooded.
+            if (m_txreconciliation) {
+                std::vector<TxId> to_flood;
+                if (const auto request =
+                        m_txreconciliation->MaybeRequestReconciliation(
+                            pto->GetId(), current_time, to_flood)) {
+                    m_connman.PushMessage(
+                        pto, msgMaker.Make(NetMsgType::REQRECON,
+                                           request->first, request->second));
+                }
+                for (const TxId &txid : to_flood) {
+                    if (m_mempool.exists(txid)) {
+                        tx_relay->m_recently_announced_invs.insert(txid);
+                        addInvAndMaybeFlush(MSG_TX, txid);
+                    }
+                }
+            }
         }
     } // release cs_main
 
@@ -8903,17 +9595,19 @@ bool PeerManagerImpl::SendMessages(const Config &config, CNode *pto) {
         LOCK(cs_main);
 
         CNodeState &state = *State(pto->GetId());
+        const int max_in_flight{GetBlocksInTransitLimit(state)};
 
         if (CanServeBlocks(*peer) &&
             ((sync_blocks_and_headers_from_peer && !IsLimitedPeer(*peer)) ||
              !m_chainman.ActiveChainstate().IsInitialBlockDownload()) &&
-            state.vBlocksInFlight.size() < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+            int(state.vBlocksInFlight.size()) < max_in_flight) {
             std::vector<const CBlockIndex *> vToDownload;
             NodeId staller = -1;
+            const CBlockIndex *waiting_block{nullptr};
             FindNextBlocksToDownload(pto->GetId(),
-                                     MAX_BLOCKS_IN_TRANSIT_PER_PEER -
+                                     max_in_flight -
                                          state.vBlocksInFlight.size(),
-                                     vToDownload, staller);
+                                     vToDownload, staller, waiting_block);
             for (const CBlockIndex *pindex : vToDownload) {
                 vGetData.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
                 BlockRequested(config, pto->GetId(), *pindex);
@@ -8922,12 +9616,34 @@ bool PeerManagerImpl::SendMessages(const Config &config, CNode *pto) {
                          pto->GetId());
             }
             if (state.vBlocksInFlight.empty() && staller != -1) {
+                // This peer is idle because a slower peer holds the block at
+                // the start of the download window. Rather than waiting for
+                // the stalling timeout, fetch that block from here as well.
+                if (waiting_block &&
+                    IsLaggingBlock(*waiting_block, state, current_time)) {
+                    vGetData.push_back(
+                        CInv(MSG_BLOCK, waiting_block->GetBlockHash()));
+                    BlockRequested(config, pto->GetId(), *waiting_block);
+                    state.m_parallel_block_requests++;
+                    LogPrint(BCLog::NET,
+                             "Requesting lagging block %s (%d) peer=%d in "
+                             "parallel with peer=%d\n",
+                             waiting_block->GetBlockHash().ToString(),
+                             waiting_block->nHeight, pto->GetId(), staller);
+                }
                 if (State(staller)->m_stalling_since == 0us) {
                     State(staller)->m_stalling_since = current_time;
                     LogPrint(BCLog::NET, "Stall started peer=%d\n", staller);
                 }
             }
         }
+
+        // Let the network thread parse the blocks we are waiting for and the
+        // transactions we are going to process, but nothing else.
+        pto->m_preparse_blocks = !state.vBlocksInFlight.empty();
+        pto->m_preparse_txs =
+            !RejectIncomingTxs(*pto) &&
+            !m_chainman.ActiveChainstate().IsInitialBlockDownload();
     } // release cs_main
 
     auto addGetDataAndMaybeFlush = [&](uint32_t type, const uint256 &hash) {
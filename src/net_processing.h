@@ -8,7 +8,9 @@
 
 #include <avalanche/avalanche.h>
 #include <net.h>
+#include <node/txreconciliation.h>
 #include <sync.h>
+#include <util/histogram.h>
 #include <validationinterface.h>
 
 namespace avalanche {
@@ -57,6 +59,11 @@ struct CNodeStateStats {
     int m_starting_height = -1;
     std::chrono::microseconds m_ping_wait;
     std::vector<int> vHeightInFlight;
+    int m_blocks_inflight_limit{0};
+    std::chrono::microseconds m_block_latency{0};
+    std::chrono::microseconds m_block_service_time{0};
+    uint64_t m_parallel_block_requests{0};
+    LatencyHistogram m_block_relay_delay;
     bool m_relay_txs;
     Amount m_fee_filter_received;
     uint64_t m_addr_processed = 0;
@@ -71,6 +78,8 @@ public:
     struct Options {
         //! Whether this node is running in -blocksonly mode
         bool ignore_incoming_txs{DEFAULT_BLOCKSONLY};
+        //! Whether transaction reconciliation protocol is enabled
+        bool reconcile_txs{DEFAULT_TXRECONCILIATION_ENABLE};
         //! Maximum number of orphan transactions kept in memory
         uint32_t max_orphan_txs{DEFAULT_MAX_ORPHAN_TRANSACTIONS};
         //! Maximum number of conflicting transactions kept in memory
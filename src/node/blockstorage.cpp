@@ -23,8 +23,11 @@
 #include <undo.h>
 #include <util/batchpriority.h>
 #include <util/fs.h>
+#include <util/strencodings.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <ios>
 #include <map>
 #include <unordered_map>
 
@@ -579,6 +582,13 @@ uint64_t BlockManager::CalculateCurrentUsage() {
 
 void BlockManager::UnlinkPrunedFiles(
     const std::set<int> &setFilesToPrune) const {
+    // Release the mappings of the files, which would keep their space in use.
+    // The blocks being served from them remain readable.
+    WITH_LOCK(m_block_file_maps_mutex,
+              m_block_file_maps.remove_if([&](const auto &entry) {
+                  return setFilesToPrune.count(entry.first) > 0;
+              }));
+
     std::error_code error_code;
     for (const int i : setFilesToPrune) {
         FlatFilePos pos(i, 0);
@@ -826,6 +836,108 @@ bool BlockManager::ReadBlockFromDisk(CBlock &block,
     return true;
 }
 
+std::shared_ptr<const FlatFileRegion>
+BlockManager::ReadRawBlockFromDisk(const CBlockIndex &index) const {
+    const FlatFilePos block_pos{WITH_LOCK(cs_main, return index.GetBlockPos())};
+    if (block_pos.nPos < BLOCK_SERIALIZATION_HEADER_SIZE) {
+        error("ReadRawBlockFromDisk: Invalid block position %s",
+              block_pos.ToString());
+        return nullptr;
+    }
+
+    // Open history file at the storage header preceding the block
+    FlatFilePos hpos{block_pos};
+    hpos.nPos -= BLOCK_SERIALIZATION_HEADER_SIZE;
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        error("ReadRawBlockFromDisk: OpenBlockFile failed for %s",
+              hpos.ToString());
+        return nullptr;
+    }
+
+    std::shared_ptr<const FlatFileRegion> region;
+    CBlockHeader header;
+    try {
+        CMessageHeader::MessageMagic blk_start;
+        unsigned int blk_size;
+        filein >> blk_start >> blk_size;
+
+        if (blk_start != GetParams().DiskMagic()) {
+            error("%s: Block magic mismatch for %s: %s versus expected %s",
+                  __func__, block_pos.ToString(), HexStr(blk_start),
+                  HexStr(GetParams().DiskMagic()));
+            return nullptr;
+        }
+
+        if (blk_size > MAX_SIZE) {
+            error("%s: Block data is larger than maximum deserialization size "
+                  "for %s: %s versus %s",
+                  __func__, block_pos.ToString(), blk_size, MAX_SIZE);
+            return nullptr;
+        }
+
+        if (auto mapping{GetBlockFileMapping(block_pos.nFile, filein.Get(),
+                                             block_pos.nPos + blk_size)}) {
+            region = std::make_shared<const FlatFileRegion>(
+                std::move(mapping), block_pos.nPos, blk_size);
+        } else {
+            region = std::make_shared<const FlatFileRegion>(
+                filein.Get(), block_pos.nPos, blk_size);
+        }
+        SpanReader{SER_DISK, CLIENT_VERSION, region->Data()} >> header;
+    } catch (const std::exception &e) {
+        error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(),
+              block_pos.ToString());
+        return nullptr;
+    }
+
+    // Make sure the bytes are the block the index points to
+    if (!CheckAuxProofOfWork(header, GetConsensus()) ||
+        header.GetHash() != index.GetBlockHash()) {
+        error("ReadRawBlockFromDisk: Errors in block header at %s",
+              block_pos.ToString());
+        return nullptr;
+    }
+
+    return region;
+}
+
+std::shared_ptr<const FlatFileMapping>
+BlockManager::GetBlockFileMapping(int file_number, FILE *file,
+                                  uint64_t size) const {
+    // Don't exhaust the address space of 32 bit systems with whole block
+    // files.
+    if constexpr (sizeof(void *) < 8) {
+        return nullptr;
+    }
+
+    LOCK(m_block_file_maps_mutex);
+    auto it = std::find_if(
+        m_block_file_maps.begin(), m_block_file_maps.end(),
+        [&](const auto &entry) { return entry.first == file_number; });
+    if (it != m_block_file_maps.end()) {
+        m_block_file_maps.splice(m_block_file_maps.begin(), m_block_file_maps,
+                                 it);
+        if (m_block_file_maps.front().second->Data().size() >= size) {
+            return m_block_file_maps.front().second;
+        }
+        // The block was written past the mapping, map the file again
+        m_block_file_maps.pop_front();
+    }
+
+    std::shared_ptr<const FlatFileMapping> mapping;
+    try {
+        mapping = std::make_shared<const FlatFileMapping>(file);
+    } catch (const std::ios_base::failure &) {
+        return nullptr;
+    }
+    m_block_file_maps.emplace_front(file_number, mapping);
+    if (m_block_file_maps.size() > MAX_MAPPED_BLOCK_FILES) {
+        m_block_file_maps.pop_back();
+    }
+    return mapping->Data().size() >= size ? mapping : nullptr;
+}
+
 bool BlockManager::ReadBlockHeaderFromDisk(CBlockHeader &header,
                                            const FlatFilePos &pos) const {
     header.SetNull();
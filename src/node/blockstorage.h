@@ -6,7 +6,10 @@
 #define BITCOIN_NODE_BLOCKSTORAGE_H
 
 #include <cstdint>
+#include <list>
+#include <memory>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <chain.h>
@@ -30,7 +33,9 @@ class Chainstate;
 class ChainstateManager;
 struct CCheckpointData;
 class Config;
+class FlatFileMapping;
 struct FlatFilePos;
+class FlatFileRegion;
 namespace Consensus {
 struct Params;
 }
@@ -51,6 +56,9 @@ static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 static constexpr size_t BLOCK_SERIALIZATION_HEADER_SIZE =
     CMessageHeader::MESSAGE_START_SIZE + sizeof(unsigned int);
 
+/** The number of block files kept mapped to serve raw blocks from */
+static constexpr size_t MAX_MAPPED_BLOCK_FILES{8};
+
 extern std::atomic_bool fReindex;
 
 // Because validation code takes pointers to the map's CBlockIndex objects, if
@@ -169,6 +177,22 @@ private:
 
     const kernel::BlockManagerOpts m_opts;
 
+    /**
+     * The block files mapped to serve raw blocks from, most recently used
+     * first, so serving a block costs neither an mmap() nor a munmap().
+     */
+    mutable Mutex m_block_file_maps_mutex;
+    mutable std::list<std::pair<int, std::shared_ptr<const FlatFileMapping>>>
+        m_block_file_maps GUARDED_BY(m_block_file_maps_mutex);
+
+    /**
+     * Get a mapping of the block file @p file_number, opened as @p file, which
+     * covers its first @p size bytes, or nullptr if it cannot be mapped.
+     */
+    std::shared_ptr<const FlatFileMapping>
+    GetBlockFileMapping(int file_number, FILE *file, uint64_t size) const
+        EXCLUSIVE_LOCKS_REQUIRED(!m_block_file_maps_mutex);
+
 public:
     using Options = kernel::BlockManagerOpts;
 
@@ -282,11 +306,21 @@ public:
     /**
      *  Actually unlink the specified files
      */
-    void UnlinkPrunedFiles(const std::set<int> &setFilesToPrune) const;
+    void UnlinkPrunedFiles(const std::set<int> &setFilesToPrune) const
+        EXCLUSIVE_LOCKS_REQUIRED(!m_block_file_maps_mutex);
 
     /** Functions for disk access for blocks */
     bool ReadBlockFromDisk(CBlock &block, const FlatFilePos &pos) const;
     bool ReadBlockFromDisk(CBlock &block, const CBlockIndex &index) const;
+    /**
+     * Get the serialized bytes of a block from its block file, so it can be
+     * served to peers without being deserialized and serialized again. They
+     * are viewed within the mapping of the file where possible, and read into
+     * memory otherwise. Returns nullptr on failure.
+     */
+    std::shared_ptr<const FlatFileRegion>
+    ReadRawBlockFromDisk(const CBlockIndex &index) const
+        EXCLUSIVE_LOCKS_REQUIRED(!m_block_file_maps_mutex);
     bool ReadBlockHeaderFromDisk(CBlockHeader &header,
                                  const FlatFilePos &pos) const;
     bool ReadBlockHeaderFromDisk(CBlockHeader &header,
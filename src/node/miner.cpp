@@ -70,6 +70,7 @@ BlockAssembler::BlockAssembler(Chainstate &chainstate,
       fPrintPriority(
           gArgs.GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY)) {
     blockMinFeeRate = options.blockMinFeeRate;
+    m_test_block_validity = options.test_block_validity;
     // Limit size to between 1K and options.nExcessiveBlockSize -1K for sanity:
     nMaxGeneratedBlockSize = std::max<uint64_t>(
         1000, std::min<uint64_t>(options.nExcessiveBlockSize - 1000,
@@ -83,7 +84,7 @@ BlockAssembler::BlockAssembler(Chainstate &chainstate,
     nMaxGeneratedBlockSigChecks = nMaxBlockSigChecks;
 }
 
-static BlockAssembler::Options DefaultOptions(const Config &config) {
+BlockAssembler::Options DefaultBlockAssemblerOptions(const Config &config) {
     // Block resource limits
     // If -blockmaxsize is not given, limit to DEFAULT_MAX_GENERATED_BLOCK_SIZE
     // If only one is given, only restrict the specified resource.
@@ -109,7 +110,8 @@ static BlockAssembler::Options DefaultOptions(const Config &config) {
 BlockAssembler::BlockAssembler(const Config &config, Chainstate &chainstate,
                                const CTxMemPool *mempool,
                                const avalanche::Processor *avalanche)
-    : BlockAssembler(chainstate, mempool, DefaultOptions(config), avalanche) {}
+    : BlockAssembler(chainstate, mempool, DefaultBlockAssemblerOptions(config),
+                     avalanche) {}
 
 void BlockAssembler::resetBlock() {
     // Reserve space for coinbase tx.
@@ -243,7 +245,8 @@ BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn) {
     pblocktemplate->entries[0].sigChecks = 0;
 
     BlockValidationState state;
-    if (!TestBlockValidity(state, chainParams, m_chainstate, *pblock,
+    if (m_test_block_validity &&
+        !TestBlockValidity(state, chainParams, m_chainstate, *pblock,
                            pindexPrev, GetAdjustedTime,
                            BlockValidationOptions(nMaxGeneratedBlockSize)
                                .withCheckPoW(false)
@@ -300,6 +303,9 @@ bool BlockAssembler::CheckTx(const CTransaction &tx) const {
  * addTxs includes transactions paying a fee by ensuring that
  * the partial ordering of transactions is maintained.  That is to say
  * children come after parents, despite having a potentially larger fee.
+ *
+ * The avalanche finalized transactions are packed first, then the rest of the
+ * mempool fills the remaining space by feerate.
  */
 void BlockAssembler::addTxs(const CTxMemPool &mempool) {
     // mapped_value is the number of mempool parents that are still needed for
@@ -349,6 +355,55 @@ void BlockAssembler::addTxs(const CTxMemPool &mempool) {
         return entry;
     };
 
+    // Add the entry to the block and account for it in its children.
+    auto addEntry = [&](const CTxMemPoolEntryRef &entry) {
+        AddToBlock(entry);
+
+        // This tx's children may now be candidates for addition if they have
+        // higher scores than the tx at the cursor. We can only process a
+        // child once all of that tx's parents have been added, though. To
+        // avoid O(n^2) checking of dependencies, we store and decrement the
+        // number of mempool parents for each child. Although this code
+        // ends up taking O(n) time to process a single tx with n children,
+        // that's okay because the amount of time taken is proportional to the
+        // tx's byte size and fee paid.
+        for (const auto &child : entry->GetMemPoolChildrenConst()) {
+            // Remember this tx has missing parents.
+            // Create the map entry if it doesn't exist already, and init with
+            // the number of parents.
+            const auto &[parentCount, _] = missingParentCount.try_emplace(
+                child, child.get()->GetMemPoolParentsConst().size());
+            // We just added one parent, so decrement the counter and check if
+            // we have any missing parent remaining.
+            const bool allParentsAdded = --parentCount->second == 0;
+
+            // If all parents have been added to the block, and if this child
+            // has been previously skipped due to missing parents, enqueue it
+            // (if it hasn't been skipped it will come up in a later iteration)
+            if (allParentsAdded && skippedChildren.count(child) > 0) {
+                backlog.push(child);
+            }
+        }
+    };
+
+    // First tier: the finalized transactions. The list is cached by the
+    // mempool in topological order, so parents are always visited before
+    // their children. A finalized tx that depends on a non finalized one is
+    // left for the second tier.
+    std::unordered_set<CTxMemPoolEntryRef> addedFinalized;
+    for (const CTxMemPoolEntryRef &entry : mempool.GetFinalizedTxsSorted()) {
+        if (entry->GetModifiedFeeRate() < blockMinFeeRate ||
+            hasMissingParents(entry) ||
+            !TestTxFits(entry->GetTxSize(), entry->GetSigChecks()) ||
+            !CheckTx(entry->GetTx())) {
+            continue;
+        }
+
+        addEntry(entry);
+        addedFinalized.insert(entry);
+    }
+
+    // Second tier: fill the rest of the block from the whole mempool.
     while (!backlog.empty() ||
            mi != mempool.mapTx.get<modified_feerate>().end()) {
         // Get a new or old transaction in mapTx to evaluate.
@@ -361,6 +416,11 @@ void BlockAssembler::addTxs(const CTxMemPool &mempool) {
             break;
         }
 
+        // Skip the transactions from the first tier.
+        if (!addedFinalized.empty() && addedFinalized.count(entry) > 0) {
+            continue;
+        }
+
         // Check whether all of this tx's parents are already in the block. If
         // not, pass on it until later.
         //
@@ -392,33 +452,7 @@ void BlockAssembler::addTxs(const CTxMemPool &mempool) {
         nConsecutiveFailed = 0;
 
         // Tx can be added.
-        AddToBlock(entry);
-
-        // This tx's children may now be candidates for addition if they have
-        // higher scores than the tx at the cursor. We can only process a
-        // child once all of that tx's parents have been added, though. To
-        // avoid O(n^2) checking of dependencies, we store and decrement the
-        // number of mempool parents for each child. Although this code
-        // ends up taking O(n) time to process a single tx with n children,
-        // that's okay because the amount of time taken is proportional to the
-        // tx's byte size and fee paid.
-        for (const auto &child : entry->GetMemPoolChildrenConst()) {
-            // Remember this tx has missing parents.
-            // Create the map entry if it doesn't exist already, and init with
-            // the number of parents.
-            const auto &[parentCount, _] = missingParentCount.try_emplace(
-                child, child.get()->GetMemPoolParentsConst().size());
-            // We just added one parent, so decrement the counter and check if
-            // we have any missing parent remaining.
-            const bool allParentsAdded = --parentCount->second == 0;
-
-            // If all parents have been added to the block, and if this child
-            // has been previously skipped due to missing parents, enqueue it
-            // (if it hasn't been skipped it will come up in a later iteration)
-            if (allParentsAdded && skippedChildren.count(child) > 0) {
-                backlog.push(child);
-            }
-        }
+        addEntry(entry);
     }
 }
 } // namespace node
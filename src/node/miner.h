@@ -59,6 +59,7 @@ private:
     uint64_t nMaxGeneratedBlockSize;
     uint64_t nMaxGeneratedBlockSigChecks;
     CFeeRate blockMinFeeRate;
+    bool m_test_block_validity;
 
     // Information on the current status of the block
     uint64_t nBlockSize;
@@ -83,6 +84,8 @@ public:
         uint64_t nExcessiveBlockSize;
         uint64_t nMaxGeneratedBlockSize;
         CFeeRate blockMinFeeRate;
+        //! Whether to check the template with TestBlockValidity()
+        bool test_block_validity{true};
     };
 
     BlockAssembler(const Config &config, Chainstate &chainstate,
@@ -122,6 +125,9 @@ private:
     bool CheckTx(const CTransaction &tx) const;
 };
 
+/** The assembler options set by the configuration and the arguments */
+BlockAssembler::Options DefaultBlockAssemblerOptions(const Config &config);
+
 int64_t UpdateTime(CBlockHeader *pblock, const CChainParams &chainParams,
                    const CBlockIndex *pindexPrev, int64_t adjustedTime);
 } // namespace node
@@ -20,6 +20,10 @@ void ApplyArgsManOptions(const ArgsManager &argsman,
             *value, 0, std::numeric_limits<uint32_t>::max()));
     }
 
+    if (auto value{argsman.GetBoolArg("-txreconciliation")}) {
+        options.reconcile_txs = *value;
+    }
+
     if (auto value{argsman.GetBoolArg("-capturemessages")}) {
         options.capture_messages = *value;
     }
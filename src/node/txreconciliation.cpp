@@ -0,0 +1,461 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/txreconciliation.h>
+
+#include <crypto/siphash.h>
+#include <hash.h>
+#include <logging.h>
+#include <random.h>
+#include <sync.h>
+#include <util/check.h>
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+/** Static salt component used to compute short ids for reconciliation. */
+const std::string RECON_SALT_HASH_SIGNATURE{"Tx Relay Salting"};
+
+/**
+ * Combine the salts of both sides into the key of the short ids. The salts are
+ * sorted so that both sides compute the same key.
+ */
+uint256 ComputeSalt(uint64_t salt1, uint64_t salt2) {
+    const uint64_t salt_min = std::min(salt1, salt2);
+    const uint64_t salt_max = std::max(salt1, salt2);
+    return (HashWriter{} << RECON_SALT_HASH_SIGNATURE << salt_min << salt_max)
+        .GetSHA256();
+}
+
+/**
+ * Number of sketch cells needed to decode the expected difference between a
+ * set of local_size and a set of remote_size transactions, with q the
+ * expected fraction of the smaller set that differs.
+ */
+size_t ComputeSketchCells(size_t local_size, size_t remote_size, double q) {
+    const size_t min_size = std::min(local_size, remote_size);
+    const size_t max_size = std::max(local_size, remote_size);
+    const size_t difference = max_size - min_size + size_t(q * min_size) + 1;
+    // A table with 3 hashes decodes up to about 80% of its cells for large
+    // differences, but small tables fail more often when a few keys share
+    // all their cells, so keep a generous margin on top of the estimate.
+    return std::min(MAX_SKETCH_CELLS, difference * 2 + 24);
+}
+
+/** The reconciliation state of a peer once the negotiation is complete. */
+class TxReconciliationState {
+public:
+    /** Whether we send the reconciliation requests to this peer. */
+    const bool m_we_initiate;
+
+    /** Keys of the short ids, derived from the salts of both sides. */
+    const uint64_t m_k0, m_k1;
+
+    /** Transactions to announce in the next reconciliation. */
+    std::set<TxId> m_local_set;
+
+    /**
+     * Transactions of the ongoing reconciliation by short id. They are taken
+     * out of m_local_set so transactions added in the meantime wait for the
+     * next round.
+     */
+    std::unordered_map<uint32_t, TxId> m_snapshot;
+
+    /** Whether a reconciliation is ongoing. */
+    bool m_pending{false};
+
+    /** Initiator only: when the ongoing reconciliation was requested. */
+    std::chrono::microseconds m_request_time{0};
+
+    /** Initiator only: when to request the next reconciliation. */
+    std::chrono::microseconds m_next_request_time{0};
+
+    /**
+     * Initiator only: number of sketches still due for the reconciliations
+     * that timed out, which are the next ones the responder sends.
+     */
+    size_t m_stale_sketches{0};
+
+    /** Initiator only: the q coefficient measured at the last round. */
+    double m_q{RECON_Q};
+
+    TxReconciliationState(bool we_initiate, uint64_t k0, uint64_t k1)
+        : m_we_initiate(we_initiate), m_k0(k0), m_k1(k1) {}
+
+    uint32_t ComputeShortID(const TxId &txid) const {
+        return uint32_t(SipHashUint256(m_k0, m_k1, txid));
+    }
+
+    /**
+     * Move the set into the snapshot. Transactions whose short id collides
+     * with another one cannot be reconciled and are added to to_flood.
+     */
+    void Snapshot(std::vector<TxId> &to_flood) {
+        m_snapshot.clear();
+        m_snapshot.reserve(m_local_set.size());
+        for (const TxId &txid : m_local_set) {
+            if (!m_snapshot.emplace(ComputeShortID(txid), txid).second) {
+                to_flood.push_back(txid);
+            }
+        }
+        m_local_set.clear();
+    }
+
+    /** End the ongoing reconciliation, adding its transactions to out. */
+    void FlushSnapshot(std::vector<TxId> &out) {
+        for (const auto &[shortid, txid] : m_snapshot) {
+            out.push_back(txid);
+        }
+        ClearSnapshot();
+    }
+
+    void ClearSnapshot() {
+        m_snapshot.clear();
+        m_pending = false;
+    }
+
+    IBLT MakeSketch(size_t cells) const {
+        IBLT sketch{cells};
+        for (const auto &[shortid, txid] : m_snapshot) {
+            sketch.Insert(shortid);
+        }
+        return sketch;
+    }
+};
+
+} // namespace
+
+class TxReconciliationTracker::Impl {
+private:
+    mutable Mutex m_txreconciliation_mutex;
+
+    /** Our reconciliation protocol version. */
+    const uint32_t m_recon_version;
+
+    /** The salt we sent to the peers which have not replied yet. */
+    std::unordered_map<NodeId, uint64_t>
+        m_pending_salts GUARDED_BY(m_txreconciliation_mutex);
+
+    std::unordered_map<NodeId, TxReconciliationState>
+        m_states GUARDED_BY(m_txreconciliation_mutex);
+
+    TxReconciliationState *GetState(NodeId peer_id)
+        EXCLUSIVE_LOCKS_REQUIRED(m_txreconciliation_mutex) {
+        auto it = m_states.find(peer_id);
+        return it == m_states.end() ? nullptr : &it->second;
+    }
+
+public:
+    explicit Impl(uint32_t recon_version) : m_recon_version(recon_version) {}
+
+    uint64_t PreRegisterPeer(NodeId peer_id)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex) {
+        LOCK(m_txreconciliation_mutex);
+
+        LogPrint(BCLog::NET, "Pre-register peer=%d for reconciliation\n",
+                 peer_id);
+        const uint64_t local_salt{GetRand<uint64_t>()};
+
+        // We do this exactly once per peer (which are unique by NodeId, see
+        // GetNewNodeId) so it's safe to assume we don't have this record.
+        const bool inserted =
+            m_pending_salts.emplace(peer_id, local_salt).second;
+        Assume(inserted);
+        return local_salt;
+    }
+
+    ReconciliationRegisterResult
+    RegisterPeer(NodeId peer_id, bool is_peer_inbound,
+                 uint32_t peer_recon_version, uint64_t remote_salt)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex) {
+        LOCK(m_txreconciliation_mutex);
+
+        if (m_states.count(peer_id)) {
+            return ReconciliationRegisterResult::ALREADY_REGISTERED;
+        }
+
+        auto it = m_pending_salts.find(peer_id);
+        if (it == m_pending_salts.end()) {
+            return ReconciliationRegisterResult::NOT_FOUND;
+        }
+
+        // If the peer supports a version which is lower than ours, we
+        // downgrade to the version it supports. Version 0 is invalid.
+        const uint32_t recon_version{
+            std::min(peer_recon_version, m_recon_version)};
+        if (recon_version < 1) {
+            return ReconciliationRegisterResult::PROTOCOL_VIOLATION;
+        }
+
+        LogPrint(BCLog::NET,
+                 "Register peer=%d for reconciliation with the following "
+                 "params: is_peer_inbound=%d\n",
+                 peer_id, is_peer_inbound);
+
+        const uint256 full_salt{ComputeSalt(it->second, remote_salt)};
+        m_pending_salts.erase(it);
+
+        // The side which opened the connection drives the reconciliation.
+        const bool inserted =
+            m_states
+                .emplace(std::piecewise_construct,
+                         std::forward_as_tuple(peer_id),
+                         std::forward_as_tuple(!is_peer_inbound,
+                                               full_salt.GetUint64(0),
+                                               full_salt.GetUint64(1)))
+                .second;
+        Assume(inserted);
+        return ReconciliationRegisterResult::SUCCESS;
+    }
+
+    void ForgetPeer(NodeId peer_id)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex) {
+        LOCK(m_txreconciliation_mutex);
+        if (m_pending_salts.erase(peer_id) || m_states.erase(peer_id)) {
+            LogPrint(BCLog::NET, "Stop tracking peer=%d for reconciliation\n",
+                     peer_id);
+        }
+    }
+
+    bool IsPeerRegistered(NodeId peer_id) const
+        EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex) {
+        LOCK(m_txreconciliation_mutex);
+        return m_states.count(peer_id);
+    }
+
+    bool AddToSet(NodeId peer_id, const TxId &txid)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex) {
+        LOCK(m_txreconciliation_mutex);
+        TxReconciliationState *state = GetState(peer_id);
+        if (!state || state->m_local_set.size() >= MAX_RECON_SET_SIZE) {
+            return false;
+        }
+        state->m_local_set.insert(txid);
+        return true;
+    }
+
+    std::optional<std::pair<uint16_t, uint16_t>>
+    MaybeRequestReconciliation(NodeId peer_id, std::chrono::microseconds now,
+                               std::vector<TxId> &to_flood)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex) {
+        LOCK(m_txreconciliation_mutex);
+        TxReconciliationState *state = GetState(peer_id);
+        if (!state || !state->m_we_initiate) {
+            return std::nullopt;
+        }
+
+        if (state->m_pending) {
+            if (now < state->m_request_time + RECON_RESPONSE_TIMEOUT) {
+                return std::nullopt;
+            }
+            LogPrint(BCLog::NET,
+                     "Reconciliation with peer=%d timed out, flooding %u "
+                     "transactions\n",
+                     peer_id, state->m_snapshot.size());
+            state->FlushSnapshot(to_flood);
+            ++state->m_stale_sketches;
+        }
+
+        if (state->m_next_request_time.count() == 0) {
+            // Spread the first requests to the peers over the interval.
+            state->m_next_request_time =
+                now + GetRandMicros(RECON_REQUEST_INTERVAL);
+        }
+        if (now < state->m_next_request_time) {
+            return std::nullopt;
+        }
+        state->m_next_request_time = now + RECON_REQUEST_INTERVAL;
+
+        state->Snapshot(to_flood);
+        state->m_pending = true;
+        state->m_request_time = now;
+
+        return std::make_pair(
+            uint16_t(std::min<size_t>(state->m_snapshot.size(), UINT16_MAX)),
+            uint16_t(state->m_q * Q_PRECISION));
+    }
+
+    bool HandleReconciliationRequest(NodeId peer_id, uint16_t peer_set_size,
+                                     uint16_t peer_q, IBLT &sketch,
+                                     std::vector<TxId> &to_flood)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex) {
+        LOCK(m_txreconciliation_mutex);
+        TxReconciliationState *state = GetState(peer_id);
+        if (!state || state->m_we_initiate) {
+            return false;
+        }
+
+        // The initiator gave up on the previous round and flooded its side.
+        if (state->m_pending) {
+            state->FlushSnapshot(to_flood);
+        }
+
+        state->Snapshot(to_flood);
+        state->m_pending = true;
+
+        const double q{double(peer_q) / Q_PRECISION};
+        sketch = state->MakeSketch(
+            ComputeSketchCells(state->m_snapshot.size(), peer_set_size, q));
+        return true;
+    }
+
+    ReconciliationSketchResult HandleSketch(NodeId peer_id, const IBLT &sketch,
+                                            std::vector<uint32_t> &ask_shortids,
+                                            std::vector<TxId> &to_announce)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex) {
+        LOCK(m_txreconciliation_mutex);
+        TxReconciliationState *state = GetState(peer_id);
+        if (!state || !state->m_we_initiate) {
+            return ReconciliationSketchResult::PROTOCOL_VIOLATION;
+        }
+        if (sketch.Size() == 0 || sketch.Size() > MAX_SKETCH_CELLS ||
+            sketch.Size() % IBLT::NUM_HASHES != 0) {
+            return ReconciliationSketchResult::PROTOCOL_VIOLATION;
+        }
+        if (state->m_stale_sketches > 0) {
+            LogPrint(BCLog::NET,
+                     "Ignoring the late sketch of a reconciliation that timed "
+                     "out from peer=%d\n",
+                     peer_id);
+            --state->m_stale_sketches;
+            return ReconciliationSketchResult::STALE;
+        }
+        if (!state->m_pending) {
+            return ReconciliationSketchResult::PROTOCOL_VIOLATION;
+        }
+
+        IBLT difference = state->MakeSketch(sketch.Size());
+        difference -= sketch;
+
+        std::vector<uint32_t> local_only;
+        ask_shortids.clear();
+        if (!difference.Decode(local_only, ask_shortids)) {
+            LogPrint(BCLog::NET,
+                     "Reconciliation with peer=%d failed, flooding %u "
+                     "transactions\n",
+                     peer_id, state->m_snapshot.size());
+            ask_shortids.clear();
+            state->FlushSnapshot(to_announce);
+            return ReconciliationSketchResult::FAILURE;
+        }
+
+        // Only count the decoded short ids that are actually in our set, a
+        // sketch crafted by the peer could decode to anything.
+        const size_t local_size = state->m_snapshot.size();
+        size_t num_local_only{0};
+        for (const uint32_t shortid : local_only) {
+            auto node = state->m_snapshot.extract(shortid);
+            if (node) {
+                to_announce.push_back(node.mapped());
+                ++num_local_only;
+            }
+        }
+
+        // Update the estimate of how much the sets differ beyond their size
+        // difference for the next round.
+        const size_t remote_size =
+            local_size - num_local_only + ask_shortids.size();
+        const size_t min_size = std::min(local_size, remote_size);
+        if (min_size > 0) {
+            const size_t size_difference =
+                std::max(local_size, remote_size) - min_size;
+            const size_t set_difference = num_local_only + ask_shortids.size();
+            state->m_q = std::clamp(
+                double(set_difference - size_difference) / min_size, 0.0,
+                double(UINT16_MAX) / Q_PRECISION);
+        }
+
+        LogPrint(BCLog::NET,
+                 "Reconciliation with peer=%d succeeded: %u transactions to "
+                 "announce, %u to request\n",
+                 peer_id, to_announce.size(), ask_shortids.size());
+        state->ClearSnapshot();
+        return ReconciliationSketchResult::SUCCESS;
+    }
+
+    bool HandleReconciliationDifference(NodeId peer_id, bool success,
+                                        const std::vector<uint32_t> &shortids,
+                                        std::vector<TxId> &to_announce)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_txreconciliation_mutex) {
+        LOCK(m_txreconciliation_mutex);
+        TxReconciliationState *state = GetState(peer_id);
+        if (!state || state->m_we_initiate || !state->m_pending) {
+            return false;
+        }
+
+        if (!success) {
+            state->FlushSnapshot(to_announce);
+            return true;
+        }
+
+        for (const uint32_t shortid : shortids) {
+            auto it = state->m_snapshot.find(shortid);
+            if (it != state->m_snapshot.end()) {
+                to_announce.push_back(it->second);
+            }
+        }
+        state->ClearSnapshot();
+        return true;
+    }
+};
+
+TxReconciliationTracker::TxReconciliationTracker(uint32_t recon_version)
+    : m_impl{std::make_unique<TxReconciliationTracker::Impl>(recon_version)} {}
+
+TxReconciliationTracker::~TxReconciliationTracker() = default;
+
+uint64_t TxReconciliationTracker::PreRegisterPeer(NodeId peer_id) {
+    return m_impl->PreRegisterPeer(peer_id);
+}
+
+ReconciliationRegisterResult
+TxReconciliationTracker::RegisterPeer(NodeId peer_id, bool is_peer_inbound,
+                                      uint32_t peer_recon_version,
+                                      uint64_t remote_salt) {
+    return m_impl->RegisterPeer(peer_id, is_peer_inbound, peer_recon_version,
+                                remote_salt);
+}
+
+void TxReconciliationTracker::ForgetPeer(NodeId peer_id) {
+    m_impl->ForgetPeer(peer_id);
+}
+
+bool TxReconciliationTracker::IsPeerRegistered(NodeId peer_id) const {
+    return m_impl->IsPeerRegistered(peer_id);
+}
+
+bool TxReconciliationTracker::AddToSet(NodeId peer_id, const TxId &txid) {
+    return m_impl->AddToSet(peer_id, txid);
+}
+
+std::optional<std::pair<uint16_t, uint16_t>>
+TxReconciliationTracker::MaybeRequestReconciliation(
+    NodeId peer_id, std::chrono::microseconds now,
+    std::vector<TxId> &to_flood) {
+    return m_impl->MaybeRequestReconciliation(peer_id, now, to_flood);
+}
+
+bool TxReconciliationTracker::HandleReconciliationRequest(
+    NodeId peer_id, uint16_t peer_set_size, uint16_t peer_q, IBLT &sketch,
+    std::vector<TxId> &to_flood) {
+    return m_impl->HandleReconciliationRequest(peer_id, peer_set_size, peer_q,
+                                               sketch, to_flood);
+}
+
+ReconciliationSketchResult TxReconciliationTracker::HandleSketch(
+    NodeId peer_id, const IBLT &sketch, std::vector<uint32_t> &ask_shortids,
+    std::vector<TxId> &to_announce) {
+    return m_impl->HandleSketch(peer_id, sketch, ask_shortids, to_announce);
+}
+
+bool TxReconciliationTracker::HandleReconciliationDifference(
+    NodeId peer_id, bool success, const std::vector<uint32_t> &shortids,
+    std::vector<TxId> &to_announce) {
+    return m_impl->HandleReconciliationDifference(peer_id, success, shortids,
+                                                  to_announce);
+}
@@ -0,0 +1,166 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_TXRECONCILIATION_H
+#define BITCOIN_NODE_TXRECONCILIATION_H
+
+#include <iblt.h>
+#include <nodeid.h>
+#include <primitives/txid.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/** Whether transaction reconciliation is enabled by default. */
+static constexpr bool DEFAULT_TXRECONCILIATION_ENABLE{false};
+/** Supported transaction reconciliation protocol version. */
+static constexpr uint32_t TXRECONCILIATION_VERSION{1};
+/** How often the initiator of the reconciliation requests it from a peer. */
+static constexpr std::chrono::seconds RECON_REQUEST_INTERVAL{8};
+/**
+ * How long the initiator waits for a sketch before flooding the transactions
+ * of the reconciliation.
+ */
+static constexpr std::chrono::seconds RECON_RESPONSE_TIMEOUT{30};
+/**
+ * Maximum number of transactions waiting to be reconciled with a peer. Any
+ * transaction beyond this is announced with a regular inv instead.
+ */
+static constexpr size_t MAX_RECON_SET_SIZE{3000};
+/** Maximum number of cells of a sketch we will build or accept. */
+static constexpr size_t MAX_SKETCH_CELLS{6000};
+/** Fixed point precision of the q coefficient sent in a reconciliation. */
+static constexpr uint16_t Q_PRECISION{(2 << 14) - 1};
+/**
+ * Initial estimate of the fraction of the smaller set expected to differ, on
+ * top of the difference in set sizes.
+ */
+static constexpr double RECON_Q{0.25};
+
+enum class ReconciliationRegisterResult {
+    NOT_FOUND,
+    SUCCESS,
+    ALREADY_REGISTERED,
+    PROTOCOL_VIOLATION,
+};
+
+enum class ReconciliationSketchResult {
+    /** The peer was not allowed to send this sketch. */
+    PROTOCOL_VIOLATION,
+    /** Late reply to a reconciliation that timed out, ignored. */
+    STALE,
+    /** The difference between the sets was decoded. */
+    SUCCESS,
+    /** The difference between the sets could not be decoded. */
+    FAILURE,
+};
+
+/**
+ * Transaction reconciliation is a way for nodes to efficiently announce
+ * transactions. Instead of sending an inv for every transaction to every
+ * peer, each side accumulates the transactions it would announce to a peer in
+ * a reconciliation set. Periodically, the side that opened the connection
+ * (the initiator) sends the size of its set in a reqrecon message, and the
+ * other side (the responder) replies with a sketch of its own set. The
+ * initiator subtracts the sketch of its set, decodes the difference, then
+ * announces the transactions the responder is missing and asks in a
+ * reconcildiff message for those it is missing itself. If the difference
+ * cannot be decoded, both sides announce their whole set with invs.
+ *
+ * Transactions are identified in sketches by 32 bits short ids, salted per
+ * connection with the salts exchanged in the sendtxrcncl message during the
+ * version handshake.
+ *
+ * This class holds the reconciliation state of every peer and is thread safe.
+ */
+class TxReconciliationTracker {
+    class Impl;
+    const std::unique_ptr<Impl> m_impl;
+
+public:
+    explicit TxReconciliationTracker(uint32_t recon_version);
+    ~TxReconciliationTracker();
+
+    /**
+     * Start the negotiation with a peer and return the local salt to send in
+     * the sendtxrcncl message.
+     */
+    uint64_t PreRegisterPeer(NodeId peer_id);
+
+    /**
+     * Finish the negotiation from the sendtxrcncl message of the peer. The
+     * peer must have been pre-registered.
+     */
+    ReconciliationRegisterResult RegisterPeer(NodeId peer_id,
+                                              bool is_peer_inbound,
+                                              uint32_t peer_recon_version,
+                                              uint64_t remote_salt);
+
+    /** Drop all the state of a peer, registered or not. */
+    void ForgetPeer(NodeId peer_id);
+
+    bool IsPeerRegistered(NodeId peer_id) const;
+
+    /**
+     * Add a transaction to be announced to a registered peer through
+     * reconciliation.
+     *
+     * @return false if the transaction should be announced with an inv
+     *         instead, because the peer is not registered or its
+     *         reconciliation set is full.
+     */
+    bool AddToSet(NodeId peer_id, const TxId &txid);
+
+    /**
+     * Called periodically for every peer. If we are the initiator and it is
+     * time for a new reconciliation, snapshot the set and return the set size
+     * and q coefficient to send in a reqrecon message. The transactions of a
+     * reconciliation that timed out are added to to_flood.
+     */
+    std::optional<std::pair<uint16_t, uint16_t>>
+    MaybeRequestReconciliation(NodeId peer_id, std::chrono::microseconds now,
+                               std::vector<TxId> &to_flood);
+
+    /**
+     * Responder side: build the sketch of our set in reply to a reqrecon
+     * message. The transactions of a previous reconciliation the initiator
+     * gave up on are added to to_flood.
+     *
+     * @return false if the peer is not allowed to send this message.
+     */
+    bool HandleReconciliationRequest(NodeId peer_id, uint16_t peer_set_size,
+                                     uint16_t peer_q, IBLT &sketch,
+                                     std::vector<TxId> &to_flood);
+
+    /**
+     * Initiator side: reconcile our set with the sketch of the peer. On
+     * SUCCESS, ask_shortids are the short ids to request with a reconcildiff
+     * message and to_announce the transactions the peer is missing. On
+     * FAILURE, to_announce holds our whole set and a failed reconcildiff
+     * should be sent. Nothing is to be sent for a STALE sketch: the responder
+     * replies to the requests in order, so the sketches received while the
+     * replies to the rounds that timed out are still due belong to these
+     * rounds.
+     */
+    ReconciliationSketchResult HandleSketch(NodeId peer_id, const IBLT &sketch,
+                                            std::vector<uint32_t> &ask_shortids,
+                                            std::vector<TxId> &to_announce);
+
+    /**
+     * Responder side: collect the transactions to announce after the
+     * initiator sent the outcome of the reconciliation, which is our whole
+     * set if it failed.
+     *
+     * @return false if the peer is not allowed to send this message.
+     */
+    bool HandleReconciliationDifference(NodeId peer_id, bool success,
+                                        const std::vector<uint32_t> &shortids,
+                                        std::vector<TxId> &to_announce);
+};
+
+#endif // BITCOIN_NODE_TXRECONCILIATION_H
@@ -9,6 +9,7 @@
 #include <primitives/blockhash.h>
 #include <streams.h>
 #include <util/fs.h>
+#include <util/thread.h>
 #include <validation.h>
 
 #include <cstdio>
@@ -94,4 +95,77 @@ std::optional<fs::path> FindSnapshotChainstateDir() {
     return std::nullopt;
 }
 
+SnapshotStatsWorker::SnapshotStatsWorker(int base_height,
+                                         const BlockHash &base_blockhash)
+    : m_builder(kernel::CoinStatsHashType::HASH_SERIALIZED, base_height,
+                base_blockhash) {
+    m_thread = std::thread(&util::TraceThread, "snapshothash",
+                           [this] { ThreadHash(); });
+}
+
+SnapshotStatsWorker::~SnapshotStatsWorker() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        // The result is not needed anymore, don't bother hashing the backlog.
+        LOCK(m_mutex);
+        m_queue.clear();
+        m_finished = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+}
+
+void SnapshotStatsWorker::Push(CoinsBatch batch) {
+    {
+        WAIT_LOCK(m_mutex, lock);
+        m_cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+            return m_queue.size() < MAX_QUEUED_BATCHES;
+        });
+        m_queue.push_back(std::move(batch));
+    }
+    m_cond.notify_all();
+}
+
+std::optional<kernel::CCoinsStats> SnapshotStatsWorker::Finish() {
+    {
+        LOCK(m_mutex);
+        m_finished = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+
+    if (!m_ordered) {
+        return std::nullopt;
+    }
+    return m_builder.Finalize();
+}
+
+void SnapshotStatsWorker::ThreadHash() {
+    while (true) {
+        CoinsBatch batch;
+        {
+            WAIT_LOCK(m_mutex, lock);
+            m_cond.wait(lock, [this]() EXCLUSIVE_LOCKS_REQUIRED(m_mutex) {
+                return !m_queue.empty() || m_finished;
+            });
+            if (m_queue.empty()) {
+                return;
+            }
+            batch = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        m_cond.notify_all();
+
+        for (auto &[outpoint, coin] : batch) {
+            if (!m_ordered) {
+                // Keep draining the queue so the producer never blocks.
+                break;
+            }
+            m_ordered = m_builder.Add(outpoint, std::move(coin));
+        }
+    }
+}
+
 } // namespace node
@@ -6,12 +6,20 @@
 #ifndef BITCOIN_NODE_UTXO_SNAPSHOT_H
 #define BITCOIN_NODE_UTXO_SNAPSHOT_H
 
+#include <coins.h>
+#include <kernel/coinstats.h>
 #include <primitives/blockhash.h>
 #include <serialize.h>
+#include <sync.h>
 #include <util/fs.h>
 #include <validation.h>
 
+#include <condition_variable>
+#include <deque>
 #include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
 
 struct BlockHash;
 
@@ -63,6 +71,49 @@ constexpr std::string_view SNAPSHOT_CHAINSTATE_SUFFIX = "_snapshot";
 //! Return a path to the snapshot-based chainstate dir, if one exists.
 std::optional<fs::path> FindSnapshotChainstateDir();
 
+/**
+ * Computes the HASH_SERIALIZED statistics of a stream of coins on a
+ * background thread. This lets a UTXO snapshot be hashed while it is being
+ * written or loaded, instead of in a separate pass over the whole coins
+ * database.
+ */
+class SnapshotStatsWorker {
+public:
+    using CoinsBatch = std::vector<std::pair<COutPoint, Coin>>;
+
+    //! Number of coins to queue at once, to keep synchronization negligible.
+    static constexpr size_t BATCH_SIZE{10000};
+
+    SnapshotStatsWorker(int base_height, const BlockHash &base_blockhash);
+    ~SnapshotStatsWorker();
+
+    //! Queue a batch of coins, in database order. Blocks while the worker is
+    //! too far behind.
+    void Push(CoinsBatch batch) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    //! Wait for all the queued coins to be processed and return the
+    //! statistics, or std::nullopt if the coins were not in database order.
+    std::optional<kernel::CCoinsStats> Finish()
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+private:
+    //! Bound the memory used by the coins waiting to be hashed.
+    static constexpr size_t MAX_QUEUED_BATCHES{16};
+
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<CoinsBatch> m_queue GUARDED_BY(m_mutex);
+    bool m_finished GUARDED_BY(m_mutex){false};
+
+    //! Only accessed by the worker thread until it is joined.
+    kernel::UTXOStatsBuilder m_builder;
+    bool m_ordered{true};
+
+    std::thread m_thread;
+
+    void ThreadHash() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+};
+
 } // namespace node
 
 #endif // BITCOIN_NODE_UTXO_SNAPSHOT_H
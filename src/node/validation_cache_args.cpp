@@ -7,6 +7,7 @@
 #include <kernel/validation_cache_sizes.h>
 
 #include <common/args.h>
+#include <util/fs.h>
 
 #include <algorithm>
 #include <cstddef>
@@ -31,4 +32,17 @@ void ApplyArgsManOptions(const ArgsManager &argsman,
             std::max<int64_t>(*max_size, 0) * (1 << 20);
     }
 }
+
+bool ShouldPersistValidationCaches(const ArgsManager &argsman) {
+    return argsman.GetBoolArg("-persistvalidationcaches",
+                              DEFAULT_PERSIST_VALIDATION_CACHES);
+}
+
+fs::path SignatureCachePath(const ArgsManager &argsman) {
+    return argsman.GetDataDirNet() / "sigcache.dat";
+}
+
+fs::path ScriptExecutionCachePath(const ArgsManager &argsman) {
+    return argsman.GetDataDirNet() / "scriptcache.dat";
+}
 } // namespace node
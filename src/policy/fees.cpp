@@ -8,6 +8,9 @@
 
 #include <feerate.h>
 
+#include <algorithm>
+#include <cassert>
+
 static std::set<Amount> MakeFeeSet(const CFeeRate &min_incremental_fee,
                                    const Amount &max_filter_fee_rate,
                                    const double fee_filter_spacing) {
@@ -43,3 +46,83 @@ Amount FeeFilterRounder::round(const Amount currentMinFee) {
 
     return *it;
 }
+
+static std::vector<Amount> MakeHistogramBounds() {
+    std::vector<Amount> bounds{Amount::zero()};
+    for (double boundary = MIN_FEERATE / SATOSHI;
+         boundary <= double(MAX_FEERATE / SATOSHI); boundary *= FEE_SPACING) {
+        bounds.push_back(int64_t(boundary) * SATOSHI);
+    }
+    return bounds;
+}
+
+FeeRateHistogram::FeeRateHistogram()
+    : m_bounds{MakeHistogramBounds()}, m_sizes(m_bounds.size(), 0),
+      m_counts(m_bounds.size(), 0) {}
+
+size_t FeeRateHistogram::GetBucketIndex(const CFeeRate &feerate) const {
+    // Prioritisation can make the modified feerate negative, count these in
+    // the first bucket along with the zero feerates.
+    auto it = std::upper_bound(m_bounds.begin(), m_bounds.end(),
+                               feerate.GetFeePerK());
+    if (it == m_bounds.begin()) {
+        return 0;
+    }
+    return std::distance(m_bounds.begin(), it) - 1;
+}
+
+void FeeRateHistogram::Add(const CFeeRate &feerate, int64_t size) {
+    const size_t i = GetBucketIndex(feerate);
+    m_sizes[i] += size;
+    ++m_counts[i];
+}
+
+void FeeRateHistogram::Remove(const CFeeRate &feerate, int64_t size) {
+    const size_t i = GetBucketIndex(feerate);
+    assert(m_counts[i] > 0 && m_sizes[i] >= size);
+    m_sizes[i] -= size;
+    --m_counts[i];
+}
+
+void FeeRateHistogram::Clear() {
+    std::fill(m_sizes.begin(), m_sizes.end(), 0);
+    std::fill(m_counts.begin(), m_counts.end(), 0);
+}
+
+std::vector<FeeRateHistogram::Bucket> FeeRateHistogram::GetBuckets() const {
+    std::vector<Bucket> buckets;
+    for (size_t i = m_bounds.size(); i-- > 0;) {
+        if (m_counts[i] > 0) {
+            buckets.push_back({m_bounds[i], m_sizes[i], m_counts[i]});
+        }
+    }
+    return buckets;
+}
+
+CFeeRate FeeRateHistogram::GetFeeRateForSize(int64_t size) const {
+    int64_t total = 0;
+    for (size_t i = m_bounds.size(); i-- > 0;) {
+        total += m_sizes[i];
+        if (total > size) {
+            // Pay enough to be above this bucket
+            return CFeeRate(m_bounds[std::min(i + 1, m_bounds.size() - 1)]);
+        }
+    }
+    return CFeeRate(Amount::zero());
+}
+
+void RecentBlockFeeRates::AddBlock(const CFeeRate &min_feerate) {
+    m_feerates.push_back(min_feerate);
+    while (m_feerates.size() > m_max_blocks) {
+        m_feerates.pop_front();
+    }
+}
+
+CFeeRate RecentBlockFeeRates::GetMedian() const {
+    if (m_feerates.empty()) {
+        return CFeeRate(Amount::zero());
+    }
+    std::vector<CFeeRate> sorted(m_feerates.begin(), m_feerates.end());
+    std::sort(sorted.begin(), sorted.end());
+    return sorted[sorted.size() / 2];
+}
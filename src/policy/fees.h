@@ -6,16 +6,17 @@
 #define BITCOIN_POLICY_FEES_H
 
 #include <consensus/amount.h>
+#include <feerate.h>
 #include <random.h>
 #include <sync.h>
 #include <uint256.h>
 
+#include <cstdint>
+#include <deque>
 #include <map>
 #include <string>
 #include <vector>
 
-class CFeeRate;
-
 // Minimum and Maximum values for tracking feerates
 static constexpr Amount MIN_FEERATE(10 * SATOSHI);
 static const Amount MAX_FEERATE(int64_t(1e7) * SATOSHI);
@@ -44,4 +45,68 @@ private:
     FastRandomContext &insecure_rand GUARDED_BY(m_insecure_rand_mutex);
 };
 
+/**
+ * Histogram of the mempool by feerate, in virtual size units. The buckets are
+ * spaced exponentially like the fee filter ones, starting at MIN_FEERATE. It
+ * is updated as transactions enter and leave the mempool so reading it never
+ * requires walking the mempool.
+ */
+class FeeRateHistogram {
+public:
+    struct Bucket {
+        //! Lowest feerate (per kB) of the transactions in the bucket
+        Amount feerate;
+        //! Total virtual size of the transactions
+        int64_t size;
+        //! Number of transactions
+        uint64_t count;
+    };
+
+    FeeRateHistogram();
+
+    void Add(const CFeeRate &feerate, int64_t size);
+    void Remove(const CFeeRate &feerate, int64_t size);
+    void Clear();
+
+    /** Return the non-empty buckets, highest feerate first */
+    std::vector<Bucket> GetBuckets() const;
+
+    /**
+     * Return the lowest bucket boundary such that the transactions paying at
+     * least that feerate fit in the given size, or zero if they all do.
+     */
+    CFeeRate GetFeeRateForSize(int64_t size) const;
+
+private:
+    size_t GetBucketIndex(const CFeeRate &feerate) const;
+
+    //! Lower boundary of each bucket, the first one starts at zero
+    const std::vector<Amount> m_bounds;
+    std::vector<int64_t> m_sizes;
+    std::vector<uint64_t> m_counts;
+};
+
+/**
+ * Lowest feerate of the mempool transactions included in each of the last
+ * few blocks. Miners that skip cheap transactions show up here before the
+ * mempool grows.
+ */
+class RecentBlockFeeRates {
+public:
+    static constexpr size_t DEFAULT_MAX_BLOCKS{6};
+
+    explicit RecentBlockFeeRates(size_t max_blocks = DEFAULT_MAX_BLOCKS)
+        : m_max_blocks(max_blocks) {}
+
+    void AddBlock(const CFeeRate &min_feerate);
+    size_t Size() const { return m_feerates.size(); }
+
+    /** Median of the recorded feerates, zero if there is none */
+    CFeeRate GetMedian() const;
+
+private:
+    const size_t m_max_blocks;
+    std::deque<CFeeRate> m_feerates;
+};
+
 #endif // BITCOIN_POLICY_FEES_H
@@ -56,11 +56,18 @@ const char *GETAVAADDR = "getavaaddr";
 const char *GETAVAPROOFS = "getavaproofs";
 const char *AVAPROOFS = "avaproofs";
 const char *AVAPROOFSREQ = "avaproofsreq";
+const char *SENDTXRCNCL = "sendtxrcncl";
+const char *REQRECON = "reqrecon";
+const char *SKETCH = "sketch";
+const char *RECONCILDIFF = "reconcildiff";
+const char *SENDCMPR = "sendcmpr";
+const char *CMPRMSG = "cmprmsg";
 
 bool IsBlockLike(const std::string &strCommand) {
     return strCommand == NetMsgType::BLOCK ||
            strCommand == NetMsgType::CMPCTBLOCK ||
-           strCommand == NetMsgType::BLOCKTXN;
+           strCommand == NetMsgType::BLOCKTXN ||
+           strCommand == NetMsgType::CMPRMSG;
 }
 }; // namespace NetMsgType
 
@@ -82,7 +89,9 @@ static const std::string allNetMessageTypes[] = {
     NetMsgType::CFHEADERS,   NetMsgType::GETCFCHECKPT, NetMsgType::CFCHECKPT,
     NetMsgType::AVAHELLO,    NetMsgType::AVAPOLL,      NetMsgType::AVARESPONSE,
     NetMsgType::AVAPROOF,    NetMsgType::GETAVAADDR,   NetMsgType::GETAVAPROOFS,
-    NetMsgType::AVAPROOFS,   NetMsgType::AVAPROOFSREQ,
+    NetMsgType::AVAPROOFS,   NetMsgType::AVAPROOFSREQ, NetMsgType::SENDTXRCNCL,
+    NetMsgType::REQRECON,    NetMsgType::SKETCH,       NetMsgType::RECONCILDIFF,
+    NetMsgType::SENDCMPR,    NetMsgType::CMPRMSG,
 };
 static const std::vector<std::string>
     allNetMessageTypesVec(std::begin(allNetMessageTypes),
@@ -318,6 +318,44 @@ extern const char *AVAPROOFS;
  */
 extern const char *AVAPROOFSREQ;
 
+/**
+ * Contains a 4-byte version number and an 8-byte salt.
+ * The salt is used to compute short txids needed for efficient
+ * txreconciliation, as described in the TxReconciliationTracker.
+ * It must be sent before verack.
+ */
+extern const char *SENDTXRCNCL;
+/**
+ * Contains the size of the reconciliation set of the initiator and the q
+ * coefficient used to estimate the difference between the sets.
+ * Peer should respond with "sketch" message.
+ */
+extern const char *REQRECON;
+/**
+ * Contains a sketch of the reconciliation set of the responder.
+ * Sent in response to a "reqrecon" message.
+ */
+extern const char *SKETCH;
+/**
+ * Contains the outcome of a reconciliation and, on success, the short ids of
+ * the transactions the initiator is missing.
+ * Sent in response to a "sketch" message.
+ */
+extern const char *RECONCILDIFF;
+
+/**
+ * Contains a 4-byte version number. Sent before verack to the peers we are
+ * allowed to exchange compressed messages with, see
+ * NetPermissionFlags::Compress.
+ */
+extern const char *SENDCMPR;
+/**
+ * Contains the type of the wrapped message, the size of its payload and the
+ * payload compressed with LZCompress(). Only sent to a peer which sent us a
+ * "sendcmpr" message.
+ */
+extern const char *CMPRMSG;
+
 /**
  * Indicate if the message is used to transmit the content of a block.
  * These messages can be significantly larger than usual messages and therefore
@@ -12,6 +12,7 @@
 #include <atomic>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <type_traits>
 
 template <typename T> struct PassthroughAdapter {
@@ -114,11 +115,16 @@ public:
     /**
      * Get the value corresponding to a key.
      * Returns the value if found, nullptr if not.
+     * This can be called from within an RCU read section, which then protects
+     * the lookup.
      */
     RCUPtr<T> get(const KeyType &key) {
         uint32_t level = TOP_LEVEL;
 
-        RCULock lock;
+        std::optional<RCULock> lock;
+        if (!RCULock::isLocked()) {
+            lock.emplace();
+        }
         RadixElement e = root.load();
 
         // Find a leaf.
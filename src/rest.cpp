@@ -429,6 +429,36 @@ static bool rest_mempool_info(Config &config, const std::any &context,
     }
 }
 
+static bool rest_mempool_fees(Config &config, const std::any &context,
+                              HTTPRequest *req, const std::string &strURIPart) {
+    if (!CheckWarmup(req)) {
+        return false;
+    }
+
+    const CTxMemPool *mempool = GetMemPool(context, req);
+    if (!mempool) {
+        return false;
+    }
+
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    switch (rf) {
+        case RetFormat::JSON: {
+            UniValue feeInfoObject = MempoolFeeInfoToJSON(*mempool);
+
+            std::string strJSON = feeInfoObject.write() + "\n";
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReply(HTTP_OK, strJSON);
+            return true;
+        }
+        default: {
+            return RESTERR(req, HTTP_NOT_FOUND,
+                           "output format not found (available: json)");
+        }
+    }
+}
+
 static bool rest_mempool_contents(Config &config, const std::any &context,
                                   HTTPRequest *req,
                                   const std::string &strURIPart) {
@@ -829,6 +859,7 @@ static const struct {
     {"/rest/chaininfo", rest_chaininfo},
     {"/rest/mempool/info", rest_mempool_info},
     {"/rest/mempool/contents", rest_mempool_contents},
+    {"/rest/mempool/fees", rest_mempool_fees},
     {"/rest/headers/", rest_headers},
     {"/rest/getutxos", rest_getutxos},
     {"/rest/blockhashbyheight/", rest_blockhash_by_height},
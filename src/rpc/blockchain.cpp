@@ -44,6 +44,7 @@
 
 #include <condition_variable>
 #include <cstdint>
+#include <cstdio>
 #include <memory>
 #include <mutex>
 
@@ -54,6 +55,7 @@ using node::BlockManager;
 using node::GetUTXOStats;
 using node::NodeContext;
 using node::SnapshotMetadata;
+using node::SnapshotStatsWorker;
 
 struct CUpdatedBlock {
     BlockHash hash;
@@ -2646,15 +2648,13 @@ UniValue CreateUTXOSnapshot(NodeContext &node, Chainstate &chainstate,
                             AutoFile &afile, const fs::path &path,
                             const fs::path &temppath) {
     std::unique_ptr<CCoinsViewCursor> pcursor;
-    std::optional<CCoinsStats> maybe_stats;
     const CBlockIndex *tip;
 
     {
         // We need to lock cs_main to ensure that the coinsdb isn't
         // written to between (i) flushing coins cache to disk
-        // (coinsdb), (ii) getting stats based upon the coinsdb, and
-        // (iii) constructing a cursor to the coinsdb for use below this
-        // block.
+        // (coinsdb) and (ii) constructing a cursor to the coinsdb for use
+        // below this block.
         //
         // Cursors returned by leveldb iterate over snapshots, so the
         // contents of the pcursor will not be affected by simultaneous
@@ -2667,17 +2667,10 @@ UniValue CreateUTXOSnapshot(NodeContext &node, Chainstate &chainstate,
 
         chainstate.ForceFlushStateToDisk();
 
-        maybe_stats = GetUTXOStats(&chainstate.CoinsDB(), chainstate.m_blockman,
-                                   CoinStatsHashType::HASH_SERIALIZED,
-                                   node.rpc_interruption_point);
-        if (!maybe_stats) {
-            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
-        }
-
         pcursor =
             std::unique_ptr<CCoinsViewCursor>(chainstate.CoinsDB().Cursor());
-        tip = CHECK_NONFATAL(
-            chainstate.m_blockman.LookupBlockIndex(maybe_stats->hashBlock));
+        tip = CHECK_NONFATAL(chainstate.m_blockman.LookupBlockIndex(
+            chainstate.CoinsDB().GetBestBlock()));
     }
 
     LOG_TIME_SECONDS(
@@ -2685,11 +2678,19 @@ UniValue CreateUTXOSnapshot(NodeContext &node, Chainstate &chainstate,
                   tip->nHeight, tip->GetBlockHash().ToString(),
                   fs::PathToString(path), fs::PathToString(temppath)));
 
-    SnapshotMetadata metadata{tip->GetBlockHash(), maybe_stats->coins_count,
+    // The coins count is only known once all the coins are written, so the
+    // metadata is written again at the end. It has a fixed size.
+    SnapshotMetadata metadata{tip->GetBlockHash(), /*coins_count=*/0,
                               uint64_t(tip->GetChainTxCount())};
 
     afile << metadata;
 
+    // Compute the UTXO set hash in the same pass as the file is written,
+    // instead of doing a separate scan of the coins database.
+    SnapshotStatsWorker stats_worker{tip->nHeight, tip->GetBlockHash()};
+    SnapshotStatsWorker::CoinsBatch batch;
+    batch.reserve(SnapshotStatsWorker::BATCH_SIZE);
+
     COutPoint key;
     Coin coin;
     unsigned int iter{0};
@@ -2702,10 +2703,31 @@ UniValue CreateUTXOSnapshot(NodeContext &node, Chainstate &chainstate,
         if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
             afile << key;
             afile << coin;
+
+            batch.emplace_back(key, std::move(coin));
+            if (batch.size() == SnapshotStatsWorker::BATCH_SIZE) {
+                stats_worker.Push(std::move(batch));
+                batch = {};
+                batch.reserve(SnapshotStatsWorker::BATCH_SIZE);
+            }
         }
 
         pcursor->Next();
     }
+    if (!batch.empty()) {
+        stats_worker.Push(std::move(batch));
+    }
+
+    const std::optional<CCoinsStats> maybe_stats{stats_worker.Finish()};
+    if (!maybe_stats) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+    }
+
+    metadata.m_coins_count = maybe_stats->coins_count;
+    if (std::fseek(afile.Get(), 0, SEEK_SET) != 0) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to write snapshot metadata");
+    }
+    afile << metadata;
 
     afile.fclose();
 
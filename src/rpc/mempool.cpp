@@ -10,6 +10,7 @@
 #include <core_io.h>
 #include <node/context.h>
 #include <node/mempool_persist_args.h>
+#include <policy/policy.h>
 #include <policy/settings.h>
 #include <primitives/transaction.h>
 #include <rpc/server.h>
@@ -737,6 +738,72 @@ static RPCHelpMan getmempoolinfo() {
     };
 }
 
+UniValue MempoolFeeInfoToJSON(const CTxMemPool &pool) {
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("feerate",
+               pool.EstimateInclusionFee(DEFAULT_MAX_GENERATED_BLOCK_SIZE)
+                   .GetFeePerK());
+    ret.pushKV("blocks", uint64_t{pool.GetFeeEstimateBlocks()});
+
+    UniValue histogram(UniValue::VARR);
+    for (const FeeRateHistogram::Bucket &bucket : pool.GetFeeHistogram()) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("feerate", bucket.feerate);
+        entry.pushKV("size", bucket.size);
+        entry.pushKV("count", bucket.count);
+        histogram.push_back(entry);
+    }
+    ret.pushKV("histogram", histogram);
+    return ret;
+}
+
+static RPCHelpMan getmempoolfeeinfo() {
+    const auto &ticker = Currency::get().ticker;
+    return RPCHelpMan{
+        "getmempoolfeeinfo",
+        "Returns a fee rate estimate for inclusion in the next block and the "
+        "fee rate histogram of the TX memory pool.\n"
+        "Both are maintained as transactions enter and leave the mempool, so "
+        "this is cheap to call.\n",
+        {},
+        RPCResult{
+            RPCResult::Type::OBJ,
+            "",
+            "",
+            {
+                {RPCResult::Type::STR_AMOUNT, "feerate",
+                 "Estimated fee rate in " + ticker +
+                     "/kB for a transaction to be included in the next "
+                     "block. It is at least the mempool minimum fee"},
+                {RPCResult::Type::NUM, "blocks",
+                 "Number of recent blocks the estimate is based upon"},
+                {RPCResult::Type::ARR,
+                 "histogram",
+                 "The non-empty fee rate buckets, highest fee rate first",
+                 {
+                     {RPCResult::Type::OBJ,
+                      "",
+                      "",
+                      {
+                          {RPCResult::Type::STR_AMOUNT, "feerate",
+                           "Lowest fee rate of the bucket in " + ticker +
+                               "/kB, using the modified fees"},
+                          {RPCResult::Type::NUM, "size",
+                           "Total virtual size of the transactions"},
+                          {RPCResult::Type::NUM, "count",
+                           "Number of transactions"},
+                      }},
+                 }},
+            }},
+        RPCExamples{HelpExampleCli("getmempoolfeeinfo", "") +
+                    HelpExampleRpc("getmempoolfeeinfo", "")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            return MempoolFeeInfoToJSON(EnsureAnyMemPool(request.context));
+        },
+    };
+}
+
 static RPCHelpMan savemempool() {
     return RPCHelpMan{
         "savemempool",
@@ -1009,6 +1076,7 @@ void RegisterMempoolRPCCommands(CRPCTable &t) {
         {"blockchain", getmempooldescendants},
         {"blockchain", getmempoolentry},
         {"blockchain", getmempoolinfo},
+        {"blockchain", getmempoolfeeinfo},
         {"blockchain", getrawmempool},
         {"blockchain", savemempool},
         {"rawtransactions", submitpackage},
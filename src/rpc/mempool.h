@@ -11,6 +11,9 @@ class UniValue;
 /** Mempool information to JSON */
 UniValue MempoolInfoToJSON(const CTxMemPool &pool);
 
+/** Mempool fee estimate and feerate histogram to JSON */
+UniValue MempoolFeeInfoToJSON(const CTxMemPool &pool);
+
 /** Mempool to JSON */
 UniValue MempoolToJSON(const CTxMemPool &pool, bool verbose = false,
                        bool include_mempool_sequence = false);
@@ -49,6 +49,7 @@
 
 using node::BlockAssembler;
 using node::CBlockTemplate;
+using node::DefaultBlockAssemblerOptions;
 using node::NodeContext;
 using node::UpdateTime;
 
@@ -1016,6 +1017,7 @@ static RPCHelpMan getblocktemplate() {
 
             // Update block
             static CBlockIndex *pindexPrev;
+            static const CBlockIndex *pindexValidated;
             static int64_t nStart;
             static std::unique_ptr<CBlockTemplate> pblocktemplate;
             if (pindexPrev != active_chain.Tip() ||
@@ -1031,10 +1033,15 @@ static RPCHelpMan getblocktemplate() {
                 CBlockIndex *pindexPrevNew = active_chain.Tip();
                 nStart = GetTime();
 
-                // Create new block
+                // Create new block. The mempool transactions are valid on top
+                // of the tip, so only the first template built on a tip is
+                // fully validated.
                 CScript scriptDummy = CScript() << OP_TRUE;
-                pblocktemplate = BlockAssembler{config, active_chainstate,
-                                                &mempool, node.avalanche.get()}
+                BlockAssembler::Options options{
+                    DefaultBlockAssemblerOptions(config)};
+                options.test_block_validity = pindexPrevNew != pindexValidated;
+                pblocktemplate = BlockAssembler{active_chainstate, &mempool,
+                                                options, node.avalanche.get()}
                                      .CreateNewBlock(scriptDummy);
                 if (!pblocktemplate) {
                     throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
@@ -1042,6 +1049,7 @@ static RPCHelpMan getblocktemplate() {
 
                 // Need to update only after we know CreateNewBlock succeeded
                 pindexPrev = pindexPrevNew;
+                pindexValidated = pindexPrevNew;
             }
 
             CHECK_NONFATAL(pindexPrev);
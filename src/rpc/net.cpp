@@ -22,6 +22,7 @@
 #include <rpc/util.h>
 #include <sync.h>
 #include <timedata.h>
+#include <util/histogram.h>
 #include <util/strencodings.h>
 #include <util/string.h>
 #include <util/time.h>
@@ -182,6 +183,25 @@ static RPCHelpMan getpeerinfo() {
                           "The heights of blocks we're currently asking from "
                           "this peer"},
                      }},
+                    {RPCResult::Type::NUM, "inflight_limit",
+                     "The number of blocks we may currently ask from this "
+                     "peer at once, sized from its measured download speed"},
+                    {RPCResult::Type::NUM, "block_latency",
+                     "The average time in seconds between requesting a block "
+                     "from this peer and receiving it, or 0 if it did not "
+                     "deliver any block yet"},
+                    {RPCResult::Type::NUM, "block_download_time",
+                     "The average time in seconds this peer takes to deliver a "
+                     "block once done with the previous one, or 0 if it did "
+                     "not deliver any block yet"},
+                    {RPCResult::Type::NUM, "parallel_block_requests",
+                     "The number of lagging blocks requested from this peer "
+                     "in parallel with a slower peer"},
+                    {RPCResult::Type::NUM, "block_relay_delay",
+                     "The average time in seconds between the first "
+                     "announcement of a new block by any peer and its "
+                     "announcement by this peer, or 0 if it did not announce "
+                     "any block yet"},
                     {RPCResult::Type::BOOL, "addr_relay_enabled",
                      "Whether we participate in address relay with this peer"},
                     {RPCResult::Type::NUM, "minfeefilter",
@@ -206,8 +226,46 @@ static RPCHelpMan getpeerinfo() {
                        "object and all bytes received\n"
                        "of unknown message types are listed under '" +
                            NET_MESSAGE_COMMAND_OTHER + "'."}}},
+                    {RPCResult::Type::OBJ_DYN,
+                     "processtime_per_msg",
+                     "",
+                     {{RPCResult::Type::NUM, "msg",
+                       "The total time in seconds spent processing the "
+                       "messages received, aggregated by message type\n"
+                       "When a message type is not listed in this json object, "
+                       "no time was spent processing it.\n"
+                       "The time spent processing messages of unknown types "
+                       "is listed under '" +
+                           NET_MESSAGE_COMMAND_OTHER + "'."}}},
+                    {RPCResult::Type::NUM, "queue_wait_time",
+                     "The total time in seconds the messages received waited "
+                     "in the receive queue before being processed"},
+                    {RPCResult::Type::NUM, "send_stall_time",
+                     "The total time in seconds sending to this peer was "
+                     "stalled because its socket buffer was full"},
                     {RPCResult::Type::NUM, "availability_score",
                      "Avalanche availability score of this node (if any)"},
+                    {RPCResult::Type::OBJ,
+                     "compression",
+                     /*optional=*/true,
+                     "Counters of the compressed messages, only for the peers "
+                     "with the compress permission",
+                     {
+                         {RPCResult::Type::NUM, "bytessent_raw",
+                          "The size of the payloads sent compressed, before "
+                          "compression"},
+                         {RPCResult::Type::NUM, "bytessent_compressed",
+                          "The size of these payloads once compressed"},
+                         {RPCResult::Type::NUM, "compress_time",
+                          "The time in seconds spent compressing messages"},
+                         {RPCResult::Type::NUM, "bytesrecv_raw",
+                          "The size of the payloads received compressed, once "
+                          "decompressed"},
+                         {RPCResult::Type::NUM, "bytesrecv_compressed",
+                          "The size of these payloads as received"},
+                         {RPCResult::Type::NUM, "decompress_time",
+                          "The time in seconds spent decompressing messages"},
+                     }},
                 }},
             }},
         },
@@ -289,6 +347,18 @@ static RPCHelpMan getpeerinfo() {
                         heights.push_back(height);
                     }
                     obj.pushKV("inflight", heights);
+                    obj.pushKV("inflight_limit",
+                               statestats.m_blocks_inflight_limit);
+                    obj.pushKV("block_latency",
+                               CountSecondsDouble(statestats.m_block_latency));
+                    obj.pushKV(
+                        "block_download_time",
+                        CountSecondsDouble(statestats.m_block_service_time));
+                    obj.pushKV("parallel_block_requests",
+                               statestats.m_parallel_block_requests);
+                    obj.pushKV("block_relay_delay",
+                               CountSecondsDouble(
+                                   statestats.m_block_relay_delay.Average()));
                     obj.pushKV("relaytxes", statestats.m_relay_txs);
                     obj.pushKV("minfeefilter",
                                statestats.m_fee_filter_received);
@@ -320,6 +390,19 @@ static RPCHelpMan getpeerinfo() {
                     }
                 }
                 obj.pushKV("bytesrecv_per_msg", recvPerMsgCmd);
+
+                UniValue processTimePerMsgCmd(UniValue::VOBJ);
+                for (const auto &i : stats.m_process_time_per_msg_cmd) {
+                    if (i.second > 0us) {
+                        processTimePerMsgCmd.pushKV(
+                            i.first, CountSecondsDouble(i.second));
+                    }
+                }
+                obj.pushKV("processtime_per_msg", processTimePerMsgCmd);
+                obj.pushKV("queue_wait_time",
+                           CountSecondsDouble(stats.m_queue_wait_time));
+                obj.pushKV("send_stall_time",
+                           CountSecondsDouble(stats.m_send_stall_time));
                 obj.pushKV("connection_type",
                            ConnectionTypeAsString(stats.m_conn_type));
 
@@ -328,6 +411,28 @@ static RPCHelpMan getpeerinfo() {
                                *stats.m_availabilityScore);
                 }
 
+                if (NetPermissions::HasFlag(stats.m_permission_flags,
+                                            NetPermissionFlags::Compress)) {
+                    UniValue compression(UniValue::VOBJ);
+                    compression.pushKV("bytessent_raw",
+                                       stats.m_compression_sent.raw_bytes);
+                    compression.pushKV(
+                        "bytessent_compressed",
+                        stats.m_compression_sent.compressed_bytes);
+                    compression.pushKV(
+                        "compress_time",
+                        CountSecondsDouble(stats.m_compression_sent.time));
+                    compression.pushKV("bytesrecv_raw",
+                                       stats.m_compression_recv.raw_bytes);
+                    compression.pushKV(
+                        "bytesrecv_compressed",
+                        stats.m_compression_recv.compressed_bytes);
+                    compression.pushKV(
+                        "decompress_time",
+                        CountSecondsDouble(stats.m_compression_recv.time));
+                    obj.pushKV("compression", compression);
+                }
+
                 ret.push_back(obj);
             }
 
@@ -682,6 +787,123 @@ static RPCHelpMan getnettotals() {
     };
 }
 
+static std::vector<RPCResult> LatencyHistogramDoc() {
+    return {
+        {RPCResult::Type::NUM, "count", "The number of durations measured"},
+        {RPCResult::Type::NUM, "total",
+         "The sum of the durations in seconds"},
+        {RPCResult::Type::NUM, "average",
+         "The average duration in seconds"},
+        {RPCResult::Type::NUM, "p50",
+         "The median duration in seconds, rounded up to a power of two "
+         "microseconds"},
+        {RPCResult::Type::NUM, "p90",
+         "The 90th percentile of the durations in seconds, rounded up to a "
+         "power of two microseconds"},
+        {RPCResult::Type::NUM, "p99",
+         "The 99th percentile of the durations in seconds, rounded up to a "
+         "power of two microseconds"},
+        {RPCResult::Type::NUM, "max", "The longest duration in seconds"},
+        {RPCResult::Type::ARR,
+         "histogram",
+         "The number of durations in each bucket. The first bucket counts "
+         "the durations under 1 microsecond, bucket n those under 2^n "
+         "microseconds and the last one all the longer durations",
+         {{RPCResult::Type::NUM, "", "The number of durations"}}},
+    };
+}
+
+static UniValue LatencyHistogramToUniv(const LatencyHistogram &histogram) {
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("count", histogram.count);
+    obj.pushKV("total", CountSecondsDouble(histogram.total));
+    obj.pushKV("average", CountSecondsDouble(histogram.Average()));
+    obj.pushKV("p50", CountSecondsDouble(histogram.Percentile(0.5)));
+    obj.pushKV("p90", CountSecondsDouble(histogram.Percentile(0.9)));
+    obj.pushKV("p99", CountSecondsDouble(histogram.Percentile(0.99)));
+    obj.pushKV("max", CountSecondsDouble(histogram.max));
+    UniValue buckets(UniValue::VARR);
+    for (const uint64_t bucket : histogram.buckets) {
+        buckets.push_back(bucket);
+    }
+    obj.pushKV("histogram", buckets);
+    return obj;
+}
+
+static RPCHelpMan getnettimings() {
+    return RPCHelpMan{
+        "getnettimings",
+        "Returns the distributions of the time spent processing network "
+        "messages, of the time they wait before being processed, of the time "
+        "sending is stalled on full socket buffers and of the delay of the "
+        "block announcements of the connected peers.\n",
+        {},
+        RPCResult{
+            RPCResult::Type::OBJ,
+            "",
+            "",
+            {
+                {RPCResult::Type::OBJ_DYN,
+                 "process_time_per_msg",
+                 "The time spent processing the messages received since "
+                 "startup, by message type. Only the message types received "
+                 "are listed, and the unknown ones are aggregated under '" +
+                     NET_MESSAGE_COMMAND_OTHER + "'",
+                 {{RPCResult::Type::OBJ, "msg", "", LatencyHistogramDoc()}}},
+                {RPCResult::Type::OBJ, "queue_wait",
+                 "The time the messages received since startup waited in the "
+                 "receive queue before being processed",
+                 LatencyHistogramDoc()},
+                {RPCResult::Type::OBJ, "send_stall",
+                 "The durations of the send stalls on full socket buffers "
+                 "since startup",
+                 LatencyHistogramDoc()},
+                {RPCResult::Type::OBJ, "block_relay_delay",
+                 "The delays between the first announcement of a new block by "
+                 "any peer and its announcement by each of the connected "
+                 "peers",
+                 LatencyHistogramDoc()},
+            }},
+        RPCExamples{HelpExampleCli("getnettimings", "") +
+                    HelpExampleRpc("getnettimings", "")},
+        [&](const RPCHelpMan &self, const Config &config,
+            const JSONRPCRequest &request) -> UniValue {
+            NodeContext &node = EnsureAnyNodeContext(request.context);
+            const CConnman &connman = EnsureConnman(node);
+            const PeerManager &peerman = EnsurePeerman(node);
+
+            const NetTimingStats timings{connman.GetTimingStats()};
+
+            UniValue processTimePerMsgCmd(UniValue::VOBJ);
+            for (const auto &[msg_type, histogram] :
+                 timings.process_time_per_msg_cmd) {
+                processTimePerMsgCmd.pushKV(msg_type,
+                                            LatencyHistogramToUniv(histogram));
+            }
+
+            std::vector<CNodeStats> vstats;
+            connman.GetNodeStats(vstats);
+            LatencyHistogram block_relay_delay;
+            for (const CNodeStats &stats : vstats) {
+                CNodeStateStats statestats;
+                if (peerman.GetNodeStateStats(stats.nodeid, statestats)) {
+                    block_relay_delay.Merge(statestats.m_block_relay_delay);
+                }
+            }
+
+            UniValue obj(UniValue::VOBJ);
+            obj.pushKV("process_time_per_msg", processTimePerMsgCmd);
+            obj.pushKV("queue_wait",
+                       LatencyHistogramToUniv(timings.queue_wait));
+            obj.pushKV("send_stall",
+                       LatencyHistogramToUniv(timings.send_stall));
+            obj.pushKV("block_relay_delay",
+                       LatencyHistogramToUniv(block_relay_delay));
+            return obj;
+        },
+    };
+}
+
 static UniValue GetNetworksInfo() {
     UniValue networks(UniValue::VARR);
     for (int n = 0; n < NET_MAX; ++n) {
@@ -1253,6 +1475,7 @@ void RegisterNetRPCCommands(CRPCTable &t) {
         { "network",            disconnectnode,          },
         { "network",            getaddednodeinfo,        },
         { "network",            getnettotals,            },
+        { "network",            getnettimings,           },
         { "network",            getnetworkinfo,          },
         { "network",            setban,                  },
         { "network",            listbanned,              },
@@ -4,15 +4,23 @@
 
 #include <script/scriptcache.h>
 
+#include <clientversion.h>
 #include <common/system.h>
 #include <crypto/sha256.h>
 #include <cuckoocache.h>
+#include <logging.h>
 #include <primitives/transaction.h>
 #include <random.h>
 #include <script/sigcache.h>
+#include <streams.h>
 #include <sync.h>
+#include <util/fs_helpers.h>
 #include <validation.h>
 
+#include <exception>
+#include <stdexcept>
+#include <vector>
+
 /**
  * In future if many more values are added, it should be considered to
  * expand the element size to 64 bytes (with padding the spare space as
@@ -34,6 +42,10 @@ struct ScriptCacheElement {
         : key(keyIn), nSigChecks(nSigChecksIn) {}
 
     const KeyType &getKey() const { return key; }
+
+    SERIALIZE_METHODS(ScriptCacheElement, obj) {
+        READWRITE(obj.key, obj.nSigChecks);
+    }
 };
 
 static_assert(sizeof(ScriptCacheElement) == 32,
@@ -72,15 +84,28 @@ public:
 static CuckooCache::cache<ScriptCacheElement, ScriptCacheHasher>
     g_scriptExecutionCache;
 static CSHA256 g_scriptExecutionCacheHasher;
+static uint256 g_scriptExecutionCacheNonce;
 
-bool InitScriptExecutionCache(size_t max_size_bytes) {
-    // Setup the salted hasher
-    uint256 nonce = GetRandHash();
+/**
+ * Version of the on-disk script execution cache. It must be bumped whenever
+ * the way ScriptCacheKey is computed or the meaning of the cached values
+ * changes, so that stale entries are never loaded.
+ */
+static constexpr uint64_t SCRIPT_CACHE_DUMP_VERSION{1};
+
+static void SetupScriptExecutionCacheHasher(const uint256 &nonce) {
+    g_scriptExecutionCacheNonce = nonce;
     // We want the nonce to be 64 bytes long to force the hasher to process
     // this chunk, which makes later hash computations more efficient. We
     // just write our 32-byte entropy twice to fill the 64 bytes.
-    g_scriptExecutionCacheHasher.Write(nonce.begin(), 32);
-    g_scriptExecutionCacheHasher.Write(nonce.begin(), 32);
+    g_scriptExecutionCacheHasher.Reset()
+        .Write(nonce.begin(), 32)
+        .Write(nonce.begin(), 32);
+}
+
+bool InitScriptExecutionCache(size_t max_size_bytes) {
+    // Setup the salted hasher
+    SetupScriptExecutionCacheHasher(GetRandHash());
 
     auto setup_results = g_scriptExecutionCache.setup_bytes(max_size_bytes);
     if (!setup_results) {
@@ -124,3 +149,99 @@ void AddKeyInScriptCache(ScriptCacheKey key, int nSigChecks) {
     ScriptCacheElement elem(key, nSigChecks);
     g_scriptExecutionCache.insert(elem);
 }
+
+bool DumpScriptExecutionCache(const fs::path &dump_path) {
+    AssertLockHeld(cs_main);
+
+    uint64_t num_entries{0};
+    g_scriptExecutionCache.for_each_live(
+        [&](const ScriptCacheElement &) { ++num_entries; });
+    if (num_entries == 0) {
+        // Don't clobber a previous dump with an unused cache, e.g. when the
+        // node is shutting down before it finished initializing.
+        return true;
+    }
+
+    try {
+        const fs::path tmp_path{dump_path + ".new"};
+        CAutoFile file{fsbridge::fopen(tmp_path, "wb"), SER_DISK,
+                       CLIENT_VERSION};
+        if (file.IsNull()) {
+            throw std::runtime_error("Failed to open file");
+        }
+
+        file << SCRIPT_CACHE_DUMP_VERSION;
+        file << g_scriptExecutionCacheNonce;
+        file << num_entries;
+        g_scriptExecutionCache.for_each_live(
+            [&](const ScriptCacheElement &elem) { file << elem; });
+
+        if (!FileCommit(file.Get())) {
+            throw std::runtime_error("FileCommit failed");
+        }
+        file.fclose();
+        if (!RenameOver(tmp_path, dump_path)) {
+            throw std::runtime_error("Rename failed");
+        }
+    } catch (const std::exception &e) {
+        LogPrintf("Failed to dump script execution cache: %s. Continuing "
+                  "anyway.\n",
+                  e.what());
+        return false;
+    }
+
+    LogPrintf("Dumped %u script execution cache entries to disk\n",
+              num_entries);
+    return true;
+}
+
+bool LoadScriptExecutionCache(const fs::path &load_path) {
+    AssertLockHeld(cs_main);
+
+    CAutoFile file{fsbridge::fopen(load_path, "rb"), SER_DISK, CLIENT_VERSION};
+    if (file.IsNull()) {
+        LogPrintf("Failed to open script execution cache file from disk. "
+                  "Continuing anyway.\n");
+        return false;
+    }
+
+    uint256 nonce;
+    std::vector<ScriptCacheElement> entries;
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != SCRIPT_CACHE_DUMP_VERSION) {
+            LogPrintf("Unsupported script execution cache file version %u. "
+                      "Continuing anyway.\n",
+                      version);
+            return false;
+        }
+
+        uint64_t num_entries;
+        file >> nonce;
+        file >> num_entries;
+        // Read everything before touching the cache so a truncated or corrupt
+        // file leaves it untouched.
+        while (num_entries--) {
+            ScriptCacheElement elem;
+            file >> elem;
+            entries.push_back(elem);
+        }
+    } catch (const std::exception &e) {
+        LogPrintf("Failed to deserialize script execution cache data on disk: "
+                  "%s. Continuing anyway.\n",
+                  e.what());
+        return false;
+    }
+
+    // The keys on file were computed with the dumped nonce, so switch to it.
+    // Any entry inserted with the previous nonce becomes unreachable.
+    SetupScriptExecutionCacheHasher(nonce);
+    for (const ScriptCacheElement &elem : entries) {
+        g_scriptExecutionCache.insert(elem);
+    }
+
+    LogPrintf("Loaded %u script execution cache entries from disk\n",
+              entries.size());
+    return true;
+}
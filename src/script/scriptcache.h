@@ -9,7 +9,9 @@
 #include <cstdint>
 
 #include <kernel/cs_main.h>
+#include <serialize.h>
 #include <sync.h>
+#include <util/fs.h>
 
 class CTransaction;
 
@@ -36,6 +38,8 @@ public:
         return rhs.data == data;
     }
 
+    SERIALIZE_METHODS(ScriptCacheKey, obj) { READWRITE(obj.data); }
+
     friend class ScriptCacheHasher;
 };
 
@@ -60,4 +64,21 @@ bool IsKeyInScriptCache(ScriptCacheKey key, bool erase, int &nSigChecksOut)
 void AddKeyInScriptCache(ScriptCacheKey key, int nSigChecks)
     EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/**
+ * Dump the script execution cache to disk, along with the salt used to
+ * compute its keys, so it can be restored after a restart. Nothing is written
+ * if the cache is empty.
+ */
+bool DumpScriptExecutionCache(const fs::path &dump_path)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+/**
+ * Load a script execution cache previously written by
+ * DumpScriptExecutionCache. This replaces the cache salt with the one from the
+ * file, so it must be called after InitScriptExecutionCache and before any key
+ * is computed.
+ */
+bool LoadScriptExecutionCache(const fs::path &load_path)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 #endif // BITCOIN_SCRIPT_SCRIPTCACHE_H
@@ -5,21 +5,32 @@
 
 #include <script/sigcache.h>
 
+#include <clientversion.h>
 #include <common/system.h>
 #include <cuckoocache.h>
 #include <logging.h>
 #include <pubkey.h>
 #include <random.h>
+#include <streams.h>
 #include <uint256.h>
+#include <util/fs_helpers.h>
 
 #include <algorithm>
+#include <exception>
 #include <mutex>
 #include <optional>
 #include <shared_mutex>
+#include <stdexcept>
 #include <vector>
 
 namespace {
 
+/**
+ * Version of the on-disk signature cache. It must be bumped whenever the way
+ * cache entries are computed changes, so that stale entries are never loaded.
+ */
+constexpr uint64_t SIG_CACHE_DUMP_VERSION{1};
+
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
  * twice for every transaction (once when accepted into memory pool, and
@@ -29,22 +40,26 @@ class CSignatureCache {
 private:
     //! Entries are SHA256(nonce || signature hash || public key || signature):
     CSHA256 m_salted_hasher;
+    uint256 m_nonce;
     typedef CuckooCache::cache<CuckooCache::KeyOnly<uint256>,
                                SignatureCacheHasher>
         map_type;
     map_type setValid;
     std::shared_mutex cs_sigcache;
 
-public:
-    CSignatureCache() {
-        uint256 nonce = GetRandHash();
+    void SetNonce(const uint256 &nonce) {
+        m_nonce = nonce;
         // We want the nonce to be 64 bytes long to force the hasher to process
         // this chunk, which makes later hash computations more efficient. We
         // just write our 32-byte entropy twice to fill the 64 bytes.
-        m_salted_hasher.Write(nonce.begin(), 32);
-        m_salted_hasher.Write(nonce.begin(), 32);
+        m_salted_hasher.Reset()
+            .Write(nonce.begin(), 32)
+            .Write(nonce.begin(), 32);
     }
 
+public:
+    CSignatureCache() { SetNonce(GetRandHash()); }
+
     void ComputeEntry(uint256 &entry, const uint256 &hash,
                       const std::vector<uint8_t> &vchSig,
                       const CPubKey &pubkey) {
@@ -67,6 +82,27 @@ public:
     std::optional<std::pair<uint32_t, size_t>> setup_bytes(size_t n) {
         return setValid.setup_bytes(n);
     }
+
+    /**
+     * Return the nonce and all the live entries. A cache that was never set
+     * up has no entry.
+     */
+    uint256 GetLiveEntries(std::vector<uint256> &entries) {
+        std::shared_lock<std::shared_mutex> lock(cs_sigcache);
+        setValid.for_each_live(
+            [&](const uint256 &entry) { entries.push_back(entry); });
+        return m_nonce;
+    }
+
+    /** Switch to the dumped nonce and bulk insert the dumped entries. */
+    void Load(const uint256 &nonce, const std::vector<uint256> &entries) {
+        std::unique_lock<std::shared_mutex> lock(cs_sigcache);
+        // Any entry inserted with the previous nonce becomes unreachable.
+        SetNonce(nonce);
+        for (const uint256 &entry : entries) {
+            setValid.insert(entry);
+        }
+    }
 };
 
 /**
@@ -95,6 +131,77 @@ bool InitSignatureCache(size_t max_size_bytes) {
     return true;
 }
 
+bool DumpSignatureCache(const fs::path &dump_path) {
+    std::vector<uint256> entries;
+    const uint256 nonce{signatureCache.GetLiveEntries(entries)};
+    if (entries.empty()) {
+        // Don't clobber a previous dump with an unused cache, e.g. when the
+        // node is shutting down before it finished initializing.
+        return true;
+    }
+
+    try {
+        const fs::path tmp_path{dump_path + ".new"};
+        CAutoFile file{fsbridge::fopen(tmp_path, "wb"), SER_DISK,
+                       CLIENT_VERSION};
+        if (file.IsNull()) {
+            throw std::runtime_error("Failed to open file");
+        }
+
+        file << SIG_CACHE_DUMP_VERSION << nonce << entries;
+
+        if (!FileCommit(file.Get())) {
+            throw std::runtime_error("FileCommit failed");
+        }
+        file.fclose();
+        if (!RenameOver(tmp_path, dump_path)) {
+            throw std::runtime_error("Rename failed");
+        }
+    } catch (const std::exception &e) {
+        LogPrintf("Failed to dump signature cache: %s. Continuing anyway.\n",
+                  e.what());
+        return false;
+    }
+
+    LogPrintf("Dumped %u signature cache entries to disk\n", entries.size());
+    return true;
+}
+
+bool LoadSignatureCache(const fs::path &load_path) {
+    CAutoFile file{fsbridge::fopen(load_path, "rb"), SER_DISK, CLIENT_VERSION};
+    if (file.IsNull()) {
+        LogPrintf("Failed to open signature cache file from disk. Continuing "
+                  "anyway.\n");
+        return false;
+    }
+
+    uint256 nonce;
+    std::vector<uint256> entries;
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != SIG_CACHE_DUMP_VERSION) {
+            LogPrintf("Unsupported signature cache file version %u. "
+                      "Continuing anyway.\n",
+                      version);
+            return false;
+        }
+        file >> nonce;
+        file >> entries;
+    } catch (const std::exception &e) {
+        LogPrintf("Failed to deserialize signature cache data on disk: %s. "
+                  "Continuing anyway.\n",
+                  e.what());
+        return false;
+    }
+
+    signatureCache.Load(nonce, entries);
+
+    LogPrintf("Loaded %u signature cache entries from disk\n",
+              entries.size());
+    return true;
+}
+
 template <typename F>
 bool RunMemoizedCheck(const std::vector<uint8_t> &vchSig, const CPubKey &pubkey,
                       const uint256 &sighash, bool storeOrErase, const F &fun) {
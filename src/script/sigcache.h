@@ -7,6 +7,7 @@
 #define BITCOIN_SCRIPT_SIGCACHE_H
 
 #include <script/interpreter.h>
+#include <util/fs.h>
 #include <util/hasher.h>
 
 #include <optional>
@@ -43,4 +44,17 @@ public:
 
 [[nodiscard]] bool InitSignatureCache(size_t max_size_bytes);
 
+/**
+ * Dump the signature cache to disk, along with the salt used to compute its
+ * entries. Nothing is written if the cache is empty.
+ */
+bool DumpSignatureCache(const fs::path &dump_path);
+
+/**
+ * Load a signature cache previously written by DumpSignatureCache. This
+ * replaces the cache salt with the one from the file, so it must be called
+ * after InitSignatureCache and before any signature is checked.
+ */
+bool LoadSignatureCache(const fs::path &load_path);
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -93,6 +93,11 @@ public:
     /** Unique shortid count */
     size_t getShortIdCount() const { return shortIdIndexMap.size(); }
 
+    /** Whether one of the supplied shortids is this one. */
+    bool hasShortId(uint64_t shortid) const {
+        return shortIdIndexMap.count(shortid);
+    }
+
     /**
      * Attempts to add a known item by matching its shortid with the supplied
      * ones. The shortids must be processed prior from calling this method.
@@ -318,6 +318,9 @@ inline const uint8_t *UCharCast(const char *c) {
 inline const uint8_t *UCharCast(const uint8_t *c) {
     return c;
 }
+inline uint8_t *UCharCast(std::byte *c) {
+    return reinterpret_cast<uint8_t *>(c);
+}
 inline const uint8_t *UCharCast(const std::byte *c) {
     return reinterpret_cast<const uint8_t *>(c);
 }
@@ -12,6 +12,7 @@
 #include <random.h>
 #include <streams.h>
 #include <util/asmap.h>
+#include <util/fs.h>
 #include <util/string.h>
 
 #include <test/data/asmap.raw.h>
@@ -287,6 +288,50 @@ BOOST_AUTO_TEST_CASE(addrman_select) {
     BOOST_CHECK_EQUAL(ports.size(), 3U);
 }
 
+BOOST_AUTO_TEST_CASE(addrman_select_by_bucket) {
+    AddrManTest addrman;
+
+    // A bucket full of addresses from the same group and source...
+    CNetAddr source = ResolveIP("252.2.2.2");
+    std::set<int> buckets;
+    for (unsigned int i = 1; i <= 22; ++i) {
+        CAddress addr(ResolveService("250.1.1." + ToString(i)), NODE_NONE);
+        BOOST_CHECK(addrman.Add({addr}, source));
+        buckets.insert(addrman.GetBucketAndEntry(addr).first);
+    }
+    BOOST_CHECK_EQUAL(buckets.size(), 1U);
+
+    // ... and buckets with a single address.
+    std::vector<CService> sparse;
+    for (unsigned int i = 10; i < 20; ++i) {
+        sparse.push_back(ResolveService("250." + ToString(i) + ".1.1"));
+        CAddress addr(sparse.back(), NODE_NONE);
+        BOOST_CHECK(
+            addrman.Add({addr}, ResolveIP("252." + ToString(i) + ".1.1")));
+        buckets.insert(addrman.GetBucketAndEntry(addr).first);
+    }
+    BOOST_CHECK_EQUAL(addrman.size(), 32U);
+    BOOST_REQUIRE(buckets.size() > 8);
+
+    // Each non-empty bucket is as likely to be picked, however many
+    // addresses it holds.
+    const int num_selections{1000};
+    int dense_selections{0};
+    std::set<CService> selected_sparse;
+    for (int i = 0; i < num_selections; ++i) {
+        const CAddress addr{addrman.Select(/*newOnly=*/true).first};
+        if (addr.ToStringIP().rfind("250.1.1.", 0) == 0) {
+            ++dense_selections;
+        } else {
+            selected_sparse.insert(addr);
+        }
+    }
+    const int expected{num_selections / int(buckets.size())};
+    BOOST_CHECK(dense_selections > expected / 3);
+    BOOST_CHECK(dense_selections < expected * 3);
+    BOOST_CHECK_EQUAL(selected_sparse.size(), sparse.size());
+}
+
 BOOST_AUTO_TEST_CASE(addrman_new_collisions) {
     AddrManTest addrman;
 
@@ -1071,6 +1116,150 @@ BOOST_AUTO_TEST_CASE(load_addrman_corrupted) {
                       std::ios_base::failure);
 }
 
+static void CheckSameEntries(AddrManTest &addrman, AddrManTest &other,
+                             const std::vector<CService> &addresses) {
+    BOOST_CHECK_EQUAL(addrman.size(), other.size());
+    for (const CService &addr : addresses) {
+        const AddrInfo *info = addrman.Find(addr);
+        const AddrInfo *other_info = other.Find(addr);
+        BOOST_REQUIRE_EQUAL(info == nullptr, other_info == nullptr);
+        if (!info) {
+            continue;
+        }
+        BOOST_CHECK_EQUAL(info->fInTried, other_info->fInTried);
+        BOOST_CHECK_EQUAL(info->nRefCount, other_info->nRefCount);
+        BOOST_CHECK_EQUAL(info->nAttempts, other_info->nAttempts);
+        BOOST_CHECK_EQUAL(info->nServices, other_info->nServices);
+        BOOST_CHECK(info->nTime == other_info->nTime);
+        BOOST_CHECK(info->m_last_success == other_info->m_last_success);
+        BOOST_CHECK(addrman.GetBucketAndEntry(CAddress(addr, NODE_NONE)) ==
+                    other.GetBucketAndEntry(CAddress(addr, NODE_NONE)));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(addrman_journal) {
+    AddrManTest addrman;
+    std::vector<CService> addresses;
+    CNetAddr source = ResolveIP("252.2.2.2");
+    for (unsigned int i = 1; i < 36; i++) {
+        CService addr = ResolveService("250.1.1." + ToString(i));
+        BOOST_CHECK(addrman.Add({CAddress(addr, NODE_NONE)}, source));
+        addrman.Good(addr);
+        addresses.push_back(addr);
+    }
+
+    // A journal can only be serialized after a full serialization.
+    CDataStream journal1(SER_DISK, CLIENT_VERSION);
+    BOOST_CHECK(!addrman.SerializeJournal(journal1));
+    CDataStream full(SER_DISK, CLIENT_VERSION);
+    full << addrman;
+    BOOST_CHECK(addrman.SerializeJournal(journal1));
+    BOOST_CHECK(journal1.empty());
+
+    // Evict 250.1.1.19 from tried to new and update some entries.
+    CService addr36 = ResolveService("250.1.1.36");
+    addresses.push_back(addr36);
+    BOOST_CHECK(addrman.Add({CAddress(addr36, NODE_NONE)}, source));
+    addrman.Good(addr36);
+    addrman.SimConnFail(ResolveService("250.1.1.19"));
+    addrman.ResolveCollisions();
+    BOOST_CHECK(!addrman.Find(ResolveService("250.1.1.19"))->fInTried);
+    addrman.Attempt(ResolveService("250.1.1.1"), /*fCountFailure=*/true);
+    addrman.SetServices(ResolveService("250.1.1.2"), NODE_NETWORK);
+    BOOST_CHECK(addrman.SerializeJournal(journal1));
+    BOOST_CHECK(!journal1.empty());
+
+    // Add new entries, from several sources so some are in several buckets.
+    for (unsigned int i = 1; i < 50; i++) {
+        CService addr = ResolveService("250.2.1." + ToString(i));
+        addresses.push_back(addr);
+        for (unsigned int j = 1; j < 4; j++) {
+            CAddress caddr(addr, NODE_NONE);
+            caddr.nTime = Now<NodeSeconds>() - 2h * (4 - j);
+            addrman.Add({caddr}, ResolveIP("251." + ToString(j) + ".1.1"));
+        }
+    }
+    CDataStream journal2(SER_DISK, CLIENT_VERSION);
+    BOOST_CHECK(addrman.SerializeJournal(journal2));
+
+    AddrManTest loaded;
+    full >> loaded;
+    loaded.UnserializeJournal(journal1);
+    loaded.UnserializeJournal(journal2);
+    CheckSameEntries(addrman, loaded, addresses);
+
+    // Journals can be serialized on top of the loaded tables.
+    CService addr = ResolveService("250.3.1.1");
+    addresses.push_back(addr);
+    BOOST_CHECK(loaded.Add({CAddress(addr, NODE_NONE)}, source));
+    CDataStream journal3(SER_DISK, CLIENT_VERSION);
+    BOOST_CHECK(loaded.SerializeJournal(journal3));
+    BOOST_CHECK(addrman.Add({CAddress(addr, NODE_NONE)}, source));
+    AddrManTest reloaded;
+    CDataStream full2(SER_DISK, CLIENT_VERSION);
+    full2 << addrman;
+    full2 >> reloaded;
+    // Applying a journal again leaves the entries as they were.
+    reloaded.UnserializeJournal(journal3);
+    CheckSameEntries(addrman, reloaded, addresses);
+
+    addrman.Clear();
+    BOOST_CHECK(!addrman.SerializeJournal(journal3));
+}
+
+BOOST_AUTO_TEST_CASE(load_addrman_journal) {
+    m_args.ForceSetArg("-peersjournal", "1");
+    const fs::path path{m_args.GetDataDirNet() / "peers.dat"};
+
+    // peers.dat is created when missing.
+    auto addrman{LoadAddrman(Params(), /*asmap=*/{}, m_args)};
+    BOOST_REQUIRE(addrman);
+    const auto empty_size{fs::file_size(path)};
+
+    CNetAddr source = ResolveIP("252.2.2.2");
+    for (unsigned int i = 1; i < 20; i++) {
+        BOOST_CHECK((*addrman)->Add(
+            {CAddress(ResolveService("250.1.1." + ToString(i)), NODE_NONE)},
+            source));
+    }
+    BOOST_CHECK(DumpPeerAddresses(Params(), m_args, **addrman));
+    const auto journal_size{fs::file_size(path)};
+    BOOST_CHECK(journal_size > empty_size);
+    // Some of the addresses share a bucket position and replace each other.
+    const size_t first_size{(*addrman)->size()};
+
+    // Nothing is written when nothing changed.
+    BOOST_CHECK(DumpPeerAddresses(Params(), m_args, **addrman));
+    BOOST_CHECK_EQUAL(fs::file_size(path), journal_size);
+
+    for (unsigned int i = 20; i < 30; i++) {
+        BOOST_CHECK((*addrman)->Add(
+            {CAddress(ResolveService("250.1.1." + ToString(i)), NODE_NONE)},
+            source));
+    }
+    BOOST_CHECK(DumpPeerAddresses(Params(), m_args, **addrman));
+    BOOST_CHECK(fs::file_size(path) > journal_size);
+
+    auto loaded{LoadAddrman(Params(), /*asmap=*/{}, m_args)};
+    BOOST_REQUIRE(loaded);
+    BOOST_CHECK_EQUAL((*loaded)->size(), (*addrman)->size());
+    BOOST_CHECK((*loaded)->size() > first_size);
+
+    // A truncated journal, as if the node crashed while appending it, is
+    // dropped and the file rewritten without it.
+    fs::resize_file(path, fs::file_size(path) - 1);
+    loaded = LoadAddrman(Params(), /*asmap=*/{}, m_args);
+    BOOST_REQUIRE(loaded);
+    BOOST_CHECK_EQUAL((*loaded)->size(), first_size);
+    auto reloaded{LoadAddrman(Params(), /*asmap=*/{}, m_args)};
+    BOOST_REQUIRE(reloaded);
+    BOOST_CHECK_EQUAL((*reloaded)->size(), first_size);
+
+    m_args.ForceSetArg("-peersjournal", "0");
+    BOOST_CHECK(DumpPeerAddresses(Params(), m_args, **reloaded));
+    BOOST_CHECK(fs::file_size(path) < journal_size);
+}
+
 BOOST_AUTO_TEST_CASE(addrman_is_terrible) {
     AddrInfo addr_info{};
     const auto now = Now<NodeSeconds>();
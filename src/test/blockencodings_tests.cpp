@@ -7,6 +7,7 @@
 #include <chainparams.h>
 #include <config.h>
 #include <consensus/merkle.h>
+#include <core_memusage.h>
 #include <pow/pow.h>
 #include <streams.h>
 #include <txmempool.h>
@@ -371,6 +372,128 @@ BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(ShortIdCacheTest) {
+    CTxMemPool &pool = *Assert(m_node.mempool);
+    TestMemPoolEntryHelper entry;
+    CBlock block(BuildBlockTestCase());
+    ShortIdCache cache;
+
+    LOCK2(cs_main, pool.cs);
+    pool.addUnchecked(entry.FromTx(block.vtx[2]));
+    const CTransaction *block_tx2 = block.vtx[2].get();
+
+    CBlockHeaderAndShortTxIDs shortIDs(block);
+    {
+        PartiallyDownloadedBlock partialBlock(m_node.chainman->GetConfig(),
+                                              &pool, &cache);
+        BOOST_CHECK(partialBlock.InitData(shortIDs, extra_txn) ==
+                    READ_STATUS_OK);
+        BOOST_CHECK(partialBlock.IsTxAvailable(2));
+
+        // Only the partial block references the tx, not the cached short IDs
+        expectUseCount(pool, block_tx2, 1);
+    }
+    expectUseCount(pool, block_tx2, 0);
+
+    // Another reconstruction of the same compact block uses the cached IDs
+    {
+        PartiallyDownloadedBlock partialBlock(m_node.chainman->GetConfig(),
+                                              &pool, &cache);
+        BOOST_CHECK(partialBlock.InitData(shortIDs, extra_txn) ==
+                    READ_STATUS_OK);
+        BOOST_CHECK(partialBlock.IsTxAvailable(2));
+        expectUseCount(pool, block_tx2, 1);
+    }
+
+    // Entries are looked up by key and mempool state
+    const unsigned int updated{pool.GetTransactionsUpdated() + 1};
+    auto shortids = std::make_shared<const ShortIdCache::ShortIds>(
+        ShortIdCache::ShortIds{{42, block.vtx[1]->GetId()}});
+    cache.Add(1, 2, updated, shortids);
+    BOOST_CHECK(cache.Get(1, 2, updated) == shortids);
+    BOOST_CHECK(!cache.Get(1, 3, updated));
+    BOOST_CHECK(!cache.Get(1, 2, updated + 1));
+
+    // A new mempool state drops every stale entry
+    cache.Add(3, 4, updated + 1, shortids);
+    BOOST_CHECK(!cache.Get(1, 2, updated));
+    BOOST_CHECK(cache.Get(3, 4, updated + 1) == shortids);
+    expectUseCount(pool, block_tx2, 0);
+
+    // Only the most recent keys are kept
+    for (uint64_t k = 0; k < ShortIdCache::MAX_ENTRIES; ++k) {
+        cache.Add(5, k, updated + 1, shortids);
+    }
+    BOOST_CHECK(!cache.Get(3, 4, updated + 1));
+    BOOST_CHECK(cache.Get(5, 0, updated + 1) == shortids);
+}
+
+BOOST_AUTO_TEST_CASE(RecentBlockMsgsCacheTest) {
+    std::vector<std::shared_ptr<const CBlock>> blocks;
+    for (int i = 0; i < 4; ++i) {
+        blocks.push_back(std::make_shared<const CBlock>(BuildBlockTestCase()));
+    }
+    auto add = [](RecentBlockMsgsCache &cache,
+                  const std::shared_ptr<const CBlock> &block) {
+        cache.Add(block, CBlockHeaderAndShortTxIDs{*block});
+    };
+    auto contains = [&](const RecentBlockMsgsCache &cache, size_t i) {
+        return cache.Contains(blocks[i]->GetHash());
+    };
+
+    // The memory usage accounts for the block kept alive by the cache, on top
+    // of its wire forms.
+    RecentBlockMsgsCache cache{2, std::numeric_limits<size_t>::max()};
+    add(cache, blocks[0]);
+    const auto entry{cache.Get(blocks[0]->GetHash())};
+    BOOST_REQUIRE(entry);
+    BOOST_CHECK(entry->block == blocks[0]);
+    const size_t entry_usage{cache.DynamicMemoryUsage()};
+    BOOST_CHECK_EQUAL(entry_usage, entry->DynamicMemoryUsage());
+    size_t block_usage{0};
+    for (const CTransactionRef &tx : blocks[0]->vtx) {
+        block_usage += RecursiveDynamicUsage(tx);
+    }
+    BOOST_CHECK(entry_usage > entry->block_payload->size() +
+                                  entry->cmpctblock_payload->size() +
+                                  entry->headers_payload->size() +
+                                  block_usage);
+
+    // Adding a block twice is a no-op
+    add(cache, blocks[0]);
+    BOOST_CHECK_EQUAL(cache.Size(), 1U);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), entry_usage);
+
+    // The least recently used block is evicted first
+    add(cache, blocks[1]);
+    BOOST_CHECK(cache.Get(blocks[0]->GetHash()));
+    add(cache, blocks[2]);
+    BOOST_CHECK_EQUAL(cache.Size(), 2U);
+    BOOST_CHECK(contains(cache, 0));
+    BOOST_CHECK(!contains(cache, 1));
+    BOOST_CHECK(contains(cache, 2));
+    BOOST_CHECK(!cache.Get(blocks[1]->GetHash()));
+
+    // The memory bound evicts blocks before the count bound does
+    RecentBlockMsgsCache small_cache{4, 2 * entry_usage + entry_usage / 2};
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        add(small_cache, blocks[i]);
+        BOOST_CHECK(small_cache.DynamicMemoryUsage() <=
+                    2 * entry_usage + entry_usage / 2);
+    }
+    BOOST_CHECK_EQUAL(small_cache.Size(), 2U);
+    BOOST_CHECK(contains(small_cache, 2));
+    BOOST_CHECK(contains(small_cache, 3));
+
+    // The last block is kept even if it exceeds the bound on its own
+    RecentBlockMsgsCache tiny_cache{4, 1};
+    add(tiny_cache, blocks[0]);
+    add(tiny_cache, blocks[1]);
+    BOOST_CHECK_EQUAL(tiny_cache.Size(), 1U);
+    BOOST_CHECK(contains(tiny_cache, 1));
+    BOOST_CHECK_EQUAL(tiny_cache.DynamicMemoryUsage(), entry_usage);
+}
+
 BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest) {
     BlockTransactionsRequest req1;
     req1.blockhash = BlockHash(InsecureRand256());
@@ -3,6 +3,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chainparams.h>
+#include <clientversion.h>
+#include <flatfile.h>
 #include <node/blockstorage.h>
 #include <node/context.h>
 #include <validation.h>
@@ -103,4 +105,39 @@ BOOST_FIXTURE_TEST_CASE(blockmanager_scan_unlink_already_pruned_files,
     BOOST_CHECK(!AutoFile(blockman.OpenBlockFile(new_pos, true)).IsNull());
 }
 
+BOOST_FIXTURE_TEST_CASE(blockmanager_read_raw_block, TestChain100Setup) {
+    const auto &chainman = Assert(m_node.chainman);
+    auto &blockman = chainman->m_blockman;
+    const CBlockIndex *tip{
+        WITH_LOCK(chainman->GetMutex(), return chainman->ActiveChain().Tip())};
+
+    // The raw bytes are exactly the serialization of the stored block
+    CBlock block;
+    BOOST_REQUIRE(blockman.ReadBlockFromDisk(block, *tip));
+    const auto raw_block{blockman.ReadRawBlockFromDisk(*tip)};
+    BOOST_REQUIRE(raw_block);
+    std::vector<uint8_t> expected;
+    CVectorWriter{SER_DISK, CLIENT_VERSION, expected, 0, block};
+    BOOST_CHECK(Span<const uint8_t>{expected} == raw_block->Data());
+
+    // Serving it again reuses the mapping of the block file
+    const auto raw_block_again{blockman.ReadRawBlockFromDisk(*tip)};
+    BOOST_REQUIRE(raw_block_again);
+    if (raw_block->IsMapped()) {
+        BOOST_CHECK(raw_block_again->Data().data() ==
+                    raw_block->Data().data());
+    }
+
+    // An index whose position holds another block is rejected
+    CBlockIndex bad_index;
+    {
+        LOCK(chainman->GetMutex());
+        bad_index.phashBlock = tip->phashBlock;
+        bad_index.nStatus = tip->pprev->nStatus;
+        bad_index.nFile = tip->pprev->nFile;
+        bad_index.nDataPos = tip->pprev->nDataPos;
+    }
+    BOOST_CHECK(!blockman.ReadRawBlockFromDisk(bad_index));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
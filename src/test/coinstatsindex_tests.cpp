@@ -5,6 +5,8 @@
 #include <chainparams.h>
 #include <config.h>
 #include <index/coinstatsindex.h>
+#include <kernel/coinstats.h>
+#include <node/utxo_snapshot.h>
 #include <test/util/setup_common.h>
 #include <test/util/validation.h>
 #include <util/time.h>
@@ -13,9 +15,15 @@
 #include <boost/test/unit_test.hpp>
 
 #include <chrono>
+#include <optional>
+#include <utility>
+#include <vector>
 
 using kernel::CCoinsStats;
 using kernel::CoinStatsHashType;
+using kernel::ComputeUTXOStats;
+using kernel::UTXOStatsBuilder;
+using node::SnapshotStatsWorker;
 
 BOOST_AUTO_TEST_SUITE(coinstatsindex_tests)
 
@@ -138,4 +146,69 @@ BOOST_FIXTURE_TEST_CASE(coinstatsindex_unclean_shutdown, TestChain100Setup) {
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(utxo_stats_streaming, TestChain100Setup) {
+    Chainstate &chainstate = Assert(m_node.chainman)->ActiveChainstate();
+
+    std::vector<std::pair<COutPoint, Coin>> coins;
+    BlockHash best_block;
+    {
+        LOCK(cs_main);
+        chainstate.ForceFlushStateToDisk();
+        best_block = chainstate.CoinsDB().GetBestBlock();
+        std::unique_ptr<CCoinsViewCursor> cursor{chainstate.CoinsDB().Cursor()};
+        for (; cursor->Valid(); cursor->Next()) {
+            COutPoint outpoint;
+            Coin coin;
+            BOOST_REQUIRE(cursor->GetKey(outpoint) && cursor->GetValue(coin));
+            coins.emplace_back(outpoint, std::move(coin));
+        }
+    }
+    BOOST_REQUIRE(coins.size() > 2);
+
+    const std::optional<CCoinsStats> db_stats{
+        ComputeUTXOStats(CoinStatsHashType::HASH_SERIALIZED,
+                         &chainstate.CoinsDB(), m_node.chainman->m_blockman,
+                         [] {})};
+    BOOST_REQUIRE(db_stats);
+    BOOST_CHECK_EQUAL(db_stats->coins_count, coins.size());
+
+    // Hashing the coins as a stream, in small batches on the background
+    // worker, gives the same result as scanning the database.
+    {
+        SnapshotStatsWorker worker{db_stats->nHeight, best_block};
+        for (const auto &coin : coins) {
+            worker.Push({coin});
+        }
+        const std::optional<CCoinsStats> stream_stats{worker.Finish()};
+        BOOST_REQUIRE(stream_stats);
+        BOOST_CHECK_EQUAL(stream_stats->hashSerialized,
+                          db_stats->hashSerialized);
+        BOOST_CHECK_EQUAL(stream_stats->coins_count, db_stats->coins_count);
+        BOOST_CHECK_EQUAL(stream_stats->nTransactionOutputs,
+                          db_stats->nTransactionOutputs);
+        BOOST_CHECK(stream_stats->nTotalAmount == db_stats->nTotalAmount);
+    }
+
+    // Coins out of database order are rejected.
+    {
+        UTXOStatsBuilder builder{CoinStatsHashType::HASH_SERIALIZED,
+                                 db_stats->nHeight, best_block};
+        BOOST_CHECK(builder.Add(coins[1].first, coins[1].second));
+        BOOST_CHECK(!builder.Add(coins[0].first, coins[0].second));
+    }
+    {
+        SnapshotStatsWorker worker{db_stats->nHeight, best_block};
+        worker.Push({coins[1], coins[0], coins[2]});
+        BOOST_CHECK(!worker.Finish());
+    }
+
+    // Duplicated coins are rejected.
+    {
+        UTXOStatsBuilder builder{CoinStatsHashType::HASH_SERIALIZED,
+                                 db_stats->nHeight, best_block};
+        BOOST_CHECK(builder.Add(coins[0].first, coins[0].second));
+        BOOST_CHECK(!builder.Add(coins[0].first, coins[0].second));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -125,4 +125,78 @@ BOOST_AUTO_TEST_CASE(flatfile_flush) {
     BOOST_CHECK_EQUAL(fs::file_size(seq.FileName(FlatFilePos(0, 1))), 1U);
 }
 
+BOOST_AUTO_TEST_CASE(flatfile_region) {
+    const auto data_dir = m_args.GetDataDirBase();
+    FlatFileSeq seq(data_dir, "c", 100);
+
+    std::vector<uint8_t> data(10000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = uint8_t(i * 7);
+    }
+    {
+        AutoFile file{seq.Open(FlatFilePos(0, 0))};
+        file << Span<const uint8_t>{data};
+    }
+
+    AutoFile file{seq.Open(FlatFilePos(0, 0), true)};
+
+    // Ranges not aligned to a page are viewed at the right offset
+    for (const size_t offset : {0, 1, 4095, 4096, 5000}) {
+        const size_t size = data.size() - offset;
+        FlatFileRegion region(file.Get(), offset, size);
+        BOOST_CHECK(region.Data() ==
+                    Span<const uint8_t>{data}.subspan(offset, size));
+    }
+
+    // The view outlives the file handle
+    auto region = std::make_unique<FlatFileRegion>(file.Get(), 10, 20);
+    file.fclose();
+    BOOST_CHECK(region->Data() == Span<const uint8_t>{data}.subspan(10, 20));
+
+    // Ranges past the end of the file cannot be read
+    AutoFile file2{seq.Open(FlatFilePos(0, 0), true)};
+    BOOST_CHECK_THROW(FlatFileRegion(file2.Get(), 9990, 20),
+                      std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(flatfile_mapping) {
+    const auto data_dir = m_args.GetDataDirBase();
+    FlatFileSeq seq(data_dir, "d", 100);
+
+    std::vector<uint8_t> data(10000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = uint8_t(i * 7);
+    }
+    {
+        AutoFile file{seq.Open(FlatFilePos(0, 0))};
+        file << Span<const uint8_t>{data};
+    }
+
+    AutoFile file{seq.Open(FlatFilePos(0, 0), true)};
+    std::shared_ptr<const FlatFileMapping> mapping;
+    try {
+        mapping = std::make_shared<const FlatFileMapping>(file.Get());
+    } catch (const std::ios_base::failure &) {
+        // No mmap on this platform
+        return;
+    }
+    file.fclose();
+    BOOST_CHECK(mapping->Data() == Span<const uint8_t>{data});
+
+    // Regions are views within the mapping, which they keep alive
+    auto region = std::make_unique<FlatFileRegion>(mapping, 4095, 20);
+    BOOST_CHECK(region->IsMapped());
+    BOOST_CHECK(region->Data().data() == mapping->Data().data() + 4095);
+    mapping.reset();
+    BOOST_CHECK(region->Data() == Span<const uint8_t>{data}.subspan(4095, 20));
+
+    // Ranges past the end of the mapping cannot be viewed
+    AutoFile file2{seq.Open(FlatFilePos(0, 0), true)};
+    mapping = std::make_shared<const FlatFileMapping>(file2.Get());
+    BOOST_CHECK_THROW(FlatFileRegion(mapping, 9990, 20),
+                      std::ios_base::failure);
+    BOOST_CHECK_THROW(FlatFileRegion(mapping, 10001, 0),
+                      std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
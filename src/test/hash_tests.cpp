@@ -157,6 +157,22 @@ BOOST_AUTO_TEST_CASE(siphash) {
         BOOST_CHECK_EQUAL(SipHashUint256(k1, k2, x), sip256.Finalize());
         BOOST_CHECK_EQUAL(SipHashUint256Extra(k1, k2, x, n), sip288.Finalize());
     }
+
+    // Check consistency between SipHashUint256 and SipHashUint256Batch, with
+    // counts that do and do not fill whole SIMD batches.
+    for (size_t count : {0, 1, 3, 4, 5, 8, 17}) {
+        uint64_t k1 = ctx.rand64();
+        uint64_t k2 = ctx.rand64();
+        std::vector<uint256> vals(count);
+        for (uint256 &val : vals) {
+            val = InsecureRand256();
+        }
+        std::vector<uint64_t> out(count);
+        SipHashUint256Batch(k1, k2, vals.data(), count, out.data());
+        for (size_t i = 0; i < count; ++i) {
+            BOOST_CHECK_EQUAL(out[i], SipHashUint256(k1, k2, vals[i]));
+        }
+    }
 }
 
 namespace {
@@ -0,0 +1,122 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <iblt.h>
+
+#include <streams.h>
+#include <version.h>
+
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(iblt_tests, BasicTestingSetup)
+
+static uint32_t TestKey(uint32_t i) {
+    return i * 0x9e3779b9U + 1;
+}
+
+BOOST_AUTO_TEST_CASE(iblt_empty) {
+    IBLT table{10};
+    // Rounded up to a multiple of the number of hashes.
+    BOOST_CHECK_EQUAL(table.Size(), 12);
+
+    std::vector<uint32_t> positive, negative;
+    BOOST_CHECK(table.Decode(positive, negative));
+    BOOST_CHECK(positive.empty());
+    BOOST_CHECK(negative.empty());
+
+    // A key inserted in both tables cancels out.
+    IBLT other{10};
+    table.Insert(42);
+    other.Insert(42);
+    table -= other;
+    BOOST_CHECK(table.Decode(positive, negative));
+    BOOST_CHECK(positive.empty());
+    BOOST_CHECK(negative.empty());
+}
+
+BOOST_AUTO_TEST_CASE(iblt_difference) {
+    IBLT a{120};
+    IBLT b{120};
+
+    // 1000 keys in common, 20 only in a and 15 only in b.
+    for (uint32_t i = 0; i < 1000; ++i) {
+        a.Insert(TestKey(i));
+        b.Insert(TestKey(i));
+    }
+    std::vector<uint32_t> a_only, b_only;
+    for (uint32_t i = 1000; i < 1020; ++i) {
+        a.Insert(TestKey(i));
+        a_only.push_back(TestKey(i));
+    }
+    for (uint32_t i = 2000; i < 2015; ++i) {
+        b.Insert(TestKey(i));
+        b_only.push_back(TestKey(i));
+    }
+
+    // The sets themselves are far too large to be decoded.
+    std::vector<uint32_t> positive, negative;
+    BOOST_CHECK(!a.Decode(positive, negative));
+
+    a -= b;
+    positive.clear();
+    negative.clear();
+    BOOST_CHECK(a.Decode(positive, negative));
+
+    std::sort(positive.begin(), positive.end());
+    std::sort(negative.begin(), negative.end());
+    std::sort(a_only.begin(), a_only.end());
+    std::sort(b_only.begin(), b_only.end());
+    BOOST_CHECK(positive == a_only);
+    BOOST_CHECK(negative == b_only);
+}
+
+BOOST_AUTO_TEST_CASE(iblt_serialization) {
+    IBLT table{30};
+    for (uint32_t i = 0; i < 8; ++i) {
+        table.Insert(TestKey(i));
+    }
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << table;
+    // Compact size followed by 9 bytes per cell.
+    BOOST_CHECK_EQUAL(stream.size(), 1 + 30 * 9);
+
+    IBLT decoded;
+    stream >> decoded;
+    BOOST_CHECK_EQUAL(decoded.Size(), table.Size());
+
+    std::vector<uint32_t> positive, negative;
+    BOOST_CHECK(decoded.Decode(positive, negative));
+    BOOST_CHECK_EQUAL(positive.size(), 8);
+    BOOST_CHECK(negative.empty());
+}
+
+BOOST_AUTO_TEST_CASE(iblt_corrupted) {
+    IBLT table{30};
+    for (uint32_t i = 0; i < 5; ++i) {
+        table.Insert(TestKey(i));
+    }
+
+    // Flip a checksum bit of a non empty cell, so it can no longer be peeled.
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << table;
+    for (size_t i = 1; i < stream.size(); i += 9) {
+        if (stream[i] != std::byte{0}) {
+            stream[i + 5] ^= std::byte{1};
+            break;
+        }
+    }
+    IBLT corrupted;
+    stream >> corrupted;
+
+    std::vector<uint32_t> positive, negative;
+    BOOST_CHECK(!corrupted.Decode(positive, negative));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
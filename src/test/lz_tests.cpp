@@ -0,0 +1,112 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <util/lz.h>
+
+#include <test/util/random.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(lz_tests, BasicTestingSetup)
+
+static bool RoundTrip(const std::vector<uint8_t> &data,
+                      size_t &compressed_size) {
+    std::vector<uint8_t> compressed;
+    LZCompress(data, compressed);
+    compressed_size = compressed.size();
+
+    std::vector<uint8_t> decompressed(data.size());
+    if (!LZDecompress(compressed, decompressed) || decompressed != data) {
+        return false;
+    }
+
+    // The exact size is required.
+    std::vector<uint8_t> too_large(data.size() + 1);
+    if (LZDecompress(compressed, too_large)) {
+        return false;
+    }
+    if (!data.empty()) {
+        std::vector<uint8_t> too_small(data.size() - 1);
+        if (LZDecompress(compressed, too_small)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(lz_roundtrip) {
+    size_t compressed_size;
+
+    // Inputs too short to contain any match. From 15 literals on, the token
+    // is followed by a length extension byte.
+    for (size_t size = 0; size < 20; ++size) {
+        BOOST_CHECK(
+            RoundTrip(g_insecure_rand_ctx.randbytes(size), compressed_size));
+        BOOST_CHECK_EQUAL(compressed_size, size + (size < 15 ? 1 : 2));
+    }
+
+    // Random data does not compress, and only grows by a few bytes.
+    BOOST_CHECK(
+        RoundTrip(g_insecure_rand_ctx.randbytes(100000), compressed_size));
+    BOOST_CHECK(compressed_size <= 100000 + 100000 / 255 + 16);
+
+    // Long runs exercise the overlapping matches and the length extensions.
+    const std::vector<uint8_t> zeros(100000, 0);
+    BOOST_CHECK(RoundTrip(zeros, compressed_size));
+    BOOST_CHECK(compressed_size < 1000);
+
+    // Repeated chunks of random data, like the scripts of similar outputs.
+    const std::vector<uint8_t> chunk = g_insecure_rand_ctx.randbytes(40);
+    std::vector<uint8_t> repeated;
+    for (size_t i = 0; i < 1000; ++i) {
+        const std::vector<uint8_t> noise = g_insecure_rand_ctx.randbytes(32);
+        repeated.insert(repeated.end(), noise.begin(), noise.end());
+        repeated.insert(repeated.end(), chunk.begin(), chunk.end());
+    }
+    BOOST_CHECK(RoundTrip(repeated, compressed_size));
+    BOOST_CHECK(compressed_size < repeated.size() * 3 / 4);
+}
+
+BOOST_AUTO_TEST_CASE(lz_malformed) {
+    std::vector<uint8_t> output(16);
+
+    // Empty input.
+    BOOST_CHECK(!LZDecompress({}, output));
+    // Literals running past the end of the input.
+    BOOST_CHECK(!LZDecompress(std::vector<uint8_t>{0x50, 1, 2}, output));
+    // Truncated length extension.
+    BOOST_CHECK(!LZDecompress(std::vector<uint8_t>{0xf0, 255}, output));
+    // Truncated offset.
+    BOOST_CHECK(!LZDecompress(std::vector<uint8_t>{0x10, 1, 1}, output));
+    // Match referring to data before the start of the output.
+    BOOST_CHECK(!LZDecompress(std::vector<uint8_t>{0x10, 1, 2, 0, 0x00},
+                              output));
+    // Zero offset.
+    BOOST_CHECK(!LZDecompress(std::vector<uint8_t>{0x10, 1, 0, 0, 0x00},
+                              output));
+
+    // A match of 4 bytes after a literal, then 11 literals.
+    const std::vector<uint8_t> valid{0x10, 7,  1,  0,  0xb0, 1, 2, 3,
+                                     4,    5,  6,  7,  8,    9, 10, 11};
+    BOOST_CHECK(LZDecompress(valid, output));
+    BOOST_CHECK_EQUAL(output[4], 7);
+    BOOST_CHECK_EQUAL(output[15], 11);
+
+    // A match running past the end of the output.
+    std::vector<uint8_t> small_output(4);
+    BOOST_CHECK(!LZDecompress(valid, small_output));
+
+    // Garbage never decompresses out of bounds.
+    for (size_t i = 0; i < 1000; ++i) {
+        const std::vector<uint8_t> garbage =
+            g_insecure_rand_ctx.randbytes(InsecureRandRange(64));
+        std::vector<uint8_t> garbage_output(InsecureRandRange(256));
+        LZDecompress(garbage, garbage_output);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
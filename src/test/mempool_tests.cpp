@@ -7,15 +7,18 @@
 #include <common/system.h>
 #include <kernel/disconnected_transactions.h>
 #include <kernel/mempool_entry.h>
+#include <kernel/mempool_persist.h>
 #include <policy/settings.h>
 #include <reverse_iterator.h>
 #include <util/time.h>
+#include <validation.h>
 
 #include <test/util/setup_common.h>
 
 #include <boost/test/unit_test.hpp>
 
 #include <algorithm>
+#include <thread>
 #include <vector>
 
 BOOST_FIXTURE_TEST_SUITE(mempool_tests, TestingSetup)
@@ -107,6 +110,158 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest) {
     BOOST_CHECK_EQUAL(testPool.size(), 0UL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolDiamondTest) {
+    // A parent with two children, both spent by the same grandchild: the
+    // traversals must visit every entry exactly once.
+    TestMemPoolEntryHelper entry;
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vin[0].scriptSig = CScript() << OP_11;
+    txParent.vout.resize(2);
+    for (int i = 0; i < 2; i++) {
+        txParent.vout[i].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txParent.vout[i].nValue = 33000 * SATOSHI;
+    }
+    CMutableTransaction txChild[2];
+    for (int i = 0; i < 2; i++) {
+        txChild[i].vin.resize(1);
+        txChild[i].vin[0].scriptSig = CScript() << OP_11;
+        txChild[i].vin[0].prevout = COutPoint(txParent.GetId(), i);
+        txChild[i].vout.resize(1);
+        txChild[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txChild[i].vout[0].nValue = 11000 * SATOSHI;
+    }
+    CMutableTransaction txGrandChild;
+    txGrandChild.vin.resize(2);
+    for (int i = 0; i < 2; i++) {
+        txGrandChild.vin[i].scriptSig = CScript() << OP_11;
+        txGrandChild.vin[i].prevout = COutPoint(txChild[i].GetId(), 0);
+    }
+    txGrandChild.vout.resize(1);
+    txGrandChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txGrandChild.vout[0].nValue = 11000 * SATOSHI;
+
+    CTxMemPool &testPool = *Assert(m_node.mempool);
+    LOCK2(::cs_main, testPool.cs);
+
+    testPool.addUnchecked(entry.FromTx(txParent));
+    for (int i = 0; i < 2; i++) {
+        testPool.addUnchecked(entry.FromTx(txChild[i]));
+    }
+    testPool.addUnchecked(entry.FromTx(txGrandChild));
+    BOOST_CHECK_EQUAL(testPool.size(), 4UL);
+
+    auto grandChildIt = *testPool.GetIter(txGrandChild.GetId());
+    const auto &parents = (*grandChildIt)->GetMemPoolParentsConst();
+    BOOST_CHECK_EQUAL(parents.size(), 2UL);
+    BOOST_CHECK(std::is_sorted(parents.begin(), parents.end(),
+                               CompareIteratorById()));
+
+    CTxMemPool::setEntries ancestors;
+    BOOST_CHECK(testPool.CalculateMemPoolAncestors(*grandChildIt, ancestors,
+                                                   false));
+    BOOST_CHECK_EQUAL(ancestors.size(), 3UL);
+
+    std::vector<CTxMemPool::txiter> descendants;
+    testPool.CalculateDescendants({*testPool.GetIter(txParent.GetId())},
+                                  descendants);
+    BOOST_CHECK_EQUAL(descendants.size(), 4UL);
+
+    // Removing a child takes the grandchild along and unlinks it from the
+    // other child.
+    testPool.removeRecursive(CTransaction(txChild[0]), REMOVAL_REASON_DUMMY);
+    BOOST_CHECK_EQUAL(testPool.size(), 2UL);
+    auto childIt = *testPool.GetIter(txChild[1].GetId());
+    BOOST_CHECK((*childIt)->GetMemPoolChildrenConst().empty());
+
+    testPool.removeRecursive(CTransaction(txParent), REMOVAL_REASON_DUMMY);
+    BOOST_CHECK_EQUAL(testPool.size(), 0UL);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolRemoveForBlockTest) {
+    TestMemPoolEntryHelper entry;
+    auto makeTx = [](const std::vector<COutPoint> &prevouts) {
+        CMutableTransaction tx;
+        for (const COutPoint &prevout : prevouts) {
+            tx.vin.emplace_back(prevout);
+            tx.vin.back().scriptSig = CScript() << OP_11;
+        }
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = 10000 * SATOSHI;
+        return tx;
+    };
+
+    const TxId fundingId{uint256S("0x01")};
+    // txA is in the mempool and gets mined, its child stays.
+    const CMutableTransaction txA = makeTx({COutPoint(fundingId, 0)});
+    const CMutableTransaction txAChild = makeTx({COutPoint(txA.GetId(), 0)});
+    // txB is mined without having been in the mempool. It double spends
+    // txConflict1 and txConflict2, which share a descendant.
+    const CMutableTransaction txB =
+        makeTx({COutPoint(fundingId, 1), COutPoint(fundingId, 2)});
+    const CMutableTransaction txConflict1 = makeTx({COutPoint(fundingId, 1)});
+    const CMutableTransaction txConflict2 = makeTx({COutPoint(fundingId, 2)});
+    const CMutableTransaction txConflictChild = makeTx(
+        {COutPoint(txConflict1.GetId(), 0), COutPoint(txConflict2.GetId(), 0)});
+
+    CTxMemPool &testPool = *Assert(m_node.mempool);
+    LOCK2(::cs_main, testPool.cs);
+    for (const CMutableTransaction &tx :
+         {txA, txAChild, txConflict1, txConflict2, txConflictChild}) {
+        testPool.addUnchecked(entry.FromTx(tx));
+    }
+    BOOST_CHECK_EQUAL(testPool.size(), 5UL);
+
+    DisconnectedBlockTransactions disconnectpool;
+    disconnectpool.removeForBlock(
+        {MakeTransactionRef(txA), MakeTransactionRef(txB)}, testPool);
+
+    BOOST_CHECK_EQUAL(testPool.size(), 1UL);
+    BOOST_CHECK(testPool.exists(txAChild.GetId()));
+    auto childIt = *testPool.GetIter(txAChild.GetId());
+    BOOST_CHECK((*childIt)->GetMemPoolParentsConst().empty());
+    BOOST_CHECK(disconnectpool.isEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(MempoolExpiryTest) {
+    TestMemPoolEntryHelper entry;
+    auto makeTx = [](const COutPoint &prevout) {
+        CMutableTransaction tx;
+        tx.vin.emplace_back(prevout);
+        tx.vin[0].scriptSig = CScript() << OP_11;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = 10000 * SATOSHI;
+        return tx;
+    };
+
+    const TxId fundingId{uint256S("0x01")};
+    const CMutableTransaction txOld1 = makeTx(COutPoint(fundingId, 0));
+    const CMutableTransaction txOld2 = makeTx(COutPoint(fundingId, 1));
+    const CMutableTransaction txMid = makeTx(COutPoint(fundingId, 2));
+    // A recent child of an old transaction expires with its parent
+    const CMutableTransaction txChild = makeTx(COutPoint(txOld1.GetId(), 0));
+
+    CTxMemPool &testPool = *Assert(m_node.mempool);
+    LOCK2(::cs_main, testPool.cs);
+    testPool.addUnchecked(entry.Time(100).FromTx(txOld1));
+    testPool.addUnchecked(entry.Time(200).FromTx(txMid));
+    // Out of time order, as happens when the mempool is reloaded
+    testPool.addUnchecked(entry.Time(100).FromTx(txOld2));
+    testPool.addUnchecked(entry.Time(300).FromTx(txChild));
+    BOOST_CHECK_EQUAL(testPool.size(), 4UL);
+
+    BOOST_CHECK_EQUAL(testPool.Expire(std::chrono::seconds{100}), 0);
+    BOOST_CHECK_EQUAL(testPool.Expire(std::chrono::seconds{150}), 3);
+    BOOST_CHECK_EQUAL(testPool.size(), 1UL);
+    BOOST_CHECK(testPool.exists(txMid.GetId()));
+
+    BOOST_CHECK_EQUAL(testPool.Expire(std::chrono::seconds{200}), 0);
+    BOOST_CHECK_EQUAL(testPool.Expire(std::chrono::seconds{201}), 1);
+    BOOST_CHECK_EQUAL(testPool.size(), 0UL);
+}
+
 BOOST_AUTO_TEST_CASE(MempoolClearTest) {
     // Test CTxMemPool::clear functionality
 
@@ -141,6 +296,85 @@ BOOST_AUTO_TEST_CASE(MempoolClearTest) {
     BOOST_CHECK_EQUAL(testPool.mapNextTx.size(), 0UL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolLockFreeLookupTest) {
+    TestMemPoolEntryHelper entry;
+    CTxMemPool &testPool = *Assert(m_node.mempool);
+
+    std::vector<CTransactionRef> txs;
+    for (int i = 0; i < 10; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].scriptSig = CScript() << i;
+        mtx.vout.resize(1);
+        mtx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        mtx.vout[0].nValue = 10000 * SATOSHI;
+        txs.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+
+    auto countTxs = [&]() {
+        std::vector<CTransactionRef> visited;
+        size_t found = 0;
+        testPool.forEachTx([&](const CTransactionRef &tx) {
+            visited.push_back(tx);
+            // Lookups are allowed from within the walk.
+            found += testPool.exists(tx->GetId()) &&
+                     testPool.get(tx->GetId()) == tx;
+            return true;
+        });
+        BOOST_CHECK_EQUAL(found, visited.size());
+        return visited.size();
+    };
+
+    {
+        LOCK2(cs_main, testPool.cs);
+        for (const auto &tx : txs) {
+            testPool.addUnchecked(entry.FromTx(tx));
+        }
+    }
+
+    // Lookups don't need the mempool lock, even while another thread owns it.
+    {
+        LOCK(testPool.cs);
+        // Boost checks are not thread safe, collect the results instead.
+        size_t found = 0;
+        size_t visited = 0;
+        std::thread reader([&]() {
+            for (const auto &tx : txs) {
+                found += testPool.exists(tx->GetId()) &&
+                         testPool.get(tx->GetId()) == tx;
+            }
+            testPool.forEachTx([&](const CTransactionRef &) {
+                visited++;
+                return true;
+            });
+        });
+        reader.join();
+        BOOST_CHECK_EQUAL(found, txs.size());
+        BOOST_CHECK_EQUAL(visited, txs.size());
+    }
+
+    // Stopping early.
+    size_t visited = 0;
+    BOOST_CHECK(!testPool.forEachTx([&](const CTransactionRef &tx) {
+        return ++visited < 3;
+    }));
+    BOOST_CHECK_EQUAL(visited, 3);
+
+    {
+        LOCK2(cs_main, testPool.cs);
+        testPool.removeRecursive(*txs[0], REMOVAL_REASON_DUMMY);
+    }
+    BOOST_CHECK(!testPool.exists(txs[0]->GetId()));
+    BOOST_CHECK(testPool.get(txs[0]->GetId()) == nullptr);
+    BOOST_CHECK_EQUAL(countTxs(), txs.size() - 1);
+
+    testPool.clear();
+    BOOST_CHECK_EQUAL(countTxs(), 0);
+    for (const auto &tx : txs) {
+        BOOST_CHECK(!testPool.exists(tx->GetId()));
+    }
+}
+
 template <typename name>
 static void CheckSort(CTxMemPool &pool, std::vector<std::string> &sortedOrder,
                       const std::string &testcase)
@@ -634,4 +868,40 @@ BOOST_AUTO_TEST_CASE(remove_for_finalized_block) {
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(dump_load_mempool_chains, TestChain100Setup) {
+    CTxMemPool &pool = *Assert(m_node.mempool);
+    const CScript script = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+    // Chains of transactions, so that batches contain children of
+    // transactions from the same batch as well as from the previous ones.
+    std::vector<TxId> txids;
+    for (int i = 0; i < 3; i++) {
+        CTransactionRef parent = m_coinbase_txns[i];
+        int height = i + 1;
+        Amount amount = 49 * COIN;
+        for (int j = 0; j < 10; j++) {
+            parent = MakeTransactionRef(CreateValidMempoolTransaction(
+                parent, 0, height, coinbaseKey, script, amount));
+            txids.push_back(parent->GetId());
+            height = MEMPOOL_HEIGHT;
+            amount -= COIN / 100;
+        }
+    }
+    BOOST_CHECK_EQUAL(pool.size(), txids.size());
+
+    const fs::path path = m_args.GetDataDirNet() / "mempool_chains.dat";
+    BOOST_CHECK(kernel::DumpMempool(pool, path, fsbridge::fopen,
+                                    /*skip_file_commit=*/true));
+
+    pool.clear();
+    BOOST_CHECK_EQUAL(pool.size(), 0);
+
+    BOOST_CHECK(kernel::LoadMempool(pool, path,
+                                    m_node.chainman->ActiveChainstate()));
+    BOOST_CHECK_EQUAL(pool.size(), txids.size());
+    for (const TxId &txid : txids) {
+        BOOST_CHECK(pool.exists(txid));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
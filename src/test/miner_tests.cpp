@@ -831,6 +831,80 @@ BOOST_AUTO_TEST_CASE(BlockAssembler_construction) {
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(CreateNewBlock_no_validity_test, TestChain100Setup) {
+    const CScript scriptPubKey = CScript() << OP_TRUE;
+    const CTransaction tx{CreateValidMempoolTransaction(
+        m_coinbase_txns[0], 0, 0, coinbaseKey, scriptPubKey, 49 * COIN)};
+
+    // Skipping TestBlockValidity doesn't change the template.
+    BlockAssembler::Options options;
+    const std::unique_ptr<CBlockTemplate> validated{
+        BlockAssembler{m_node.chainman->ActiveChainstate(),
+                       m_node.mempool.get(), options}
+            .CreateNewBlock(scriptPubKey)};
+    options.test_block_validity = false;
+    const std::unique_ptr<CBlockTemplate> unvalidated{
+        BlockAssembler{m_node.chainman->ActiveChainstate(),
+                       m_node.mempool.get(), options}
+            .CreateNewBlock(scriptPubKey)};
+    BOOST_REQUIRE(validated && unvalidated);
+    BOOST_REQUIRE_EQUAL(unvalidated->block.vtx.size(), 2UL);
+    BOOST_CHECK(unvalidated->block.vtx[1]->GetId() == tx.GetId());
+    BOOST_CHECK(unvalidated->block.vtx[0]->GetId() ==
+                validated->block.vtx[0]->GetId());
+}
+
+BOOST_FIXTURE_TEST_CASE(CreateNewBlock_finalized_first, TestChain100Setup) {
+    const CScript scriptPubKey = CScript() << OP_TRUE;
+    const CScript outputScript = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+    // A low fee and a high fee transaction of about the same size.
+    const CTransaction lowFeeTx{CreateValidMempoolTransaction(
+        m_coinbase_txns[0], 0, 0, coinbaseKey, outputScript, 49 * COIN)};
+    const CTransaction highFeeTx{CreateValidMempoolTransaction(
+        m_coinbase_txns[1], 0, 0, coinbaseKey, outputScript, COIN)};
+
+    // Only leave room for one of them.
+    BlockAssembler::Options options;
+    options.nMaxGeneratedBlockSize =
+        1000 + std::max(lowFeeTx.GetTotalSize(), highFeeTx.GetTotalSize()) + 1;
+    auto createNewBlock = [&]() {
+        return BlockAssembler{m_node.chainman->ActiveChainstate(),
+                              m_node.mempool.get(), options}
+            .CreateNewBlock(scriptPubKey);
+    };
+
+    std::unique_ptr<CBlockTemplate> pblocktemplate = createNewBlock();
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2UL);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->GetId() == highFeeTx.GetId());
+
+    // Once finalized, the low fee transaction takes precedence.
+    {
+        LOCK(m_node.mempool->cs);
+        auto it = m_node.mempool->GetIter(lowFeeTx.GetId());
+        BOOST_REQUIRE(it.has_value());
+        BOOST_CHECK(m_node.mempool->setAvalancheFinalized(**it));
+
+        const auto &finalized = m_node.mempool->GetFinalizedTxsSorted();
+        BOOST_CHECK_EQUAL(finalized.size(), 1UL);
+        BOOST_CHECK(finalized[0]->GetTx().GetId() == lowFeeTx.GetId());
+    }
+    pblocktemplate = createNewBlock();
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2UL);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->GetId() == lowFeeTx.GetId());
+
+    // Removing the finalized transaction updates the cached list.
+    {
+        LOCK(m_node.mempool->cs);
+        m_node.mempool->removeRecursive(lowFeeTx,
+                                        MemPoolRemovalReason::CONFLICT);
+        BOOST_CHECK(m_node.mempool->GetFinalizedTxsSorted().empty());
+    }
+    pblocktemplate = createNewBlock();
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 2UL);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->GetId() == highFeeTx.GetId());
+}
+
 BOOST_AUTO_TEST_CASE(TestCBlockTemplateEntry) {
     const CTransaction tx;
     CTransactionRef txRef = MakeTransactionRef(tx);
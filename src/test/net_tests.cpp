@@ -12,6 +12,7 @@
 #include <clientversion.h>
 #include <compat.h>
 #include <config.h>
+#include <core_memusage.h>
 #include <net_processing.h>
 #include <netaddress.h>
 #include <netbase.h>
@@ -19,6 +20,8 @@
 #include <serialize.h>
 #include <span.h>
 #include <streams.h>
+#include <test/util/net.h>
+#include <test/util/random.h>
 #include <test/util/validation.h>
 #include <threadsafety.h>
 #include <timedata.h>
@@ -1392,4 +1395,320 @@ BOOST_AUTO_TEST_CASE(already_connected_to_address) {
     BOOST_CHECK(connman.AlreadyConnectedToAddress(ip1port2));
 }
 
+BOOST_AUTO_TEST_CASE(net_message_preparse) {
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(TxId(uint256::ONE), 0);
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = COIN;
+    const CTransactionRef tx = MakeTransactionRef(mtx);
+
+    CBlock block;
+    block.vtx.push_back(tx);
+
+    auto make_message = [](const std::string &type, const auto &payload) {
+        CDataStream stream{SER_NETWORK, PROTOCOL_VERSION};
+        stream << payload;
+        CNetMessage msg{std::move(stream)};
+        msg.m_type = type;
+        msg.m_valid_netmagic = true;
+        msg.m_valid_header = true;
+        msg.m_valid_checksum = true;
+        return msg;
+    };
+
+    CNetMessage tx_msg = make_message(NetMsgType::TX, tx);
+    const size_t tx_msg_size = tx_msg.m_recv.size();
+    tx_msg.Preparse();
+    BOOST_REQUIRE(tx_msg.m_tx);
+    BOOST_CHECK(tx_msg.m_tx->GetId() == tx->GetId());
+    // The raw payload is still available.
+    BOOST_CHECK_EQUAL(tx_msg.m_recv.size(), tx_msg_size);
+    BOOST_CHECK_EQUAL(tx_msg.m_parsed_usage,
+                      RecursiveDynamicUsage(tx_msg.m_tx));
+
+    CNetMessage block_msg = make_message(NetMsgType::BLOCK, block);
+    block_msg.Preparse();
+    BOOST_REQUIRE(block_msg.m_block);
+    BOOST_CHECK(block_msg.m_block->GetHash() == block.GetHash());
+    BOOST_REQUIRE_EQUAL(block_msg.m_block->vtx.size(), 1U);
+    BOOST_CHECK(block_msg.m_block->vtx[0]->GetId() == tx->GetId());
+    BOOST_CHECK(block_msg.m_parsed_usage > tx_msg.m_parsed_usage);
+
+    // Other message types are left alone.
+    CNetMessage ping_msg = make_message(NetMsgType::PING, uint64_t{42});
+    ping_msg.Preparse();
+    BOOST_CHECK(!ping_msg.m_tx && !ping_msg.m_block && !ping_msg.m_blocktxn);
+    BOOST_CHECK_EQUAL(ping_msg.m_parsed_usage, 0U);
+
+    // So are the invalid messages and the ones that fail to parse.
+    CNetMessage bad_checksum_msg = make_message(NetMsgType::TX, tx);
+    bad_checksum_msg.m_valid_checksum = false;
+    bad_checksum_msg.Preparse();
+    BOOST_CHECK(!bad_checksum_msg.m_tx);
+
+    CNetMessage truncated_msg = make_message(NetMsgType::TX, uint8_t{1});
+    truncated_msg.Preparse();
+    BOOST_CHECK(!truncated_msg.m_tx);
+}
+
+BOOST_AUTO_TEST_CASE(net_message_preparse_peer) {
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(TxId(uint256::ONE), 0);
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = COIN;
+    const CTransactionRef tx = MakeTransactionRef(mtx);
+
+    CBlock block;
+    block.vtx.push_back(tx);
+
+    const auto &connman = static_cast<ConnmanTestMsg &>(*m_node.connman);
+    const size_t flood_size{connman.GetReceiveFloodSize()};
+    CNode node{0,
+               /*sock=*/nullptr,
+               CAddress{},
+               /*nKeyedNetGroupIn=*/0,
+               /*nLocalHostNonceIn=*/0,
+               /*nLocalExtraEntropyIn=*/0,
+               CAddress{},
+               /*pszDest=*/"",
+               ConnectionType::OUTBOUND_FULL_RELAY,
+               /*inbound_onion=*/false};
+
+    const CNetMsgMaker msg_maker{INIT_PROTO_VERSION};
+    // Receive a message and check whether it got parsed by the network
+    // thread, and that the parsed payload is counted in the queue size.
+    auto receive = [&](const std::string &msg_type, const auto &payload) {
+        CSerializedNetMsg msg{msg_maker.Make(msg_type, payload)};
+        BOOST_CHECK(connman.ReceiveMsgFrom(node, msg));
+        const size_t queue_size{node.nProcessQueueSize};
+        auto result = node.PollMessage(flood_size);
+        BOOST_REQUIRE(result);
+        const CNetMessage &received{result->first};
+        BOOST_CHECK_EQUAL(queue_size, received.m_raw_message_size +
+                                          received.m_parsed_usage);
+        BOOST_CHECK_EQUAL(node.nProcessQueueSize, 0);
+        return received.m_tx || received.m_block;
+    };
+
+    // Nothing is parsed before the handshake completes.
+    node.m_preparse_txs = true;
+    node.m_preparse_blocks = true;
+    BOOST_CHECK(!receive(NetMsgType::TX, tx));
+    BOOST_CHECK(!receive(NetMsgType::BLOCK, block));
+
+    // Then only the message types the peer is allowed to send.
+    node.fSuccessfullyConnected = true;
+    node.m_preparse_txs = false;
+    node.m_preparse_blocks = false;
+    BOOST_CHECK(!receive(NetMsgType::TX, tx));
+    BOOST_CHECK(!receive(NetMsgType::BLOCK, block));
+
+    node.m_preparse_txs = true;
+    BOOST_CHECK(receive(NetMsgType::TX, tx));
+    BOOST_CHECK(!receive(NetMsgType::BLOCK, block));
+
+    node.m_preparse_txs = false;
+    node.m_preparse_blocks = true;
+    BOOST_CHECK(!receive(NetMsgType::TX, tx));
+    BOOST_CHECK(receive(NetMsgType::BLOCK, block));
+}
+
+BOOST_AUTO_TEST_CASE(net_message_priority) {
+    BOOST_CHECK(GetMessagePriority(NetMsgType::CMPCTBLOCK) ==
+                MsgPriority::BLOCK);
+    BOOST_CHECK(GetMessagePriority(NetMsgType::AVAPOLL) ==
+                MsgPriority::AVALANCHE);
+    BOOST_CHECK(GetMessagePriority(NetMsgType::TX) == MsgPriority::DEFAULT);
+    BOOST_CHECK(GetMessagePriority(NetMsgType::PING) == MsgPriority::DEFAULT);
+    BOOST_CHECK(GetMessagePriority(NetMsgType::ADDRV2) == MsgPriority::ADDR);
+
+    const auto &connman = static_cast<ConnmanTestMsg &>(*m_node.connman);
+    const size_t flood_size{connman.GetReceiveFloodSize()};
+    CNode node{0,
+               /*sock=*/nullptr,
+               CAddress{},
+               /*nKeyedNetGroupIn=*/0,
+               /*nLocalHostNonceIn=*/0,
+               /*nLocalExtraEntropyIn=*/0,
+               CAddress{},
+               /*pszDest=*/"",
+               ConnectionType::OUTBOUND_FULL_RELAY,
+               /*inbound_onion=*/false};
+
+    const CNetMsgMaker msg_maker{INIT_PROTO_VERSION};
+    auto receive = [&](const std::string &msg_type) {
+        CSerializedNetMsg msg{msg_maker.Make(msg_type)};
+        // The message has no payload, so it is already complete once its
+        // header is received and the returned value is meaningless.
+        (void)connman.ReceiveMsgFrom(node, msg);
+    };
+    auto poll_all = [&]() {
+        std::vector<std::string> msg_types;
+        while (auto result = node.PollMessage(flood_size)) {
+            msg_types.push_back(result->first.m_type);
+            BOOST_CHECK_EQUAL(result->second, node.nProcessQueueSize > 0);
+        }
+        return msg_types;
+    };
+
+    // The messages are processed in order until the handshake completes.
+    receive(NetMsgType::ADDR);
+    receive(NetMsgType::TX);
+    receive(NetMsgType::HEADERS);
+    BOOST_CHECK(!node.HasUrgentMessages());
+    BOOST_CHECK(poll_all() ==
+                std::vector<std::string>({NetMsgType::ADDR, NetMsgType::TX,
+                                          NetMsgType::HEADERS}));
+
+    // Then the most urgent class goes first.
+    node.fSuccessfullyConnected = true;
+    receive(NetMsgType::ADDR);
+    receive(NetMsgType::PING);
+    receive(NetMsgType::AVAPOLL);
+    receive(NetMsgType::HEADERS);
+    BOOST_CHECK(node.HasUrgentMessages());
+    BOOST_CHECK(poll_all() ==
+                std::vector<std::string>({NetMsgType::HEADERS,
+                                          NetMsgType::AVAPOLL, NetMsgType::PING,
+                                          NetMsgType::ADDR}));
+    BOOST_CHECK(!node.HasUrgentMessages());
+    BOOST_CHECK_EQUAL(node.nProcessQueueSize, 0);
+
+    // The block messages don't overtake the transactions received before them,
+    // nor the block messages which waited behind these.
+    receive(NetMsgType::TX);
+    receive(NetMsgType::CMPCTBLOCK);
+    receive(NetMsgType::PING);
+    receive(NetMsgType::AVAPOLL);
+    receive(NetMsgType::BLOCKTXN);
+    BOOST_CHECK(!node.HasUrgentMessages());
+    BOOST_CHECK(!node.PollUrgentMessage(flood_size));
+    BOOST_CHECK(poll_all() ==
+                std::vector<std::string>({NetMsgType::AVAPOLL, NetMsgType::TX,
+                                          NetMsgType::CMPCTBLOCK,
+                                          NetMsgType::PING,
+                                          NetMsgType::BLOCKTXN}));
+
+    // Once they are processed the block messages are urgent again, and the
+    // urgent poll only takes these.
+    receive(NetMsgType::PING);
+    receive(NetMsgType::HEADERS);
+    BOOST_CHECK(node.HasUrgentMessages());
+    auto result = node.PollUrgentMessage(flood_size);
+    BOOST_REQUIRE(result);
+    BOOST_CHECK_EQUAL(result->first.m_type, NetMsgType::HEADERS);
+    BOOST_CHECK(result->second);
+    BOOST_CHECK(!node.PollUrgentMessage(flood_size));
+    BOOST_CHECK(poll_all() == std::vector<std::string>({NetMsgType::PING}));
+    BOOST_CHECK_EQUAL(node.nProcessQueueSize, 0);
+
+    // A stream of urgent messages does not starve the other classes.
+    receive(NetMsgType::ADDR);
+    for (size_t i = 0; i < 2 * MAX_MSG_PRIORITY_SKIPS; ++i) {
+        receive(NetMsgType::HEADERS);
+    }
+    const std::vector<std::string> msg_types{poll_all()};
+    BOOST_REQUIRE_EQUAL(msg_types.size(), 2 * MAX_MSG_PRIORITY_SKIPS + 1);
+    for (size_t i = 0; i < msg_types.size(); ++i) {
+        BOOST_CHECK_EQUAL(msg_types[i], i == MAX_MSG_PRIORITY_SKIPS
+                                            ? NetMsgType::ADDR
+                                            : NetMsgType::HEADERS);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(net_message_compression) {
+    const Config &config = m_node.chainman->GetConfig();
+
+    // Transactions paying to the same script compress well.
+    CBlock block;
+    for (uint32_t i = 0; i < 50; ++i) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(TxId(uint256::ONE), i);
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = COIN;
+        mtx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        block.vtx.push_back(MakeTransactionRef(mtx));
+    }
+
+    const CNetMsgMaker msg_maker{INIT_PROTO_VERSION};
+    const CSerializedNetMsg block_msg{
+        msg_maker.Make(NetMsgType::BLOCK, block)};
+    const std::optional<CSerializedNetMsg> compressed{
+        CompressMessage(block_msg)};
+    BOOST_REQUIRE(compressed);
+    BOOST_CHECK_EQUAL(compressed->m_type, NetMsgType::CMPRMSG);
+    BOOST_CHECK(compressed->data.size() < block_msg.data.size());
+
+    // Random data is not worth compressing.
+    const CSerializedNetMsg random_msg{msg_maker.Make(
+        NetMsgType::BLOCK, g_insecure_rand_ctx.randbytes(2000))};
+    BOOST_CHECK(!CompressMessage(random_msg));
+
+    const auto &connman = static_cast<ConnmanTestMsg &>(*m_node.connman);
+    const size_t flood_size{connman.GetReceiveFloodSize()};
+    auto make_node = [](NetPermissionFlags permission_flags) {
+        return std::make_unique<CNode>(
+            0, /*sock=*/nullptr, CAddress{}, /*nKeyedNetGroupIn=*/0,
+            /*nLocalHostNonceIn=*/0, /*nLocalExtraEntropyIn=*/0, CAddress{},
+            /*pszDest=*/"", ConnectionType::OUTBOUND_FULL_RELAY,
+            /*inbound_onion=*/false,
+            CNodeOptions{.permission_flags = permission_flags});
+    };
+
+    // The peers allowed to compress get the message they sent unwrapped.
+    auto node = make_node(NetPermissionFlags::Compress);
+    // The block was requested, so it is parsed by the network thread.
+    node->fSuccessfullyConnected = true;
+    node->m_preparse_blocks = true;
+    CSerializedNetMsg msg{compressed->Copy()};
+    BOOST_CHECK(connman.ReceiveMsgFrom(*node, msg));
+    // The decompressed size is charged to the process queue.
+    BOOST_CHECK(node->nProcessQueueSize > block_msg.data.size());
+    auto result = node->PollMessage(flood_size);
+    BOOST_REQUIRE(result);
+    BOOST_CHECK_EQUAL(result->first.m_type, NetMsgType::BLOCK);
+    BOOST_CHECK_EQUAL(result->first.m_message_size, block_msg.data.size());
+    BOOST_REQUIRE(result->first.m_block);
+    BOOST_CHECK(result->first.m_block->GetHash() == block.GetHash());
+
+    CNodeStats stats;
+    node->copyStats(stats);
+    BOOST_CHECK_EQUAL(stats.m_compression_recv.raw_bytes,
+                      block_msg.data.size());
+    BOOST_CHECK_EQUAL(stats.m_compression_recv.compressed_bytes,
+                      compressed->data.size());
+    BOOST_CHECK_EQUAL(stats.mapRecvBytesPerMsgCmd[NetMsgType::BLOCK],
+                      compressed->data.size() + CMessageHeader::HEADER_SIZE);
+
+    // The other peers get it as is.
+    auto other_node = make_node(NetPermissionFlags::None);
+    msg = compressed->Copy();
+    BOOST_CHECK(connman.ReceiveMsgFrom(*other_node, msg));
+    result = other_node->PollMessage(flood_size);
+    BOOST_REQUIRE(result);
+    BOOST_CHECK_EQUAL(result->first.m_type, NetMsgType::CMPRMSG);
+
+    auto make_compressed = [](const std::string &msg_type, uint64_t raw_size) {
+        CDataStream stream{SER_NETWORK, PROTOCOL_VERSION};
+        stream << msg_type << COMPACTSIZE(raw_size);
+        return CNetMessage{std::move(stream)};
+    };
+
+    // Only the message types worth compressing can be wrapped.
+    CNetMessage tx_msg = make_compressed(NetMsgType::TX, 100);
+    BOOST_CHECK(!DecompressMessage(config, tx_msg));
+
+    // The size is checked before decompressing.
+    CNetMessage oversized_msg =
+        make_compressed(NetMsgType::HEADERS, MAX_PROTOCOL_MESSAGE_LENGTH + 1);
+    BOOST_CHECK(!DecompressMessage(config, oversized_msg));
+
+    // So is the payload.
+    CNetMessage truncated_msg = make_compressed(NetMsgType::HEADERS, 100);
+    BOOST_CHECK(!DecompressMessage(config, truncated_msg));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -546,6 +546,12 @@ BOOST_AUTO_TEST_CASE(netpermissions_test) {
     BOOST_CHECK(NetWhitelistPermissions::TryParse(
         "bloom,forcerelay,noban,relay,mempool@1.2.3.4/32", whitelistPermissions,
         connection_direction, error));
+    BOOST_CHECK(NetWhitelistPermissions::TryParse(
+        "compress,out@1.2.3.4", whitelistPermissions, connection_direction,
+        error));
+    BOOST_CHECK_EQUAL(whitelistPermissions.m_flags,
+                      NetPermissionFlags::Compress);
+    BOOST_CHECK(connection_direction == ConnectionDirection::Out);
 
     const auto strings = NetPermissions::ToStrings(NetPermissionFlags::All);
     BOOST_CHECK_EQUAL(strings.size(), 8U);
@@ -565,6 +571,9 @@ BOOST_AUTO_TEST_CASE(netpermissions_test) {
                 strings.end());
     BOOST_CHECK(std::find(strings.begin(), strings.end(),
                           "bypass_proof_request_limits") != strings.end());
+    // Compression has to be granted explicitly.
+    BOOST_CHECK(std::find(strings.begin(), strings.end(), "compress") ==
+                strings.end());
 }
 
 BOOST_AUTO_TEST_CASE(
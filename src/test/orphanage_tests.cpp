@@ -15,6 +15,7 @@
 #include <test/util/setup_common.h>
 
 #include <cstdint>
+#include <iterator>
 #include <map>
 
 #include <boost/test/unit_test.hpp>
@@ -30,11 +31,8 @@ public:
 
     CTransactionRef RandomOrphan() EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
         LOCK(m_mutex);
-        std::map<TxId, PoolTx>::iterator it;
-        it = m_pool_txs.lower_bound(TxId{InsecureRand256()});
-        if (it == m_pool_txs.end()) {
-            it = m_pool_txs.begin();
-        }
+        auto it = m_pool_txs.begin();
+        std::advance(it, InsecureRandRange(m_pool_txs.size()));
         return it->second.tx;
     }
 };
@@ -97,4 +97,111 @@ BOOST_AUTO_TEST_CASE(MempoolMinimumFeeEstimate) {
                         "Confirm blocks has failed");
 }
 
+BOOST_AUTO_TEST_CASE(FeeRateHistogramTest) {
+    FeeRateHistogram histogram;
+    BOOST_CHECK(histogram.GetBuckets().empty());
+    BOOST_CHECK(histogram.GetFeeRateForSize(0) ==
+                CFeeRate(Amount::zero()));
+
+    const CFeeRate low(1000 * SATOSHI);
+    const CFeeRate high(100000 * SATOSHI);
+    histogram.Add(low, 300);
+    histogram.Add(low, 200);
+    histogram.Add(high, 1000);
+
+    auto buckets = histogram.GetBuckets();
+    BOOST_CHECK_EQUAL(buckets.size(), 2);
+    BOOST_CHECK(buckets[0].feerate <= high.GetFeePerK());
+    BOOST_CHECK(buckets[0].feerate > low.GetFeePerK());
+    BOOST_CHECK_EQUAL(buckets[0].size, 1000);
+    BOOST_CHECK_EQUAL(buckets[0].count, 1);
+    BOOST_CHECK(buckets[1].feerate <= low.GetFeePerK());
+    BOOST_CHECK_EQUAL(buckets[1].size, 500);
+    BOOST_CHECK_EQUAL(buckets[1].count, 2);
+
+    // Everything fits, any fee does
+    BOOST_CHECK(histogram.GetFeeRateForSize(1500) ==
+                CFeeRate(Amount::zero()));
+    // Only the high feerate tx fits, beat the low feerate bucket
+    const CFeeRate needed = histogram.GetFeeRateForSize(1200);
+    BOOST_CHECK(needed > low);
+    BOOST_CHECK(needed <= high);
+    // Nothing fits, beat the high feerate bucket
+    BOOST_CHECK(histogram.GetFeeRateForSize(500) > high);
+
+    histogram.Remove(high, 1000);
+    BOOST_CHECK_EQUAL(histogram.GetBuckets().size(), 1);
+
+    // Negative feerates are counted with the zero ones
+    const CFeeRate negative(-1000 * SATOSHI);
+    histogram.Add(negative, 100);
+    buckets = histogram.GetBuckets();
+    BOOST_CHECK_EQUAL(buckets.size(), 2);
+    BOOST_CHECK(buckets.back().feerate == Amount::zero());
+    BOOST_CHECK_EQUAL(buckets.back().size, 100);
+    BOOST_CHECK_EQUAL(buckets.back().count, 1);
+    histogram.Remove(negative, 100);
+    BOOST_CHECK_EQUAL(histogram.GetBuckets().size(), 1);
+    histogram.Clear();
+    BOOST_CHECK(histogram.GetBuckets().empty());
+}
+
+BOOST_AUTO_TEST_CASE(MempoolInclusionFeeEstimate) {
+    CTxMemPool &mpool = *Assert(m_node.mempool);
+    LOCK2(cs_main, mpool.cs);
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = Amount::zero();
+
+    // Keep the feerates well within the tracked range, below MAX_FEERATE.
+    const Amount fee = 1000 * SATOSHI;
+    std::vector<CTransactionRef> block;
+    for (int i = 0; i < 10; i++) {
+        tx.vin[0].nSequence = i;
+        mpool.addUnchecked(entry.Fee((i + 1) * fee).FromTx(tx));
+        block.push_back(MakeTransactionRef(tx));
+    }
+
+    uint64_t count = 0;
+    for (const auto &bucket : mpool.GetFeeHistogram()) {
+        count += bucket.count;
+    }
+    BOOST_CHECK_EQUAL(count, 10);
+
+    // With a tiny block, only the best transactions make it
+    const CFeeRate lowest(fee, CTransaction(tx).GetTotalSize());
+    BOOST_CHECK(mpool.EstimateInclusionFee(1) > lowest);
+
+    // Prioritisation moves the transaction in the histogram
+    const Amount top = mpool.GetFeeHistogram().front().feerate;
+    const TxId txid = block.front()->GetId();
+    mpool.PrioritiseTransaction(txid, 100 * fee);
+    BOOST_CHECK(mpool.GetFeeHistogram().front().feerate > top);
+    BOOST_CHECK_EQUAL(mpool.GetFeeHistogram().front().count, 1);
+    mpool.PrioritiseTransaction(txid, -100 * fee);
+    BOOST_CHECK(mpool.GetFeeHistogram().front().feerate == top);
+
+    // A negative delta can take the modified fee below zero
+    mpool.PrioritiseTransaction(txid, -100 * fee);
+    BOOST_CHECK(mpool.GetFeeHistogram().back().feerate == Amount::zero());
+    BOOST_CHECK_EQUAL(mpool.GetFeeHistogram().back().count, 1);
+    mpool.PrioritiseTransaction(txid, 100 * fee);
+    BOOST_CHECK(mpool.GetFeeHistogram().front().feerate == top);
+
+    // Mining all of them records the lowest mined feerate, which is above the
+    // minimum relay fee.
+    const CFeeRate unmined =
+        mpool.EstimateInclusionFee(DEFAULT_MAX_GENERATED_BLOCK_SIZE);
+    BOOST_CHECK_EQUAL(mpool.GetFeeEstimateBlocks(), 0);
+    DisconnectedBlockTransactions disconnectedBlocktxs;
+    disconnectedBlocktxs.removeForBlock(block, mpool);
+    BOOST_CHECK(mpool.GetFeeHistogram().empty());
+    BOOST_CHECK_EQUAL(mpool.GetFeeEstimateBlocks(), 1);
+    BOOST_CHECK(mpool.EstimateInclusionFee(DEFAULT_MAX_GENERATED_BLOCK_SIZE) >
+                unmined);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
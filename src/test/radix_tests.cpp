@@ -194,6 +194,18 @@ BOOST_AUTO_TEST_CASE(get_test) {
     testGet<TestElementUint256>();
 }
 
+BOOST_AUTO_TEST_CASE(get_in_read_section_test) {
+    RadixTree<TestElementInt<uint32_t>> mytree;
+    auto one = RCUPtr<TestElementInt<uint32_t>>::make(1);
+    BOOST_CHECK(mytree.insert(one));
+
+    // The lookup doesn't lock again if the caller already holds the lock.
+    RCULock lock;
+    BOOST_CHECK_EQUAL(mytree.get(one->getId()), one);
+    BOOST_CHECK_EQUAL(mytree.get(2), nullptr);
+    BOOST_CHECK(RCULock::isLocked());
+}
+
 template <typename E> void testRemove() {
     RadixTree<E> mytree;
 
@@ -6,10 +6,13 @@
 
 #include <script/sigcache.h>
 
+#include <clientversion.h>
 #include <key.h>
 #include <key_io.h>
+#include <random.h>
 #include <streams.h>
 #include <tinyformat.h>
+#include <util/fs.h>
 #include <util/strencodings.h>
 
 #include <test/util/setup_common.h>
@@ -115,4 +118,56 @@ BOOST_AUTO_TEST_CASE(sig_pubkey_hash_variations) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(sigcache_persistence) {
+    CDataStream stream(
+        ParseHex(
+            "010000000122739e70fbee987a8be1788395a2f2e6ad18ccb7ff611cd798071539"
+            "dde3c38e000000000151ffffffff010000000000000000016a00000000"),
+        SER_NETWORK, PROTOCOL_VERSION);
+    CTransaction dummyTx(deserialize, stream);
+    PrecomputedTransactionData txdata(dummyTx);
+    CachingTransactionSignatureChecker checker(&dummyTx, 0, 0 * SATOSHI, true,
+                                               txdata);
+    TestCachingTransactionSignatureChecker testChecker(checker);
+
+    CKey key;
+    key.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+    uint256 hashMsg = Hash(std::string{"Sigcache persistence"});
+    std::vector<uint8_t> sig;
+    BOOST_CHECK(key.SignECDSA(hashMsg, sig));
+
+    BOOST_CHECK(testChecker.VerifyAndStore(sig, pubkey, hashMsg));
+    BOOST_CHECK(testChecker.IsCached(sig, pubkey, hashMsg));
+
+    const fs::path dump_path = m_args.GetDataDirBase() / "sigcache.dat";
+    BOOST_CHECK(DumpSignatureCache(dump_path));
+    BOOST_CHECK(fs::exists(dump_path));
+
+    // Loading a dump made with another salt makes the entry unreachable, as
+    // after a restart without persistence.
+    const fs::path other_path = m_args.GetDataDirBase() / "othercache.dat";
+    {
+        CAutoFile file{fsbridge::fopen(other_path, "wb"), SER_DISK,
+                       CLIENT_VERSION};
+        file << uint64_t{1} << GetRandHash() << std::vector<uint256>{};
+    }
+    BOOST_CHECK(LoadSignatureCache(other_path));
+    BOOST_CHECK(!testChecker.IsCached(sig, pubkey, hashMsg));
+
+    // Restoring the dump brings both the salt and the entry back.
+    BOOST_CHECK(LoadSignatureCache(dump_path));
+    BOOST_CHECK(testChecker.IsCached(sig, pubkey, hashMsg));
+
+    // Unknown versions and missing files are ignored.
+    {
+        CAutoFile file{fsbridge::fopen(other_path, "wb"), SER_DISK,
+                       CLIENT_VERSION};
+        file << uint64_t{2} << GetRandHash() << std::vector<uint256>{};
+    }
+    BOOST_CHECK(!LoadSignatureCache(other_path));
+    BOOST_CHECK(!LoadSignatureCache(m_args.GetDataDirBase() / "missing.dat"));
+    BOOST_CHECK(testChecker.IsCached(sig, pubkey, hashMsg));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
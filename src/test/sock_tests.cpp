@@ -139,6 +139,99 @@ BOOST_AUTO_TEST_CASE(wait) {
     waiter.join();
 }
 
+#ifdef USE_EPOLL
+BOOST_AUTO_TEST_CASE(epoll_edge_triggered) {
+    int s[2];
+    CreateSocketPair(s);
+
+    Sock sock0(s[0]);
+    Sock sock1(s[1]);
+
+    SockEpoll epoll;
+    BOOST_REQUIRE(epoll.Add(sock0, 42, /*edge_triggered=*/true));
+    BOOST_CHECK(!epoll.Add(sock0, 42, /*edge_triggered=*/true));
+
+    // A new socket is reported writable once.
+    SockEpoll::ReadySocks ready;
+    BOOST_REQUIRE(epoll.Wait(0ms, ready));
+    BOOST_REQUIRE_EQUAL(ready.size(), 1U);
+    BOOST_CHECK_EQUAL(ready[0].first, 42U);
+    BOOST_CHECK_EQUAL(ready[0].second, Sock::SEND);
+    BOOST_REQUIRE(epoll.Wait(0ms, ready));
+    BOOST_CHECK(ready.empty());
+
+    // Incoming data is reported once, even if it is not read.
+    BOOST_REQUIRE_EQUAL(sock1.Send("a", 1, 0), 1);
+    BOOST_REQUIRE(epoll.Wait(24h, ready));
+    BOOST_REQUIRE_EQUAL(ready.size(), 1U);
+    BOOST_CHECK(ready[0].second & Sock::RECV);
+    BOOST_REQUIRE(epoll.Wait(0ms, ready));
+    BOOST_CHECK(ready.empty());
+
+    // More data is a new edge.
+    BOOST_REQUIRE_EQUAL(sock1.Send("b", 1, 0), 1);
+    BOOST_REQUIRE(epoll.Wait(24h, ready));
+    BOOST_REQUIRE_EQUAL(ready.size(), 1U);
+    BOOST_CHECK(ready[0].second & Sock::RECV);
+
+    // Closing the other end is an error.
+    sock1.Reset();
+    BOOST_REQUIRE(epoll.Wait(24h, ready));
+    BOOST_REQUIRE_EQUAL(ready.size(), 1U);
+    BOOST_CHECK(ready[0].second & Sock::ERR);
+
+    BOOST_CHECK(epoll.Remove(sock0));
+    BOOST_CHECK(!epoll.Remove(sock0));
+}
+
+BOOST_AUTO_TEST_CASE(epoll_level_triggered) {
+    int s[2];
+    CreateSocketPair(s);
+
+    Sock sock0(s[0]);
+    Sock sock1(s[1]);
+
+    SockEpoll epoll;
+    BOOST_REQUIRE(epoll.Add(sock0, 1, /*edge_triggered=*/false));
+
+    // Unread data is reported for as long as it stays unread.
+    BOOST_REQUIRE_EQUAL(sock1.Send("a", 1, 0), 1);
+    SockEpoll::ReadySocks ready;
+    for (int i = 0; i < 2; ++i) {
+        BOOST_REQUIRE(epoll.Wait(24h, ready));
+        BOOST_REQUIRE_EQUAL(ready.size(), 1U);
+        BOOST_CHECK(ready[0].second & Sock::RECV);
+    }
+
+    char c;
+    BOOST_REQUIRE_EQUAL(sock0.Recv(&c, 1, 0), 1);
+    BOOST_REQUIRE(epoll.Wait(0ms, ready));
+    BOOST_REQUIRE_EQUAL(ready.size(), 1U);
+    BOOST_CHECK_EQUAL(ready[0].second, Sock::SEND);
+}
+
+BOOST_AUTO_TEST_CASE(epoll_interrupt) {
+    SockEpoll epoll;
+    SockEpoll::ReadySocks ready;
+    BOOST_REQUIRE(epoll.Wait(0ms, ready));
+    BOOST_CHECK(ready.empty());
+
+    // An interruption before the wait makes it return right away, once.
+    BOOST_REQUIRE(epoll.Interrupt());
+    BOOST_REQUIRE(epoll.Interrupt());
+    BOOST_REQUIRE(epoll.Wait(24h, ready));
+    BOOST_CHECK(ready.empty());
+    BOOST_REQUIRE(epoll.Wait(0ms, ready));
+    BOOST_CHECK(ready.empty());
+
+    // So does one from another thread during the wait.
+    std::thread interrupter([&epoll]() { epoll.Interrupt(); });
+    BOOST_REQUIRE(epoll.Wait(24h, ready));
+    BOOST_CHECK(ready.empty());
+    interrupter.join();
+}
+#endif /* USE_EPOLL */
+
 BOOST_AUTO_TEST_CASE(recv_until_terminator_limit) {
     // High enough timeout so that it is never hit.
     constexpr auto timeout = 1min;
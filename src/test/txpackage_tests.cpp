@@ -273,6 +273,63 @@ BOOST_FIXTURE_TEST_CASE(package_validation_tests, TestChain100Setup) {
     BOOST_CHECK_EQUAL(m_node.mempool->size(), initialPoolSize);
 }
 
+BOOST_FIXTURE_TEST_CASE(package_script_checks_tests, TestChain100Setup) {
+    LOCK(cs_main);
+    unsigned int initialPoolSize = m_node.mempool->size();
+
+    // The scripts of a package are checked on the script check queue workers,
+    // make sure a failure is still attributed to the right transaction with
+    // the right reason.
+    CKey parent_key;
+    parent_key.MakeNewKey(true);
+    CScript parent_locking_script =
+        GetScriptForDestination(PKHash(parent_key.GetPubKey()));
+    auto mtx_parent = CreateValidMempoolTransaction(
+        /* input_transaction */ m_coinbase_txns[0], /* vout */ 0,
+        /* input_height */ 0, /* input_signing_key */ coinbaseKey,
+        /* output_destination */ parent_locking_script,
+        /* output_amount */ Amount(49 * COIN), /* submit */ false);
+    CTransactionRef tx_parent = MakeTransactionRef(mtx_parent);
+
+    auto mtx_child = CreateValidMempoolTransaction(
+        /* input_transaction */ tx_parent, /* vout */ 0,
+        /* input_height */ 101, /* input_signing_key */ parent_key,
+        /* output_destination */ parent_locking_script,
+        /* output_amount */ Amount(48 * COIN), /* submit */ false);
+    // Invalidate the signature.
+    mtx_child.vout[0].nValue -= COIN;
+    CTransactionRef tx_child = MakeTransactionRef(mtx_child);
+
+    Package package_parent_child{tx_parent, tx_child};
+    const auto result_parent_child =
+        ProcessNewPackage(m_node.chainman->ActiveChainstate(), *m_node.mempool,
+                          package_parent_child, /*test_accept=*/false);
+    BOOST_CHECK_EQUAL(result_parent_child.m_state.GetResult(),
+                      PackageValidationResult::PCKG_TX);
+    BOOST_CHECK_EQUAL(result_parent_child.m_state.GetRejectReason(),
+                      "transaction failed");
+    auto it_child = result_parent_child.m_tx_results.find(tx_child->GetId());
+    BOOST_REQUIRE(it_child != result_parent_child.m_tx_results.end());
+    BOOST_CHECK_EQUAL(it_child->second.m_state.GetResult(),
+                      TxValidationResult::TX_CONSENSUS);
+    BOOST_CHECK_EQUAL(
+        it_child->second.m_state.GetRejectReason().rfind(
+            "mandatory-script-verify-flag-failed", 0),
+        0);
+    BOOST_CHECK_EQUAL(m_node.mempool->size(), initialPoolSize);
+
+    // The parent alone is still accepted.
+    const auto result_parent =
+        ProcessNewPackage(m_node.chainman->ActiveChainstate(), *m_node.mempool,
+                          {tx_parent}, /*test_accept=*/false);
+    if (auto err_parent{CheckPackageMempoolAcceptResult(
+            {tx_parent}, result_parent, /*expect_valid=*/true,
+            m_node.mempool.get())}) {
+        BOOST_ERROR(err_parent.value());
+    }
+    BOOST_CHECK_EQUAL(m_node.mempool->size(), initialPoolSize + 1);
+}
+
 BOOST_FIXTURE_TEST_CASE(noncontextual_package_tests, TestChain100Setup) {
     // The signatures won't be verified so we can just use a placeholder
     CKey placeholder_key;
@@ -127,4 +127,96 @@ BOOST_AUTO_TEST_CASE(txpool_get_tx) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(txpool_peer_accounting) {
+    TxPool txpool("testing", 1h, 1h);
+    FastRandomContext rng(true);
+
+    auto makeTx = [](const std::vector<COutPoint> &prevouts) {
+        CMutableTransaction tx;
+        for (const COutPoint &prevout : prevouts) {
+            tx.vin.emplace_back(prevout);
+            tx.vin.back().scriptSig = SCRIPT_SIG;
+        }
+        tx.vout.resize(1);
+        tx.vout[0].nValue = CENT;
+        tx.vout[0].scriptPubKey = SCRIPT_PUB_KEY;
+        return MakeTransactionRef(tx);
+    };
+
+    // Peer 1 provides a parent and a child spending the same outpoint twice,
+    // peer 2 another child of the parent.
+    const COutPoint funding{TxId(rng.rand256()), 0};
+    const CTransactionRef parent = makeTx({funding});
+    const COutPoint parentOut{parent->GetId(), 0};
+    const CTransactionRef child1 = makeTx({parentOut, parentOut});
+    const CTransactionRef child2 = makeTx({parentOut});
+    BOOST_CHECK(txpool.AddTx(parent, 1));
+    BOOST_CHECK(txpool.AddTx(child1, 1));
+    BOOST_CHECK(txpool.AddTx(child2, 2));
+    BOOST_CHECK(!txpool.AddTx(child2, 3));
+
+    BOOST_CHECK_EQUAL(txpool.GetPeerTxCount(1), 2);
+    BOOST_CHECK_EQUAL(txpool.GetPeerTxBytes(1),
+                      parent->GetTotalSize() + child1->GetTotalSize());
+    BOOST_CHECK_EQUAL(txpool.GetPeerTxCount(2), 1);
+    BOOST_CHECK_EQUAL(txpool.GetPeerTxCount(3), 0);
+    BOOST_CHECK_EQUAL(txpool.GetConflictTxs(makeTx({parentOut})).size(), 2);
+
+    // The children go to the work set of the peer that provided them
+    txpool.AddChildrenToWorkSet(*parent);
+    BOOST_CHECK(txpool.HaveTxToReconsider(1));
+    BOOST_CHECK_EQUAL(txpool.GetTxToReconsider(1), child1);
+    BOOST_CHECK(!txpool.HaveTxToReconsider(1));
+    BOOST_CHECK_EQUAL(txpool.GetTxToReconsider(2), child2);
+
+    // Erasing a peer only touches its own transactions
+    txpool.EraseForPeer(1);
+    BOOST_CHECK_EQUAL(txpool.GetPeerTxCount(1), 0);
+    BOOST_CHECK_EQUAL(txpool.GetPeerTxBytes(1), 0);
+    BOOST_CHECK_EQUAL(txpool.Size(), 1);
+    BOOST_CHECK(txpool.HaveTx(child2->GetId()));
+    BOOST_CHECK_EQUAL(txpool.GetConflictTxs(makeTx({parentOut})).size(), 1);
+
+    BOOST_CHECK_EQUAL(txpool.LimitTxs(0, rng), 1);
+    BOOST_CHECK_EQUAL(txpool.GetPeerTxCount(2), 0);
+    BOOST_CHECK_EQUAL(txpool.Size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(txpool_peer_budget) {
+    TxPool txpool("testing", 1h, 1h);
+    FastRandomContext rng(true);
+
+    auto addTxs = [&](NodeId peer, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            CMutableTransaction tx;
+            tx.vin.emplace_back(TxId(rng.rand256()), 0);
+            tx.vin[0].scriptSig = SCRIPT_SIG;
+            tx.vout.resize(1);
+            tx.vout[0].nValue = CENT;
+            tx.vout[0].scriptPubKey = SCRIPT_PUB_KEY;
+            BOOST_CHECK(txpool.AddTx(MakeTransactionRef(tx), peer));
+        }
+    };
+
+    // Peer 1 floods the pool, peers 2 and 3 only provide a couple of txs.
+    addTxs(1, 10);
+    addTxs(2, 2);
+    addTxs(3, 2);
+
+    // Only the flooding peer loses transactions.
+    BOOST_CHECK_EQUAL(txpool.LimitTxs(9, rng), 5);
+    BOOST_CHECK_EQUAL(txpool.GetPeerTxCount(1), 5);
+    BOOST_CHECK_EQUAL(txpool.GetPeerTxCount(2), 2);
+    BOOST_CHECK_EQUAL(txpool.GetPeerTxCount(3), 2);
+
+    // Once under its budget, the peers are evicted from evenly.
+    BOOST_CHECK_EQUAL(txpool.LimitTxs(3, rng), 6);
+    BOOST_CHECK_EQUAL(txpool.GetPeerTxCount(1), 1);
+    BOOST_CHECK_EQUAL(txpool.GetPeerTxCount(2), 1);
+    BOOST_CHECK_EQUAL(txpool.GetPeerTxCount(3), 1);
+
+    BOOST_CHECK_EQUAL(txpool.LimitTxs(0, rng), 3);
+    BOOST_CHECK_EQUAL(txpool.Size(), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,329 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/txreconciliation.h>
+
+#include <test/util/random.h>
+#include <test/util/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(txreconciliation_tests, BasicTestingSetup)
+
+namespace {
+/**
+ * Register peer_id on both trackers, the initiator being the side which
+ * opened the connection.
+ */
+void RegisterPair(TxReconciliationTracker &initiator,
+                  TxReconciliationTracker &responder, NodeId peer_id) {
+    const uint64_t initiator_salt = initiator.PreRegisterPeer(peer_id);
+    const uint64_t responder_salt = responder.PreRegisterPeer(peer_id);
+    BOOST_CHECK(initiator.RegisterPeer(peer_id, /*is_peer_inbound=*/false, 1,
+                                       responder_salt) ==
+                ReconciliationRegisterResult::SUCCESS);
+    BOOST_CHECK(responder.RegisterPeer(peer_id, /*is_peer_inbound=*/true, 1,
+                                       initiator_salt) ==
+                ReconciliationRegisterResult::SUCCESS);
+}
+
+/** Get a reconciliation request out of the initiator. */
+std::optional<std::pair<uint16_t, uint16_t>>
+RequestReconciliation(TxReconciliationTracker &initiator, NodeId peer_id,
+                      std::chrono::microseconds &now) {
+    std::vector<TxId> to_flood;
+    // The first call schedules the first request within the interval.
+    auto request =
+        initiator.MaybeRequestReconciliation(peer_id, now, to_flood);
+    if (!request) {
+        now += RECON_REQUEST_INTERVAL;
+        request = initiator.MaybeRequestReconciliation(peer_id, now, to_flood);
+    }
+    BOOST_CHECK(to_flood.empty());
+    return request;
+}
+
+std::set<TxId> ToSet(const std::vector<TxId> &txids) {
+    return {txids.begin(), txids.end()};
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(register_peer) {
+    TxReconciliationTracker tracker(TXRECONCILIATION_VERSION);
+    const uint64_t salt = 0;
+
+    // Not pre-registered.
+    BOOST_CHECK(tracker.RegisterPeer(0, true, 1, salt) ==
+                ReconciliationRegisterResult::NOT_FOUND);
+    BOOST_CHECK(!tracker.IsPeerRegistered(0));
+
+    // Invalid version.
+    tracker.PreRegisterPeer(0);
+    BOOST_CHECK(tracker.RegisterPeer(0, true, 0, salt) ==
+                ReconciliationRegisterResult::PROTOCOL_VIOLATION);
+    BOOST_CHECK(!tracker.IsPeerRegistered(0));
+
+    // A higher version is downgraded to ours.
+    BOOST_CHECK(tracker.RegisterPeer(0, true, 2, salt) ==
+                ReconciliationRegisterResult::SUCCESS);
+    BOOST_CHECK(tracker.IsPeerRegistered(0));
+    BOOST_CHECK(tracker.RegisterPeer(0, true, 1, salt) ==
+                ReconciliationRegisterResult::ALREADY_REGISTERED);
+
+    tracker.ForgetPeer(0);
+    BOOST_CHECK(!tracker.IsPeerRegistered(0));
+    BOOST_CHECK(tracker.RegisterPeer(0, true, 1, salt) ==
+                ReconciliationRegisterResult::NOT_FOUND);
+
+    // Forgetting a pre-registered peer works too.
+    tracker.PreRegisterPeer(1);
+    tracker.ForgetPeer(1);
+    BOOST_CHECK(tracker.RegisterPeer(1, true, 1, salt) ==
+                ReconciliationRegisterResult::NOT_FOUND);
+}
+
+BOOST_AUTO_TEST_CASE(add_to_set) {
+    TxReconciliationTracker tracker(TXRECONCILIATION_VERSION);
+
+    // Unregistered peers get transactions flooded.
+    BOOST_CHECK(!tracker.AddToSet(0, TxId{InsecureRand256()}));
+
+    tracker.PreRegisterPeer(0);
+    BOOST_CHECK(!tracker.AddToSet(0, TxId{InsecureRand256()}));
+    BOOST_CHECK(tracker.RegisterPeer(0, true, 1, 0) ==
+                ReconciliationRegisterResult::SUCCESS);
+
+    for (size_t i = 0; i < MAX_RECON_SET_SIZE; ++i) {
+        BOOST_CHECK(tracker.AddToSet(0, TxId{InsecureRand256()}));
+    }
+    // The set is full.
+    BOOST_CHECK(!tracker.AddToSet(0, TxId{InsecureRand256()}));
+}
+
+BOOST_AUTO_TEST_CASE(reconciliation_round) {
+    TxReconciliationTracker initiator(TXRECONCILIATION_VERSION);
+    TxReconciliationTracker responder(TXRECONCILIATION_VERSION);
+    RegisterPair(initiator, responder, 0);
+
+    std::vector<TxId> initiator_only, responder_only;
+    for (size_t i = 0; i < 100; ++i) {
+        const TxId txid{InsecureRand256()};
+        BOOST_CHECK(initiator.AddToSet(0, txid));
+        BOOST_CHECK(responder.AddToSet(0, txid));
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        initiator_only.emplace_back(InsecureRand256());
+        BOOST_CHECK(initiator.AddToSet(0, initiator_only.back()));
+    }
+    for (size_t i = 0; i < 3; ++i) {
+        responder_only.emplace_back(InsecureRand256());
+        BOOST_CHECK(responder.AddToSet(0, responder_only.back()));
+    }
+
+    std::chrono::microseconds now{GetTime<std::chrono::microseconds>()};
+
+    // Only the initiator requests reconciliations.
+    std::vector<TxId> to_flood;
+    BOOST_CHECK(!responder.MaybeRequestReconciliation(
+        0, now + RECON_REQUEST_INTERVAL, to_flood));
+
+    const auto request = RequestReconciliation(initiator, 0, now);
+    BOOST_REQUIRE(request);
+    BOOST_CHECK_EQUAL(request->first, 104);
+    BOOST_CHECK_EQUAL(request->second, uint16_t(RECON_Q * Q_PRECISION));
+
+    // No new request while this one is ongoing.
+    BOOST_CHECK(!initiator.MaybeRequestReconciliation(
+        0, now + RECON_REQUEST_INTERVAL, to_flood));
+    BOOST_CHECK(to_flood.empty());
+
+    // The initiator does not answer requests.
+    IBLT sketch;
+    BOOST_CHECK(!initiator.HandleReconciliationRequest(
+        0, request->first, request->second, sketch, to_flood));
+
+    BOOST_CHECK(responder.HandleReconciliationRequest(
+        0, request->first, request->second, sketch, to_flood));
+    BOOST_CHECK(to_flood.empty());
+    BOOST_CHECK(sketch.Size() > 0 && sketch.Size() <= MAX_SKETCH_CELLS);
+
+    // The responder does not expect a sketch.
+    std::vector<uint32_t> ask_shortids;
+    std::vector<TxId> initiator_announce;
+    BOOST_CHECK(responder.HandleSketch(0, sketch, ask_shortids,
+                                       initiator_announce) ==
+                ReconciliationSketchResult::PROTOCOL_VIOLATION);
+
+    const ReconciliationSketchResult result{
+        initiator.HandleSketch(0, sketch, ask_shortids, initiator_announce)};
+    BOOST_CHECK(result == ReconciliationSketchResult::SUCCESS ||
+                result == ReconciliationSketchResult::FAILURE);
+    const bool success{result == ReconciliationSketchResult::SUCCESS};
+
+    std::vector<TxId> responder_announce;
+    BOOST_CHECK(responder.HandleReconciliationDifference(
+        0, success, ask_shortids, responder_announce));
+
+    if (success) {
+        // Each side announces what the other is missing.
+        BOOST_CHECK_EQUAL(ask_shortids.size(), responder_only.size());
+        BOOST_CHECK(ToSet(initiator_announce) == ToSet(initiator_only));
+        BOOST_CHECK(ToSet(responder_announce) == ToSet(responder_only));
+    } else {
+        // The sketch could not be decoded, so both sides flood their set.
+        BOOST_CHECK_EQUAL(initiator_announce.size(), 104);
+        BOOST_CHECK_EQUAL(responder_announce.size(), 103);
+    }
+
+    // The round is over on both sides.
+    BOOST_CHECK(initiator.HandleSketch(0, sketch, ask_shortids,
+                                       initiator_announce) ==
+                ReconciliationSketchResult::PROTOCOL_VIOLATION);
+    BOOST_CHECK(!responder.HandleReconciliationDifference(
+        0, true, ask_shortids, responder_announce));
+}
+
+BOOST_AUTO_TEST_CASE(reconciliation_timeout) {
+    TxReconciliationTracker initiator(TXRECONCILIATION_VERSION);
+    TxReconciliationTracker responder(TXRECONCILIATION_VERSION);
+    RegisterPair(initiator, responder, 0);
+
+    const TxId txid{InsecureRand256()};
+    BOOST_CHECK(initiator.AddToSet(0, txid));
+
+    std::chrono::microseconds now{GetTime<std::chrono::microseconds>()};
+    const auto request = RequestReconciliation(initiator, 0, now);
+    BOOST_REQUIRE(request);
+    BOOST_CHECK_EQUAL(request->first, 1);
+
+    // Transactions added during the round wait for the next one.
+    BOOST_CHECK(initiator.AddToSet(0, TxId{InsecureRand256()}));
+
+    // The responder never answers: the transactions of the round are flooded
+    // and a new round starts.
+    std::vector<TxId> to_flood;
+    BOOST_CHECK(!initiator.MaybeRequestReconciliation(
+        0, now + RECON_RESPONSE_TIMEOUT - 1us, to_flood));
+    BOOST_CHECK(to_flood.empty());
+    const auto next_request = initiator.MaybeRequestReconciliation(
+        0, now + RECON_RESPONSE_TIMEOUT, to_flood);
+    BOOST_REQUIRE(next_request);
+    BOOST_CHECK_EQUAL(next_request->first, 1);
+    BOOST_CHECK(to_flood == std::vector<TxId>{txid});
+
+    // A sketch of the wrong size is rejected.
+    BOOST_CHECK(responder.AddToSet(0, txid));
+    IBLT sketch{IBLT::NUM_HASHES * (MAX_SKETCH_CELLS / IBLT::NUM_HASHES + 1)};
+    std::vector<uint32_t> ask_shortids;
+    std::vector<TxId> to_announce;
+    BOOST_CHECK(initiator.HandleSketch(0, sketch, ask_shortids, to_announce) ==
+                ReconciliationSketchResult::PROTOCOL_VIOLATION);
+
+    // The responder floods the round the initiator gave up on when it gets
+    // the next request.
+    to_flood.clear();
+    BOOST_CHECK(responder.HandleReconciliationRequest(
+        0, next_request->first, next_request->second, sketch, to_flood));
+    BOOST_CHECK(to_flood.empty());
+    BOOST_CHECK(responder.HandleReconciliationRequest(
+        0, next_request->first, next_request->second, sketch, to_flood));
+    BOOST_CHECK(to_flood == std::vector<TxId>{txid});
+}
+
+BOOST_AUTO_TEST_CASE(reconciliation_late_sketch) {
+    TxReconciliationTracker initiator(TXRECONCILIATION_VERSION);
+    TxReconciliationTracker responder(TXRECONCILIATION_VERSION);
+    RegisterPair(initiator, responder, 0);
+
+    const TxId txid{InsecureRand256()};
+    BOOST_CHECK(initiator.AddToSet(0, txid));
+    BOOST_CHECK(responder.AddToSet(0, txid));
+
+    std::chrono::microseconds now{GetTime<std::chrono::microseconds>()};
+    const auto request = RequestReconciliation(initiator, 0, now);
+    BOOST_REQUIRE(request);
+    IBLT late_sketch;
+    std::vector<TxId> to_flood;
+    BOOST_CHECK(responder.HandleReconciliationRequest(
+        0, request->first, request->second, late_sketch, to_flood));
+
+    // The sketch is not received in time, a new round starts.
+    const TxId next_txid{InsecureRand256()};
+    BOOST_CHECK(initiator.AddToSet(0, next_txid));
+    BOOST_CHECK(responder.AddToSet(0, next_txid));
+    const auto next_request = initiator.MaybeRequestReconciliation(
+        0, now + RECON_RESPONSE_TIMEOUT, to_flood);
+    BOOST_REQUIRE(next_request);
+    BOOST_CHECK(to_flood == std::vector<TxId>{txid});
+    IBLT sketch;
+    to_flood.clear();
+    BOOST_CHECK(responder.HandleReconciliationRequest(
+        0, next_request->first, next_request->second, sketch, to_flood));
+    BOOST_CHECK(to_flood == std::vector<TxId>{txid});
+
+    // The late sketch is ignored rather than reconciled against the new round
+    // or treated as a protocol violation.
+    std::vector<uint32_t> ask_shortids;
+    std::vector<TxId> to_announce;
+    BOOST_CHECK(initiator.HandleSketch(0, late_sketch, ask_shortids,
+                                       to_announce) ==
+                ReconciliationSketchResult::STALE);
+    BOOST_CHECK(ask_shortids.empty());
+    BOOST_CHECK(to_announce.empty());
+
+    // The sketch of the new round is reconciled: both sets are the same.
+    BOOST_CHECK(initiator.HandleSketch(0, sketch, ask_shortids, to_announce) ==
+                ReconciliationSketchResult::SUCCESS);
+    BOOST_CHECK(ask_shortids.empty());
+    BOOST_CHECK(to_announce.empty());
+
+    // Any other sketch is unexpected.
+    BOOST_CHECK(initiator.HandleSketch(0, sketch, ask_shortids, to_announce) ==
+                ReconciliationSketchResult::PROTOCOL_VIOLATION);
+}
+
+BOOST_AUTO_TEST_CASE(reconciliation_crafted_sketch) {
+    TxReconciliationTracker initiator(TXRECONCILIATION_VERSION);
+    TxReconciliationTracker responder(TXRECONCILIATION_VERSION);
+    RegisterPair(initiator, responder, 0);
+
+    const TxId txid{InsecureRand256()};
+    BOOST_CHECK(initiator.AddToSet(0, txid));
+
+    std::chrono::microseconds now{GetTime<std::chrono::microseconds>()};
+    const auto request = RequestReconciliation(initiator, 0, now);
+    BOOST_REQUIRE(request);
+    IBLT sketch;
+    std::vector<TxId> to_flood;
+    BOOST_CHECK(responder.HandleReconciliationRequest(
+        0, request->first, request->second, sketch, to_flood));
+
+    // A sketch which decodes to more transactions on our side than we have.
+    IBLT extra{sketch.Size()};
+    extra.Insert(1);
+    extra.Insert(2);
+    IBLT crafted{sketch.Size()};
+    crafted -= extra;
+
+    std::vector<uint32_t> ask_shortids;
+    std::vector<TxId> to_announce;
+    const ReconciliationSketchResult result{
+        initiator.HandleSketch(0, crafted, ask_shortids, to_announce)};
+    BOOST_CHECK(result == ReconciliationSketchResult::SUCCESS ||
+                result == ReconciliationSketchResult::FAILURE);
+    // Only our own transaction is announced either way.
+    BOOST_CHECK(to_announce == std::vector<TxId>{txid});
+
+    // The estimate sent in the next request is still sane.
+    const auto next_request = initiator.MaybeRequestReconciliation(
+        0, now + RECON_REQUEST_INTERVAL, to_flood);
+    BOOST_REQUIRE(next_request);
+    BOOST_CHECK_EQUAL(next_request->second, request->second);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
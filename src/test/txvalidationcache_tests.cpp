@@ -3,16 +3,20 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chain.h>
+#include <clientversion.h>
 #include <config.h>
 #include <consensus/validation.h>
 #include <kernel/validation_cache_sizes.h>
 #include <key.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <script/scriptcache.h>
 #include <script/sighashtype.h>
 #include <script/sign.h>
 #include <script/signingprovider.h>
+#include <streams.h>
 #include <txmempool.h>
+#include <util/fs.h>
 #include <validation.h>
 
 #include <test/lcg.h>
@@ -684,4 +688,45 @@ BOOST_AUTO_TEST_CASE(scriptcache_values) {
     CHECK_CACHE_HAS(key1A, 42);
 }
 
+BOOST_FIXTURE_TEST_CASE(scriptcache_persistence, BasicTestingSetup) {
+    LOCK(cs_main);
+
+    CMutableTransaction tx;
+    tx.nVersion = 3;
+    const uint32_t flags = 0x12345678;
+    AddKeyInScriptCache(ScriptCacheKey(CTransaction(tx), flags), 7);
+
+    const fs::path dump_path = m_args.GetDataDirBase() / "scriptcache.dat";
+    BOOST_CHECK(DumpScriptExecutionCache(dump_path));
+
+    // Switch to another salt: the keys computed for the same transaction
+    // change and the entry can no longer be found.
+    const fs::path other_path = m_args.GetDataDirBase() / "othercache.dat";
+    {
+        CAutoFile file{fsbridge::fopen(other_path, "wb"), SER_DISK,
+                       CLIENT_VERSION};
+        file << uint64_t{1} << GetRandHash() << uint64_t{0};
+    }
+    BOOST_CHECK(LoadScriptExecutionCache(other_path));
+    int nSigChecks;
+    BOOST_CHECK(!IsKeyInScriptCache(ScriptCacheKey(CTransaction(tx), flags),
+                                    false, nSigChecks));
+
+    // Loading the dump restores both the salt and the cached value.
+    BOOST_CHECK(LoadScriptExecutionCache(dump_path));
+    BOOST_CHECK(IsKeyInScriptCache(ScriptCacheKey(CTransaction(tx), flags),
+                                   false, nSigChecks));
+    BOOST_CHECK_EQUAL(nSigChecks, 7);
+
+    // A truncated file is rejected and leaves the cache untouched.
+    {
+        CAutoFile file{fsbridge::fopen(other_path, "wb"), SER_DISK,
+                       CLIENT_VERSION};
+        file << uint64_t{1} << GetRandHash() << uint64_t{1};
+    }
+    BOOST_CHECK(!LoadScriptExecutionCache(other_path));
+    BOOST_CHECK(IsKeyInScriptCache(ScriptCacheKey(CTransaction(tx), flags),
+                                   false, nSigChecks));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
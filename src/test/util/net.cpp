@@ -76,21 +76,7 @@ void ConnmanTestMsg::NodeReceiveMsgBytes(CNode &node,
                                          bool &complete) const {
     assert(node.ReceiveMsgBytes(*config, msg_bytes, complete));
     if (complete) {
-        size_t nSizeAdded = 0;
-        auto it(node.vRecvMsg.begin());
-        for (; it != node.vRecvMsg.end(); ++it) {
-            // vRecvMsg contains only completed CNetMessage
-            // the single possible partially deserialized message are held by
-            // TransportDeserializer
-            nSizeAdded += it->m_raw_message_size;
-        }
-        {
-            LOCK(node.cs_vProcessMsg);
-            node.vProcessMsg.splice(node.vProcessMsg.end(), node.vRecvMsg,
-                                    node.vRecvMsg.begin(), it);
-            node.nProcessQueueSize += nSizeAdded;
-            node.fPauseRecv = node.nProcessQueueSize > nReceiveFloodSize;
-        }
+        node.MarkReceivedMsgsForProcessing(nReceiveFloodSize);
     }
 }
 
@@ -101,7 +87,7 @@ bool ConnmanTestMsg::ReceiveMsgFrom(CNode &node,
 
     bool complete;
     NodeReceiveMsgBytes(node, ser_msg_header, complete);
-    NodeReceiveMsgBytes(node, ser_msg.data, complete);
+    NodeReceiveMsgBytes(node, ser_msg.Payload(), complete);
     return complete;
 }
 
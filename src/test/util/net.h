@@ -65,6 +65,7 @@ constexpr NetPermissionFlags ALL_NET_PERMISSION_FLAGS[]{
     NetPermissionFlags::NoBan,    NetPermissionFlags::Mempool,
     NetPermissionFlags::Addr,     NetPermissionFlags::Download,
     NetPermissionFlags::Implicit, NetPermissionFlags::All,
+    NetPermissionFlags::Compress,
 };
 
 constexpr ConnectionType ALL_CONNECTION_TYPES[]{
@@ -15,6 +15,7 @@
 #include <util/fs.h>
 #include <util/fs_helpers.h>
 #include <util/getuniquepath.h>
+#include <util/histogram.h>
 #include <util/message.h> // For MessageSign(), MessageVerify(), MESSAGE_MAGIC
 #include <util/moneystr.h>
 #include <util/spanparsing.h>
@@ -2924,4 +2925,45 @@ BOOST_AUTO_TEST_CASE(remove_prefix) {
     BOOST_CHECK_EQUAL(RemovePrefix("", ""), "");
 }
 
+BOOST_AUTO_TEST_CASE(latency_histogram) {
+    LatencyHistogram histogram;
+    BOOST_CHECK_EQUAL(histogram.count, 0U);
+    BOOST_CHECK(histogram.Average() == 0us);
+    BOOST_CHECK(histogram.Percentile(0.5) == 0us);
+
+    histogram.Add(0us);
+    // Negative durations, e.g. from clock adjustments, are counted as 0.
+    histogram.Add(-5us);
+    histogram.Add(1us);
+    histogram.Add(3us);
+    histogram.Add(1ms);
+    // Out of range durations go to the last bucket.
+    histogram.Add(1h);
+
+    BOOST_CHECK_EQUAL(histogram.count, 6U);
+    BOOST_CHECK(histogram.total == 1h + 1ms + 4us);
+    BOOST_CHECK(histogram.max == 1h);
+    BOOST_CHECK(histogram.Average() == (1h + 1ms + 4us) / 6);
+    BOOST_CHECK_EQUAL(histogram.buckets[0], 2U);
+    BOOST_CHECK_EQUAL(histogram.buckets[1], 1U);
+    BOOST_CHECK_EQUAL(histogram.buckets[2], 1U);
+    BOOST_CHECK_EQUAL(histogram.buckets[10], 1U);
+    BOOST_CHECK_EQUAL(histogram.buckets[LatencyHistogram::NUM_BUCKETS - 1], 1U);
+
+    BOOST_CHECK(histogram.Percentile(0) == 1us);
+    BOOST_CHECK(histogram.Percentile(0.5) == 4us);
+    BOOST_CHECK(histogram.Percentile(0.8) == 1024us);
+    BOOST_CHECK(histogram.Percentile(0.9) ==
+                std::chrono::microseconds{1 << 26});
+    BOOST_CHECK(histogram.Percentile(1) == 1h);
+
+    LatencyHistogram other;
+    other.Add(2ms);
+    histogram.Merge(other);
+    BOOST_CHECK_EQUAL(histogram.count, 7U);
+    BOOST_CHECK(histogram.total == 1h + 3ms + 4us);
+    BOOST_CHECK(histogram.max == 1h);
+    BOOST_CHECK_EQUAL(histogram.buckets[11], 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -26,27 +26,49 @@
 #include <cmath>
 #include <limits>
 
+namespace {
+/**
+ * Add or remove a link in the sorted parents or children of an entry. Returns
+ * whether the links changed.
+ */
+template <typename Links>
+bool UpdateLinks(Links &links, const CTxMemPoolEntryRef &entry, bool add) {
+    const auto ref = std::cref(entry);
+    auto it = std::lower_bound(links.begin(), links.end(), ref,
+                               CompareIteratorById());
+    const bool found = it != links.end() && !CompareIteratorById()(ref, *it);
+    if (add == found) {
+        return false;
+    }
+
+    if (add) {
+        links.insert(it, ref);
+    } else {
+        links.erase(it);
+    }
+    return true;
+}
+} // namespace
+
 bool CTxMemPool::CalculateAncestors(
-    setEntries &setAncestors,
-    CTxMemPoolEntry::Parents &staged_ancestors) const {
-    while (!staged_ancestors.empty()) {
-        const auto stage = staged_ancestors.begin()->get();
+    setEntries &setAncestors, std::vector<txiter> &staged_ancestors) const {
+    WITH_FRESH_EPOCH(m_epoch);
+    for (txiter it : setAncestors) {
+        visited(it);
+    }
 
-        txiter stageit = mapTx.find(stage->GetTx().GetId());
-        assert(stageit != mapTx.end());
+    while (!staged_ancestors.empty()) {
+        const txiter stageit = staged_ancestors.back();
+        staged_ancestors.pop_back();
+        if (visited(stageit)) {
+            continue;
+        }
         setAncestors.insert(stageit);
-        staged_ancestors.erase(staged_ancestors.begin());
 
-        const CTxMemPoolEntry::Parents &parents =
-            (*stageit)->GetMemPoolParentsConst();
-        for (const auto &parent : parents) {
-            txiter parent_it = mapTx.find(parent.get()->GetTx().GetId());
-            assert(parent_it != mapTx.end());
-
-            // If this is a new ancestor, add it.
-            if (setAncestors.count(parent_it) == 0) {
-                staged_ancestors.insert(parent);
-            }
+        // The parents are references to the mapTx elements themselves, so
+        // there is no need to look them up by txid.
+        for (const auto &parent : (*stageit)->GetMemPoolParentsConst()) {
+            staged_ancestors.push_back(mapTx.iterator_to(parent.get()));
         }
     }
 
@@ -56,7 +78,7 @@ bool CTxMemPool::CalculateAncestors(
 bool CTxMemPool::CalculateMemPoolAncestors(
     const CTxMemPoolEntryRef &entry, setEntries &setAncestors,
     bool fSearchForParents /* = true */) const {
-    CTxMemPoolEntry::Parents staged_ancestors;
+    std::vector<txiter> staged_ancestors;
     const CTransaction &tx = entry->GetTx();
 
     if (fSearchForParents) {
@@ -68,12 +90,14 @@ bool CTxMemPool::CalculateMemPoolAncestors(
             if (!piter) {
                 continue;
             }
-            staged_ancestors.insert(**piter);
+            staged_ancestors.push_back(*piter);
         }
     } else {
         // If we're not searching for parents, we require this to be an entry in
         // the mempool already.
-        staged_ancestors = entry->GetMemPoolParentsConst();
+        for (const auto &parent : entry->GetMemPoolParentsConst()) {
+            staged_ancestors.push_back(mapTx.iterator_to(parent.get()));
+        }
     }
 
     return CalculateAncestors(setAncestors, staged_ancestors);
@@ -82,9 +106,7 @@ bool CTxMemPool::CalculateMemPoolAncestors(
 void CTxMemPool::UpdateParentsOf(bool add, txiter it) {
     // add or remove this tx as a child of each parent
     for (const auto &parent : (*it)->GetMemPoolParentsConst()) {
-        auto parent_it = mapTx.find(parent.get()->GetTx().GetId());
-        assert(parent_it != mapTx.end());
-        UpdateChild(parent_it, it, add);
+        UpdateChild(mapTx.iterator_to(parent.get()), it, add);
     }
 }
 
@@ -92,13 +114,12 @@ void CTxMemPool::UpdateChildrenForRemoval(txiter it) {
     const CTxMemPoolEntry::Children &children =
         (*it)->GetMemPoolChildrenConst();
     for (const auto &child : children) {
-        auto updateIt = mapTx.find(child.get()->GetTx().GetId());
-        assert(updateIt != mapTx.end());
-        UpdateParent(updateIt, it, false);
+        UpdateParent(mapTx.iterator_to(child.get()), it, false);
     }
 }
 
-void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove) {
+void CTxMemPool::UpdateForRemoveFromMempool(
+    const std::vector<txiter> &entriesToRemove) {
     for (txiter removeIt : entriesToRemove) {
         // Note that UpdateParentsOf severs the child links that point to
         // removeIt in the entries for the parents of removeIt.
@@ -153,6 +174,8 @@ void CTxMemPool::addUnchecked(CTxMemPoolEntryRef entry) {
         ApplyDelta(entry->GetTx().GetId(), feeDelta);
         entry->UpdateFeeDelta(feeDelta);
     }
+    m_fee_histogram.Add(entry->GetModifiedFeeRate(),
+                        entry->GetTxVirtualSize());
 
     // Add to memory pool without checking anything.
     // Used by AcceptToMemoryPool(), which DOES do all the appropriate checks.
@@ -163,6 +186,20 @@ void CTxMemPool::addUnchecked(CTxMemPoolEntryRef entry) {
     // Sanity check: We should always end up inserting at the end of the
     // entry_id index
     assert(&*mapTx.get<entry_id>().rbegin() == &*newit);
+    m_txIndex.insert(entry);
+    if (finalizedTxs.get(entry->GetTx().GetId())) {
+        // A finalized transaction is back after a reorg.
+        m_finalized_sorted.reset();
+    }
+
+    std::vector<txiter> &expiry_bucket =
+        m_expiry_buckets
+            .emplace_hint(m_expiry_buckets.end(),
+                          count_seconds(entry->GetTime()),
+                          std::vector<txiter>{})
+            ->second;
+    entry->m_expiry_pos = expiry_bucket.size();
+    expiry_bucket.push_back(newit);
 
     // Update cachedInnerUsage to include contained transaction's usage.
     // (When we update the entry for in-mempool parents, memory usage will be
@@ -198,6 +235,10 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
 
     const TxId &txid = (*it)->GetTx().GetId();
 
+    if (finalizedTxs.get(txid)) {
+        m_finalized_sorted.reset();
+    }
+
     if (reason != MemPoolRemovalReason::BLOCK) {
         // Notify clients that a transaction has been removed from the mempool
         // for any reason except being included in a block. Clients interested
@@ -216,12 +257,38 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
     /* add logging because unchecked */
     RemoveUnbroadcastTx(txid, true);
 
+    auto expiry_it = m_expiry_buckets.find(count_seconds((*it)->GetTime()));
+    assert(expiry_it != m_expiry_buckets.end());
+    std::vector<txiter> &expiry_bucket = expiry_it->second;
+    const size_t expiry_pos = (*it)->m_expiry_pos;
+    assert(expiry_bucket[expiry_pos] == it);
+    if (expiry_pos + 1 != expiry_bucket.size()) {
+        // Move the last entry of the bucket into the freed position
+        expiry_bucket[expiry_pos] = expiry_bucket.back();
+        (*expiry_bucket[expiry_pos])->m_expiry_pos = expiry_pos;
+    }
+    expiry_bucket.pop_back();
+    if (expiry_bucket.empty()) {
+        m_expiry_buckets.erase(expiry_it);
+    }
+
+    if (reason == MemPoolRemovalReason::BLOCK) {
+        const CFeeRate feerate((*it)->GetFee(), (*it)->GetTxVirtualSize());
+        if (!m_connecting_block_min_feerate ||
+            feerate < *m_connecting_block_min_feerate) {
+            m_connecting_block_min_feerate = feerate;
+        }
+    }
+    m_fee_histogram.Remove((*it)->GetModifiedFeeRate(),
+                           (*it)->GetTxVirtualSize());
+
     totalTxSize -= (*it)->GetTxSize();
     m_total_fee -= (*it)->GetFee();
     cachedInnerUsage -= (*it)->DynamicMemoryUsage();
     cachedInnerUsage -=
         memusage::DynamicUsage((*it)->GetMemPoolParentsConst()) +
         memusage::DynamicUsage((*it)->GetMemPoolChildrenConst());
+    m_txIndex.remove(txid);
     mapTx.erase(it);
     nTransactionsUpdated++;
 }
@@ -234,26 +301,54 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
 // time by not iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit,
                                       setEntries &setDescendants) const {
-    setEntries stage;
+    std::vector<txiter> stage;
     if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
+        stage.push_back(entryit);
     }
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have
     // either already been walked, or will be walked in this iteration).
     while (!stage.empty()) {
-        txiter it = *stage.begin();
-        setDescendants.insert(it);
-        stage.erase(stage.begin());
+        txiter it = stage.back();
+        stage.pop_back();
+        if (!setDescendants.insert(it).second) {
+            // Reached through another path before it was popped
+            continue;
+        }
 
         const CTxMemPoolEntry::Children &children =
             (*it)->GetMemPoolChildrenConst();
         for (const auto &child : children) {
-            txiter childiter = mapTx.find(child.get()->GetTx().GetId());
-            assert(childiter != mapTx.end());
-
+            txiter childiter = mapTx.iterator_to(child.get());
             if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+                stage.push_back(childiter);
+            }
+        }
+    }
+}
+
+void CTxMemPool::CalculateDescendants(const std::vector<txiter> &roots,
+                                      std::vector<txiter> &descendants) const {
+    WITH_FRESH_EPOCH(m_epoch);
+    for (txiter it : descendants) {
+        visited(it);
+    }
+
+    std::vector<txiter> stage;
+    for (txiter root : roots) {
+        if (!visited(root)) {
+            stage.push_back(root);
+        }
+    }
+    while (!stage.empty()) {
+        const txiter it = stage.back();
+        stage.pop_back();
+        descendants.push_back(it);
+
+        for (const auto &child : (*it)->GetMemPoolChildrenConst()) {
+            const txiter childiter = mapTx.iterator_to(child.get());
+            if (!visited(childiter)) {
+                stage.push_back(childiter);
             }
         }
     }
@@ -263,10 +358,10 @@ void CTxMemPool::removeRecursive(const CTransaction &origTx,
                                  MemPoolRemovalReason reason) {
     // Remove transaction from memory pool.
     AssertLockHeld(cs);
-    setEntries txToRemove;
+    std::vector<txiter> txToRemove;
     txiter origit = mapTx.find(origTx.GetId());
     if (origit != mapTx.end()) {
-        txToRemove.insert(origit);
+        txToRemove.push_back(origit);
     } else {
         // When recursively removing but origTx isn't in the mempool be sure to
         // remove any children that are in the pool. This can happen during
@@ -277,17 +372,15 @@ void CTxMemPool::removeRecursive(const CTransaction &origTx,
                it->first->GetTxId() == origTx.GetId()) {
             txiter nextit = mapTx.find(it->second->GetId());
             assert(nextit != mapTx.end());
-            txToRemove.insert(nextit);
+            txToRemove.push_back(nextit);
             ++it;
         }
     }
 
-    setEntries setAllRemoves;
-    for (txiter it : txToRemove) {
-        CalculateDescendants(it, setAllRemoves);
-    }
+    std::vector<txiter> allRemoves;
+    CalculateDescendants(txToRemove, allRemoves);
 
-    RemoveStaged(setAllRemoves, reason);
+    RemoveStaged(allRemoves, reason);
 }
 
 void CTxMemPool::removeConflicts(const CTransaction &tx) {
@@ -305,6 +398,35 @@ void CTxMemPool::removeConflicts(const CTransaction &tx) {
     }
 }
 
+void CTxMemPool::removeConflicts(const std::vector<CTransactionRef> &vtx) {
+    AssertLockHeld(cs);
+    std::vector<txiter> conflicts;
+    for (const CTransactionRef &tx : vtx) {
+        for (const CTxIn &txin : tx->vin) {
+            auto it = mapNextTx.find(txin.prevout);
+            if (it == mapNextTx.end() || *it->second == *tx) {
+                continue;
+            }
+
+            const TxId &conflictId = it->second->GetId();
+            ClearPrioritisation(conflictId);
+            txiter conflictit = mapTx.find(conflictId);
+            assert(conflictit != mapTx.end());
+            conflicts.push_back(conflictit);
+        }
+    }
+
+    if (conflicts.empty()) {
+        return;
+    }
+
+    // Walk the descendants of all the conflicts at once, a conflict reached
+    // from another one is only removed once.
+    std::vector<txiter> stage;
+    CalculateDescendants(conflicts, stage);
+    RemoveStaged(stage, MemPoolRemovalReason::CONFLICT);
+}
+
 /**
  * Called when a block is connected. Updates the miner fee estimator.
  */
@@ -313,6 +435,11 @@ void CTxMemPool::updateFeeForBlock() {
 
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = true;
+
+    if (m_connecting_block_min_feerate) {
+        m_block_feerates.AddBlock(*m_connecting_block_min_feerate);
+        m_connecting_block_min_feerate.reset();
+    }
 }
 
 void CTxMemPool::removeForFinalizedBlock(
@@ -328,12 +455,50 @@ void CTxMemPool::removeForFinalizedBlock(
     }
 }
 
+const std::vector<CTxMemPoolEntryRef> &
+CTxMemPool::GetFinalizedTxsSorted() const {
+    AssertLockHeld(cs);
+
+    if (m_finalized_sorted) {
+        return *m_finalized_sorted;
+    }
+
+    std::vector<CTxMemPoolEntryRef> sorted;
+    finalizedTxs.forEachLeaf([&](const CTxMemPoolEntryRef &leaf) {
+        // Mined transactions stay in the tree until the block is finalized,
+        // and a transaction re-added after a reorg has a new entry.
+        auto it = mapTx.find(leaf->GetTx().GetId());
+        if (it != mapTx.end()) {
+            sorted.push_back(*it);
+        }
+        return true;
+    });
+    std::sort(sorted.begin(), sorted.end(),
+              [](const CTxMemPoolEntryRef &a, const CTxMemPoolEntryRef &b) {
+                  return a->GetEntryId() < b->GetEntryId();
+              });
+
+    m_finalized_sorted = std::move(sorted);
+    return *m_finalized_sorted;
+}
+
 void CTxMemPool::_clear() {
     mapTx.clear();
+    {
+        // Lock free readers may still be walking the index, so swap an empty
+        // one in rather than clearing it in place. The nodes of the old one
+        // are freed by RCU cleanups, once these readers are done.
+        RadixTree<CTxMemPoolEntry, MemPoolEntryRadixTreeAdapter> old_index{
+            std::move(m_txIndex)};
+    }
+    m_expiry_buckets.clear();
+    m_finalized_sorted.reset();
     mapNextTx.clear();
     totalTxSize = 0;
     m_total_fee = Amount::zero();
     cachedInnerUsage = 0;
+    m_fee_histogram.Clear();
+    m_connecting_block_min_feerate.reset();
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
     rollingMinimumFeeRate = 0;
@@ -376,7 +541,9 @@ void CTxMemPool::check(const CCoinsViewCache &active_coins_tip,
         innerUsage += memusage::DynamicUsage(entry->GetMemPoolParentsConst()) +
                       memusage::DynamicUsage(entry->GetMemPoolChildrenConst());
 
-        CTxMemPoolEntry::Parents setParentCheck;
+        std::set<std::reference_wrapper<const CTxMemPoolEntryRef>,
+                 CompareIteratorById>
+            setParentCheck;
         for (const CTxIn &txin : tx.vin) {
             // Check that every mempool transaction's inputs refer to available
             // coins, or other mempool tx's.
@@ -421,7 +588,9 @@ void CTxMemPool::check(const CCoinsViewCache &active_coins_tip,
         }
 
         // Check children against mapNextTx
-        CTxMemPoolEntry::Children setChildrenCheck;
+        std::set<std::reference_wrapper<const CTxMemPoolEntryRef>,
+                 CompareIteratorById>
+            setChildrenCheck;
         auto iter = mapNextTx.lower_bound(COutPoint(entry->GetTx().GetId(), 0));
         for (; iter != mapNextTx.end() &&
                iter->first->GetTxId() == entry->GetTx().GetId();
@@ -455,6 +624,17 @@ void CTxMemPool::check(const CCoinsViewCache &active_coins_tip,
         assert((*it)->GetSharedTx() == nextTx);
     }
 
+    size_t expiry_entries = 0;
+    for (const auto &[bucket_time, bucket] : m_expiry_buckets) {
+        assert(!bucket.empty());
+        for (size_t i = 0; i < bucket.size(); ++i) {
+            assert(count_seconds((*bucket[i])->GetTime()) == bucket_time);
+            assert((*bucket[i])->m_expiry_pos == i);
+        }
+        expiry_entries += bucket.size();
+    }
+    assert(expiry_entries == mapTx.size());
+
     assert(totalTxSize == checkTotal);
     assert(m_total_fee == check_total_fee);
     assert(innerUsage == cachedInnerUsage);
@@ -507,13 +687,12 @@ std::vector<TxMempoolInfo> CTxMemPool::infoAll() const {
 }
 
 CTransactionRef CTxMemPool::get(const TxId &txid) const {
-    LOCK(cs);
-    indexed_transaction_set::const_iterator i = mapTx.find(txid);
-    if (i == mapTx.end()) {
+    auto entry = m_txIndex.get(txid);
+    if (!entry) {
         return nullptr;
     }
 
-    return (*i)->GetSharedTx();
+    return entry->GetSharedTx();
 }
 
 TxMempoolInfo CTxMemPool::info(const TxId &txid) const {
@@ -536,6 +715,23 @@ CFeeRate CTxMemPool::estimateFee() const {
     return std::max(m_min_relay_feerate, GetMinFee());
 }
 
+CFeeRate CTxMemPool::EstimateInclusionFee(uint64_t block_size) const {
+    LOCK(cs);
+    return std::max({m_min_relay_feerate, GetMinFee(),
+                     m_fee_histogram.GetFeeRateForSize(block_size),
+                     m_block_feerates.GetMedian()});
+}
+
+std::vector<FeeRateHistogram::Bucket> CTxMemPool::GetFeeHistogram() const {
+    LOCK(cs);
+    return m_fee_histogram.GetBuckets();
+}
+
+size_t CTxMemPool::GetFeeEstimateBlocks() const {
+    LOCK(cs);
+    return m_block_feerates.Size();
+}
+
 void CTxMemPool::PrioritiseTransaction(const TxId &txid,
                                        const Amount nFeeDelta) {
     {
@@ -544,9 +740,13 @@ void CTxMemPool::PrioritiseTransaction(const TxId &txid,
         delta += nFeeDelta;
         txiter it = mapTx.find(txid);
         if (it != mapTx.end()) {
+            m_fee_histogram.Remove((*it)->GetModifiedFeeRate(),
+                                   (*it)->GetTxVirtualSize());
             mapTx.modify(it, [&delta](CTxMemPoolEntryRef &e) {
                 e->UpdateFeeDelta(delta);
             });
+            m_fee_histogram.Add((*it)->GetModifiedFeeRate(),
+                                (*it)->GetTxVirtualSize());
             ++nTransactionsUpdated;
         }
     }
@@ -668,30 +868,33 @@ void CTxMemPool::RemoveUnbroadcastTx(const TxId &txid, const bool unchecked) {
 
 void CTxMemPool::RemoveStaged(const setEntries &stage,
                               MemPoolRemovalReason reason) {
+    std::vector<txiter> vstage(stage.begin(), stage.end());
+    RemoveStaged(vstage, reason);
+}
+
+void CTxMemPool::RemoveStaged(std::vector<txiter> &stage,
+                              MemPoolRemovalReason reason) {
     AssertLockHeld(cs);
     UpdateForRemoveFromMempool(stage);
 
     // Remove txs in reverse-topological order
-    const setRevTopoEntries stageRevTopo(stage.begin(), stage.end());
-    for (txiter it : stageRevTopo) {
+    std::sort(stage.begin(), stage.end(), CompareIteratorByRevEntryId());
+    for (txiter it : stage) {
         removeUnchecked(it, reason);
     }
 }
 
 int CTxMemPool::Expire(std::chrono::seconds time) {
     AssertLockHeld(cs);
-    indexed_transaction_set::index<entry_time>::type::iterator it =
-        mapTx.get<entry_time>().begin();
-    setEntries toremove;
-    while (it != mapTx.get<entry_time>().end() && (*it)->GetTime() < time) {
-        toremove.insert(mapTx.project<0>(it));
-        it++;
+    std::vector<txiter> toremove;
+    for (auto it = m_expiry_buckets.begin();
+         it != m_expiry_buckets.end() && it->first < count_seconds(time);
+         ++it) {
+        toremove.insert(toremove.end(), it->second.begin(), it->second.end());
     }
 
-    setEntries stage;
-    for (txiter removeit : toremove) {
-        CalculateDescendants(removeit, stage);
-    }
+    std::vector<txiter> stage;
+    CalculateDescendants(toremove, stage);
 
     RemoveStaged(stage, MemPoolRemovalReason::EXPIRY);
     return stage.size();
@@ -715,21 +918,21 @@ void CTxMemPool::LimitSize(CCoinsViewCache &coins_cache) {
 
 void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add) {
     AssertLockHeld(cs);
-    CTxMemPoolEntry::Children s;
-    if (add && (*entry)->GetMemPoolChildren().insert(*child).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && (*entry)->GetMemPoolChildren().erase(*child)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    CTxMemPoolEntry::Children &children = (*entry)->GetMemPoolChildren();
+    const size_t usage_before = memusage::DynamicUsage(children);
+    if (UpdateLinks(children, *child, add)) {
+        cachedInnerUsage -= usage_before;
+        cachedInnerUsage += memusage::DynamicUsage(children);
     }
 }
 
 void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add) {
     AssertLockHeld(cs);
-    CTxMemPoolEntry::Parents s;
-    if (add && (*entry)->GetMemPoolParents().insert(*parent).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && (*entry)->GetMemPoolParents().erase(*parent)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    CTxMemPoolEntry::Parents &parents = (*entry)->GetMemPoolParents();
+    const size_t usage_before = memusage::DynamicUsage(parents);
+    if (UpdateLinks(parents, *parent, add)) {
+        cachedInnerUsage -= usage_before;
+        cachedInnerUsage += memusage::DynamicUsage(parents);
     }
 }
 
@@ -785,8 +988,8 @@ void CTxMemPool::TrimToSize(size_t sizelimit,
         trackPackageRemoved(removed);
         maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
 
-        setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
+        std::vector<txiter> stage;
+        CalculateDescendants({mapTx.project<0>(it)}, stage);
         nTxnRemoved += stage.size();
 
         if (pvNoSpendsRemaining) {
@@ -13,6 +13,7 @@
 #include <kernel/cs_main.h>
 #include <kernel/mempool_entry.h>
 #include <kernel/mempool_options.h>
+#include <policy/fees.h>
 #include <policy/packages.h>
 #include <primitives/transaction.h>
 #include <radix.h>
@@ -20,6 +21,7 @@
 #include <txconflicting.h>
 #include <txorphanage.h>
 #include <uint256radixkey.h>
+#include <util/epochguard.h>
 #include <util/hasher.h>
 
 #include <boost/multi_index/hashed_index.hpp>
@@ -69,14 +71,6 @@ struct MemPoolEntryRadixTreeAdapter {
     }
 };
 
-// used by the entry_time index
-struct CompareTxMemPoolEntryByEntryTime {
-    bool operator()(const CTxMemPoolEntryRef &a,
-                    const CTxMemPoolEntryRef &b) const {
-        return a->GetTime() < b->GetTime();
-    }
-};
-
 // used by the entry_id index
 struct CompareTxMemPoolEntryByEntryId {
     bool operator()(const CTxMemPoolEntryRef &a,
@@ -120,7 +114,6 @@ struct CompareTxMemPoolEntryByModifiedFeeRate {
 };
 
 // Multi_index tag names
-struct entry_time {};
 struct modified_feerate {};
 struct entry_id {};
 
@@ -229,6 +222,13 @@ private:
     //! minimum fee to get into the pool, decreases exponentially
     mutable double rollingMinimumFeeRate GUARDED_BY(cs);
 
+    //! mempool transactions by modified feerate
+    FeeRateHistogram m_fee_histogram GUARDED_BY(cs);
+    //! lowest feerate of the mempool txs mined in the last blocks
+    RecentBlockFeeRates m_block_feerates GUARDED_BY(cs);
+    //! lowest feerate of the mempool txs mined in the block being connected
+    std::optional<CFeeRate> m_connecting_block_min_feerate GUARDED_BY(cs);
+
     // In-memory counter for external mempool tracking purposes.
     // This number is incremented once every time a transaction
     // is added or removed from the mempool for any reason.
@@ -265,11 +265,6 @@ public:
                 boost::multi_index::tag<modified_feerate>,
                 boost::multi_index::identity<CTxMemPoolEntryRef>,
                 CompareTxMemPoolEntryByModifiedFeeRate>,
-            // sorted by entry time
-            boost::multi_index::ordered_non_unique<
-                boost::multi_index::tag<entry_time>,
-                boost::multi_index::identity<CTxMemPoolEntryRef>,
-                CompareTxMemPoolEntryByEntryTime>,
             // sorted topologically (insertion order)
             boost::multi_index::ordered_unique<
                 boost::multi_index::tag<entry_id>,
@@ -314,6 +309,34 @@ public:
     RadixTree<CTxMemPoolEntry, MemPoolEntryRadixTreeAdapter> finalizedTxs;
 
 private:
+    /**
+     * Index of all the mempool entries by txid, kept in sync with mapTx. It is
+     * only written to while holding cs but can be read without it, so lookups
+     * by txid don't wait for AcceptToMemoryPool to finish its script checks.
+     */
+    RadixTree<CTxMemPoolEntry, MemPoolEntryRadixTreeAdapter> m_txIndex;
+
+    mutable Epoch m_epoch GUARDED_BY(cs){};
+
+    /**
+     * The finalized transactions that are still in the mempool, in entry id
+     * (hence topological) order. It is built from finalizedTxs on demand and
+     * kept until a finalized entry is added to or removed from the mempool, so
+     * the block assembler doesn't walk the radix tree and sort on every
+     * template.
+     */
+    mutable std::optional<std::vector<CTxMemPoolEntryRef>>
+        m_finalized_sorted GUARDED_BY(cs);
+
+    /**
+     * Mempool entries bucketed by entry time, in seconds, for Expire(). Entries
+     * mostly arrive in time order so they are appended to the last bucket in
+     * amortized constant time, and each entry records its position in its
+     * bucket so it is removed in constant time after the bucket lookup.
+     * Expire() only visits the buckets it empties.
+     */
+    std::map<int64_t, std::vector<txiter>> m_expiry_buckets GUARDED_BY(cs);
+
     void UpdateParent(txiter entry, txiter parent, bool add)
         EXCLUSIVE_LOCKS_REQUIRED(cs);
     void UpdateChild(txiter entry, txiter child, bool add)
@@ -327,12 +350,14 @@ private:
 
     /**
      * Helper function to calculate all in-mempool ancestors of staged_ancestors
-     * param@[in]   staged_ancestors    Should contain entries in the mempool.
+     * param@[in]   staged_ancestors    Should contain entries in the mempool,
+     *                                  duplicates are allowed. Used as the
+     *                                  traversal stack.
      * param@[out]  setAncestors        Will be populated with all mempool
      *                                  ancestors.
      */
     bool CalculateAncestors(setEntries &setAncestors,
-                            CTxMemPoolEntry::Parents &staged_ancestors) const
+                            std::vector<txiter> &staged_ancestors) const
         EXCLUSIVE_LOCKS_REQUIRED(cs);
 
 public:
@@ -375,6 +400,13 @@ public:
     void removeRecursive(const CTransaction &tx, MemPoolRemovalReason reason)
         EXCLUSIVE_LOCKS_REQUIRED(cs);
     void removeConflicts(const CTransaction &tx) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /**
+     * Remove the mempool transactions spending an input of any of vtx, and
+     * their descendants, as a single staged removal. None of vtx should be in
+     * the mempool.
+     */
+    void removeConflicts(const std::vector<CTransactionRef> &vtx)
+        EXCLUSIVE_LOCKS_REQUIRED(cs);
     void updateFeeForBlock() EXCLUSIVE_LOCKS_REQUIRED(cs);
     void removeForFinalizedBlock(const std::vector<CTransactionRef> &vtx)
         EXCLUSIVE_LOCKS_REQUIRED(cs);
@@ -423,6 +455,9 @@ public:
      */
     void RemoveStaged(const setEntries &stage, MemPoolRemovalReason reason)
         EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Same as above, the stage is reordered in place. */
+    void RemoveStaged(std::vector<txiter> &stage, MemPoolRemovalReason reason)
+        EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     /**
      * Try to calculate all in-mempool ancestors of entry.
@@ -443,6 +478,15 @@ public:
      */
     void CalculateDescendants(txiter it, setEntries &setDescendants) const
         EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /**
+     * Append to descendants all the in-mempool descendants of the roots,
+     * including the roots themselves, that are not already in it. Each entry
+     * is added once. The walk is marked with an epoch rather than a set, so it
+     * doesn't allocate beyond the output and the traversal stack.
+     */
+    void CalculateDescendants(const std::vector<txiter> &roots,
+                              std::vector<txiter> &descendants) const
+        EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     /**
      * The minimum fee to get into the mempool, which may itself not be enough
@@ -500,14 +544,24 @@ public:
         return m_total_fee;
     }
 
+    /**
+     * Lock free, see m_txIndex. Can be called from within an RCU read
+     * section.
+     */
     bool exists(const TxId &txid) const {
-        LOCK(cs);
-        return mapTx.count(txid) != 0;
+        return m_txIndex.get(txid) != nullptr;
     }
 
     bool setAvalancheFinalized(const CTxMemPoolEntryRef &tx)
         EXCLUSIVE_LOCKS_REQUIRED(cs) {
-        return finalizedTxs.insert(tx);
+        if (!finalizedTxs.insert(tx)) {
+            return false;
+        }
+
+        // The block template content depends on the finalized set.
+        m_finalized_sorted.reset();
+        ++nTransactionsUpdated;
+        return true;
     }
 
     bool isAvalancheFinalized(const TxId &txid) const {
@@ -515,12 +569,38 @@ public:
         return finalizedTxs.get(txid) != nullptr;
     }
 
+    /**
+     * Get the finalized transactions that are in the mempool, parents before
+     * children. The result is cached until the finalized set changes.
+     */
+    const std::vector<CTxMemPoolEntryRef> &GetFinalizedTxsSorted() const
+        EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /**
+     * Lock free, see m_txIndex. Can be called from within an RCU read
+     * section.
+     */
     CTransactionRef get(const TxId &txid) const;
     TxMempoolInfo info(const TxId &txid) const;
     std::vector<TxMempoolInfo> infoAll() const;
 
     CFeeRate estimateFee() const;
 
+    /**
+     * Estimate the feerate needed to be included in the next block of the
+     * given size. This is the highest of the minimum mempool feerate, the
+     * feerate placing a transaction among the best block_size bytes of the
+     * mempool and the median lowest feerate mined in the recent blocks. It
+     * only reads the fee histogram and never walks the mempool.
+     */
+    CFeeRate EstimateInclusionFee(uint64_t block_size) const;
+
+    /** Return the fee histogram buckets, highest feerate first */
+    std::vector<FeeRateHistogram::Bucket> GetFeeHistogram() const;
+
+    /** Number of recent blocks the inclusion estimate is based upon */
+    size_t GetFeeEstimateBlocks() const;
+
     size_t DynamicMemoryUsage() const;
 
     /** Adds a transaction to the unbroadcast set */
@@ -557,6 +637,18 @@ public:
         return m_sequence_number;
     }
 
+    /**
+     * Call func for each transaction in the mempool, in no particular order,
+     * until it returns false. This doesn't take cs: transactions added or
+     * removed concurrently may or may not be visited. func runs under the RCU
+     * read lock, which is not reentrant: it can call exists() and get(), but
+     * nothing else that takes the RCU lock or cs.
+     */
+    template <typename Callable> bool forEachTx(Callable &&func) const {
+        return m_txIndex.forEachLeaf(
+            [&](const auto &entry) { return func(entry->GetSharedTx()); });
+    }
+
     template <typename Callable>
     auto withOrphanage(Callable &&func) const
         EXCLUSIVE_LOCKS_REQUIRED(!cs_orphanage) {
@@ -585,7 +677,7 @@ private:
      * For each transaction being removed, update ancestors and any direct
      * children.
      */
-    void UpdateForRemoveFromMempool(const setEntries &entriesToRemove)
+    void UpdateForRemoveFromMempool(const std::vector<txiter> &entriesToRemove)
         EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** Sever link between specified transaction and direct children. */
     void UpdateChildrenForRemoval(txiter entry) EXCLUSIVE_LOCKS_REQUIRED(cs);
@@ -600,6 +692,14 @@ private:
      */
     void removeUnchecked(txiter entry, MemPoolRemovalReason reason)
         EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    /**
+     * Mark the entry as visited in the current epoch. Returns true if it had
+     * already been visited.
+     */
+    bool visited(txiter it) const EXCLUSIVE_LOCKS_REQUIRED(cs, m_epoch) {
+        return m_epoch.visited((*it)->m_epoch_marker);
+    }
 };
 
 /**
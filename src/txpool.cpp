@@ -10,6 +10,7 @@
 #include <policy/policy.h>
 #include <random.h>
 
+#include <algorithm>
 #include <cassert>
 
 bool TxPool::AddTx(const CTransactionRef &tx, NodeId peer) {
@@ -31,19 +32,27 @@ bool TxPool::AddTx(const CTransactionRef &tx, NodeId peer) {
         return false;
     }
 
+    PeerTxs &peer_txs = m_peers[peer];
     auto ret = m_pool_txs.emplace(
-        txid,
-        PoolTx{tx, peer, Now<NodeSeconds>() + expireTime, m_txs_list.size()});
+        txid, PoolTx{tx, peer, Now<NodeSeconds>() + expireTime,
+                     peer_txs.txs.size()});
     assert(ret.second);
-    m_txs_list.push_back(ret.first);
+    const PoolTxRef ref = &*ret.first;
+    m_peers_by_usage.erase(GetPeerUsage(peer, peer_txs));
+    peer_txs.txs.push_back(ref);
+    peer_txs.total_size += sz;
+    m_peers_by_usage.insert(GetPeerUsage(peer, peer_txs));
     for (const CTxIn &txin : tx->vin) {
-        m_outpoint_to_tx_it[txin.prevout].insert(ret.first);
+        std::vector<PoolTxRef> &spenders = m_outpoint_to_tx[txin.prevout];
+        // The tx might spend the same outpoint twice, don't index it twice
+        if (spenders.empty() || spenders.back() != ref) {
+            spenders.push_back(ref);
+        }
     }
 
     LogPrint(BCLog::TXPACKAGES,
              "stored %s tx %s, size: %u (mapsz %u outsz %u)\n", txKind,
-             txid.ToString(), sz, m_pool_txs.size(),
-             m_outpoint_to_tx_it.size());
+             txid.ToString(), sz, m_pool_txs.size(), m_outpoint_to_tx.size());
     return true;
 }
 
@@ -54,29 +63,43 @@ int TxPool::EraseTx(const TxId &txid) {
 
 int TxPool::EraseTxNoLock(const TxId &txid) {
     AssertLockHeld(m_mutex);
-    std::map<TxId, PoolTx>::iterator it = m_pool_txs.find(txid);
+    PoolTxMap::iterator it = m_pool_txs.find(txid);
     if (it == m_pool_txs.end()) {
         return 0;
     }
+    const PoolTxRef ref = &*it;
     for (const CTxIn &txin : it->second.tx->vin) {
-        auto itPrev = m_outpoint_to_tx_it.find(txin.prevout);
-        if (itPrev == m_outpoint_to_tx_it.end()) {
+        auto itPrev = m_outpoint_to_tx.find(txin.prevout);
+        if (itPrev == m_outpoint_to_tx.end()) {
             continue;
         }
-        itPrev->second.erase(it);
-        if (itPrev->second.empty()) {
-            m_outpoint_to_tx_it.erase(itPrev);
+        std::vector<PoolTxRef> &spenders = itPrev->second;
+        spenders.erase(std::remove(spenders.begin(), spenders.end(), ref),
+                       spenders.end());
+        if (spenders.empty()) {
+            m_outpoint_to_tx.erase(itPrev);
         }
     }
 
-    size_t old_pos = it->second.list_pos;
-    assert(m_txs_list[old_pos] == it);
-    if (old_pos + 1 != m_txs_list.size()) {
-        // Unless we're deleting the last entry in m_txs_list, move the last
-        // entry to the position we're deleting.
-        auto it_last = m_txs_list.back();
-        m_txs_list[old_pos] = it_last;
-        it_last->second.list_pos = old_pos;
+    auto peer_it = m_peers.find(it->second.fromPeer);
+    assert(peer_it != m_peers.end());
+    PeerTxs &peer_txs = peer_it->second;
+    m_peers_by_usage.erase(GetPeerUsage(peer_it->first, peer_txs));
+    const size_t peer_pos = it->second.peer_pos;
+    assert(peer_txs.txs[peer_pos] == ref);
+    if (peer_pos + 1 != peer_txs.txs.size()) {
+        // Unless we're deleting the last entry in the peer's list, move the
+        // last entry to the position we're deleting.
+        auto it_last = peer_txs.txs.back();
+        peer_txs.txs[peer_pos] = it_last;
+        it_last->second.peer_pos = peer_pos;
+    }
+    peer_txs.txs.pop_back();
+    peer_txs.total_size -= it->second.tx->GetTotalSize();
+    if (!peer_txs.txs.empty()) {
+        m_peers_by_usage.insert(GetPeerUsage(peer_it->first, peer_txs));
+    } else if (peer_txs.work_set.empty()) {
+        m_peers.erase(peer_it);
     }
 
     // Time spent in pool = difference between current and entry time.
@@ -85,7 +108,6 @@ int TxPool::EraseTxNoLock(const TxId &txid) {
              txid.ToString(),
              Ticks<std::chrono::seconds>(NodeClock::now() + expireTime -
                                          it->second.nTimeExpire));
-    m_txs_list.pop_back();
 
     m_pool_txs.erase(it);
     return 1;
@@ -94,17 +116,24 @@ int TxPool::EraseTxNoLock(const TxId &txid) {
 void TxPool::EraseForPeer(NodeId peer) {
     LOCK(m_mutex);
 
-    m_peer_work_set.erase(peer);
+    auto peer_it = m_peers.find(peer);
+    if (peer_it == m_peers.end()) {
+        return;
+    }
+
+    // Copy the txids, erasing shrinks the peer's list and eventually drops it
+    std::vector<TxId> txids;
+    txids.reserve(peer_it->second.txs.size());
+    for (const PoolTxRef &ref : peer_it->second.txs) {
+        txids.push_back(ref->first);
+    }
+    peer_it->second.work_set.clear();
 
     int nErased = 0;
-    std::map<TxId, PoolTx>::iterator iter = m_pool_txs.begin();
-    while (iter != m_pool_txs.end()) {
-        // increment to avoid iterator becoming invalid after erasure
-        const auto &[txid, orphan] = *iter++;
-        if (orphan.fromPeer == peer) {
-            nErased += EraseTxNoLock(txid);
-        }
+    for (const TxId &txid : txids) {
+        nErased += EraseTxNoLock(txid);
     }
+    m_peers.erase(peer);
     if (nErased > 0) {
         LogPrint(BCLog::TXPACKAGES,
                  "Erased %d %s transaction(s) from peer=%d\n", nErased, txKind,
@@ -121,9 +150,9 @@ unsigned int TxPool::LimitTxs(unsigned int max_txs, FastRandomContext &rng) {
         // Sweep out expired orphan pool entries:
         int nErased = 0;
         auto nMinExpTime{nNow + expireTime - expireInterval};
-        std::map<TxId, PoolTx>::iterator iter = m_pool_txs.begin();
+        PoolTxMap::iterator iter = m_pool_txs.begin();
         while (iter != m_pool_txs.end()) {
-            std::map<TxId, PoolTx>::iterator maybeErase = iter++;
+            PoolTxMap::iterator maybeErase = iter++;
             if (maybeErase->second.nTimeExpire <= nNow) {
                 nErased += EraseTxNoLock(maybeErase->second.tx->GetId());
             } else {
@@ -139,10 +168,15 @@ unsigned int TxPool::LimitTxs(unsigned int max_txs, FastRandomContext &rng) {
                      nErased, txKind);
         }
     }
+    // Each peer's budget is an equal share of the pool. While the pool is over
+    // its limit at least one peer is over its budget, so evict a random tx of
+    // the peer that provided the most: a peer flooding the pool only pushes
+    // out its own transactions.
     while (m_pool_txs.size() > max_txs) {
-        // Evict a random tx:
-        size_t randompos = rng.randrange(m_txs_list.size());
-        EraseTxNoLock(m_txs_list[randompos]->first);
+        assert(!m_peers_by_usage.empty());
+        const NodeId worst{std::get<2>(*m_peers_by_usage.rbegin())};
+        const std::vector<PoolTxRef> &txs = m_peers.at(worst).txs;
+        EraseTxNoLock(txs[rng.randrange(txs.size())]->first);
         ++nEvicted;
     }
     return nEvicted;
@@ -152,15 +186,12 @@ void TxPool::AddChildrenToWorkSet(const CTransaction &tx) {
     LOCK(m_mutex);
 
     for (size_t i = 0; i < tx.vout.size(); i++) {
-        const auto it_by_prev =
-            m_outpoint_to_tx_it.find(COutPoint(tx.GetId(), i));
-        if (it_by_prev != m_outpoint_to_tx_it.end()) {
+        const auto it_by_prev = m_outpoint_to_tx.find(COutPoint(tx.GetId(), i));
+        if (it_by_prev != m_outpoint_to_tx.end()) {
             for (const auto &elem : it_by_prev->second) {
-                // Get this peer's work set, emplacing an empty set if it didn't
-                // exist
+                // The peer that provided a pooled tx is always tracked
                 std::set<TxId> &work_set =
-                    m_peer_work_set.try_emplace(elem->second.fromPeer)
-                        .first->second;
+                    m_peers.at(elem->second.fromPeer).work_set;
                 // Add this tx to the work set
                 work_set.insert(elem->first);
                 LogPrint(BCLog::TXPACKAGES,
@@ -193,14 +224,13 @@ TxPool::GetConflictTxs(const CTransactionRef &tx) const {
 
     std::vector<CTransactionRef> conflictingTxs;
     for (const auto &txin : tx->vin) {
-        auto itByPrev = m_outpoint_to_tx_it.find(txin.prevout);
-        if (itByPrev == m_outpoint_to_tx_it.end()) {
+        auto itByPrev = m_outpoint_to_tx.find(txin.prevout);
+        if (itByPrev == m_outpoint_to_tx.end()) {
             continue;
         }
 
-        for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end();
-             ++mi) {
-            conflictingTxs.push_back((*mi)->second.tx);
+        for (const PoolTxRef &ref : itByPrev->second) {
+            conflictingTxs.push_back(ref->second.tx);
         }
     }
     return conflictingTxs;
@@ -209,9 +239,9 @@ TxPool::GetConflictTxs(const CTransactionRef &tx) const {
 CTransactionRef TxPool::GetTxToReconsider(NodeId peer) {
     LOCK(m_mutex);
 
-    auto work_set_it = m_peer_work_set.find(peer);
-    if (work_set_it != m_peer_work_set.end()) {
-        auto &work_set = work_set_it->second;
+    auto peer_it = m_peers.find(peer);
+    if (peer_it != m_peers.end()) {
+        auto &work_set = peer_it->second.work_set;
         while (!work_set.empty()) {
             TxId txid = *work_set.begin();
             work_set.erase(work_set.begin());
@@ -228,35 +258,62 @@ CTransactionRef TxPool::GetTxToReconsider(NodeId peer) {
 bool TxPool::HaveTxToReconsider(NodeId peer) {
     LOCK(m_mutex);
 
-    auto work_set_it = m_peer_work_set.find(peer);
-    if (work_set_it != m_peer_work_set.end()) {
-        auto &work_set = work_set_it->second;
-        return !work_set.empty();
+    auto peer_it = m_peers.find(peer);
+    if (peer_it != m_peers.end()) {
+        return !peer_it->second.work_set.empty();
     }
     return false;
 }
 
-void TxPool::EraseForBlock(const CBlock &block) {
+size_t TxPool::GetPeerTxCount(NodeId peer) const {
     LOCK(m_mutex);
 
-    std::vector<TxId> vTxErase;
+    auto peer_it = m_peers.find(peer);
+    return peer_it != m_peers.end() ? peer_it->second.txs.size() : 0;
+}
+
+size_t TxPool::GetPeerTxBytes(NodeId peer) const {
+    LOCK(m_mutex);
 
+    auto peer_it = m_peers.find(peer);
+    return peer_it != m_peers.end() ? peer_it->second.total_size : 0;
+}
+
+std::vector<COutPoint> TxPool::GetSpentOutpoints(const CBlock &block) {
+    std::vector<COutPoint> outpoints;
     for (const CTransactionRef &ptx : block.vtx) {
-        const CTransaction &tx = *ptx;
+        if (ptx->IsCoinBase()) {
+            continue;
+        }
+        for (const auto &txin : ptx->vin) {
+            outpoints.push_back(txin.prevout);
+        }
+    }
+    return outpoints;
+}
 
-        // Which pool entries must we evict?
-        for (const auto &txin : tx.vin) {
-            auto itByPrev = m_outpoint_to_tx_it.find(txin.prevout);
-            if (itByPrev == m_outpoint_to_tx_it.end()) {
-                continue;
-            }
+void TxPool::EraseForBlock(const CBlock &block) {
+    EraseSpending(GetSpentOutpoints(block));
+}
 
-            for (auto mi = itByPrev->second.begin();
-                 mi != itByPrev->second.end(); ++mi) {
-                const CTransaction &orphanTx = *(*mi)->second.tx;
-                const TxId &txid = orphanTx.GetId();
-                vTxErase.push_back(txid);
-            }
+void TxPool::EraseSpending(const std::vector<COutPoint> &outpoints) {
+    LOCK(m_mutex);
+
+    if (m_pool_txs.empty()) {
+        return;
+    }
+
+    std::vector<TxId> vTxErase;
+
+    // Which pool entries must we evict?
+    for (const COutPoint &outpoint : outpoints) {
+        auto itByPrev = m_outpoint_to_tx.find(outpoint);
+        if (itByPrev == m_outpoint_to_tx.end()) {
+            continue;
+        }
+
+        for (const PoolTxRef &ref : itByPrev->second) {
+            vTxErase.push_back(ref->first);
         }
     }
 
@@ -280,14 +337,14 @@ TxPool::GetChildrenFromSamePeer(const CTransactionRef &parent,
 
     // First construct a vector of iterators to ensure we do not return
     // duplicates of the same tx and so we can sort by nTimeExpire.
-    std::vector<PoolTxMap::iterator> iters;
+    std::vector<PoolTxRef> iters;
 
     // For each output, get all entries spending this prevout, filtering for
     // ones from the specified peer.
     for (unsigned int i = 0; i < parent->vout.size(); i++) {
         const auto it_by_prev =
-            m_outpoint_to_tx_it.find(COutPoint(parent->GetId(), i));
-        if (it_by_prev != m_outpoint_to_tx_it.end()) {
+            m_outpoint_to_tx.find(COutPoint(parent->GetId(), i));
+        if (it_by_prev != m_outpoint_to_tx.end()) {
             for (const auto &elem : it_by_prev->second) {
                 if (elem->second.fromPeer == nodeid) {
                     iters.emplace_back(elem);
@@ -302,7 +359,7 @@ TxPool::GetChildrenFromSamePeer(const CTransactionRef &parent,
     // possible for txs to have the same expiry.
     std::sort(iters.begin(), iters.end(), [](const auto &lhs, const auto &rhs) {
         if (lhs->second.nTimeExpire == rhs->second.nTimeExpire) {
-            return &(*lhs) < &(*rhs);
+            return lhs < rhs;
         }
         return lhs->second.nTimeExpire > rhs->second.nTimeExpire;
     });
@@ -325,14 +382,14 @@ TxPool::GetChildrenFromDifferentPeer(const CTransactionRef &parent,
 
     // First construct vector of iterators to ensure we do not return duplicates
     // of the same tx.
-    std::vector<PoolTxMap::iterator> iters;
+    std::vector<PoolTxRef> iters;
 
     // For each output, get all entries spending this prevout, filtering for
     // ones not from the specified peer.
     for (unsigned int i = 0; i < parent->vout.size(); i++) {
         const auto it_by_prev =
-            m_outpoint_to_tx_it.find(COutPoint(parent->GetId(), i));
-        if (it_by_prev != m_outpoint_to_tx_it.end()) {
+            m_outpoint_to_tx.find(COutPoint(parent->GetId(), i));
+        if (it_by_prev != m_outpoint_to_tx.end()) {
             for (const auto &elem : it_by_prev->second) {
                 if (elem->second.fromPeer != nodeid) {
                     iters.emplace_back(elem);
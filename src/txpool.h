@@ -9,11 +9,14 @@
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <sync.h>
+#include <util/hasher.h>
 #include <util/time.h>
 
 #include <chrono>
-#include <map>
 #include <set>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 class FastRandomContext;
@@ -61,7 +64,21 @@ public:
     /** Erase all txs included in or invalidated by a new block */
     void EraseForBlock(const CBlock &block) EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
-    /** Limit the txs to the given maximum */
+    /**
+     * Erase all txs spending any of the outpoints, e.g. the ones spent by a
+     * new block. This lets several pools share the block's outpoints instead
+     * of walking the block each.
+     */
+    void EraseSpending(const std::vector<COutPoint> &outpoints)
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Gather the outpoints spent by the non-coinbase txs of a block */
+    static std::vector<COutPoint> GetSpentOutpoints(const CBlock &block);
+
+    /**
+     * Limit the txs to the given maximum. The evicted txs are taken from the
+     * peers that provided more than an equal share of the pool.
+     */
     unsigned int LimitTxs(unsigned int max_txs, FastRandomContext &rng)
         EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
@@ -92,6 +109,14 @@ public:
                                  NodeId nodeid) const
         EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
 
+    /** Return how many entries the peer provided that are still pooled */
+    size_t GetPeerTxCount(NodeId peer) const
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
+    /** Return the total size of the entries the peer provided */
+    size_t GetPeerTxBytes(NodeId peer) const
+        EXCLUSIVE_LOCKS_REQUIRED(!m_mutex);
+
     /** Return how many entries exist in the pool */
     size_t Size() const EXCLUSIVE_LOCKS_REQUIRED(!m_mutex) {
         LOCK(m_mutex);
@@ -113,19 +138,23 @@ protected:
         CTransactionRef tx;
         NodeId fromPeer;
         NodeSeconds nTimeExpire;
-        size_t list_pos;
+        //! Position in the announcing peer's PeerTxs::txs
+        size_t peer_pos;
     };
 
+    using PoolTxMap = std::unordered_map<TxId, PoolTx, SaltedTxIdHasher>;
+
     /**
      * Map from txid to pool transaction record. Should be size constrained by
      * calling LimitTxs() with the desired max size.
      */
-    std::map<TxId, PoolTx> m_pool_txs GUARDED_BY(m_mutex);
-
-    /** Which peer provided the transactions that need to be reconsidered */
-    std::map<NodeId, std::set<TxId>> m_peer_work_set GUARDED_BY(m_mutex);
+    PoolTxMap m_pool_txs GUARDED_BY(m_mutex);
 
-    using PoolTxMap = decltype(m_pool_txs);
+    /**
+     * Pointer to a m_pool_txs element. Unlike the map iterators, it remains
+     * valid when the map rehashes.
+     */
+    using PoolTxRef = PoolTxMap::value_type *;
 
     struct IteratorComparator {
         template <typename I> bool operator()(const I &a, const I &b) const {
@@ -133,15 +162,40 @@ protected:
         }
     };
 
+    /** Per peer accounting of the pool transactions */
+    struct PeerTxs {
+        /** Transactions provided by the peer */
+        std::vector<PoolTxRef> txs;
+        /** Total size of these transactions */
+        size_t total_size{0};
+        /** Transactions that need to be reconsidered */
+        std::set<TxId> work_set;
+    };
+
+    /**
+     * The peers that provided transactions or have work to do. An entry is
+     * dropped once both are empty.
+     */
+    std::unordered_map<NodeId, PeerTxs> m_peers GUARDED_BY(m_mutex);
+
+    using PeerUsage = std::tuple<size_t, size_t, NodeId>;
+    static PeerUsage GetPeerUsage(NodeId peer, const PeerTxs &peer_txs) {
+        return {peer_txs.txs.size(), peer_txs.total_size, peer};
+    }
+
+    /**
+     * The peers that provided transactions, ordered by the count and then the
+     * total size of these transactions, so LimitTxs() finds the one that
+     * provided the most in O(log n).
+     */
+    std::set<PeerUsage> m_peers_by_usage GUARDED_BY(m_mutex);
+
     /**
      * Index from the parents' COutPoint into the m_pool_txs. Used to remove
      * transactions from the m_pool_txs
      */
-    std::map<COutPoint, std::set<PoolTxMap ::iterator, IteratorComparator>>
-        m_outpoint_to_tx_it GUARDED_BY(m_mutex);
-
-    /** Pool transactions in vector for quick random eviction */
-    std::vector<PoolTxMap::iterator> m_txs_list GUARDED_BY(m_mutex);
+    std::unordered_map<COutPoint, std::vector<PoolTxRef>, SaltedOutpointHasher>
+        m_outpoint_to_tx GUARDED_BY(m_mutex);
 
     /** Erase a transaction by txid */
     int EraseTxNoLock(const TxId &txid) EXCLUSIVE_LOCKS_REQUIRED(m_mutex);
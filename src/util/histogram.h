@@ -0,0 +1,82 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTIL_HISTOGRAM_H
+#define BITCOIN_UTIL_HISTOGRAM_H
+
+#include <crypto/common.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Distribution of durations over power of two buckets: bucket 0 counts the
+ * durations under 1 microsecond, bucket i the ones in [2^(i-1), 2^i)
+ * microseconds and the last bucket all the longer ones. Adding a duration
+ * only takes a few instructions, so it can be done on hot paths.
+ */
+struct LatencyHistogram {
+    //! The last bucket starts at 2^26us, about 67 seconds.
+    static constexpr size_t NUM_BUCKETS{28};
+
+    std::array<uint64_t, NUM_BUCKETS> buckets{};
+    //! Number of durations added
+    uint64_t count{0};
+    //! Sum of the durations added
+    std::chrono::microseconds total{0};
+    //! Longest duration added
+    std::chrono::microseconds max{0};
+
+    void Add(std::chrono::microseconds duration) {
+        duration = std::max(duration, std::chrono::microseconds{0});
+        const uint64_t bucket{CountBits(uint64_t(duration.count()))};
+        ++buckets[std::min<uint64_t>(bucket, NUM_BUCKETS - 1)];
+        ++count;
+        total += duration;
+        max = std::max(max, duration);
+    }
+
+    void Merge(const LatencyHistogram &other) {
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            buckets[i] += other.buckets[i];
+        }
+        count += other.count;
+        total += other.total;
+        max = std::max(max, other.max);
+    }
+
+    std::chrono::microseconds Average() const {
+        return count ? total / int64_t(count) : std::chrono::microseconds{0};
+    }
+
+    /**
+     * Upper bound of the durations counted in a bucket. The last bucket has
+     * no bound and its lower bound is returned instead.
+     */
+    static std::chrono::microseconds BucketLimit(size_t bucket) {
+        return std::chrono::microseconds{
+            int64_t{1} << std::min(bucket, NUM_BUCKETS - 2)};
+    }
+
+    /**
+     * Estimate the duration below which a fraction of the added durations
+     * fall, as the upper bound of the bucket reaching that fraction.
+     */
+    std::chrono::microseconds Percentile(double fraction) const {
+        const uint64_t target(fraction * count);
+        uint64_t seen{0};
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            seen += buckets[i];
+            if (seen > target) {
+                return std::min(BucketLimit(i), max);
+            }
+        }
+        return max;
+    }
+};
+
+#endif // BITCOIN_UTIL_HISTOGRAM_H
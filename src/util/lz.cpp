@@ -0,0 +1,189 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <util/lz.h>
+
+#include <crypto/common.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+/** Matches shorter than this are not worth encoding. */
+constexpr size_t MIN_MATCH{4};
+/** Largest distance a match can refer back to. */
+constexpr size_t MAX_OFFSET{65535};
+/** The last bytes of the input are always encoded as literals. */
+constexpr size_t LAST_LITERALS{5};
+/** No match can start within this many bytes of the end of the input. */
+constexpr size_t MATCH_FIND_LIMIT{12};
+/** Length values of a token that continue in the following bytes. */
+constexpr size_t TOKEN_LENGTH_MASK{15};
+constexpr int HASH_BITS{16};
+/**
+ * The search step grows with the number of bytes since the last match, so
+ * incompressible data such as hashes and signatures is skipped quickly.
+ */
+constexpr int SKIP_STRENGTH{6};
+
+uint32_t HashSequence(uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32 - HASH_BITS);
+}
+
+void WriteLength(std::vector<uint8_t> &output, size_t length) {
+    for (; length >= 255; length -= 255) {
+        output.push_back(255);
+    }
+    output.push_back(uint8_t(length));
+}
+
+/** Write the literals followed by a match, if any. */
+void WriteSequence(std::vector<uint8_t> &output, Span<const uint8_t> literals,
+                   size_t match_length, size_t offset) {
+    const size_t match_token = match_length ? match_length - MIN_MATCH : 0;
+    output.push_back(
+        uint8_t((std::min(literals.size(), TOKEN_LENGTH_MASK) << 4) |
+                std::min(match_token, TOKEN_LENGTH_MASK)));
+    if (literals.size() >= TOKEN_LENGTH_MASK) {
+        WriteLength(output, literals.size() - TOKEN_LENGTH_MASK);
+    }
+    output.insert(output.end(), literals.begin(), literals.end());
+
+    if (match_length == 0) {
+        return;
+    }
+    output.push_back(uint8_t(offset));
+    output.push_back(uint8_t(offset >> 8));
+    if (match_token >= TOKEN_LENGTH_MASK) {
+        WriteLength(output, match_token - TOKEN_LENGTH_MASK);
+    }
+}
+
+bool ReadLength(Span<const uint8_t> input, size_t &pos, size_t &length) {
+    uint8_t byte;
+    do {
+        if (pos >= input.size()) {
+            return false;
+        }
+        byte = input[pos++];
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+} // namespace
+
+void LZCompress(Span<const uint8_t> input, std::vector<uint8_t> &output) {
+    output.reserve(output.size() + input.size() + input.size() / 255 + 16);
+
+    size_t anchor = 0;
+    if (input.size() > MATCH_FIND_LIMIT) {
+        // Positions of the last sequences of 4 bytes seen with each hash.
+        std::vector<uint32_t> table(size_t{1} << HASH_BITS, 0);
+        const size_t match_limit = input.size() - LAST_LITERALS;
+        const size_t search_limit = input.size() - MATCH_FIND_LIMIT;
+
+        size_t pos = 0;
+        while (pos <= search_limit) {
+            const uint32_t sequence = ReadLE32(&input[pos]);
+            uint32_t &entry = table[HashSequence(sequence)];
+            const size_t candidate = entry;
+            entry = uint32_t(pos);
+            if (candidate >= pos || pos - candidate > MAX_OFFSET ||
+                ReadLE32(&input[candidate]) != sequence) {
+                pos += 1 + ((pos - anchor) >> SKIP_STRENGTH);
+                continue;
+            }
+
+            size_t start = pos;
+            size_t match_start = candidate;
+            size_t length = MIN_MATCH;
+            while (pos + length < match_limit &&
+                   input[candidate + length] == input[pos + length]) {
+                ++length;
+            }
+            // The match may also extend over the preceding literals.
+            while (start > anchor && match_start > 0 &&
+                   input[start - 1] == input[match_start - 1]) {
+                --start;
+                --match_start;
+                ++length;
+            }
+
+            WriteSequence(output, input.subspan(anchor, start - anchor),
+                          length, start - match_start);
+            pos = start + length;
+            anchor = pos;
+        }
+    }
+
+    WriteSequence(output, input.subspan(anchor), /*match_length=*/0,
+                  /*offset=*/0);
+}
+
+bool LZDecompress(Span<const uint8_t> input, Span<uint8_t> output) {
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    while (true) {
+        if (in_pos >= input.size()) {
+            return false;
+        }
+        const uint8_t token = input[in_pos++];
+
+        size_t literals = token >> 4;
+        if (literals == TOKEN_LENGTH_MASK &&
+            !ReadLength(input, in_pos, literals)) {
+            return false;
+        }
+        if (literals > input.size() - in_pos ||
+            literals > output.size() - out_pos) {
+            return false;
+        }
+        if (literals > 0) {
+            std::memcpy(output.data() + out_pos, input.data() + in_pos,
+                        literals);
+        }
+        in_pos += literals;
+        out_pos += literals;
+
+        // The last sequence has no match.
+        if (in_pos == input.size()) {
+            break;
+        }
+
+        if (input.size() - in_pos < 2) {
+            return false;
+        }
+        const size_t offset = input[in_pos] | (input[in_pos + 1] << 8);
+        in_pos += 2;
+        if (offset == 0 || offset > out_pos) {
+            return false;
+        }
+
+        size_t length = token & TOKEN_LENGTH_MASK;
+        if (length == TOKEN_LENGTH_MASK && !ReadLength(input, in_pos, length)) {
+            return false;
+        }
+        length += MIN_MATCH;
+        if (length > output.size() - out_pos) {
+            return false;
+        }
+
+        uint8_t *dest = output.data() + out_pos;
+        const uint8_t *src = dest - offset;
+        if (offset >= length) {
+            std::memcpy(dest, src, length);
+        } else {
+            // The match overlaps the bytes it produces, e.g. a run of a
+            // repeated pattern, so it has to be copied in order.
+            for (size_t i = 0; i < length; ++i) {
+                dest[i] = src[i];
+            }
+        }
+        out_pos += length;
+    }
+
+    return out_pos == output.size();
+}
@@ -0,0 +1,32 @@
+// Copyright (c) 2024 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTIL_LZ_H
+#define BITCOIN_UTIL_LZ_H
+
+#include <span.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * A fast LZ77 compressor using the LZ4 block format: a sequence of tokens,
+ * each one made of literals copied as is followed by a match referring to up
+ * to 64KiB of previously decompressed data. It trades compression ratio for
+ * speed, so it can be used on the network path.
+ */
+
+/** Compress input and append the result to output. */
+void LZCompress(Span<const uint8_t> input, std::vector<uint8_t> &output);
+
+/**
+ * Decompress input into output, which must be sized to the exact size of the
+ * decompressed data.
+ *
+ * @return false if input is malformed or does not decompress to exactly
+ *         output.size() bytes.
+ */
+bool LZDecompress(Span<const uint8_t> input, Span<uint8_t> output);
+
+#endif // BITCOIN_UTIL_LZ_H
@@ -9,6 +9,7 @@
 #define PASTE2(x, y) PASTE(x, y)
 
 #define UNIQUE_LOG_NAME(name) PASTE2(name, __COUNTER__)
+#define UNIQUE_NAME(name) PASTE2(name, __COUNTER__)
 
 /**
  * Converts the parameter X to a string after macro replacement on X has been
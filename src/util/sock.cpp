@@ -23,6 +23,11 @@
 #include <poll.h>
 #endif
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 static inline bool IOErrorIsPermanent(int err) {
     return err != WSAEAGAIN && err != WSAEINTR && err != WSAEWOULDBLOCK &&
            err != WSAEINPROGRESS;
@@ -418,3 +423,96 @@ bool CloseSocket(SOCKET &hSocket) {
     hSocket = INVALID_SOCKET;
     return ret != SOCKET_ERROR;
 }
+
+#ifdef USE_EPOLL
+SockEpoll::SockEpoll() : m_epoll_fd{epoll_create1(EPOLL_CLOEXEC)} {
+    if (m_epoll_fd == -1) {
+        throw std::runtime_error(
+            strprintf("epoll_create1(): %s", SysErrorString(errno)));
+    }
+
+    m_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_event_fd == -1) {
+        const int err{errno};
+        close(m_epoll_fd);
+        throw std::runtime_error(
+            strprintf("eventfd(): %s", SysErrorString(err)));
+    }
+
+    // Level triggered, the counter is reset by Wait().
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = INTERRUPT_ID;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_event_fd, &ev) != 0) {
+        const int err{errno};
+        close(m_event_fd);
+        close(m_epoll_fd);
+        throw std::runtime_error(
+            strprintf("epoll_ctl(): %s", SysErrorString(err)));
+    }
+}
+
+SockEpoll::~SockEpoll() {
+    close(m_event_fd);
+    close(m_epoll_fd);
+}
+
+bool SockEpoll::Add(const Sock &sock, uint64_t id, bool edge_triggered) {
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+    if (edge_triggered) {
+        ev.events |= EPOLLET;
+    }
+    ev.data.u64 = id;
+    return epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, sock.Get(), &ev) == 0;
+}
+
+bool SockEpoll::Remove(const Sock &sock) {
+    return epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, sock.Get(), nullptr) == 0;
+}
+
+bool SockEpoll::Wait(std::chrono::milliseconds timeout,
+                     ReadySocks &ready) const {
+    ready.clear();
+
+    epoll_event events[MAX_READY_SOCKS];
+    const int n = epoll_wait(m_epoll_fd, events, MAX_READY_SOCKS,
+                             count_milliseconds(timeout));
+    if (n == -1) {
+        // Being interrupted by a signal is the same as a timeout.
+        return errno == EINTR;
+    }
+
+    ready.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        if (events[i].data.u64 == INTERRUPT_ID) {
+            uint64_t count;
+            // Fails with EAGAIN if another Wait() already reset it.
+            [[maybe_unused]] const ssize_t drained{
+                read(m_event_fd, &count, sizeof(count))};
+            continue;
+        }
+        Sock::Event occurred = 0;
+        if (events[i].events & EPOLLIN) {
+            occurred |= Sock::RECV;
+        }
+        if (events[i].events & EPOLLOUT) {
+            occurred |= Sock::SEND;
+        }
+        if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+            occurred |= Sock::ERR;
+        }
+        const uint64_t id{events[i].data.u64};
+        ready.emplace_back(id, occurred);
+    }
+
+    return true;
+}
+
+bool SockEpoll::Interrupt() const {
+    const uint64_t one{1};
+    // EAGAIN means the counter is saturated: a wake-up is pending anyway.
+    return write(m_event_fd, &one, sizeof(one)) == sizeof(one) ||
+           errno == EAGAIN;
+}
+#endif /* USE_EPOLL */
@@ -13,6 +13,8 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 /**
  * Maximum time to wait for I/O readiness.
@@ -268,4 +270,71 @@ std::string NetworkErrorString(int err);
 /** Close socket and set hSocket to INVALID_SOCKET */
 bool CloseSocket(SOCKET &hSocket);
 
+#ifdef USE_EPOLL
+/**
+ * Persistent epoll(7) set of sockets. Unlike `Sock::WaitMany()`, the sockets
+ * are registered once and waiting only costs in the number of sockets that
+ * are ready, not in the number of sockets being watched.
+ */
+class SockEpoll {
+public:
+    /**
+     * @throws std::runtime_error if the epoll instance cannot be created.
+     */
+    SockEpoll();
+    ~SockEpoll();
+
+    SockEpoll(const SockEpoll &) = delete;
+    SockEpoll &operator=(const SockEpoll &) = delete;
+
+    /**
+     * Start watching a socket for reads, writes and errors.
+     * @param[in] sock The socket to watch.
+     * @param[in] id Identifier reported by `Wait()` when the socket is ready.
+     *     INTERRUPT_ID is reserved.
+     * @param[in] edge_triggered Only report when the readiness changes rather
+     *     than for as long as the socket stays ready. The caller must then
+     *     read or write until the operation would block before it can expect
+     *     another report.
+     * @return true on success
+     */
+    bool Add(const Sock &sock, uint64_t id, bool edge_triggered);
+
+    /**
+     * Stop watching a socket. A closed socket is removed automatically.
+     * @return true on success
+     */
+    bool Remove(const Sock &sock);
+
+    using ReadySocks = std::vector<std::pair<uint64_t, Sock::Event>>;
+
+    /**
+     * Wait for some of the watched sockets to become ready.
+     * @param[in] timeout Wait this long for at least one socket to be ready.
+     * @param[out] ready The identifier and the occurred events of each ready
+     *     socket.
+     * @return true on success (or timeout or interruption, if `ready` is
+     *     returned empty), false otherwise
+     */
+    bool Wait(std::chrono::milliseconds timeout, ReadySocks &ready) const;
+
+    /**
+     * Make the current or the next `Wait()` return early. Safe to call from
+     * any thread.
+     * @return true on success
+     */
+    bool Interrupt() const;
+
+    /** Identifier of the eventfd(2) used by `Interrupt()`. */
+    static constexpr uint64_t INTERRUPT_ID{~uint64_t{0}};
+
+private:
+    /** Maximum number of ready sockets reported by a single `Wait()`. */
+    static constexpr int MAX_READY_SOCKS = 256;
+
+    int m_epoll_fd;
+    int m_event_fd;
+};
+#endif
+
 #endif // BITCOIN_UTIL_SOCK_H
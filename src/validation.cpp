@@ -92,6 +92,7 @@ using node::BlockManager;
 using node::BlockMap;
 using node::fReindex;
 using node::SnapshotMetadata;
+using node::SnapshotStatsWorker;
 using node::UNDOFILE_CHUNK_SIZE;
 
 #define MICRO 0.000001
@@ -290,6 +291,27 @@ static bool CheckInputsFromMempoolAndCache(
                              /*scriptCacheStore=*/true, txdata, nSigChecksOut);
 }
 
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+
+void StartScriptCheckWorkerThreads(int threads_num) {
+    scriptcheckqueue.StartWorkerThreads(threads_num);
+}
+
+void StopScriptCheckWorkerThreads() {
+    scriptcheckqueue.StopWorkerThreads();
+}
+
+/**
+ * Policy flags, on top of the next block's consensus flags, used to check the
+ * scripts of the transactions entering the mempool.
+ */
+static uint32_t
+GetStandardScriptVerifyFlags(const Consensus::Params &params) {
+    return IsLegacyScriptRulesEnabled(params)
+               ? STANDARD_SCRIPT_VERIFY_FLAGS_LEGACY
+               : STANDARD_SCRIPT_VERIFY_FLAGS;
+}
+
 namespace {
 
 class MemPoolAccept {
@@ -467,8 +489,8 @@ private:
         }
         /**
          * Mempool entry constructed for this transaction.
-         * Constructed in PreChecks() but not inserted into the mempool until
-         * Finalize().
+         * Constructed in PolicyScriptChecks() but not inserted into the mempool
+         * until Finalize().
          */
         std::unique_ptr<CTxMemPoolEntry> m_entry;
 
@@ -497,19 +519,25 @@ private:
          */
         CFeeRate m_package_feerate{Amount::zero()};
 
+        /** Lock points for the next block, computed in PreChecks(). */
+        LockPoints m_lock_points;
+
         const CTransactionRef &m_ptx;
         TxValidationState m_state;
         /**
          * A temporary cache containing serialized transaction data for
          * signature verification.
-         * Reused across PreChecks and ConsensusScriptChecks.
+         * Reused across PolicyScriptChecks and ConsensusScriptChecks.
          */
         PrecomputedTransactionData m_precomputed_txdata;
 
-        // ABC specific flags that are used in both PreChecks and
+        // ABC specific flags that are used in both PolicyScriptChecks and
         // ConsensusScriptChecks
         const uint32_t m_next_block_script_verify_flags;
         int m_sig_checks_standard;
+        //! Whether ParallelScriptChecks() verified the scripts with the policy
+        //! flags, in which case m_sig_checks_standard is already set.
+        bool m_scripts_verified{false};
     };
 
     // Run the policy checks on a given transaction, excluding any script
@@ -520,6 +548,24 @@ private:
     bool PreChecks(ATMPArgs &args, Workspace &ws)
         EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
 
+    // Verify the input scripts of all the given transactions on the script
+    // check queue workers, spreading the inputs of all the transactions over
+    // them. The queue only tells whether all of them passed: if so the
+    // transactions are marked as verified and PolicyScriptChecks() doesn't run
+    // their scripts again. Otherwise it checks them one by one to find the
+    // failure and its reason, mostly hitting the signature cache. The
+    // transactions must have passed PreChecks().
+    void ParallelScriptChecks(const ATMPArgs &args,
+                              const std::vector<Workspace *> &workspaces)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
+
+    // Run the script checks using our policy flags. As this can be slow, we
+    // should only invoke this on transactions that have passed PreChecks().
+    // This also creates the mempool entry, which needs the sigchecks count
+    // to compute the virtual size, and checks the individual feerate.
+    bool PolicyScriptChecks(const ATMPArgs &args, Workspace &ws)
+        EXCLUSIVE_LOCKS_REQUIRED(cs_main, m_pool.cs);
+
     // Re-run the script checks, using consensus flags, and try to cache the
     // result in the scriptcache. This should be done after
     // PolicyScriptChecks(). This requires that all inputs either be in our
@@ -586,15 +632,11 @@ private:
 bool MemPoolAccept::PreChecks(ATMPArgs &args, Workspace &ws) {
     AssertLockHeld(cs_main);
     AssertLockHeld(m_pool.cs);
-    const CTransactionRef &ptx = ws.m_ptx;
     const CTransaction &tx = *ws.m_ptx;
     const TxId &txid = ws.m_ptx->GetId();
 
     // Copy/alias what we need out of args
-    const int64_t nAcceptTime = args.m_accept_time;
-    const bool bypass_limits = args.m_bypass_limits;
     std::vector<COutPoint> &coins_to_uncache = args.m_coins_to_uncache;
-    const unsigned int heightOverride = args.m_heightOverride;
 
     // Alias what we need out of ws
     TxValidationState &state = ws.m_state;
@@ -729,19 +771,106 @@ bool MemPoolAccept::PreChecks(ATMPArgs &args, Workspace &ws) {
     // ws.m_modified_fess includes any fee deltas from PrioritiseTransaction
     ws.m_modified_fees = ws.m_base_fees;
     m_pool.ApplyDelta(txid, ws.m_modified_fees);
+    ws.m_lock_points = *lock_points;
+    ws.m_precomputed_txdata = PrecomputedTransactionData{tx};
+
+    return true;
+}
+
+void MemPoolAccept::ParallelScriptChecks(
+    const ATMPArgs &args, const std::vector<Workspace *> &workspaces) {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(m_pool.cs);
+
+    // Without worker threads the checks would run serially on this thread
+    // anyway. A single input doesn't benefit from the workers either.
+    const size_t nInputs = std::accumulate(
+        workspaces.begin(), workspaces.end(), size_t{0},
+        [](size_t sum, const Workspace *ws) {
+            return sum + ws->m_ptx->vin.size();
+        });
+    if (nInputs < 2 || !scriptcheckqueue.HasThreads()) {
+        return;
+    }
+
+    const uint32_t scriptVerifyFlags = GetStandardScriptVerifyFlags(
+        args.m_config.GetChainParams().GetConsensus());
+
+    // The checks keep pointers to the limiters, which must outlive them.
+    std::vector<TxSigCheckLimiter> txLimitSigChecks(workspaces.size());
+    // The sigchecks count of the transactions found in the script cache.
+    std::vector<std::optional<int>> cachedSigChecks(workspaces.size());
+    std::vector<CScriptCheck> vChecks;
+    for (size_t i = 0; i < workspaces.size(); ++i) {
+        Workspace &ws = *workspaces[i];
+
+        // With checks deferred to pvChecks, scriptCacheStore=true only
+        // prevents the lookup from evicting a cached entry: nothing is stored.
+        TxValidationState state;
+        int nSigChecks;
+        std::vector<CScriptCheck> vTxChecks;
+        if (!CheckInputScripts(*ws.m_ptx, state, m_view,
+                               ws.m_next_block_script_verify_flags |
+                                   scriptVerifyFlags,
+                               /*sigCacheStore=*/true,
+                               /*scriptCacheStore=*/true,
+                               ws.m_precomputed_txdata, nSigChecks,
+                               txLimitSigChecks[i], nullptr, &vTxChecks)) {
+            // PolicyScriptChecks() reports the failure.
+            return;
+        }
+        if (vTxChecks.empty()) {
+            cachedSigChecks[i] = nSigChecks;
+        }
+        std::move(vTxChecks.begin(), vTxChecks.end(),
+                  std::back_inserter(vChecks));
+    }
+
+    // Not worth waking up the workers.
+    if (vChecks.size() < 2) {
+        return;
+    }
+
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(std::move(vChecks));
+    if (!control.Wait()) {
+        return;
+    }
+
+    // The scripts of every transaction passed, and their checks consumed
+    // their sigchecks count from their fresh limiter.
+    for (size_t i = 0; i < workspaces.size(); ++i) {
+        Workspace &ws = *workspaces[i];
+        ws.m_sig_checks_standard =
+            cachedSigChecks[i]
+                ? *cachedSigChecks[i]
+                : int(MAX_TX_SIGCHECKS - txLimitSigChecks[i].getRemaining());
+        ws.m_scripts_verified = true;
+    }
+}
+
+bool MemPoolAccept::PolicyScriptChecks(const ATMPArgs &args, Workspace &ws) {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(m_pool.cs);
+    const CTransactionRef &ptx = ws.m_ptx;
+    const CTransaction &tx = *ws.m_ptx;
+
+    // Copy/alias what we need out of args
+    const int64_t nAcceptTime = args.m_accept_time;
+    const bool bypass_limits = args.m_bypass_limits;
+    const unsigned int heightOverride = args.m_heightOverride;
+
+    TxValidationState &state = ws.m_state;
 
     unsigned int nSize = tx.GetTotalSize();
 
     // Validate input scripts against standard script flags.
-    uint32_t scriptVerifyFlags = ws.m_next_block_script_verify_flags;
-    if (IsLegacyScriptRulesEnabled(
-            args.m_config.GetChainParams().GetConsensus())) {
-        scriptVerifyFlags |= STANDARD_SCRIPT_VERIFY_FLAGS_LEGACY;
-    } else {
-        scriptVerifyFlags |= STANDARD_SCRIPT_VERIFY_FLAGS;
-    }
-    ws.m_precomputed_txdata = PrecomputedTransactionData{tx};
-    if (!CheckInputScripts(tx, state, m_view, scriptVerifyFlags, true, false,
+    const uint32_t scriptVerifyFlags =
+        ws.m_next_block_script_verify_flags |
+        GetStandardScriptVerifyFlags(
+            args.m_config.GetChainParams().GetConsensus());
+    if (!ws.m_scripts_verified &&
+        !CheckInputScripts(tx, state, m_view, scriptVerifyFlags, true, false,
                            ws.m_precomputed_txdata, ws.m_sig_checks_standard)) {
         // State filled in by CheckInputScripts
         return false;
@@ -750,7 +879,7 @@ bool MemPoolAccept::PreChecks(ATMPArgs &args, Workspace &ws) {
     ws.m_entry = std::make_unique<CTxMemPoolEntry>(
         ptx, ws.m_base_fees, nAcceptTime,
         heightOverride ? heightOverride : m_active_chainstate.m_chain.Height(),
-        ws.m_sig_checks_standard, lock_points.value());
+        ws.m_sig_checks_standard, ws.m_lock_points);
 
     ws.m_vsize = ws.m_entry->GetTxVirtualSize();
 
@@ -971,6 +1100,12 @@ MemPoolAccept::AcceptSingleTransaction(const CTransactionRef &ptx,
     // verification unless those checks pass, to mitigate CPU exhaustion
     // denial-of-service attacks.
     if (!PreChecks(args, ws)) {
+        return MempoolAcceptResult::Failure(ws.m_state);
+    }
+
+    ParallelScriptChecks(args, {&ws});
+
+    if (!PolicyScriptChecks(args, ws)) {
         if (ws.m_state.GetResult() ==
             TxValidationResult::TX_PACKAGE_RECONSIDERABLE) {
             // Failed for fee reasons. Provide the effective feerate and which
@@ -1078,6 +1213,26 @@ PackageMempoolAcceptResult MemPoolAccept::AcceptMultipleTransactions(
         valid_txids.push_back(ws.m_ptx->GetId());
     }
 
+    // All the transactions passed PreChecks, verify the scripts of the whole
+    // package at once on the script check queue workers.
+    std::vector<Workspace *> package_workspaces;
+    package_workspaces.reserve(workspaces.size());
+    for (Workspace &ws : workspaces) {
+        package_workspaces.push_back(&ws);
+    }
+    ParallelScriptChecks(args, package_workspaces);
+
+    for (Workspace &ws : workspaces) {
+        if (!PolicyScriptChecks(args, ws)) {
+            package_state.Invalid(PackageValidationResult::PCKG_TX,
+                                  "transaction failed");
+            results.emplace(ws.m_ptx->GetId(),
+                            MempoolAcceptResult::Failure(ws.m_state));
+            return PackageMempoolAcceptResult(package_state,
+                                              std::move(results));
+        }
+    }
+
     // Transactions must meet two minimum feerates: the mempool minimum fee and
     // min relay fee. For transactions consisting of exactly one child and its
     // parents, it suffices to use the package feerate
@@ -1133,9 +1288,10 @@ PackageMempoolAcceptResult MemPoolAccept::AcceptMultipleTransactions(
             const auto effective_feerate_txids =
                 args.m_package_feerates ? all_package_txids
                                         : std::vector<TxId>{ws.m_ptx->GetId()};
-            // When test_accept=true, transactions that pass PreChecks
-            // are valid because there are no further mempool checks (passing
-            // PreChecks implies passing ConsensusScriptChecks).
+            // When test_accept=true, transactions that pass PreChecks and
+            // PolicyScriptChecks are valid because there are no further
+            // mempool checks (passing PolicyScriptChecks implies passing
+            // ConsensusScriptChecks).
             results.emplace(ws_txid,
                             MempoolAcceptResult::Success(
                                 ws.m_vsize, ws.m_base_fees, effective_feerate,
@@ -1464,6 +1620,72 @@ MempoolAcceptResult AcceptToMemoryPool(Chainstate &active_chainstate,
     return result;
 }
 
+void WarmSignatureCache(Chainstate &active_chainstate,
+                        const std::vector<CTransactionRef> &txs) {
+    AssertLockHeld(::cs_main);
+    assert(active_chainstate.GetMempool() != nullptr);
+    const CTxMemPool &pool{*active_chainstate.GetMempool()};
+
+    if (!scriptcheckqueue.HasThreads()) {
+        return;
+    }
+
+    const uint32_t flags =
+        GetNextBlockScriptFlags(active_chainstate.m_chain.Tip(),
+                                active_chainstate.m_chainman) |
+        GetStandardScriptVerifyFlags(
+            active_chainstate.m_chainman.GetConsensus());
+
+    // The checks keep pointers to the transaction data and to the limiters,
+    // which must outlive them.
+    std::vector<PrecomputedTransactionData> txdata;
+    txdata.reserve(txs.size());
+    std::vector<TxSigCheckLimiter> txLimitSigChecks(txs.size());
+    std::vector<CScriptCheck> vChecks;
+    {
+        LOCK(pool.cs);
+        CCoinsViewCache &coins_cache = active_chainstate.CoinsTip();
+        CCoinsViewMemPool viewMemPool(&coins_cache, pool);
+        CCoinsViewCache view(&viewMemPool);
+        // The coins fetched from disk end up in the coins cache. Evict them
+        // afterwards, as ATMP does for invalid transactions, so warming up
+        // doesn't fill the cache with coins that ATMP may never need.
+        std::vector<COutPoint> coins_to_uncache;
+        for (const CTransactionRef &ptx : txs) {
+            const CTransaction &tx = *ptx;
+            txdata.emplace_back(tx);
+
+            for (const CTxIn &txin : tx.vin) {
+                if (!coins_cache.HaveCoinInCache(txin.prevout)) {
+                    coins_to_uncache.push_back(txin.prevout);
+                }
+            }
+
+            // Make the outputs available to the transactions spending them
+            // later in the batch, whether this one turns out valid or not.
+            if (!tx.IsCoinBase() && view.HaveInputs(tx)) {
+                TxValidationState state;
+                int nSigChecks;
+                CheckInputScripts(tx, state, view, flags,
+                                  /*sigCacheStore=*/true,
+                                  /*scriptCacheStore=*/true, txdata.back(),
+                                  nSigChecks,
+                                  txLimitSigChecks[txdata.size() - 1],
+                                  nullptr, &vChecks);
+            }
+            AddCoins(view, tx, MEMPOOL_HEIGHT, /*check=*/true);
+        }
+
+        for (const COutPoint &outpoint : coins_to_uncache) {
+            coins_cache.Uncache(outpoint);
+        }
+    }
+
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(std::move(vChecks));
+    control.Wait();
+}
+
 PackageMempoolAcceptResult ProcessNewPackage(Chainstate &active_chainstate,
                                              CTxMemPool &pool,
                                              const Package &package,
@@ -2030,16 +2252,6 @@ public:
     }
 };
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
-
-void StartScriptCheckWorkerThreads(int threads_num) {
-    scriptcheckqueue.StartWorkerThreads(threads_num);
-}
-
-void StopScriptCheckWorkerThreads() {
-    scriptcheckqueue.StopWorkerThreads();
-}
-
 static CCheckQueue<CPowCheck> powcheckqueue(128);
 
 void StartPowCheckWorkerThreads(int threads_num) {
@@ -6582,6 +6794,15 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
               base_blockhash.ToString());
     int64_t coins_processed{0};
 
+    // The snapshot is hashed on a background thread while its coins are being
+    // loaded, rather than by scanning the resulting coins database once they
+    // are all flushed. Since the coins are required to be in database order
+    // and unique, the database ends up holding exactly the coins that were
+    // hashed.
+    SnapshotStatsWorker stats_worker{base_height, base_blockhash};
+    SnapshotStatsWorker::CoinsBatch batch;
+    batch.reserve(SnapshotStatsWorker::BATCH_SIZE);
+
     while (coins_left > 0) {
         try {
             coins_file >> outpoint;
@@ -6593,6 +6814,8 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
             return false;
         }
         if (coin.GetHeight() > uint32_t(base_height) ||
+            // A spent coin would not be written to the coins database
+            coin.IsSpent() ||
             // Avoid integer wrap-around in coinstats.cpp:ApplyHash
             outpoint.GetN() >=
                 std::numeric_limits<decltype(outpoint.GetN())>::max()) {
@@ -6601,6 +6824,14 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
                 coins_count - coins_left);
             return false;
         }
+
+        batch.emplace_back(outpoint, coin);
+        if (batch.size() == SnapshotStatsWorker::BATCH_SIZE) {
+            stats_worker.Push(std::move(batch));
+            batch = {};
+            batch.reserve(SnapshotStatsWorker::BATCH_SIZE);
+        }
+
         coins_cache.EmplaceCoinInternalDANGER(std::move(outpoint),
                                               std::move(coin));
 
@@ -6640,6 +6871,9 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
             }
         }
     }
+    if (!batch.empty()) {
+        stats_worker.Push(std::move(batch));
+    }
 
     // Important that we set this. This and the coins_cache accesses above are
     // sort of a layer violation, but either we reach into the innards of
@@ -6662,31 +6896,10 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
         return false;
     }
 
-    LogPrintf("[snapshot] loaded %d (%.2f MB) coins from snapshot %s\n",
-              coins_count, coins_cache.DynamicMemoryUsage() / (1000 * 1000),
-              base_blockhash.ToString());
-
-    // No need to acquire cs_main since this chainstate isn't being used yet.
-    FlushSnapshotToDisk(coins_cache, /*snapshot_loaded=*/true);
-
-    assert(coins_cache.GetBestBlock() == base_blockhash);
-
-    // As above, okay to immediately release cs_main here since no other context
-    // knows about the snapshot_chainstate.
-    CCoinsViewDB *snapshot_coinsdb =
-        WITH_LOCK(::cs_main, return &snapshot_chainstate.CoinsDB());
-
-    std::optional<CCoinsStats> maybe_stats;
-
-    try {
-        maybe_stats = ComputeUTXOStats(CoinStatsHashType::HASH_SERIALIZED,
-                                       snapshot_coinsdb, m_blockman,
-                                       SnapshotUTXOHashBreakpoint);
-    } catch (StopHashingException const &) {
-        return false;
-    }
+    const std::optional<CCoinsStats> maybe_stats{stats_worker.Finish()};
     if (!maybe_stats.has_value()) {
-        LogPrintf("[snapshot] failed to generate coins stats\n");
+        LogPrintf("[snapshot] bad snapshot - coins are not sorted or contain "
+                  "duplicates\n");
         return false;
     }
 
@@ -6700,6 +6913,15 @@ bool ChainstateManager::PopulateAndValidateSnapshot(
         return false;
     }
 
+    LogPrintf("[snapshot] loaded %d (%.2f MB) coins from snapshot %s\n",
+              coins_count, coins_cache.DynamicMemoryUsage() / (1000 * 1000),
+              base_blockhash.ToString());
+
+    // No need to acquire cs_main since this chainstate isn't being used yet.
+    FlushSnapshotToDisk(coins_cache, /*snapshot_loaded=*/true);
+
+    assert(coins_cache.GetBestBlock() == base_blockhash);
+
     snapshot_chainstate.m_chain.SetTip(*snapshot_start_block);
 
     // The remainder of this function requires modifying data protected by
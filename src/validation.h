@@ -363,6 +363,18 @@ AcceptToMemoryPool(Chainstate &active_chainstate, const CTransactionRef &tx,
                    bool test_accept = false, unsigned int heightOverride = 0)
     EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/**
+ * Verify the input scripts of a batch of transactions on the script check
+ * queue workers ahead of submitting them one by one with AcceptToMemoryPool,
+ * so that it finds the signatures in the cache. The transactions must be in
+ * topological order; they may spend each other's outputs. Nothing is
+ * validated: transactions whose inputs can't be found are skipped and
+ * failures are ignored.
+ */
+void WarmSignatureCache(Chainstate &active_chainstate,
+                        const std::vector<CTransactionRef> &txs)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /**
  * Validate (and maybe submit) a package to the mempool.
  * See doc/policy/packages.md for full detailson package validation rules.
@@ -396,6 +408,8 @@ public:
     }
 
     bool check() { return remaining >= 0; }
+
+    int64_t getRemaining() const { return remaining; }
 };
 
 class TxSigCheckLimiter : public CheckInputsLimiter {
@@ -165,6 +165,29 @@ class AddrmanTest(BitcoinTestFramework):
             self.start_node(0)
         assert_equal(self.nodes[0].getnodeaddresses(), [])
 
+        self.log.info("Check that changes are appended to addrman as a journal")
+        empty_size = os.path.getsize(peers_dat)
+        self.restart_node(0, extra_args=["-peersjournal"])
+        self.nodes[0].addpeeraddress(address="1.2.3.4", port=8333)
+        self.nodes[0].addpeeraddress(address="2.3.4.5", port=8333)
+        self.stop_node(0)
+        assert os.path.getsize(peers_dat) > empty_size
+        with self.nodes[0].assert_debug_log(["Loaded 2 addresses from peers.dat"]):
+            self.start_node(0, extra_args=["-peersjournal"])
+        assert_equal(len(self.nodes[0].getnodeaddresses(count=0)), 2)
+
+        self.log.info("Check that a truncated journal is dropped")
+        self.stop_node(0)
+        os.truncate(peers_dat, os.path.getsize(peers_dat) - 1)
+        with self.nodes[0].assert_debug_log(
+            [
+                "Dropping journal 1 and the rest of peers.dat",
+                "Loaded 0 addresses from peers.dat",
+            ]
+        ):
+            self.start_node(0, extra_args=["-peersjournal"])
+        assert_equal(self.nodes[0].getnodeaddresses(), [])
+
 
 if __name__ == "__main__":
     AddrmanTest().main()
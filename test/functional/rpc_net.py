@@ -69,6 +69,7 @@ class NetTest(BitcoinTestFramework):
         self.test_connection_count()
         self.test_getpeerinfo()
         self.test_getnettotals()
+        self.test_getnettimings()
         self.test_getnetworkinfo()
         self.test_getaddednodeinfo()
         self.test_service_flags()
@@ -120,6 +121,45 @@ class NetTest(BitcoinTestFramework):
                 timeout=10,
             )
 
+    def test_getnettimings(self):
+        self.log.info("Test getnettimings")
+        timings_before = self.nodes[0].getnettimings()
+        pongs_before = (
+            timings_before["process_time_per_msg"].get("pong", {}).get("count", 0)
+        )
+        self.nodes[0].ping()
+        self.wait_until(
+            lambda: self.nodes[0]
+            .getnettimings()["process_time_per_msg"]
+            .get("pong", {})
+            .get("count", 0)
+            >= pongs_before + 2,
+            timeout=10,
+        )
+
+        timings = self.nodes[0].getnettimings()
+        for histogram in [
+            timings["process_time_per_msg"]["pong"],
+            timings["queue_wait"],
+            timings["send_stall"],
+            timings["block_relay_delay"],
+        ]:
+            assert_equal(len(histogram["histogram"]), 28)
+            assert_equal(sum(histogram["histogram"]), histogram["count"])
+            assert histogram["p50"] <= histogram["p90"] <= histogram["p99"]
+            assert histogram["p99"] <= histogram["max"]
+        assert_greater_than(
+            timings["queue_wait"]["count"], timings_before["queue_wait"]["count"]
+        )
+
+        for peer in self.nodes[0].getpeerinfo():
+            for field in [
+                "processtime_per_msg",
+                "queue_wait_time",
+                "send_stall_time",
+            ]:
+                assert field in peer.keys()
+
     def test_getnetworkinfo(self):
         self.log.info("Test getnetworkinfo")
         info = self.nodes[0].getnetworkinfo()
@@ -254,7 +294,17 @@ class NetTest(BitcoinTestFramework):
         for node, peer, field in product(
             range(self.num_nodes),
             range(2),
-            ["startingheight", "synced_headers", "synced_blocks", "inflight"],
+            [
+                "startingheight",
+                "synced_headers",
+                "synced_blocks",
+                "inflight",
+                "inflight_limit",
+                "block_latency",
+                "block_download_time",
+                "parallel_block_requests",
+                "block_relay_delay",
+            ],
         ):
             assert field in peer_info[node][peer].keys()
 